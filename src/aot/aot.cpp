@@ -0,0 +1,93 @@
+/*
+ * Author: kayo
+ */
+
+#include <string>
+#include <climits>
+#include <mutex>
+#include <unordered_map>
+#include <dlfcn.h>
+#include "aot.h"
+#include "../kayo.h"
+#include "../objects/Class.h"
+#include "../objects/Method.h"
+#include "../../zlib/zlib.h"
+
+using namespace std;
+
+char aotLibraryPath[PATH_MAX] = { 0 };
+
+// key: className~name~descriptor
+static unordered_map<string, const AotMethodEntry *> aotMethods;
+static mutex aotMethodsMutex;
+
+void initAot()
+{
+    if (aotLibraryPath[0] == 0)
+        return;
+
+    void *handle = dlopen(aotLibraryPath, RTLD_NOW | RTLD_GLOBAL);
+    if (handle == nullptr) {
+        printvm("Unable to load AOT library %s: %s\n", aotLibraryPath, dlerror());
+        return;
+    }
+
+    auto methods = (const AotMethodEntry *) dlsym(handle, AOT_METHODS_SYMBOL);
+    auto count = (const int *) dlsym(handle, AOT_METHODS_COUNT_SYMBOL);
+    if (methods == nullptr or count == nullptr) {
+        printvm("%s is not an AOT library\n", aotLibraryPath);
+        dlclose(handle);
+        return;
+    }
+
+    aotMethods.reserve(*count);
+    for (int i = 0; i < *count; i++) {
+        const AotMethodEntry &e = methods[i];
+        aotMethods.emplace(string(e.className) + '~' + e.name + '~' + e.descriptor, &e);
+    }
+}
+
+void bindAotMethods(Class *c, const u1 *classfile, size_t len)
+{
+    assert(c != nullptr);
+    assert(classfile != nullptr);
+    /*
+     * 编译后的代码把常量池的解析结果缓存在静态变量中，只对一个类有效，
+     * 所以每个编译后的方法只绑定一次，绑定后从表中删除。
+     * 其他类加载器再次加载的同名类解释执行。
+     */
+    lock_guard<mutex> lock(aotMethodsMutex);
+    if (aotMethods.empty())
+        return;
+
+    string key = c->className;
+    key += '~';
+    size_t prefixLen = key.size();
+    bool crcComputed = false;
+    u4 crc = 0;
+
+    for (Method *m : c->methods) {
+        if (m->isNative() or m->code == nullptr)
+            continue;
+
+        key.resize(prefixLen);
+        key.append(m->name).append(1, '~').append(m->descriptor);
+        auto iter = aotMethods.find(key);
+        if (iter == aotMethods.end())
+            continue;
+
+        // 运行时的类与编译时的不同，仍解释执行。CRC 只在类有编译后的方法时计算。
+        const AotMethodEntry *e = iter->second;
+        if (e->classLen != len)
+            continue;
+        if (!crcComputed) {
+            crc = (u4) crc32(0, classfile, (uInt) len);
+            crcComputed = true;
+        }
+        if (e->classCrc != crc)
+            continue;
+
+        m->bindCompiledCode(e->fn);
+        aotMethods.erase(iter);
+    }
+}
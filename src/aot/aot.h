@@ -0,0 +1,53 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_AOT_H
+#define KAYOVM_AOT_H
+
+#include "../jtypes.h"
+#include "../native/registry.h"
+
+class Class;
+
+/*
+ * 预先编译（AOT）的方法。
+ *
+ * 构建时用 kayoaot 工具把 jar 中方法的字节码翻译为 C++（参见 aot/kayoaot.cpp），
+ * 编译为共享库，运行时用 -XX:AOTLibrary=<path> 加载。
+ *
+ * 编译后的方法和本地方法的调用约定相同：void fn(Frame *)，
+ * 参数和局部变量在 frame->lvars 中，操作数栈就是 frame 的操作数栈（GC 会扫描这两处），
+ * 返回值压入 frame 的操作数栈。
+ * 编译后的代码依赖整个类的常量池（常量的类型，字段和方法的描述符，是否 static 等），
+ * 所以只有整个 class 文件与编译时一致（长度和 CRC32 都相同）时，类加载时才改为调用编译后的代码，
+ * 否则这个类的方法都仍然解释执行。
+ */
+
+struct AotMethodEntry {
+    const char *className;
+    const char *name;
+    const char *descriptor;
+    // 编译时 class 文件的长度和 CRC32
+    u4 classLen;
+    u4 classCrc;
+    native_method_t fn;
+};
+
+// 共享库导出的符号
+#define AOT_METHODS_SYMBOL       "kayo_aot_methods"
+#define AOT_METHODS_COUNT_SYMBOL "kayo_aot_methods_count"
+
+// -XX:AOTLibrary=<path>
+extern char aotLibraryPath[];
+
+// 加载 aotLibraryPath 指定的共享库，未指定时什么都不做
+void initAot();
+
+/*
+ * 为 @c 中有编译代码的方法绑定编译后的代码，在类解析完成时调用。
+ * @classfile 和 @len 是定义 @c 的 class 文件。
+ */
+void bindAotMethods(Class *c, const u1 *classfile, size_t len);
+
+#endif //KAYOVM_AOT_H
@@ -0,0 +1,337 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_AOT_RUNTIME_H
+#define KAYOVM_AOT_RUNTIME_H
+
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include "aot.h"
+#include "../objects/slot.h"
+#include "../objects/Class.h"
+#include "../objects/Method.h"
+#include "../objects/Field.h"
+#include "../objects/Array.h"
+#include "../objects/class_loader.h"
+#include "../runtime/Frame.h"
+#include "../runtime/Thread.h"
+#include "../interpreter/interpreter.h"
+
+/*
+ * kayoaot 生成的代码所使用的运行时支持，只被生成的代码包含。
+ *
+ * 生成的每个方法中，stk 指向 frame 的操作数栈底，lvars 是 frame 的局部变量表，
+ * 每条指令的操作数栈深度在编译时已经算出，所以栈上的值都以固定下标访问。
+ * 语义与解释器相同，常量池的解析结果缓存在每个调用点的静态变量中。
+ * 静态字段和静态方法在类初始化完成后才缓存，此后的访问不再检查类是否已初始化。
+ */
+
+#define AOT_I(p) ISLOT(p)
+#define AOT_F(p) FSLOT(p)
+#define AOT_L(p) LSLOT(p)
+#define AOT_D(p) DSLOT(p)
+#define AOT_R(p) RSLOT(p)
+
+namespace aot {
+
+static inline jref nonNull(jref o)
+{
+    if (o == jnull)
+        thread_throw(new NullPointerException);
+    return o;
+}
+
+static inline Array *checkedArray(jref a, jint index)
+{
+    auto arr = (Array *) nonNull(a);
+    if (!arr->checkBounds(index))
+        thread_throw(new ArrayIndexOutOfBoundsException);
+    return arr;
+}
+
+template <typename T>
+static inline T aload(jref a, jint index)
+{
+    return checkedArray(a, index)->get<T>(index);
+}
+
+template <typename T>
+static inline void astore(jref a, jint index, T value)
+{
+    checkedArray(a, index)->set<T>(index, value);
+}
+
+static inline Field *field(ConstantPool &cp, u2 index, Field *&cache)
+{
+    if (cache == nullptr)
+        cache = cp.resolveField(index);
+    return cache;
+}
+
+// 类还没有初始化完成时才调用 initClass
+static inline void ensureInited(Class *c)
+{
+    if (c->state != Class::INITED)
+        initClass(c);
+}
+
+static inline Field *staticField(ConstantPool &cp, u2 index, Field *&cache)
+{
+    if (cache != nullptr)
+        return cache;
+    Field *f = cp.resolveField(index);
+    ensureInited(f->clazz);
+    // 类正在初始化时（<clinit> 还在执行）不缓存，其他线程仍要等待初始化完成
+    if (f->clazz->state == Class::INITED)
+        cache = f;
+    return f;
+}
+
+static inline Class *klass(ConstantPool &cp, u2 index, Class *&cache)
+{
+    if (cache == nullptr)
+        cache = cp.resolveClass(index);
+    return cache;
+}
+
+template <typename T>
+static inline T getField(jref o, Field *f)
+{
+    return *(T *) ((u1 *) nonNull(o) + f->offset);
+}
+
+template <typename T>
+static inline void putField(jref o, Field *f, T value)
+{
+    *(T *) ((u1 *) nonNull(o) + f->offset) = value;
+}
+
+/*
+ * 调用 @m，参数在 @args 中，返回值（@retSlots 个）复制到 @args 处。
+ * 编译后的方法在新的 frame 上直接调用，其余的方法由解释器执行。
+ * 被调用的方法抛出的异常以 Throwable 传播出去，
+ * 由 invokenative 转为调用者帧中的 athrow.
+ */
+static inline void invoke(Method *m, slot_t *args, int retSlots)
+{
+    if (m->isAbstract())
+        thread_throw(new AbstractMethodError);
+
+    slot_t *ret;
+    if (m->compiled) {
+        Thread *thread = getCurrentThread();
+        Frame *frame = thread->allocFrame(m, true);
+        for (int i = 0; i < m->arg_slot_count; i++)
+            frame->lvars[i] = args[i];
+        try {
+            m->nativeMethod(frame);
+        } catch (Throwable &) {
+            thread->popFrame();
+            throw;
+        }
+        // 编译后的代码把返回值放在操作数栈底，frame->ostack 指向返回值之后
+        ret = frame->ostack - retSlots;
+        thread->popFrame();
+    } else {
+        ret = execJavaFuncThrows(m, args);
+    }
+
+    for (int i = 0; i < retSlots; i++)
+        args[i] = ret[i];
+}
+
+static inline Method *staticMethod(ConstantPool &cp, u2 index, Method *&cache)
+{
+    if (cache != nullptr)
+        return cache;
+    Method *m = cp.resolveMethod(index);
+    ensureInited(m->clazz);
+    if (m->clazz->state == Class::INITED)
+        cache = m;
+    return m;
+}
+
+static inline Method *virtualMethod(ConstantPool &cp, u2 index, Method *&cache, jref obj)
+{
+    if (cache == nullptr)
+        cache = cp.resolveMethod(index);
+    Method *m = cache;
+    Class *c = nonNull(obj)->clazz;
+    return m->vtableIndex >= 0 ? c->vtable[m->vtableIndex] : m;
+}
+
+/*
+ * invokeinterface 调用点的缓存。
+ * vtableIndex 是上次选中的方法在接收者类的 vtable 中的下标，
+ * 接收者类的 vtable 在此下标处的方法与接口方法同名同描述符时，它就是要调用的方法，
+ * 所以不缓存接收者的类，类被卸载后缓存也不会失效。
+ */
+struct InterfaceCallSite {
+    Method *resolved = nullptr;
+    std::atomic<int> vtableIndex{-1};
+};
+
+static inline Method *interfaceMethod(ConstantPool &cp, u2 index, InterfaceCallSite &site, jref obj)
+{
+    if (site.resolved == nullptr)
+        site.resolved = cp.resolveInterfaceMethod(index);
+    Method *resolved = site.resolved;
+    Class *c = nonNull(obj)->clazz;
+
+    int i = site.vtableIndex.load(std::memory_order_relaxed);
+    if (i >= 0 and (size_t) i < c->vtable.size()) {
+        Method *m = c->vtable[i];
+        if (m->name == resolved->name and m->descriptor == resolved->descriptor and !m->isAbstract())
+            return m;
+    }
+
+    Method *m = c->lookupMethod(resolved->name, resolved->descriptor);
+    if (m == nullptr or m->isAbstract())
+        thread_throw(new AbstractMethodError);
+    // 接口的 default 方法不在类的 vtable 中，不缓存
+    if (m->vtableIndex >= 0 and !m->clazz->isInterface())
+        site.vtableIndex.store(m->vtableIndex, std::memory_order_relaxed);
+    return m;
+}
+
+// 与解释器的 invokespecial 相同
+static inline Method *specialMethod(Class *clazz, ConstantPool &cp, u2 index, Method *&cache, jref obj)
+{
+    nonNull(obj);
+    if (cache == nullptr) {
+        Method *m = cp.resolveMethod(index);
+        if (m->clazz->isSuper()
+            and !m->isPrivate()
+            and clazz->isSubclassOf(m->clazz)
+            and m->name != S(object_init)) {
+            m = clazz->superClass->lookupMethod(m->name, m->descriptor);
+        }
+        cache = m;
+    }
+    return cache;
+}
+
+static inline jref newInstance(ConstantPool &cp, u2 index, Class *&cache)
+{
+    Class *c = klass(cp, index, cache);
+    ensureInited(c);
+    if (c->isInterface() or c->isAbstract())
+        thread_throw(new InstantiationException);
+    return newObject(c);
+}
+
+static inline jref newPrimArray(const char *arrClassName, Class *&cache, jint len)
+{
+    if (len < 0)
+        thread_throw(new NegativeArraySizeException);
+    if (cache == nullptr)
+        cache = loadArrayClass(arrClassName);
+    return newArray(cache, len);
+}
+
+static inline jref newRefArray(ConstantPool &cp, u2 index, Class *&cache, jint len)
+{
+    if (len < 0)
+        thread_throw(new NegativeArraySizeException);
+    if (cache == nullptr)
+        cache = cp.resolveClass(index)->arrayClass();
+    return newArray(cache, len);
+}
+
+static inline jint arrayLength(jref a)
+{
+    return ((Array *) nonNull(a))->len;
+}
+
+static inline void checkcast(ConstantPool &cp, u2 index, Class *&cache, jref obj)
+{
+    if (obj != jnull and !obj->isInstanceOf(klass(cp, index, cache)))
+        thread_throw(new ClassCastException);
+}
+
+static inline jint instanceOf(ConstantPool &cp, u2 index, Class *&cache, jref obj)
+{
+    return obj != jnull and obj->isInstanceOf(klass(cp, index, cache)) ? 1 : 0;
+}
+
+[[noreturn]] static inline void athrow(jref eo)
+{
+    throw Throwable(nonNull(eo));
+}
+
+/* 整数运算，按 Java 的语义处理除零和溢出 */
+
+static inline jint idiv(jint a, jint b)
+{
+    if (b == 0)
+        thread_throw(new ArithmeticException("/ by zero"));
+    return b == -1 ? (jint) (0u - (u4) a) : a / b;
+}
+
+static inline jint irem(jint a, jint b)
+{
+    if (b == 0)
+        thread_throw(new ArithmeticException("/ by zero"));
+    return b == -1 ? 0 : a % b;
+}
+
+static inline jlong ldiv(jlong a, jlong b)
+{
+    if (b == 0)
+        thread_throw(new ArithmeticException("/ by zero"));
+    return b == -1 ? (jlong) (0ull - (unsigned long long) a) : a / b;
+}
+
+static inline jlong lrem(jlong a, jlong b)
+{
+    if (b == 0)
+        thread_throw(new ArithmeticException("/ by zero"));
+    return b == -1 ? 0 : a % b;
+}
+
+static inline jint ishl(jint a, jint s)  { return (jint) ((u4) a << (s & 0x1f)); }
+static inline jint ishr(jint a, jint s)  { return a >> (s & 0x1f); }
+static inline jint iushr(jint a, jint s) { return (jint) ((u4) a >> (s & 0x1f)); }
+static inline jlong lshl(jlong a, jint s)  { return (jlong) ((unsigned long long) a << (s & 0x3f)); }
+static inline jlong lshr(jlong a, jint s)  { return a >> (s & 0x3f); }
+static inline jlong lushr(jlong a, jint s) { return (jlong) ((unsigned long long) a >> (s & 0x3f)); }
+
+static inline jint iadd(jint a, jint b) { return (jint) ((u4) a + (u4) b); }
+static inline jint isub(jint a, jint b) { return (jint) ((u4) a - (u4) b); }
+static inline jint imul(jint a, jint b) { return (jint) ((u4) a * (u4) b); }
+static inline jint ineg(jint a)         { return (jint) (0u - (u4) a); }
+static inline jlong ladd(jlong a, jlong b) { return (jlong) ((unsigned long long) a + (unsigned long long) b); }
+static inline jlong lsub(jlong a, jlong b) { return (jlong) ((unsigned long long) a - (unsigned long long) b); }
+static inline jlong lmul(jlong a, jlong b) { return (jlong) ((unsigned long long) a * (unsigned long long) b); }
+static inline jlong lneg(jlong a)          { return (jlong) (0ull - (unsigned long long) a); }
+
+// 浮点数转整数：NaN 为 0，超出范围的取边界值
+template <typename T, typename F>
+static inline T f2int(F f)
+{
+    if (std::isnan(f))
+        return 0;
+    if (f <= (F) std::numeric_limits<T>::min())
+        return std::numeric_limits<T>::min();
+    if (f >= (F) std::numeric_limits<T>::max())
+        return std::numeric_limits<T>::max();
+    return (T) f;
+}
+
+// fcmpl/dcmpl 遇到 NaN 得 -1，fcmpg/dcmpg 得 1
+template <typename F>
+static inline jint fcmp(F v1, F v2, jint nan)
+{
+    return v1 > v2 ? 1 : (v1 == v2 ? 0 : (v1 < v2 ? -1 : nan));
+}
+
+static inline jint lcmp(jlong v1, jlong v2)
+{
+    return v1 > v2 ? 1 : (v1 == v2 ? 0 : -1);
+}
+
+}
+
+#endif //KAYOVM_AOT_RUNTIME_H
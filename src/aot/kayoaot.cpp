@@ -0,0 +1,1274 @@
+/*
+ * Author: kayo
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdarg>
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <algorithm>
+#include "../jtypes.h"
+#include "../classfile/constant.h"
+#include "../objects/Modifier.h"
+#include "../interpreter/interpreter.h"
+#include "../util/JarFile.h"
+#include "aot.h"
+#include "../../zlib/zlib.h"
+
+using namespace std;
+
+/*
+ * kayoaot: 构建时把 jar 中类的方法翻译为 C++ 代码，参见 aot/aot.h
+ *
+ * 用法：kayoaot [-p <class name prefix>]... -o <out.cpp> <jar>...
+ *
+ * -p 只编译类名（如 java/lang/）以此为前缀的类，可以指定多次，不指定时编译所有的类。
+ *
+ * 只编译满足以下条件的方法，其余的方法运行时仍解释执行：
+ *   1. 不是 native, abstract 或 synchronized 方法；
+ *   2. 没有异常处理表（异常以 C++ 异常的形式传播，编译后的代码中无法捕获）；
+ *   3. 不包含 jsr, ret, monitorenter, monitorexit, invokedynamic, multianewarray 指令；
+ *   4. 每条指令的操作数栈深度都可以静态确定。
+ */
+
+static void usage()
+{
+    printf("Usage: kayoaot [-p <class name prefix>]... -o <out.cpp> <jar>...\n");
+    exit(0);
+}
+
+static string format(const char *fmt, ...)
+{
+    char buf[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return buf;
+}
+
+// 把 modified UTF-8 的字节转为 C 字符串字面量的内容
+static string escape(const string &s)
+{
+    string r;
+    for (unsigned char c : s) {
+        if (c == '"' or c == '\\' or c == '?' or c < 0x20 or c >= 0x7f)
+            r += format("\\%03o", c);
+        else
+            r += (char) c;
+    }
+    return r;
+}
+
+/* -------------------------- class file -------------------------- */
+
+class ClassReader {
+    const u1 *p;
+    const u1 *end;
+
+public:
+    bool overflow = false;
+
+    ClassReader(const u1 *data, size_t len): p(data), end(data + len) { }
+
+    const u1 *curr() const
+    {
+        return p;
+    }
+
+    const u1 *skip(size_t n)
+    {
+        const u1 *q = p;
+        if ((size_t) (end - p) < n) {
+            overflow = true;
+            p = end;
+        } else {
+            p += n;
+        }
+        return q;
+    }
+
+    u1 readu1()
+    {
+        const u1 *q = skip(1);
+        return overflow ? 0 : q[0];
+    }
+
+    u2 readu2()
+    {
+        const u1 *q = skip(2);
+        return overflow ? 0 : (u2) (q[0] << 8 | q[1]);
+    }
+
+    u4 readu4()
+    {
+        const u1 *q = skip(4);
+        return overflow ? 0 : (u4) q[0] << 24 | (u4) q[1] << 16 | (u4) q[2] << 8 | q[3];
+    }
+};
+
+struct Constant {
+    u1 tag = CONSTANT_Invalid;
+    u2 v1 = 0; // Class, String, MethodType: index; 其他引用类型：第一个 index
+    u2 v2 = 0; // 第二个 index
+    string utf8;
+};
+
+struct MethodInfo {
+    jint modifiers;
+    string name;
+    string descriptor;
+
+    const u1 *code = nullptr;
+    u4 codeLen = 0;
+    u2 maxStack = 0;
+    u2 maxLocals = 0;
+    u2 exceptionTablesCount = 0;
+};
+
+struct ClassFile {
+    vector<Constant> cp;
+    string className;
+    vector<MethodInfo> methods;
+
+    bool parse(const u1 *data, size_t len);
+
+    const string &utf8(u2 i) const
+    {
+        static const string empty;
+        return i < cp.size() and cp[i].tag == CONSTANT_Utf8 ? cp[i].utf8 : empty;
+    }
+
+    const string &className0(u2 i) const
+    {
+        return utf8(cp[i].v1);
+    }
+
+    // Fieldref, Methodref, InterfaceMethodref 的 class name, name 和 descriptor
+    const string &refClassName(u2 i) const
+    {
+        return className0(cp[i].v1);
+    }
+
+    const string &refName(u2 i) const
+    {
+        return utf8(cp[cp[i].v2].v1);
+    }
+
+    const string &refDescriptor(u2 i) const
+    {
+        return utf8(cp[cp[i].v2].v2);
+    }
+
+    bool isRef(u2 i, u1 tag) const
+    {
+        return i < cp.size() and cp[i].tag == tag
+               and cp[i].v1 < cp.size() and cp[cp[i].v1].tag == CONSTANT_Class
+               and cp[i].v2 < cp.size() and cp[cp[i].v2].tag == CONSTANT_NameAndType;
+    }
+};
+
+bool ClassFile::parse(const u1 *data, size_t len)
+{
+    ClassReader r(data, len);
+
+    if (r.readu4() != 0xcafebabe)
+        return false;
+    r.readu2(); // minor version
+    r.readu2(); // major version
+
+    u2 cpCount = r.readu2();
+    cp.resize(cpCount);
+    for (u2 i = 1; i < cpCount and !r.overflow; i++) {
+        Constant &c = cp[i];
+        c.tag = r.readu1();
+        switch (c.tag) {
+            case CONSTANT_Utf8: {
+                u2 n = r.readu2();
+                c.utf8.assign((const char *) r.skip(n), r.overflow ? 0 : n);
+                break;
+            }
+            case CONSTANT_Integer:
+            case CONSTANT_Float:
+                r.readu4();
+                break;
+            case CONSTANT_Long:
+            case CONSTANT_Double:
+                r.readu4();
+                r.readu4();
+                i++; // 占两项
+                break;
+            case CONSTANT_Class:
+            case CONSTANT_String:
+            case CONSTANT_MethodType:
+            case CONSTANT_Module:
+            case CONSTANT_Package:
+                c.v1 = r.readu2();
+                break;
+            case CONSTANT_Fieldref:
+            case CONSTANT_Methodref:
+            case CONSTANT_InterfaceMethodref:
+            case CONSTANT_NameAndType:
+            case CONSTANT_Dynamic:
+            case CONSTANT_InvokeDynamic:
+                c.v1 = r.readu2();
+                c.v2 = r.readu2();
+                break;
+            case CONSTANT_MethodHandle:
+                c.v1 = r.readu1();
+                c.v2 = r.readu2();
+                break;
+            default:
+                return false;
+        }
+    }
+
+    r.readu2(); // access flags
+    u2 thisClass = r.readu2();
+    if (r.overflow or thisClass >= cpCount or cp[thisClass].tag != CONSTANT_Class)
+        return false;
+    className = className0(thisClass);
+    r.readu2(); // super class
+
+    r.skip(2 * r.readu2()); // interfaces
+
+    u2 fieldsCount = r.readu2();
+    for (u2 i = 0; i < fieldsCount and !r.overflow; i++) {
+        r.skip(6);
+        u2 attrCount = r.readu2();
+        for (u2 j = 0; j < attrCount and !r.overflow; j++) {
+            r.readu2();
+            r.skip(r.readu4());
+        }
+    }
+
+    u2 methodsCount = r.readu2();
+    for (u2 i = 0; i < methodsCount and !r.overflow; i++) {
+        MethodInfo m;
+        m.modifiers = r.readu2();
+        m.name = utf8(r.readu2());
+        m.descriptor = utf8(r.readu2());
+
+        u2 attrCount = r.readu2();
+        for (u2 j = 0; j < attrCount and !r.overflow; j++) {
+            const string &attrName = utf8(r.readu2());
+            u4 attrLen = r.readu4();
+            const u1 *attrEnd = r.curr() + attrLen;
+            if (attrName == "Code") {
+                m.maxStack = r.readu2();
+                m.maxLocals = r.readu2();
+                m.codeLen = r.readu4();
+                m.code = r.skip(m.codeLen);
+                m.exceptionTablesCount = r.readu2();
+            }
+            r.skip(attrEnd - r.curr());
+        }
+        methods.push_back(m);
+    }
+
+    return !r.overflow;
+}
+
+/* -------------------------- translator -------------------------- */
+
+static int slotsOf(char type)
+{
+    return type == 'J' or type == 'D' ? 2 : (type == 'V' ? 0 : 1);
+}
+
+// 参数占用的 slot 数（不包括 this）
+static int argSlotsOf(const string &descriptor)
+{
+    int slots = 0;
+    for (size_t i = 1; i < descriptor.size() and descriptor[i] != ')'; i++) {
+        slots += slotsOf(descriptor[i]);
+        while (descriptor[i] == '[')
+            i++;
+        if (descriptor[i] == 'L')
+            i = descriptor.find(';', i);
+        if (i == string::npos)
+            return -1;
+    }
+    return slots;
+}
+
+static char returnTypeOf(const string &descriptor)
+{
+    size_t i = descriptor.find(')');
+    return i == string::npos or i + 1 >= descriptor.size() ? 0 : descriptor[i + 1];
+}
+
+/*
+ * 翻译一个方法。
+ *
+ * 先做一遍数据流分析，算出每条指令开始执行时操作数栈的深度（slot 数），
+ * 然后逐条指令生成代码，栈上的值都以 stk[深度] 的形式访问。
+ */
+class MethodTranslator {
+    const ClassFile &cf;
+    const MethodInfo &m;
+    const u1 *code;
+
+    vector<int> depth;      // -1 表示不可达
+    vector<bool> boundary;  // 是否是指令的起始位置
+    vector<bool> target;    // 是否是跳转目标
+
+    set<string> caches;
+    string decls;
+    string body;
+
+    bool error = false;
+
+    u2 u2At(u4 pc) const { return (u2) (code[pc] << 8 | code[pc + 1]); }
+    s4 s4At(u4 pc) const { return (s4) ((u4) code[pc] << 24 | (u4) code[pc + 1] << 16 | (u4) code[pc + 2] << 8 | code[pc + 3]); }
+
+    int instrLen(u4 pc) const;
+    bool stackEffect(u4 pc, int &pops, int &pushes) const;
+    void successors(u4 pc, vector<u4> &succs, bool &fallThrough) const;
+
+    bool analyze();
+
+    void emit(const char *fmt, ...);
+    string cache(const char *type, const char *prefix, u4 i);
+    string callSite(u4 i);
+    void translate(u4 pc, int d);
+
+public:
+    MethodTranslator(const ClassFile &cf, const MethodInfo &m): cf(cf), m(m), code(m.code) { }
+
+    /*
+     * 生成名为 @fnName 的函数，不能编译时返回 false.
+     */
+    bool translate(const string &fnName, string &out);
+};
+
+int MethodTranslator::instrLen(u4 pc) const
+{
+    u1 opcode = code[pc];
+    switch (opcode) {
+        case OPC_TABLESWITCH: {
+            u4 base = (pc + 4) & ~3u; // 跳过 0~3 个对齐字节
+            if (base + 12 > m.codeLen)
+                return -1;
+            s4 low = s4At(base + 4);
+            s4 high = s4At(base + 8);
+            if (high < low or (int64_t) high - low + 1 > (m.codeLen - base) / 4)
+                return -1;
+            return (int) (base - pc + 12 + 4 * ((int64_t) high - low + 1));
+        }
+        case OPC_LOOKUPSWITCH: {
+            u4 base = (pc + 4) & ~3u;
+            if (base + 8 > m.codeLen)
+                return -1;
+            s4 npairs = s4At(base + 4);
+            if (npairs < 0 or (u4) npairs > (m.codeLen - base) / 8)
+                return -1;
+            return (int) (base - pc + 8 + 8 * npairs);
+        }
+        case OPC_WIDE:
+            if (pc + 1 >= m.codeLen)
+                return -1;
+            return code[pc + 1] == OPC_IINC ? 6 : 4;
+        case OPC_BIPUSH: case OPC_LDC: case OPC_NEWARRAY:
+        case OPC_ILOAD: case OPC_LLOAD: case OPC_FLOAD: case OPC_DLOAD: case OPC_ALOAD:
+        case OPC_ISTORE: case OPC_LSTORE: case OPC_FSTORE: case OPC_DSTORE: case OPC_ASTORE:
+        case OPC_RET:
+            return 2;
+        case OPC_SIPUSH: case OPC_LDC_W: case OPC_LDC2_W: case OPC_IINC:
+        case OPC_GETSTATIC: case OPC_PUTSTATIC: case OPC_GETFIELD: case OPC_PUTFIELD:
+        case OPC_INVOKEVIRTUAL: case OPC_INVOKESPECIAL: case OPC_INVOKESTATIC:
+        case OPC_NEW: case OPC_ANEWARRAY: case OPC_CHECKCAST: case OPC_INSTANCEOF:
+        case OPC_IFNULL: case OPC_IFNONNULL:
+            return 3;
+        case OPC_MULTIANEWARRAY:
+            return 4;
+        case OPC_INVOKEINTERFACE: case OPC_INVOKEDYNAMIC: case OPC_GOTO_W: case OPC_JSR_W:
+            return 5;
+        default:
+            if (OPC_IFEQ <= opcode and opcode <= OPC_JSR)
+                return 3;
+            return opcode <= OPC_JSR_W ? 1 : -1;
+    }
+}
+
+/*
+ * 指令弹出和压入操作数栈的 slot 数，不支持的指令返回 false.
+ */
+bool MethodTranslator::stackEffect(u4 pc, int &pops, int &pushes) const
+{
+    u1 opcode = code[pc];
+    pops = pushes = 0;
+
+    switch (opcode) {
+        case OPC_NOP: case OPC_IINC: case OPC_GOTO: case OPC_GOTO_W: case OPC_RETURN:
+            return true;
+        case OPC_ACONST_NULL: case OPC_BIPUSH: case OPC_SIPUSH:
+        case OPC_NEW:
+            pushes = 1;
+            return true;
+        case OPC_LDC:
+        case OPC_LDC_W: {
+            u2 i = opcode == OPC_LDC ? code[pc + 1] : u2At(pc + 1);
+            if (i >= cf.cp.size())
+                return false;
+            u1 tag = cf.cp[i].tag;
+            // ldc MethodType, MethodHandle, Dynamic 不编译
+            pushes = 1;
+            return tag == CONSTANT_Integer or tag == CONSTANT_Float
+                   or tag == CONSTANT_String or tag == CONSTANT_Class;
+        }
+        case OPC_LDC2_W: {
+            u2 i = u2At(pc + 1);
+            pushes = 2;
+            return i < cf.cp.size() and (cf.cp[i].tag == CONSTANT_Long or cf.cp[i].tag == CONSTANT_Double);
+        }
+        case OPC_ILOAD: case OPC_FLOAD: case OPC_ALOAD:
+            pushes = 1;
+            return true;
+        case OPC_LLOAD: case OPC_DLOAD:
+            pushes = 2;
+            return true;
+        case OPC_ISTORE: case OPC_FSTORE: case OPC_ASTORE:
+            pops = 1;
+            return true;
+        case OPC_LSTORE: case OPC_DSTORE:
+            pops = 2;
+            return true;
+        case OPC_IALOAD: case OPC_FALOAD: case OPC_AALOAD:
+        case OPC_BALOAD: case OPC_CALOAD: case OPC_SALOAD:
+            pops = 2; pushes = 1;
+            return true;
+        case OPC_LALOAD: case OPC_DALOAD:
+            pops = 2; pushes = 2;
+            return true;
+        case OPC_IASTORE: case OPC_FASTORE: case OPC_AASTORE:
+        case OPC_BASTORE: case OPC_CASTORE: case OPC_SASTORE:
+            pops = 3;
+            return true;
+        case OPC_LASTORE: case OPC_DASTORE:
+            pops = 4;
+            return true;
+        case OPC_POP:     pops = 1; return true;
+        case OPC_POP2:    pops = 2; return true;
+        case OPC_DUP:     pops = 1; pushes = 2; return true;
+        case OPC_DUP_X1:  pops = 2; pushes = 3; return true;
+        case OPC_DUP_X2:  pops = 3; pushes = 4; return true;
+        case OPC_DUP2:    pops = 2; pushes = 4; return true;
+        case OPC_DUP2_X1: pops = 3; pushes = 5; return true;
+        case OPC_DUP2_X2: pops = 4; pushes = 6; return true;
+        case OPC_SWAP:    pops = 2; pushes = 2; return true;
+        case OPC_IADD: case OPC_ISUB: case OPC_IMUL: case OPC_IDIV: case OPC_IREM:
+        case OPC_FADD: case OPC_FSUB: case OPC_FMUL: case OPC_FDIV: case OPC_FREM:
+        case OPC_ISHL: case OPC_ISHR: case OPC_IUSHR: case OPC_IAND: case OPC_IOR: case OPC_IXOR:
+        case OPC_FCMPL: case OPC_FCMPG:
+            pops = 2; pushes = 1;
+            return true;
+        case OPC_LADD: case OPC_LSUB: case OPC_LMUL: case OPC_LDIV: case OPC_LREM:
+        case OPC_DADD: case OPC_DSUB: case OPC_DMUL: case OPC_DDIV: case OPC_DREM:
+        case OPC_LAND: case OPC_LOR: case OPC_LXOR:
+            pops = 4; pushes = 2;
+            return true;
+        case OPC_LSHL: case OPC_LSHR: case OPC_LUSHR:
+            pops = 3; pushes = 2;
+            return true;
+        case OPC_LCMP: case OPC_DCMPL: case OPC_DCMPG:
+            pops = 4; pushes = 1;
+            return true;
+        case OPC_INEG: case OPC_FNEG: case OPC_I2F: case OPC_F2I:
+        case OPC_I2B: case OPC_I2C: case OPC_I2S:
+        case OPC_NEWARRAY: case OPC_ANEWARRAY: case OPC_ARRAYLENGTH:
+        case OPC_CHECKCAST: case OPC_INSTANCEOF:
+            pops = 1; pushes = 1;
+            return true;
+        case OPC_LNEG: case OPC_DNEG: case OPC_L2D: case OPC_D2L:
+            pops = 2; pushes = 2;
+            return true;
+        case OPC_I2L: case OPC_I2D: case OPC_F2L: case OPC_F2D:
+            pops = 1; pushes = 2;
+            return true;
+        case OPC_L2I: case OPC_L2F: case OPC_D2I: case OPC_D2F:
+            pops = 2; pushes = 1;
+            return true;
+        case OPC_IFEQ: case OPC_IFNE: case OPC_IFLT: case OPC_IFGE: case OPC_IFGT: case OPC_IFLE:
+        case OPC_IFNULL: case OPC_IFNONNULL:
+        case OPC_TABLESWITCH: case OPC_LOOKUPSWITCH:
+        case OPC_IRETURN: case OPC_FRETURN: case OPC_ARETURN:
+        case OPC_ATHROW:
+            pops = 1;
+            return true;
+        case OPC_IF_ICMPEQ: case OPC_IF_ICMPNE: case OPC_IF_ICMPLT:
+        case OPC_IF_ICMPGE: case OPC_IF_ICMPGT: case OPC_IF_ICMPLE:
+        case OPC_IF_ACMPEQ: case OPC_IF_ACMPNE:
+        case OPC_LRETURN: case OPC_DRETURN:
+            pops = 2;
+            return true;
+        case OPC_GETSTATIC: case OPC_PUTSTATIC: case OPC_GETFIELD: case OPC_PUTFIELD: {
+            u2 i = u2At(pc + 1);
+            if (!cf.isRef(i, CONSTANT_Fieldref))
+                return false;
+            int slots = slotsOf(cf.refDescriptor(i)[0]);
+            if (opcode == OPC_GETSTATIC) {
+                pushes = slots;
+            } else if (opcode == OPC_PUTSTATIC) {
+                pops = slots;
+            } else if (opcode == OPC_GETFIELD) {
+                pops = 1;
+                pushes = slots;
+            } else {
+                pops = 1 + slots;
+            }
+            return true;
+        }
+        case OPC_INVOKEVIRTUAL: case OPC_INVOKESPECIAL:
+        case OPC_INVOKESTATIC: case OPC_INVOKEINTERFACE: {
+            u2 i = u2At(pc + 1);
+            if (!cf.isRef(i, opcode == OPC_INVOKEINTERFACE ? CONSTANT_InterfaceMethodref : CONSTANT_Methodref)
+                and !(opcode != OPC_INVOKEVIRTUAL and cf.isRef(i, CONSTANT_InterfaceMethodref)))
+                return false;
+            // MethodHandle.invoke/invokeExact 等签名多态的方法由解释器处理
+            if (cf.refClassName(i) == "java/lang/invoke/MethodHandle"
+                or cf.refClassName(i) == "java/lang/invoke/VarHandle")
+                return false;
+            const string &descriptor = cf.refDescriptor(i);
+            int args = argSlotsOf(descriptor);
+            if (args < 0)
+                return false;
+            pops = args + (opcode == OPC_INVOKESTATIC ? 0 : 1);
+            pushes = slotsOf(returnTypeOf(descriptor));
+            return true;
+        }
+        case OPC_WIDE:
+            switch (code[pc + 1]) {
+                case OPC_ILOAD: case OPC_FLOAD: case OPC_ALOAD: pushes = 1; return true;
+                case OPC_LLOAD: case OPC_DLOAD: pushes = 2; return true;
+                case OPC_ISTORE: case OPC_FSTORE: case OPC_ASTORE: pops = 1; return true;
+                case OPC_LSTORE: case OPC_DSTORE: pops = 2; return true;
+                case OPC_IINC: return true;
+                default: return false; // wide ret
+            }
+        default:
+            if (OPC_ICONST_M1 <= opcode and opcode <= OPC_ICONST_5) {
+                pushes = 1;
+                return true;
+            }
+            if (opcode == OPC_FCONST_0 or opcode == OPC_FCONST_1 or opcode == OPC_FCONST_2) {
+                pushes = 1;
+                return true;
+            }
+            if (opcode == OPC_LCONST_0 or opcode == OPC_LCONST_1
+                or opcode == OPC_DCONST_0 or opcode == OPC_DCONST_1) {
+                pushes = 2;
+                return true;
+            }
+            if ((OPC_ILOAD_0 <= opcode and opcode <= OPC_FLOAD_3)
+                or (OPC_ALOAD_0 <= opcode and opcode <= OPC_ALOAD_3)) {
+                pushes = (OPC_LLOAD_0 <= opcode and opcode <= OPC_LLOAD_3) ? 2 : 1;
+                return true;
+            }
+            if (OPC_DLOAD_0 <= opcode and opcode <= OPC_DLOAD_3) {
+                pushes = 2;
+                return true;
+            }
+            if (OPC_ISTORE_0 <= opcode and opcode <= OPC_ASTORE_3) {
+                pops = ((OPC_LSTORE_0 <= opcode and opcode <= OPC_LSTORE_3)
+                        or (OPC_DSTORE_0 <= opcode and opcode <= OPC_DSTORE_3)) ? 2 : 1;
+                return true;
+            }
+            // jsr, ret, monitorenter, monitorexit, invokedynamic, multianewarray, ...
+            return false;
+    }
+}
+
+void MethodTranslator::successors(u4 pc, vector<u4> &succs, bool &fallThrough) const
+{
+    u1 opcode = code[pc];
+    succs.clear();
+    fallThrough = true;
+
+    if ((OPC_IFEQ <= opcode and opcode <= OPC_IF_ACMPNE) or opcode == OPC_IFNULL or opcode == OPC_IFNONNULL) {
+        succs.push_back(pc + (s2) u2At(pc + 1));
+    } else if (opcode == OPC_GOTO) {
+        succs.push_back(pc + (s2) u2At(pc + 1));
+        fallThrough = false;
+    } else if (opcode == OPC_GOTO_W) {
+        succs.push_back(pc + s4At(pc + 1));
+        fallThrough = false;
+    } else if (opcode == OPC_TABLESWITCH) {
+        u4 base = (pc + 4) & ~3u;
+        succs.push_back(pc + s4At(base));
+        s4 low = s4At(base + 4), high = s4At(base + 8);
+        for (int64_t i = 0; i <= (int64_t) high - low; i++)
+            succs.push_back(pc + s4At(base + 12 + 4 * (u4) i));
+        fallThrough = false;
+    } else if (opcode == OPC_LOOKUPSWITCH) {
+        u4 base = (pc + 4) & ~3u;
+        succs.push_back(pc + s4At(base));
+        s4 npairs = s4At(base + 4);
+        for (s4 i = 0; i < npairs; i++)
+            succs.push_back(pc + s4At(base + 12 + 8 * (u4) i));
+        fallThrough = false;
+    } else if ((OPC_IRETURN <= opcode and opcode <= OPC_RETURN) or opcode == OPC_ATHROW) {
+        fallThrough = false;
+    }
+}
+
+bool MethodTranslator::analyze()
+{
+    boundary.assign(m.codeLen, false);
+    for (u4 pc = 0; pc < m.codeLen; ) {
+        boundary[pc] = true;
+        int len = instrLen(pc);
+        if (len <= 0 or pc + len > m.codeLen)
+            return false;
+        pc += len;
+    }
+
+    depth.assign(m.codeLen, -1);
+    target.assign(m.codeLen, false);
+    depth[0] = 0;
+
+    vector<u4> work = { 0 };
+    vector<u4> succs;
+    while (!work.empty()) {
+        u4 pc = work.back();
+        work.pop_back();
+
+        int pops, pushes;
+        if (!stackEffect(pc, pops, pushes))
+            return false;
+        int d = depth[pc];
+        if (d < pops or d - pops + pushes > m.maxStack)
+            return false;
+        d = d - pops + pushes;
+
+        bool fallThrough;
+        successors(pc, succs, fallThrough);
+        size_t jumps = succs.size();
+        if (fallThrough)
+            succs.push_back(pc + instrLen(pc));
+
+        for (size_t i = 0; i < succs.size(); i++) {
+            u4 s = succs[i];
+            if (s >= m.codeLen or !boundary[s])
+                return false;
+            if (i < jumps)
+                target[s] = true;
+            if (depth[s] < 0) {
+                depth[s] = d;
+                work.push_back(s);
+            } else if (depth[s] != d) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void MethodTranslator::emit(const char *fmt, ...)
+{
+    char buf[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    body += "    ";
+    body += buf;
+    body += '\n';
+}
+
+// 声明缓存常量池解析结果的静态变量，返回变量名
+string MethodTranslator::cache(const char *type, const char *prefix, u4 i)
+{
+    string name = format("%s%u", prefix, i);
+    if (caches.insert(name).second)
+        decls += format("    static %s *%s = nullptr;\n", type, name.c_str());
+    return name;
+}
+
+// invokeinterface 调用点的缓存，见 aot::InterfaceCallSite
+string MethodTranslator::callSite(u4 i)
+{
+    string name = format("itf%u", i);
+    if (caches.insert(name).second)
+        decls += format("    static aot::InterfaceCallSite %s;\n", name.c_str());
+    return name;
+}
+
+static const char *fieldType(char descriptor)
+{
+    switch (descriptor) {
+        case 'Z':
+        case 'B': return "jbyte";
+        case 'C': return "jchar";
+        case 'S': return "jshort";
+        case 'I': return "jint";
+        case 'F': return "jfloat";
+        case 'J': return "jlong";
+        case 'D': return "jdouble";
+        default:  return "jref";
+    }
+}
+
+// 与 fieldType 对应的读写 slot 的宏
+static const char *slotMacro(char descriptor)
+{
+    switch (descriptor) {
+        case 'F': return "AOT_F";
+        case 'J': return "AOT_L";
+        case 'D': return "AOT_D";
+        case 'L':
+        case '[': return "AOT_R";
+        default:  return "AOT_I";
+    }
+}
+
+/*
+ * 翻译 @pc 处的指令，@d 是执行此指令前操作数栈的深度
+ */
+void MethodTranslator::translate(u4 pc, int d)
+{
+    u1 opcode = code[pc];
+    const int t = d - 1; // 栈顶
+
+    // 局部变量的 load/store 都是 slot 的拷贝，与类型无关
+    auto load = [&](u4 index, int slots) {
+        for (int i = 0; i < slots; i++)
+            emit("stk[%d] = lvars[%u];", d + i, index + i);
+    };
+    auto store = [&](u4 index, int slots) {
+        for (int i = 0; i < slots; i++)
+            emit("lvars[%u] = stk[%d];", index + i, d - slots + i);
+    };
+    // 二元运算，@size 是操作数占用的 slot 数
+    auto binary = [&](const char *macro, int size, const char *op) {
+        emit("%s(stk + %d) = %s(stk + %d) %s %s(stk + %d);",
+             macro, d - 2*size, macro, d - 2*size, op, macro, d - size);
+    };
+    auto binaryCall = [&](const char *macro, int size, const char *fn) {
+        emit("%s(stk + %d) = %s(%s(stk + %d), %s(stk + %d));",
+             macro, d - 2*size, fn, macro, d - 2*size, macro, d - size);
+    };
+    // 类型转换，@from 和 @to 是转换前后占用的 slot 数
+    auto convert = [&](const char *fromMacro, int from, const char *toMacro, const char *cast) {
+        emit("%s(stk + %d) = %s(%s(stk + %d));", toMacro, d - from, cast, fromMacro, d - from);
+    };
+    auto branch = [&](const char *cond) {
+        emit("if (%s) goto L%u;", cond, pc + (s2) u2At(pc + 1));
+    };
+    auto ret = [&](int slots) {
+        for (int i = 0; i < slots; i++) {
+            if (d - slots + i != i)
+                emit("stk[%d] = stk[%d];", i, d - slots + i);
+        }
+        emit("frame->ostack = stk + %d;", slots);
+        emit("return;");
+    };
+
+    switch (opcode) {
+        case OPC_NOP:
+            break;
+        case OPC_ACONST_NULL:
+            emit("AOT_R(stk + %d) = jnull;", d);
+            break;
+        case OPC_ICONST_M1: case OPC_ICONST_0: case OPC_ICONST_1: case OPC_ICONST_2:
+        case OPC_ICONST_3: case OPC_ICONST_4: case OPC_ICONST_5:
+            emit("AOT_I(stk + %d) = %d;", d, opcode - OPC_ICONST_0);
+            break;
+        case OPC_LCONST_0: case OPC_LCONST_1:
+            emit("AOT_L(stk + %d) = %dLL;", d, opcode - OPC_LCONST_0);
+            break;
+        case OPC_FCONST_0: case OPC_FCONST_1: case OPC_FCONST_2:
+            emit("AOT_F(stk + %d) = %d.0f;", d, opcode - OPC_FCONST_0);
+            break;
+        case OPC_DCONST_0: case OPC_DCONST_1:
+            emit("AOT_D(stk + %d) = %d.0;", d, opcode - OPC_DCONST_0);
+            break;
+        case OPC_BIPUSH:
+            emit("AOT_I(stk + %d) = %d;", d, (s1) code[pc + 1]);
+            break;
+        case OPC_SIPUSH:
+            emit("AOT_I(stk + %d) = %d;", d, (s2) u2At(pc + 1));
+            break;
+        case OPC_LDC:
+        case OPC_LDC_W: {
+            u2 i = opcode == OPC_LDC ? code[pc + 1] : u2At(pc + 1);
+            switch (cf.cp[i].tag) {
+                case CONSTANT_Integer: emit("AOT_I(stk + %d) = cp._int(%u);", d, i); break;
+                case CONSTANT_Float:   emit("AOT_F(stk + %d) = cp._float(%u);", d, i); break;
+                case CONSTANT_String:  emit("AOT_R(stk + %d) = cp.resolveString(%u);", d, i); break;
+                default:               emit("AOT_R(stk + %d) = cp.resolveClass(%u);", d, i); break;
+            }
+            break;
+        }
+        case OPC_LDC2_W: {
+            u2 i = u2At(pc + 1);
+            if (cf.cp[i].tag == CONSTANT_Long)
+                emit("AOT_L(stk + %d) = cp._long(%u);", d, i);
+            else
+                emit("AOT_D(stk + %d) = cp._double(%u);", d, i);
+            break;
+        }
+        case OPC_ILOAD: case OPC_FLOAD: case OPC_ALOAD:
+            load(code[pc + 1], 1);
+            break;
+        case OPC_LLOAD: case OPC_DLOAD:
+            load(code[pc + 1], 2);
+            break;
+        case OPC_ISTORE: case OPC_FSTORE: case OPC_ASTORE:
+            store(code[pc + 1], 1);
+            break;
+        case OPC_LSTORE: case OPC_DSTORE:
+            store(code[pc + 1], 2);
+            break;
+        case OPC_IALOAD: emit("AOT_I(stk + %d) = aot::aload<jint>(AOT_R(stk + %d), AOT_I(stk + %d));", d-2, d-2, t); break;
+        case OPC_FALOAD: emit("AOT_F(stk + %d) = aot::aload<jfloat>(AOT_R(stk + %d), AOT_I(stk + %d));", d-2, d-2, t); break;
+        case OPC_AALOAD: emit("AOT_R(stk + %d) = aot::aload<jref>(AOT_R(stk + %d), AOT_I(stk + %d));", d-2, d-2, t); break;
+        case OPC_BALOAD: emit("AOT_I(stk + %d) = aot::aload<jbyte>(AOT_R(stk + %d), AOT_I(stk + %d));", d-2, d-2, t); break;
+        case OPC_CALOAD: emit("AOT_I(stk + %d) = aot::aload<jchar>(AOT_R(stk + %d), AOT_I(stk + %d));", d-2, d-2, t); break;
+        case OPC_SALOAD: emit("AOT_I(stk + %d) = aot::aload<jshort>(AOT_R(stk + %d), AOT_I(stk + %d));", d-2, d-2, t); break;
+        case OPC_LALOAD: emit("AOT_L(stk + %d) = aot::aload<jlong>(AOT_R(stk + %d), AOT_I(stk + %d));", d-2, d-2, t); break;
+        case OPC_DALOAD: emit("AOT_D(stk + %d) = aot::aload<jdouble>(AOT_R(stk + %d), AOT_I(stk + %d));", d-2, d-2, t); break;
+        case OPC_IASTORE: emit("aot::astore<jint>(AOT_R(stk + %d), AOT_I(stk + %d), AOT_I(stk + %d));", d-3, d-2, t); break;
+        case OPC_FASTORE: emit("aot::astore<jfloat>(AOT_R(stk + %d), AOT_I(stk + %d), AOT_F(stk + %d));", d-3, d-2, t); break;
+        case OPC_AASTORE: emit("aot::astore<jref>(AOT_R(stk + %d), AOT_I(stk + %d), AOT_R(stk + %d));", d-3, d-2, t); break;
+        case OPC_BASTORE: emit("aot::astore<jbyte>(AOT_R(stk + %d), AOT_I(stk + %d), (jbyte) AOT_I(stk + %d));", d-3, d-2, t); break;
+        case OPC_CASTORE: emit("aot::astore<jchar>(AOT_R(stk + %d), AOT_I(stk + %d), (jchar) AOT_I(stk + %d));", d-3, d-2, t); break;
+        case OPC_SASTORE: emit("aot::astore<jshort>(AOT_R(stk + %d), AOT_I(stk + %d), (jshort) AOT_I(stk + %d));", d-3, d-2, t); break;
+        case OPC_LASTORE: emit("aot::astore<jlong>(AOT_R(stk + %d), AOT_I(stk + %d), AOT_L(stk + %d));", d-4, d-3, d-2); break;
+        case OPC_DASTORE: emit("aot::astore<jdouble>(AOT_R(stk + %d), AOT_I(stk + %d), AOT_D(stk + %d));", d-4, d-3, d-2); break;
+        case OPC_POP:
+        case OPC_POP2:
+            break;
+        case OPC_DUP:
+            emit("stk[%d] = stk[%d];", d, d-1);
+            break;
+        case OPC_DUP_X1:
+            emit("stk[%d] = stk[%d];", d, d-1);
+            emit("stk[%d] = stk[%d];", d-1, d-2);
+            emit("stk[%d] = stk[%d];", d-2, d);
+            break;
+        case OPC_DUP_X2:
+            emit("stk[%d] = stk[%d];", d, d-1);
+            emit("stk[%d] = stk[%d];", d-1, d-2);
+            emit("stk[%d] = stk[%d];", d-2, d-3);
+            emit("stk[%d] = stk[%d];", d-3, d);
+            break;
+        case OPC_DUP2:
+            emit("stk[%d] = stk[%d];", d, d-2);
+            emit("stk[%d] = stk[%d];", d+1, d-1);
+            break;
+        case OPC_DUP2_X1:
+            emit("stk[%d] = stk[%d];", d+1, d-1);
+            emit("stk[%d] = stk[%d];", d, d-2);
+            emit("stk[%d] = stk[%d];", d-1, d-3);
+            emit("stk[%d] = stk[%d];", d-2, d+1);
+            emit("stk[%d] = stk[%d];", d-3, d);
+            break;
+        case OPC_DUP2_X2:
+            emit("stk[%d] = stk[%d];", d+1, d-1);
+            emit("stk[%d] = stk[%d];", d, d-2);
+            emit("stk[%d] = stk[%d];", d-1, d-3);
+            emit("stk[%d] = stk[%d];", d-2, d-4);
+            emit("stk[%d] = stk[%d];", d-3, d+1);
+            emit("stk[%d] = stk[%d];", d-4, d);
+            break;
+        case OPC_SWAP:
+            emit("std::swap(stk[%d], stk[%d]);", d-2, d-1);
+            break;
+        case OPC_IADD: binaryCall("AOT_I", 1, "aot::iadd"); break;
+        case OPC_ISUB: binaryCall("AOT_I", 1, "aot::isub"); break;
+        case OPC_IMUL: binaryCall("AOT_I", 1, "aot::imul"); break;
+        case OPC_IDIV: binaryCall("AOT_I", 1, "aot::idiv"); break;
+        case OPC_IREM: binaryCall("AOT_I", 1, "aot::irem"); break;
+        case OPC_LADD: binaryCall("AOT_L", 2, "aot::ladd"); break;
+        case OPC_LSUB: binaryCall("AOT_L", 2, "aot::lsub"); break;
+        case OPC_LMUL: binaryCall("AOT_L", 2, "aot::lmul"); break;
+        case OPC_LDIV: binaryCall("AOT_L", 2, "aot::ldiv"); break;
+        case OPC_LREM: binaryCall("AOT_L", 2, "aot::lrem"); break;
+        case OPC_FADD: binary("AOT_F", 1, "+"); break;
+        case OPC_FSUB: binary("AOT_F", 1, "-"); break;
+        case OPC_FMUL: binary("AOT_F", 1, "*"); break;
+        case OPC_FDIV: binary("AOT_F", 1, "/"); break;
+        case OPC_FREM: binaryCall("AOT_F", 1, "std::fmod"); break;
+        case OPC_DADD: binary("AOT_D", 2, "+"); break;
+        case OPC_DSUB: binary("AOT_D", 2, "-"); break;
+        case OPC_DMUL: binary("AOT_D", 2, "*"); break;
+        case OPC_DDIV: binary("AOT_D", 2, "/"); break;
+        case OPC_DREM: binaryCall("AOT_D", 2, "std::fmod"); break;
+        case OPC_INEG: convert("AOT_I", 1, "AOT_I", "aot::ineg"); break;
+        case OPC_LNEG: convert("AOT_L", 2, "AOT_L", "aot::lneg"); break;
+        case OPC_FNEG: convert("AOT_F", 1, "AOT_F", "-"); break;
+        case OPC_DNEG: convert("AOT_D", 2, "AOT_D", "-"); break;
+        case OPC_ISHL:  binaryCall("AOT_I", 1, "aot::ishl"); break;
+        case OPC_ISHR:  binaryCall("AOT_I", 1, "aot::ishr"); break;
+        case OPC_IUSHR: binaryCall("AOT_I", 1, "aot::iushr"); break;
+        case OPC_LSHL:
+        case OPC_LSHR:
+        case OPC_LUSHR: {
+            const char *fn = opcode == OPC_LSHL ? "aot::lshl" : (opcode == OPC_LSHR ? "aot::lshr" : "aot::lushr");
+            emit("AOT_L(stk + %d) = %s(AOT_L(stk + %d), AOT_I(stk + %d));", d-3, fn, d-3, t);
+            break;
+        }
+        case OPC_IAND: binary("AOT_I", 1, "&"); break;
+        case OPC_IOR:  binary("AOT_I", 1, "|"); break;
+        case OPC_IXOR: binary("AOT_I", 1, "^"); break;
+        case OPC_LAND: binary("AOT_L", 2, "&"); break;
+        case OPC_LOR:  binary("AOT_L", 2, "|"); break;
+        case OPC_LXOR: binary("AOT_L", 2, "^"); break;
+        case OPC_IINC:
+            emit("AOT_I(lvars + %u) = aot::iadd(AOT_I(lvars + %u), %d);", code[pc + 1], code[pc + 1], (s1) code[pc + 2]);
+            break;
+        case OPC_I2L: convert("AOT_I", 1, "AOT_L", "(jlong)"); break;
+        case OPC_I2F: convert("AOT_I", 1, "AOT_F", "(jfloat)"); break;
+        case OPC_I2D: convert("AOT_I", 1, "AOT_D", "(jdouble)"); break;
+        case OPC_L2I: convert("AOT_L", 2, "AOT_I", "(jint)"); break;
+        case OPC_L2F: convert("AOT_L", 2, "AOT_F", "(jfloat)"); break;
+        case OPC_L2D: convert("AOT_L", 2, "AOT_D", "(jdouble)"); break;
+        case OPC_F2I: convert("AOT_F", 1, "AOT_I", "aot::f2int<jint>"); break;
+        case OPC_F2L: convert("AOT_F", 1, "AOT_L", "aot::f2int<jlong>"); break;
+        case OPC_F2D: convert("AOT_F", 1, "AOT_D", "(jdouble)"); break;
+        case OPC_D2I: convert("AOT_D", 2, "AOT_I", "aot::f2int<jint>"); break;
+        case OPC_D2L: convert("AOT_D", 2, "AOT_L", "aot::f2int<jlong>"); break;
+        case OPC_D2F: convert("AOT_D", 2, "AOT_F", "(jfloat)"); break;
+        case OPC_I2B: convert("AOT_I", 1, "AOT_I", "(jbyte)"); break;
+        case OPC_I2C: convert("AOT_I", 1, "AOT_I", "(jchar)"); break;
+        case OPC_I2S: convert("AOT_I", 1, "AOT_I", "(jshort)"); break;
+        case OPC_LCMP:
+            emit("AOT_I(stk + %d) = aot::lcmp(AOT_L(stk + %d), AOT_L(stk + %d));", d-4, d-4, d-2);
+            break;
+        case OPC_FCMPL:
+        case OPC_FCMPG:
+            emit("AOT_I(stk + %d) = aot::fcmp(AOT_F(stk + %d), AOT_F(stk + %d), %d);",
+                 d-2, d-2, t, opcode == OPC_FCMPL ? -1 : 1);
+            break;
+        case OPC_DCMPL:
+        case OPC_DCMPG:
+            emit("AOT_I(stk + %d) = aot::fcmp(AOT_D(stk + %d), AOT_D(stk + %d), %d);",
+                 d-4, d-4, d-2, opcode == OPC_DCMPL ? -1 : 1);
+            break;
+        case OPC_IFEQ: branch(format("AOT_I(stk + %d) == 0", t).c_str()); break;
+        case OPC_IFNE: branch(format("AOT_I(stk + %d) != 0", t).c_str()); break;
+        case OPC_IFLT: branch(format("AOT_I(stk + %d) < 0", t).c_str()); break;
+        case OPC_IFGE: branch(format("AOT_I(stk + %d) >= 0", t).c_str()); break;
+        case OPC_IFGT: branch(format("AOT_I(stk + %d) > 0", t).c_str()); break;
+        case OPC_IFLE: branch(format("AOT_I(stk + %d) <= 0", t).c_str()); break;
+        case OPC_IF_ICMPEQ: branch(format("AOT_I(stk + %d) == AOT_I(stk + %d)", d-2, t).c_str()); break;
+        case OPC_IF_ICMPNE: branch(format("AOT_I(stk + %d) != AOT_I(stk + %d)", d-2, t).c_str()); break;
+        case OPC_IF_ICMPLT: branch(format("AOT_I(stk + %d) < AOT_I(stk + %d)", d-2, t).c_str()); break;
+        case OPC_IF_ICMPGE: branch(format("AOT_I(stk + %d) >= AOT_I(stk + %d)", d-2, t).c_str()); break;
+        case OPC_IF_ICMPGT: branch(format("AOT_I(stk + %d) > AOT_I(stk + %d)", d-2, t).c_str()); break;
+        case OPC_IF_ICMPLE: branch(format("AOT_I(stk + %d) <= AOT_I(stk + %d)", d-2, t).c_str()); break;
+        case OPC_IF_ACMPEQ: branch(format("AOT_R(stk + %d) == AOT_R(stk + %d)", d-2, t).c_str()); break;
+        case OPC_IF_ACMPNE: branch(format("AOT_R(stk + %d) != AOT_R(stk + %d)", d-2, t).c_str()); break;
+        case OPC_IFNULL:    branch(format("AOT_R(stk + %d) == jnull", t).c_str()); break;
+        case OPC_IFNONNULL: branch(format("AOT_R(stk + %d) != jnull", t).c_str()); break;
+        case OPC_GOTO:
+            emit("goto L%u;", pc + (s2) u2At(pc + 1));
+            break;
+        case OPC_GOTO_W:
+            emit("goto L%u;", pc + s4At(pc + 1));
+            break;
+        case OPC_TABLESWITCH: {
+            u4 base = (pc + 4) & ~3u;
+            s4 low = s4At(base + 4), high = s4At(base + 8);
+            emit("switch (AOT_I(stk + %d)) {", t);
+            for (int64_t i = 0; i <= (int64_t) high - low; i++)
+                emit("    case %d: goto L%u;", (s4) (low + i), pc + s4At(base + 12 + 4 * (u4) i));
+            emit("    default: goto L%u;", pc + s4At(base));
+            emit("}");
+            break;
+        }
+        case OPC_LOOKUPSWITCH: {
+            u4 base = (pc + 4) & ~3u;
+            s4 npairs = s4At(base + 4);
+            emit("switch (AOT_I(stk + %d)) {", t);
+            for (s4 i = 0; i < npairs; i++)
+                emit("    case %d: goto L%u;", s4At(base + 8 + 8 * (u4) i), pc + s4At(base + 12 + 8 * (u4) i));
+            emit("    default: goto L%u;", pc + s4At(base));
+            emit("}");
+            break;
+        }
+        case OPC_IRETURN: case OPC_FRETURN: case OPC_ARETURN:
+            ret(1);
+            break;
+        case OPC_LRETURN: case OPC_DRETURN:
+            ret(2);
+            break;
+        case OPC_RETURN:
+            ret(0);
+            break;
+        case OPC_GETSTATIC:
+        case OPC_PUTSTATIC: {
+            u2 i = u2At(pc + 1);
+            int slots = slotsOf(cf.refDescriptor(i)[0]);
+            string f = cache("Field", "field", i);
+            emit("{");
+            emit("    Field *f = aot::staticField(cp, %u, %s);", i, f.c_str());
+            for (int k = 0; k < slots; k++) {
+                if (opcode == OPC_GETSTATIC)
+                    emit("    stk[%d] = f->staticValue.data[%d];", d + k, k);
+                else
+                    emit("    f->staticValue.data[%d] = stk[%d];", k, d - slots + k);
+            }
+            emit("}");
+            break;
+        }
+        case OPC_GETFIELD: {
+            u2 i = u2At(pc + 1);
+            char type = cf.refDescriptor(i)[0];
+            string f = cache("Field", "field", i);
+            emit("%s(stk + %d) = aot::getField<%s>(AOT_R(stk + %d), aot::field(cp, %u, %s));",
+                 slotMacro(type), t, fieldType(type), t, i, f.c_str());
+            break;
+        }
+        case OPC_PUTFIELD: {
+            u2 i = u2At(pc + 1);
+            char type = cf.refDescriptor(i)[0];
+            int slots = slotsOf(type);
+            string f = cache("Field", "field", i);
+            emit("aot::putField<%s>(AOT_R(stk + %d), aot::field(cp, %u, %s), (%s) %s(stk + %d));",
+                 fieldType(type), d - 1 - slots, i, f.c_str(), fieldType(type), slotMacro(type), d - slots);
+            break;
+        }
+        case OPC_INVOKEVIRTUAL:
+        case OPC_INVOKESPECIAL:
+        case OPC_INVOKESTATIC:
+        case OPC_INVOKEINTERFACE: {
+            u2 i = u2At(pc + 1);
+            const string &descriptor = cf.refDescriptor(i);
+            int args = argSlotsOf(descriptor) + (opcode == OPC_INVOKESTATIC ? 0 : 1);
+            int base = d - args;
+            int retSlots = slotsOf(returnTypeOf(descriptor));
+            string m;
+            if (opcode == OPC_INVOKESTATIC)
+                m = format("aot::staticMethod(cp, %u, %s)", i, cache("Method", "method", i).c_str());
+            else if (opcode == OPC_INVOKESPECIAL)
+                m = format("aot::specialMethod(frame->method->clazz, cp, %u, %s, AOT_R(stk + %d))",
+                           i, cache("Method", "method", i).c_str(), base);
+            else if (opcode == OPC_INVOKEVIRTUAL)
+                m = format("aot::virtualMethod(cp, %u, %s, AOT_R(stk + %d))", i, cache("Method", "method", i).c_str(), base);
+            else
+                m = format("aot::interfaceMethod(cp, %u, %s, AOT_R(stk + %d))", i, callSite(i).c_str(), base);
+            emit("aot::invoke(%s, stk + %d, %d);", m.c_str(), base, retSlots);
+            break;
+        }
+        case OPC_NEW: {
+            u2 i = u2At(pc + 1);
+            string c = cache("Class", "class", i);
+            emit("AOT_R(stk + %d) = aot::newInstance(cp, %u, %s);", d, i, c.c_str());
+            break;
+        }
+        case OPC_NEWARRAY: {
+            const char *arrClassName;
+            switch (code[pc + 1]) {
+                case AT_BOOLEAN: arrClassName = "[Z"; break;
+                case AT_CHAR:    arrClassName = "[C"; break;
+                case AT_FLOAT:   arrClassName = "[F"; break;
+                case AT_DOUBLE:  arrClassName = "[D"; break;
+                case AT_BYTE:    arrClassName = "[B"; break;
+                case AT_SHORT:   arrClassName = "[S"; break;
+                case AT_INT:     arrClassName = "[I"; break;
+                case AT_LONG:    arrClassName = "[J"; break;
+                default:
+                    error = true;
+                    return;
+            }
+            string c = cache("Class", "primArrayClass", code[pc + 1]);
+            emit("AOT_R(stk + %d) = aot::newPrimArray(\"%s\", %s, AOT_I(stk + %d));", t, arrClassName, c.c_str(), t);
+            break;
+        }
+        case OPC_ANEWARRAY: {
+            u2 i = u2At(pc + 1);
+            string c = cache("Class", "arrayClass", i);
+            emit("AOT_R(stk + %d) = aot::newRefArray(cp, %u, %s, AOT_I(stk + %d));", t, i, c.c_str(), t);
+            break;
+        }
+        case OPC_ARRAYLENGTH:
+            emit("AOT_I(stk + %d) = aot::arrayLength(AOT_R(stk + %d));", t, t);
+            break;
+        case OPC_ATHROW:
+            emit("aot::athrow(AOT_R(stk + %d));", t);
+            break;
+        case OPC_CHECKCAST: {
+            u2 i = u2At(pc + 1);
+            string c = cache("Class", "class", i);
+            emit("aot::checkcast(cp, %u, %s, AOT_R(stk + %d));", i, c.c_str(), t);
+            break;
+        }
+        case OPC_INSTANCEOF: {
+            u2 i = u2At(pc + 1);
+            string c = cache("Class", "class", i);
+            emit("AOT_I(stk + %d) = aot::instanceOf(cp, %u, %s, AOT_R(stk + %d));", t, i, c.c_str(), t);
+            break;
+        }
+        case OPC_WIDE: {
+            u1 op = code[pc + 1];
+            u2 index = u2At(pc + 2);
+            if (op == OPC_IINC)
+                emit("AOT_I(lvars + %u) = aot::iadd(AOT_I(lvars + %u), %d);", index, index, (s2) u2At(pc + 4));
+            else if (op == OPC_LLOAD or op == OPC_DLOAD)
+                load(index, 2);
+            else if (op == OPC_ILOAD or op == OPC_FLOAD or op == OPC_ALOAD)
+                load(index, 1);
+            else if (op == OPC_LSTORE or op == OPC_DSTORE)
+                store(index, 2);
+            else
+                store(index, 1);
+            break;
+        }
+        default:
+            if (OPC_ILOAD_0 <= opcode and opcode <= OPC_ALOAD_3) {
+                int n = (opcode - OPC_ILOAD_0) % 4;
+                bool two = (OPC_LLOAD_0 <= opcode and opcode <= OPC_LLOAD_3) or (OPC_DLOAD_0 <= opcode and opcode <= OPC_DLOAD_3);
+                load(n, two ? 2 : 1);
+            } else if (OPC_ISTORE_0 <= opcode and opcode <= OPC_ASTORE_3) {
+                int n = (opcode - OPC_ISTORE_0) % 4;
+                bool two = (OPC_LSTORE_0 <= opcode and opcode <= OPC_LSTORE_3) or (OPC_DSTORE_0 <= opcode and opcode <= OPC_DSTORE_3);
+                store(n, two ? 2 : 1);
+            } else {
+                error = true;
+            }
+            break;
+    }
+}
+
+bool MethodTranslator::translate(const string &fnName, string &out)
+{
+    if (Modifier::isNative(m.modifiers) or Modifier::isAbstract(m.modifiers)
+        or Modifier::isSynchronized(m.modifiers))
+        return false;
+    // 只有一条 return 指令的方法直接解释执行就好
+    if (code == nullptr or m.codeLen <= 1 or m.exceptionTablesCount > 0)
+        return false;
+    if (!analyze())
+        return false;
+
+    for (u4 pc = 0; pc < m.codeLen; pc += instrLen(pc)) {
+        if (depth[pc] < 0) // 不可达的指令
+            continue;
+        if (target[pc])
+            body += format("L%u:\n", pc);
+        translate(pc, depth[pc]);
+        if (error)
+            return false;
+    }
+
+    out += format("// %s~%s~%s\n", escape(cf.className).c_str(), escape(m.name).c_str(), escape(m.descriptor).c_str());
+    out += format("static void %s(Frame *frame)\n{\n", fnName.c_str());
+    out += decls;
+    out += "    [[maybe_unused]] ConstantPool &cp = frame->method->clazz->cp;\n";
+    out += "    [[maybe_unused]] slot_t *lvars = frame->lvars;\n";
+    out += "    [[maybe_unused]] slot_t *stk = frame->ostack;\n\n";
+    out += body;
+    out += "}\n\n";
+    return true;
+}
+
+/* -------------------------- main -------------------------- */
+
+struct CompiledMethod {
+    string className;
+    string name;
+    string descriptor;
+    u4 classLen;
+    u4 classCrc;
+    string fnName;
+};
+
+int main(int argc, char *argv[])
+{
+    vector<string> prefixes;
+    vector<const char *> jars;
+    const char *out = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 and i + 1 < argc) {
+            prefixes.emplace_back(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 and i + 1 < argc) {
+            out = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage();
+        } else {
+            jars.push_back(argv[i]);
+        }
+    }
+    if (out == nullptr or jars.empty())
+        usage();
+
+    string code;
+    vector<CompiledMethod> compiled;
+    int total = 0;
+
+    for (const char *path : jars) {
+        JarFile *jar = openJar(path);
+        if (jar == nullptr) {
+            fprintf(stderr, "kayoaot: can't open %s\n", path);
+            return 1;
+        }
+
+        for (size_t i = 0; i < jar->size(); i++) {
+            const JarFile::Entry *e = jar->get(i);
+            string name((const char *) e->name, e->nameLen);
+            const string suffix = ".class";
+            if (name.size() <= suffix.size() or name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+                continue;
+
+            name.resize(name.size() - suffix.size());
+            if (!prefixes.empty() and none_of(prefixes.begin(), prefixes.end(), [&](const string &p) {
+                return name.compare(0, p.size(), p) == 0;
+            })) {
+                continue;
+            }
+
+            unique_ptr<u1[]> bytes(new u1[e->uncompressedSize]);
+            ClassFile cf;
+            if (!jar->read(e, bytes.get()) or !cf.parse(bytes.get(), e->uncompressedSize)) {
+                fprintf(stderr, "kayoaot: bad class file %s in %s\n", name.c_str(), path);
+                return 1;
+            }
+
+            u4 classLen = e->uncompressedSize;
+            u4 classCrc = (u4) crc32(0, bytes.get(), (uInt) classLen);
+
+            for (const MethodInfo &m : cf.methods) {
+                if (m.code == nullptr)
+                    continue;
+                total++;
+
+                string fnName = format("aot_%zu", compiled.size());
+                if (!MethodTranslator(cf, m).translate(fnName, code))
+                    continue;
+                compiled.push_back({ cf.className, m.name, m.descriptor, classLen, classCrc, fnName });
+            }
+        }
+    }
+
+    FILE *f = fopen(out, "w");
+    if (f == nullptr) {
+        fprintf(stderr, "kayoaot: can't create %s\n", out);
+        return 1;
+    }
+
+    fprintf(f, "/*\n * Generated by kayoaot, do not edit.\n */\n\n");
+    fprintf(f, "#include <utility>\n#include \"aot/aot_runtime.h\"\n\n");
+    fputs(code.c_str(), f);
+
+    fprintf(f, "extern \"C\" const AotMethodEntry %s[] = {\n", AOT_METHODS_SYMBOL);
+    for (auto &m : compiled) {
+        fprintf(f, "    { \"%s\", \"%s\", \"%s\", %u, 0x%08xu, %s },\n",
+                escape(m.className).c_str(), escape(m.name).c_str(), escape(m.descriptor).c_str(),
+                m.classLen, m.classCrc, m.fnName.c_str());
+    }
+    if (compiled.empty())
+        fprintf(f, "    { nullptr, nullptr, nullptr, 0, 0, nullptr },\n");
+    fprintf(f, "};\n\n");
+    fprintf(f, "extern \"C\" const int %s = %zu;\n", AOT_METHODS_COUNT_SYMBOL, compiled.size());
+
+    fclose(f);
+    printf("kayoaot: compiled %zu of %d methods\n", compiled.size(), total);
+    return 0;
+}
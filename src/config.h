@@ -7,6 +7,9 @@
 
 #define VM_HEAP_SIZE (64*1024*1024) // 64Mb
 
+// 不小于此大小的对象（大数组）分配在大对象空间中，参见 LargeObjectSpace.h
+#define LARGE_OBJECT_THRESHOLD (256*1024) // 256Kb
+
 // every thread has a vm stack
 #define VM_STACK_SIZE (64*1024)     // 64Kb
 
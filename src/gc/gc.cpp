@@ -3,84 +3,692 @@
  */
 
 #include <vector>
+#include <deque>
+#include <chrono>
+#include <algorithm>
 #include "gc.h"
 #include "../kayo.h"
 #include "../runtime/Thread.h"
 #include "../runtime/Frame.h"
 #include "../objects/Object.h"
+#include "../objects/Array.h"
 #include "../objects/Class.h"
 #include "../objects/Field.h"
+#include "../objects/Method.h"
+#include "../objects/class_loader.h"
+#include "../memory/Metaspace.h"
+#include "../interpreter/interpreter.h"
+#include "../runtime/suspend.h"
+#include "telemetry.h"
 
 using namespace std;
+using namespace std::chrono;
 
 /*
- * 判断对象是否可达(GC Roots Analysis)
+ * 标记-清除（mark-sweep）。
  *
  * 可作为GC Roots对象的包括如下几种：
-    a.虚拟机栈(栈桢中的本地变量表)中的引用的对象
+    a.虚拟机栈(栈桢中的本地变量表和操作数栈)中的引用的对象
     b.方法区中的类静态属性引用的对象
     c.方法区中的常量引用的对象
     d.本地方法栈中JNI的引用的对象
+ *
+ * gc 在分配失败的线程中（或由 System.gc()）进行，期间暂停其他所有线程（参见 runtime/suspend.h）。
+ * 线程可能在任意位置被暂停，包括正持有 malloc 的锁时，所以暂停期间 gc 不能分配或释放 C++ 堆上的内存：
+ *   - 标记位图、标记栈等在暂停之前准备好，大小固定。
+ *     标记栈满时记下溢出，之后重新扫描已标记的对象（参见 Marker::trace），下次 gc 时加大标记栈；
+ *   - 发现的 Reference 经由它们自己的 discovered 字段链接，不需要额外的存储；
+ *   - 不可达对象的内存在恢复其他线程之后才归还（sweep），这些对象已不可达，其他线程不会访问它们。
+ *
+ * 栈中的 slot 不区分是否为引用，所以栈是保守扫描的：
+ * 只有恰好指向某个对象起始处的值才被当作引用。
+ * 除了虚拟机栈，线程的 C 栈也被保守扫描，本地代码中只保存在 C++ 局部变量里的对象也能存活。
+ * 堆中的对象则根据其类的 oop map（参见 Class::oopMap）精确扫描。
+ *
+ * Class 对象分配在 Metaspace 中而不在堆中，
+ * 一个 class loader 可达时，由它定义的所有类都被当作根扫描。
+ *
+ * java/lang/ref 的处理：
+ * 标记时不经由 Reference.referent 标记，而是把这些 Reference 经由 Reference.discovered 链接起来（discovery），
+ * 链表的最后一个指向它自己。soft reference 在发现时按堆的空闲程度决定是否保留 referent
+ * （参见 SOFT_REF_LRU_POLICY_MS_PER_MB），要保留的当作强引用，不加入链表。
+ * 强可达的对象都标记完后，按 soft, weak, finalizable, phantom 的顺序处理：
+ *   soft, weak: referent 不可达的，清除 referent 并加入 pending list；
+ *   finalizable: 不可达且未执行过 finalize() 的对象复活，交给 finalizer 线程；
+ *   phantom: 同 weak（JDK 9 之后的语义，referent 也被清除）.
+ * pending list 也经由 Reference.discovered 链接，
+ * 交给 java/lang/ref/Reference$ReferenceHandler 放入各自的 ReferenceQueue.
+ */
+
+// 对象按8字节对齐，参见 OBJECT_ALIGN_UP
+static const size_t GRANULE = 8;
+
+/*
+ * Soft reference 的 LRU 策略（同 HotSpot 的 -XX:SoftRefLRUPolicyMSPerMB）：
+ * 上次 gc 后堆中每空闲 1MB，soft reference 在最后一次被访问（SoftReference.get()）后保留多少毫秒。
+ * 堆越满，soft reference 被清除得越快。
  */
-static bool accessible(jref obj)
+#define SOFT_REF_LRU_POLICY_MS_PER_MB 1000
+
+// 标记栈的初始容量（对象个数），溢出后下次 gc 时加倍
+#define INITIAL_MARK_STACK_CAPACITY (64*1024)
+
+// 一次 gc 最多交给 finalizer 线程的对象个数的初始值，超出的对象留到下次 gc，超出后下次 gc 时加倍
+#define INITIAL_FINALIZE_CAPACITY 1024
+
+// java/lang/ref 相关的字段，第一次 gc 时查找
+static Field *referentField;
+static Field *nextField;
+static Field *discoveredField;
+static Field *pendingField;
+static Field *lockField;
+static Field *clockField;
+static Field *timestampField;
+
+static void initRefFields()
 {
-    // 虚拟机栈(栈桢中的本地变量表)中的引用的对象
-    for (Thread *thread : g_all_threads) {
-        for (Frame *frame = thread->getTopFrame(); frame != nullptr; frame = frame->prev) {
-            slot_t *lvars = frame->lvars;
-            u2 maxLocals = frame->method->maxLocals;
-            for (u2 i = 0; i < maxLocals; i++) {
-                // todo 这里要先判断 locals[i] 存放的是不是 jref
-                if (lvars[i] == (slot_t) obj)
-                    return true;
+    if (referentField != nullptr)
+        return;
+
+    Class *ref = loadBootClass(S(java_lang_ref_Reference));
+    referentField = ref->lookupInstField(S(referent), S(sig_java_lang_Object));
+    nextField = ref->lookupInstField(S(next), S(sig_java_lang_ref_Reference));
+    discoveredField = ref->lookupInstField(S(discovered), S(sig_java_lang_ref_Reference));
+    pendingField = ref->lookupStaticField(S(pending), S(sig_java_lang_ref_Reference));
+    lockField = ref->lookupStaticField(S(lock), S(sig_java_lang_ref_Reference_Lock));
+
+    Class *soft = loadBootClass(S(java_lang_ref_SoftReference));
+    clockField = soft->lookupStaticField(S(clock), S(J));
+    timestampField = soft->lookupInstField(S(timestamp), S(J));
+}
+
+/*
+ * 等待执行 finalize() 的对象，由 finalizer 线程逐个取出执行。
+ * 已经交给 finalizer 线程的对象记在 Marker::finalized 中，它们再次不可达时直接回收。
+ */
+static pthread_mutex_t finalizerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t finalizerCond = PTHREAD_COND_INITIALIZER;
+static deque<Object *> finalizerQueue;
+static Object *finalizing;  // 正在执行 finalize() 的对象
+
+// 同一时刻只有一个线程进行 gc
+static pthread_mutex_t gcMutex = PTHREAD_MUTEX_INITIALIZER;
+
+namespace {
+struct Marker {
+    address heapBegin = 0;
+    address heapEnd = 0;
+
+    // 以 GRANULE 为单位，记录每个位置是否为对象的起始处，以及对象是否已标记
+    vector<bool> starts;
+    vector<bool> marks;
+
+    // 对象是否已经交给 finalizer 线程，跨越多次 gc，对象被回收时清除
+    vector<bool> finalized;
+
+    // 大对象不在 objectArea 中，标记等记录在 LargeObjectSpace 中
+    LargeObjectSpace *los = nullptr;
+
+    // 容量在暂停其他线程之前准备好，满了不再增长，参见 push()
+    vector<Object *> stack;
+    bool overflowed = false;       // 有已标记的对象因为标记栈满了而没有被扫描
+    bool everOverflowed = false;   // 本次 gc 中发生过溢出
+
+    // 发现的 Reference 组成的链表，以 Class::RefType 为下标
+    Object *discovered[Class::REF_TYPE_PHANTOM + 1];
+
+    // SoftReference.clock，以及 soft reference 在最后一次被访问后保留的毫秒数
+    jlong softClock = 0;
+    jlong softMaxInterval = 0;
+
+    // 在暂停其他线程之前调用，准备好标记用到的存储
+    void prepare(Memory *oa, LargeObjectSpace *space)
+    {
+        heapBegin = oa->getMem();
+        heapEnd = heapBegin + oa->getSize();
+        size_t granules = oa->getSize()/GRANULE + 1;
+        starts.assign(granules, false);
+        marks.assign(granules, false);
+        if (finalized.size() != granules)
+            finalized.assign(granules, false);
+        los = space;
+
+        stack.clear();
+        if (stack.capacity() == 0)
+            stack.reserve(INITIAL_MARK_STACK_CAPACITY);
+        else if (everOverflowed)
+            stack.reserve(stack.capacity()*2);
+        overflowed = everOverflowed = false;
+
+        for (auto &d : discovered)
+            d = jnull;
+    }
+
+    size_t indexOf(const Object *o) const
+    {
+        return ((address) o - heapBegin)/GRANULE;
+    }
+
+    bool inHeap(const Object *o) const
+    {
+        return heapBegin <= (address) o and (address) o < heapEnd;
+    }
+
+    // 是否指向某个对象的起始处
+    bool isObject(address p) const
+    {
+        if (p < heapBegin or p >= heapEnd or (p - heapBegin) % GRANULE != 0)
+            return false;
+        return starts[(p - heapBegin)/GRANULE];
+    }
+
+    // @o 必须是 objectArea 中的对象或大对象
+    bool isMarked(const Object *o) const
+    {
+        if (inHeap(o))
+            return marks[indexOf(o)];
+        return los->isMarked((address) o);
+    }
+
+    /*
+     * 对象是否存活。
+     * 不在堆中的是 Class 对象，随其 defining class loader 存活。
+     */
+    bool isLive(const Object *o) const
+    {
+        if (o == jnull)
+            return true;
+        if (inHeap(o) or los->contains((address) o))
+            return isMarked(o);
+        Object *loader = ((const Class *) o)->loader;
+        return loader == bootClassLoader or (inHeap(loader) and isMarked(loader));
+    }
+
+    // 记录 objectArea 中所有对象的起始处，调用者持有 objectArea 的锁
+    void recordStarts(Memory *oa)
+    {
+        for (address mem = oa->jumpFreelist(heapBegin); mem < heapEnd; mem = oa->jumpFreelist(mem)) {
+            starts[(mem - heapBegin)/GRANULE] = true;
+            mem += ((jref) mem)->size();
+        }
+    }
+
+    // 对 objectArea 中的每个对象调用 @visit(Object *, size_t index)
+    template <typename Visit>
+    void forEachObject(Visit visit) const
+    {
+        for (size_t i = 0; i < starts.size(); i++) {
+            if (starts[i])
+                visit((Object *) (heapBegin + i*GRANULE), i);
+        }
+    }
+
+    void push(Object *o)
+    {
+        if (stack.size() < stack.capacity())
+            stack.push_back(o);
+        else
+            overflowed = everOverflowed = true; // 不能分配内存，参见 trace()
+    }
+
+    void mark(address p)
+    {
+        if (isObject(p)) {
+            size_t i = (p - heapBegin)/GRANULE;
+            if (!marks[i]) {
+                marks[i] = true;
+                push((Object *) p);
+            }
+        } else if (p != 0 and los->mark(p)) {
+            push((Object *) p);
+        }
+    }
+
+    void mark(const Object *o)
+    {
+        mark((address) o);
+    }
+
+    void markSlots(const slot_t *begin, const slot_t *end)
+    {
+        for (; begin < end; begin++)
+            mark((address) *begin);
+    }
+
+    // 扫描 @base 中由 @oopMap 描述的引用，跳过位于 @skip1 和 @skip2 的引用
+    void markOopMap(const void *base, const MetaVector<Class::OopMapBlock> &oopMap, int skip1 = -1, int skip2 = -1)
+    {
+        for (auto &b : oopMap) {
+            auto p = (const jref *) ((const u1 *) base + b.offset);
+            for (const jref *end = p + b.count; p < end; p++) {
+                auto offset = (const u1 *) p - (const u1 *) base;
+                if (offset != skip1 and offset != skip2)
+                    mark(*p);
+            }
+        }
+    }
+
+    // 扫描类的静态变量，Class 对象的实例变量，以及常量池中已解析的字符串
+    void markClass(Class *c)
+    {
+        // 正在创建的类（在其他线程中，或者创建过程中分配对象引起了 gc）
+        if (c->state == Class::EMPTY)
+            return;
+
+        mark(c->loader);
+        mark(c->protectionDomain);
+
+        for (Field *f : c->fields) {
+            if (f->isStatic() and !f->isPrim())
+                mark(f->staticValue.r);
+        }
+
+        if (classClass != nullptr)
+            markOopMap(c, classClass->oopMap);
+
+        mark(c->enclosing.name);
+        mark(c->enclosing.descriptor);
+
+        for (u2 i = 1; i < c->cp.size; i++) {
+            if (c->cp._type[i] == CONSTANT_ResolvedString)
+                mark((address) c->cp._info[i]);
+        }
+    }
+
+    // @currentSp: 当前线程的 C 栈从这里开始扫描，其他线程从被暂停处开始
+    void markThreads(uintptr_t currentSp)
+    {
+        Thread *self = getCurrentThread();
+        for (Thread *thread : g_all_threads) {
+            if (thread->exited)
+                continue;
+            mark(thread->jThread);
+            for (Frame *frame = thread->getTopFrame(); frame != nullptr; frame = frame->prev) {
+                Method *m = frame->method;
+                markSlots(frame->lvars, frame->lvars + m->maxLocals);
+                // 操作数栈紧跟在 Frame 之后，整个扫描，多扫描的只是一些陈旧的值
+                auto ostack = (const slot_t *) (frame + 1);
+                markSlots(ostack, ostack + m->maxStack);
+            }
+
+            uintptr_t sp = thread == self ? currentSp : thread->suspendedSp;
+            if (sp != 0 and thread->stackTop > sp) {
+                sp &= ~(uintptr_t) (sizeof(slot_t) - 1);
+                markSlots((const slot_t *) sp, (const slot_t *) thread->stackTop);
+            }
+        }
+    }
+
+    /*
+     * 如果 @ref 是 active 的（尚未入队）且 referent 不为 null，把它加入 discovered list 并返回 true，
+     * 此时不经由它的 referent 和 discovered 标记。
+     */
+    bool discover(Object *ref)
+    {
+        if (ref->getInstFieldValue<jref>(nextField) != jnull
+            or ref->getInstFieldValue<jref>(referentField) == jnull)
+            return false;
+
+        // 已经在 discovered list 中了（标记栈溢出后重新扫描时）
+        if (ref->getInstFieldValue<jref>(discoveredField) != jnull)
+            return true;
+
+        auto type = ref->clazz->refType;
+        if (type == Class::REF_TYPE_SOFT
+            and softClock - ref->getInstFieldValue<jlong>(timestampField) <= softMaxInterval)
+            return false; // 最近被访问过，保留 referent
+
+        Object *head = discovered[type];
+        ref->setFieldValue(discoveredField, (slot_t) (head != jnull ? head : ref));
+        discovered[type] = ref;
+        return true;
+    }
+
+    // 只根据 oop map 或 ref-array 标志扫描，不查看 fields 和描述符
+    void scan(Object *o)
+    {
+        Class *c = o->clazz;
+        // 对象的类的 defining loader 在对象存活时也不能卸载
+        mark(c->loader);
+
+        if (c->isArrayClass()) {
+            if (c->refArray) {
+                auto arr = (Array *) o;
+                auto p = (const jref *) arr->data();
+                for (const jref *end = p + arr->len; p < end; p++)
+                    mark(*p);
             }
+        } else if (c->refType != Class::REF_TYPE_NONE and discover(o)) {
+            markOopMap(o, c->oopMap, referentField->offset, discoveredField->offset);
+        } else {
+            markOopMap(o, c->oopMap);
+        }
+    }
+
+    void drain()
+    {
+        while (!stack.empty()) {
+            Object *o = stack.back();
+            stack.pop_back();
+            scan(o);
+        }
+    }
+
+    /*
+     * 扫描已标记的对象，直到标记栈为空。
+     * 标记栈溢出过时，有的对象已标记但没有被扫描，
+     * 重新扫描所有已标记的对象（重复扫描是无害的），直到不再溢出。
+     */
+    void trace()
+    {
+        drain();
+        while (overflowed) {
+            overflowed = false;
+            forEachObject([this](Object *o, size_t i) {
+                if (marks[i]) {
+                    scan(o);
+                    drain();
+                }
+            });
+            los->forEachObject([this](Object *o) {
+                if (los->isMarked((address) o)) {
+                    scan(o);
+                    drain();
+                }
+            });
         }
     }
+};
+}
+
+static Marker marker;
 
-    // todo 得到方法区的所有类，遍历
-    jvm_abort("未实现");
-//    MethodArea ma; // todo
-//    vector<Class *> classes = ma.getClasses();
-//    for (Class *c : classes) {
-//        for (Field *f : c->fields) {
-//            if (!f->isStatic() or f->isPrim())
-//                continue;
-//
-//            // static and reference
-//            if (f->staticValue.r == obj)
-//                return true;
-//        }
-//    }
+/*
+ * 本次 gc 要交给 finalizer 线程的对象。
+ * 容量在暂停其他线程之前准备好，满了以后发现的对象只保持存活，下次 gc 时再交给 finalizer 线程。
+ */
+static vector<Object *> toFinalize;
+static bool finalizeOverflowed = false;
 
-    // todo 方法区中的常量引用的对象
+// 本次 gc 加入 pending list 的 Reference，经由 discovered 链接，恢复其他线程后放入 Reference.pending
+static Object *pendingHead;
+static Object *pendingTail;
 
+// 上次 gc 后 objectArea 的空闲字节数，用于 soft reference 的 LRU 策略
+static size_t freeAfterLastGc = SIZE_MAX;
 
-    // todo 本地方法栈中JNI的引用的对象
+/*
+ * 标记，直到不再有新的可达的 class loader：
+ * 可达的 class loader 定义的类也是根，扫描它们可能使更多的 class loader 可达。
+ */
+static void traceLoaders()
+{
+    marker.trace();
 
-    return false;
+    for (bool changed = true; changed; ) {
+        changed = false;
+        forEachLoaderData([&changed](LoaderData *d) {
+            if (d->scanned or !marker.inHeap(d->loader) or !marker.isMarked(d->loader))
+                return;
+            d->scanned = changed = true;
+            d->metaspace->forEachClass([](Class *c) { marker.markClass(c); });
+            marker.trace();
+        });
+    }
+}
+
+// 处理 @type 的 discovered list：referent 不可达的，清除 referent 并加入 pending list，其他的移出链表
+static void processDiscovered(Class::RefType type)
+{
+    Object *ref = marker.discovered[type];
+    marker.discovered[type] = jnull;
+
+    while (ref != jnull) {
+        auto next = ref->getInstFieldValue<jref>(discoveredField);
+        if (next == ref)
+            next = jnull; // 链表的最后一个
+
+        auto referent = ref->getInstFieldValue<jref>(referentField);
+        if (marker.isLive(referent)) {
+            ref->setFieldValue(discoveredField, (slot_t) jnull);
+        } else {
+            ref->setFieldValue(referentField, (slot_t) jnull);
+            ref->setFieldValue(discoveredField, (slot_t) pendingHead);
+            if (pendingTail == jnull)
+                pendingTail = ref;
+            pendingHead = ref;
+        }
+        ref = next;
+    }
+}
+
+// 不可达且没有执行过 finalize() 的对象复活，记入 toFinalize
+static void findFinalizable()
+{
+    marker.forEachObject([](Object *o, size_t i) {
+        if (!o->clazz->finalizable or marker.marks[i] or marker.finalized[i])
+            return;
+        if (toFinalize.size() < toFinalize.capacity()) {
+            toFinalize.push_back(o);
+            marker.finalized[i] = true;
+        } else {
+            finalizeOverflowed = true;
+        }
+        marker.mark(o);
+    });
+
+    LargeObjectSpace *los = marker.los;
+    los->forEachObject([los](Object *o) {
+        if (!o->clazz->finalizable or los->isMarked((address) o) or los->isFinalized((address) o))
+            return;
+        if (toFinalize.size() < toFinalize.capacity()) {
+            toFinalize.push_back(o);
+            los->setFinalized((address) o);
+        } else {
+            finalizeOverflowed = true;
+        }
+        marker.mark(o);
+    });
+}
+
+/*
+ * 归还不可达对象的内存，在恢复其他线程之后进行。
+ * 不可达的对象不会再被访问，暂停期间之后分配的对象也不在 marker.starts 中，不受影响。
+ * 相邻的不可达对象合并后一起归还。
+ */
+static void sweep(Memory *oa, LargeObjectSpace *los)
+{
+    address runBegin = 0, runEnd = 0;
+
+    marker.forEachObject([&](Object *o, size_t i) {
+        if (marker.marks[i])
+            return;
+        marker.finalized[i] = false;
+        o->releaseMonitor();
+        auto mem = (address) o;
+        size_t size = o->size();
+        if (mem != runEnd) {
+            if (runEnd != runBegin)
+                oa->back(runBegin, runEnd - runBegin);
+            runBegin = mem;
+        }
+        runEnd = mem + size;
+    });
+    if (runEnd != runBegin)
+        oa->back(runBegin, runEnd - runBegin);
+
+    los->sweep([](Object *o) { o->releaseMonitor(); });
+}
+
+/*
+ * 将 pendingHead 到 pendingTail 加入 Reference.pending 并唤醒 ReferenceHandler.
+ * 调用者持有 Reference.lock（@lock），lock 还没有创建时为 null：
+ * Reference 的类初始化方法创建 lock 并启动 ReferenceHandler，
+ * 在此之前只需放入 pending，ReferenceHandler 启动后会处理。
+ */
+static void enqueuePending(jref lock)
+{
+    if (pendingHead == jnull)
+        return;
+
+    pendingTail->setFieldValue(discoveredField, (slot_t) pendingField->staticValue.r);
+    pendingField->staticValue.r = pendingHead;
+    pendingHead = pendingTail = jnull;
+
+    if (lock != jnull)
+        lock->notifyAll();
 }
 
 void gc()
 {
-    Memory *oa = g_heap.bytecodeArea;
+    // gc 过程中分配失败（如第一次 gc 时加载 java/lang/ref 的类）不再嵌套 gc
+    static thread_local bool collecting = false;
+    if (collecting)
+        return;
+    collecting = true;
+
+    initRefFields();
+
+    /*
+     * 同 HotSpot，暂停其他线程之前先获取 Reference.lock，
+     * 这样更新 pending list 时 ReferenceHandler 不会正在读写它。
+     */
+    jref refLock = lockField->staticValue.r;
+    if (refLock != jnull)
+        refLock->lock();
+    pthread_mutex_lock(&gcMutex);
 
+    // 把 callee-saved 寄存器保存到栈上，当前线程的 C 栈从这里开始保守扫描
+    __builtin_unwind_init();
+    volatile int stackMark = 0;
+    const auto currentSp = (uintptr_t) &stackMark;
+
+    auto startTime = steady_clock::now();
+    size_t usedBefore = g_heap.getObjectsUsed();
+
+    Memory *oa = g_heap.objectArea;
     assert(oa != nullptr);
+    LargeObjectSpace *los = g_heap.largeObjectSpace;
+
+    // 暂停其他线程期间不能分配内存，用到的存储都在这之前准备好
+    marker.prepare(oa, los);
+    marker.softClock = clockField->staticValue.j;
+    size_t free = freeAfterLastGc != SIZE_MAX ? freeAfterLastGc : oa->getSize();
+    marker.softMaxInterval = (jlong) (free >> 20) * SOFT_REF_LRU_POLICY_MS_PER_MB;
+    toFinalize.clear();
+    if (toFinalize.capacity() == 0)
+        toFinalize.reserve(INITIAL_FINALIZE_CAPACITY);
+    else if (finalizeOverflowed)
+        toFinalize.reserve(toFinalize.capacity()*2);
+    finalizeOverflowed = false;
+
+    pthread_mutex_lock(&finalizerMutex);
+    stopTheWorld();
+
+    // 以下的锁，其他线程只在 NoSuspendScope 中持有，所以暂停后一定能获取到
     oa->lock();
+    if (stringClass != nullptr and stringClass->strpool != nullptr)
+        pthread_mutex_lock(&stringClass->strpoolMutex);
+    los->lock();
 
-    address mem = oa->getMem();
-    const address end = mem + oa->getSize();
+    marker.recordStarts(oa);
 
-    while (mem < end) {
-        mem = oa->jumpFreelist(mem);
+    forEachLoaderData([](LoaderData *d) { d->scanned = false; });
 
-        auto obj = (jref) mem;
-        if (!accessible(obj)) {
-            obj->marked = 1;
-            // todo 调用 finalize() 后进行二次标记，然后才可以归还
-            oa->back(mem, obj->size());
-        }
-        mem += obj->size();
+    marker.markThreads(currentSp);
+    getMetaspace(bootClassLoader)->forEachClass([](Class *c) { marker.markClass(c); });
+    // 字符串池中的字符串
+    if (stringClass != nullptr and stringClass->strpool != nullptr) {
+        for (Object *so : *stringClass->strpool)
+            marker.mark(so);
     }
+    // 等待执行 finalize() 的对象
+    for (Object *o : finalizerQueue)
+        marker.mark(o);
+    marker.mark(finalizing);
+
+    traceLoaders();
+
+    processDiscovered(Class::REF_TYPE_SOFT);
+    processDiscovered(Class::REF_TYPE_WEAK);
+
+    findFinalizable();
+    traceLoaders();
 
+    // 复活对象时新发现的 soft/weak references 也要清除，否则其 referent 被回收后成为悬空引用
+    processDiscovered(Class::REF_TYPE_SOFT);
+    processDiscovered(Class::REF_TYPE_WEAK);
+    processDiscovered(Class::REF_TYPE_PHANTOM);
+
+    los->retireUnmarked();
+    // 不可达的 class loaders 要在恢复其他线程之前移除，之后它们的地址可能被重用
+    detachUnreachableLoaders();
+    // 此时已没有线程在读这些旧表了
+    RetiredTables::Node *retiredTables = RetiredTables::takeAll();
+
+    los->unlock();
+    if (stringClass != nullptr and stringClass->strpool != nullptr)
+        pthread_mutex_unlock(&stringClass->strpoolMutex);
     oa->unlock();
+
+    startTheWorld();
+    auto pauseNanos = (uint64_t) duration_cast<nanoseconds>(steady_clock::now() - startTime).count();
+
+    finalizerQueue.insert(finalizerQueue.end(), toFinalize.begin(), toFinalize.end());
+    if (!toFinalize.empty())
+        pthread_cond_signal(&finalizerCond);
+    pthread_mutex_unlock(&finalizerMutex);
+
+    sweep(oa, los);
+
+    // 持有 gcMutex，pending list 中的 Reference 在入队之前不会被下一次 gc 回收
+    enqueuePending(refLock);
+    clockField->staticValue.j = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+
+    size_t freeBlocks, largestFree;
+    oa->getFreeStats(freeAfterLastGc, largestFree, freeBlocks);
+    recordGcCycle(pauseNanos, usedBefore, g_heap.getObjectsUsed(), oa->getSize() + los->reservedBytes());
+
+    // 释放被卸载的 class loaders 的元数据，
+    // 要在 sweep 之后，不可达的对象的大小要由它们的类计算。
+    releaseDetachedLoaders();
+    RetiredTables::freeAll(retiredTables);
+
+    pthread_mutex_unlock(&gcMutex);
+    if (refLock != jnull)
+        refLock->unlock();
+    collecting = false;
+}
+
+void runWorldStopped(const function<void()> &visit)
+{
+    pthread_mutex_lock(&gcMutex);
+    stopTheWorld();
+    visit();
+    startTheWorld();
+    pthread_mutex_unlock(&gcMutex);
+}
+
+void *finalizerLoop(void *arg)
+{
+    while (true) {
+        pthread_mutex_lock(&finalizerMutex);
+        while (finalizerQueue.empty())
+            pthread_cond_wait(&finalizerCond, &finalizerMutex);
+        finalizing = finalizerQueue.front();
+        finalizerQueue.pop_front();
+        pthread_mutex_unlock(&finalizerMutex);
+
+        Method *m = finalizing->clazz->lookupInstMethod(S(finalize), S(___V));
+        try {
+            slot_t arg = (slot_t) finalizing;
+            execJavaFuncThrows(m, &arg);
+        } catch (Throwable &t) {
+            // 同 java.lang.ref.Finalizer，忽略 finalize() 抛出的异常
+        }
+
+        pthread_mutex_lock(&finalizerMutex);
+        finalizing = nullptr;
+        pthread_mutex_unlock(&finalizerMutex);
+    }
 }
@@ -5,10 +5,20 @@
 #ifndef JVM_GC_H
 #define JVM_GC_H
 
+#include <functional>
 #include "../jtypes.h"
 
 class Memory;
 
 void gc();
 
+/*
+ * 和 gc 互斥地暂停其他所有线程，调用 @visit()，然后恢复它们。
+ * 同 gc，@visit() 中不能分配或释放 C++ 堆上的内存，被暂停的线程可能持有 malloc 的锁。
+ */
+void runWorldStopped(const std::function<void()> &visit);
+
+// finalizer 线程，执行 gc 发现的不可达对象的 finalize() 方法
+void *finalizerLoop(void *arg);
+
 #endif //JVM_GC_H
@@ -0,0 +1,533 @@
+/*
+ * Author: kayo
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "heap_dump.h"
+#include "../kayo.h"
+#include "../runtime/Thread.h"
+#include "../runtime/Frame.h"
+#include "../objects/Object.h"
+#include "../objects/Array.h"
+#include "../objects/Class.h"
+#include "../objects/Field.h"
+#include "../objects/Method.h"
+#include "../objects/class_loader.h"
+#include "../memory/Metaspace.h"
+#include "gc.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+ * HPROF 格式：
+ * 文件头: "JAVA PROFILE 1.0.2\0" | u4 id size | u8 毫秒时间戳
+ * 之后是一系列 record: u1 tag | u4 与文件头时间戳的差（微秒）| u4 body 长度 | body
+ * 所有数据都是大端的，id 即对象的地址。
+ */
+
+// record tags
+#define HPROF_UTF8               0x01
+#define HPROF_LOAD_CLASS         0x02
+#define HPROF_TRACE              0x05
+#define HPROF_HEAP_DUMP_SEGMENT  0x1C
+#define HPROF_HEAP_DUMP_END      0x2C
+
+// heap dump sub-record tags
+#define HPROF_GC_ROOT_JAVA_FRAME    0x03
+#define HPROF_GC_ROOT_STICKY_CLASS  0x05
+#define HPROF_GC_ROOT_THREAD_OBJ    0x08
+#define HPROF_GC_CLASS_DUMP         0x20
+#define HPROF_GC_INSTANCE_DUMP      0x21
+#define HPROF_GC_OBJ_ARRAY_DUMP     0x22
+#define HPROF_GC_PRIM_ARRAY_DUMP    0x23
+
+// basic types
+#define HPROF_NORMAL_OBJECT  2
+#define HPROF_BOOLEAN        4
+#define HPROF_CHAR           5
+#define HPROF_FLOAT          6
+#define HPROF_DOUBLE         7
+#define HPROF_BYTE           8
+#define HPROF_SHORT          9
+#define HPROF_INT           10
+#define HPROF_LONG          11
+
+// 对象没有分配栈的信息，都使用这个空的 stack trace
+#define DUMMY_STACK_TRACE_SERIAL 1
+
+// heap dump segment 超过此大小就结束，开始新的 segment
+#define SEGMENT_FLUSH_SIZE (1024*1024)
+
+static u1 hprofType(char descriptor)
+{
+    switch (descriptor) {
+        case 'Z': return HPROF_BOOLEAN;
+        case 'C': return HPROF_CHAR;
+        case 'F': return HPROF_FLOAT;
+        case 'D': return HPROF_DOUBLE;
+        case 'B': return HPROF_BYTE;
+        case 'S': return HPROF_SHORT;
+        case 'I': return HPROF_INT;
+        case 'J': return HPROF_LONG;
+        case 'L':
+        case '[': return HPROF_NORMAL_OBJECT;
+        default:
+            NEVER_GO_HERE_ERROR("%c\n", descriptor);
+    }
+}
+
+// 基本类型的字节数，引用类型为 sizeof(jref)
+static size_t hprofTypeSize(u1 type)
+{
+    switch (type) {
+        case HPROF_BOOLEAN:
+        case HPROF_BYTE: return 1;
+        case HPROF_CHAR:
+        case HPROF_SHORT: return 2;
+        case HPROF_FLOAT:
+        case HPROF_INT: return 4;
+        case HPROF_DOUBLE:
+        case HPROF_LONG: return 8;
+        default: return sizeof(jref);
+    }
+}
+
+namespace {
+/*
+ * 直接写入文件，不缓存 record：
+ * record 的长度先以计算模式执行一遍 body 得到，再写出，参见 putRecord().
+ * 转储期间其他线程被暂停，不能分配内存，也就不能用可增长的缓冲区。
+ * 文件的 stdio 缓冲区在暂停其他线程之前的第一次写入时就已分配好了。
+ */
+class HprofWriter {
+    FILE *fp;
+    bool counting = false;
+    size_t len = 0;   // 当前 record 的 body 已写出（或计算出）的字节数
+
+    void putRaw(const void *p, size_t n)
+    {
+        if (!counting)
+            fwrite(p, 1, n, fp);
+        len += n;
+    }
+
+public:
+    explicit HprofWriter(FILE *fp): fp(fp) { }
+
+    void putU1(u1 x) { putRaw(&x, 1); }
+
+    void putU2(u2 x)
+    {
+        u1 b[] = { (u1) (x >> 8), (u1) x };
+        putRaw(b, sizeof(b));
+    }
+
+    void putU4(u4 x)
+    {
+        u1 b[] = { (u1) (x >> 24), (u1) (x >> 16), (u1) (x >> 8), (u1) x };
+        putRaw(b, sizeof(b));
+    }
+
+    void putU8(uint64_t x) { putU4((u4) (x >> 32)); putU4((u4) x); }
+
+    void putId(const void *p)
+    {
+        if (sizeof(void *) == 8)
+            putU8((uintptr_t) p);
+        else
+            putU4((u4) (uintptr_t) p);
+    }
+
+    // 以大端的方式写出位于 @p 的 @size 个字节的值（本地字节序）
+    void putValue(const void *p, size_t size)
+    {
+        switch (size) {
+            case 1: putU1(*(const u1 *) p); break;
+            case 2: putU2(*(const u2 *) p); break;
+            case 4: putU4(*(const u4 *) p); break;
+            case 8: putU8(*(const uint64_t *) p); break;
+            default: NEVER_GO_HERE_ERROR("%zu\n", size);
+        }
+    }
+
+    // 当前 record 的 body 的字节数
+    size_t size() const { return len; }
+
+    /*
+     * 写出一个 @tag record，其 body 由 @body() 写出。
+     * @body() 被调用两次：第一次只计算长度，第二次写出，两次写出的内容必须相同。
+     */
+    template <typename Body>
+    void putRecord(u1 tag, Body body)
+    {
+        counting = true;
+        len = 0;
+        body();
+        auto bodyLen = (u4) len;
+
+        counting = false;
+        u1 head[9];
+        head[0] = tag;
+        memset(head + 1, 0, 4); // time
+        head[5] = (u1) (bodyLen >> 24);
+        head[6] = (u1) (bodyLen >> 16);
+        head[7] = (u1) (bodyLen >> 8);
+        head[8] = (u1) bodyLen;
+        fwrite(head, 1, sizeof(head), fp);
+
+        len = 0;
+        body();
+        assert(len == bodyLen);
+    }
+
+    // 写出一个 UTF8 record，id 为字符串的地址
+    void putUtf8Record(const utf8_t *s)
+    {
+        if (s == nullptr)
+            return;
+        putRecord(HPROF_UTF8, [&]() {
+            putId(s);
+            putRaw(s, strlen(s));
+        });
+    }
+};
+}
+
+static void dumpClass(HprofWriter &w, Class *c)
+{
+    w.putU1(HPROF_GC_CLASS_DUMP);
+    w.putId(c);
+    w.putU4(DUMMY_STACK_TRACE_SERIAL);
+    w.putId(c->superClass);
+    w.putId(c->loader);
+    w.putId(nullptr); // signers
+    w.putId(nullptr); // protection domain
+    w.putId(nullptr); // reserved
+    w.putId(nullptr); // reserved
+    w.putU4((u4) (c->isArrayClass() ? 0 : OBJECT_ALIGN_UP(c->instSize)));
+    w.putU2(0); // constant pool
+
+    u2 statics = 0, insts = 0;
+    for (Field *f : c->fields)
+        f->isStatic() ? statics++ : insts++;
+
+    w.putU2(statics);
+    for (Field *f : c->fields) {
+        if (!f->isStatic())
+            continue;
+        u1 type = hprofType(f->descriptor[0]);
+        w.putId(f->name);
+        w.putU1(type);
+        if (type == HPROF_NORMAL_OBJECT)
+            w.putId(f->staticValue.r);
+        else
+            w.putValue(&f->staticValue, hprofTypeSize(type));
+    }
+
+    w.putU2(insts);
+    for (Field *f : c->fields) {
+        if (!f->isStatic()) {
+            w.putId(f->name);
+            w.putU1(hprofType(f->descriptor[0]));
+        }
+    }
+}
+
+static void dumpInstance(HprofWriter &w, Object *o)
+{
+    // 先计算实例变量值的总长度
+    u4 len = 0;
+    for (Class *c = o->clazz; c != nullptr; c = c->superClass) {
+        for (Field *f : c->fields) {
+            if (!f->isStatic())
+                len += hprofTypeSize(hprofType(f->descriptor[0]));
+        }
+    }
+
+    w.putU1(HPROF_GC_INSTANCE_DUMP);
+    w.putId(o);
+    w.putU4(DUMMY_STACK_TRACE_SERIAL);
+    w.putId(o->clazz);
+    w.putU4(len);
+    // 本类的实例变量在前，然后是父类的，顺序与 class dump 中的一致
+    for (Class *c = o->clazz; c != nullptr; c = c->superClass) {
+        for (Field *f : c->fields) {
+            if (f->isStatic())
+                continue;
+            u1 type = hprofType(f->descriptor[0]);
+            const void *p = (const u1 *) o + f->offset;
+            if (type == HPROF_NORMAL_OBJECT)
+                w.putId(*(const jref *) p);
+            else
+                w.putValue(p, hprofTypeSize(type));
+        }
+    }
+}
+
+static void dumpArray(HprofWriter &w, Array *a)
+{
+    char ele = a->clazz->className[1];
+    if (ele == 'L' or ele == '[') {
+        w.putU1(HPROF_GC_OBJ_ARRAY_DUMP);
+        w.putId(a);
+        w.putU4(DUMMY_STACK_TRACE_SERIAL);
+        w.putU4((u4) a->len);
+        w.putId(a->clazz);
+        auto p = (const jref *) a->data();
+        for (jsize i = 0; i < a->len; i++)
+            w.putId(p[i]);
+    } else {
+        u1 type = hprofType(ele);
+        size_t size = hprofTypeSize(type);
+        w.putU1(HPROF_GC_PRIM_ARRAY_DUMP);
+        w.putId(a);
+        w.putU4(DUMMY_STACK_TRACE_SERIAL);
+        w.putU4((u4) a->len);
+        w.putU1(type);
+        auto p = (const u1 *) a->data();
+        for (jsize i = 0; i < a->len; i++)
+            w.putValue(p + i*size, size);
+    }
+}
+
+// 对所有已定义的类调用 @visit(Class *)，不分配内存
+template <typename Visit>
+static void forEachClass(Visit visit)
+{
+    auto defined = [&visit](Class *c) {
+        // 正在创建的类
+        if (c->state != Class::EMPTY)
+            visit(c);
+    };
+    getMetaspace(bootClassLoader)->forEachClass(defined);
+    forEachLoaderData([&defined](LoaderData *d) { d->metaspace->forEachClass(defined); });
+}
+
+/*
+ * 转储时用到的存储，在暂停其他线程之前准备好。
+ */
+namespace {
+struct DumpContext {
+    Memory *oa;
+    LargeObjectSpace *los;
+    address heapBegin;
+    address heapEnd;
+
+    // 以 8 字节为单位，记录 objectArea 中每个位置是否为对象的起始处，用于判断栈中的值是否为引用
+    vector<bool> starts;
+
+    /*
+     * 类名和字段名，排序去重后每个写出一个 UTF8 record.
+     * 容量按准备时的类估计，暂停期间不再增长，放不下的（之间新加载的类的）名字直接写出，可能重复。
+     */
+    vector<const utf8_t *> names;
+
+    size_t objects = 0;
+    size_t classes = 0;
+
+    bool isObject(slot_t v) const
+    {
+        auto p = (address) v;
+        if (heapBegin <= p and p < heapEnd)
+            return (p - heapBegin) % 8 == 0 and starts[(p - heapBegin)/8];
+        return los->contains(p);
+    }
+};
+}
+
+// 被暂停的线程可能在任意位置，所以只能在暂停期间分配到的内存中工作，参见 gc/gc.cpp
+static void dumpStopped(HprofWriter &w, DumpContext &ctx)
+{
+    Memory *oa = ctx.oa;
+    LargeObjectSpace *los = ctx.los;
+    oa->lock();
+    los->lock();
+
+    for (address mem = oa->jumpFreelist(ctx.heapBegin); mem < ctx.heapEnd; mem = oa->jumpFreelist(mem)) {
+        ctx.starts[(mem - ctx.heapBegin)/8] = true;
+        ctx.objects++;
+        mem += ((jref) mem)->size();
+    }
+    los->forEachObject([&ctx](Object *) { ctx.objects++; });
+
+    // stack traces：对象共用一个空的，每个线程一个（不含栈帧，栈帧中的引用以 GC root 给出）
+    // 暂停期间 g_all_threads 不会变化（stopTheWorld 持有线程表的锁）
+    w.putRecord(HPROF_TRACE, [&w]() {
+        w.putU4(DUMMY_STACK_TRACE_SERIAL);
+        w.putU4(0); // thread serial
+        w.putU4(0); // frames count
+    });
+    for (Thread *t : g_all_threads) {
+        w.putRecord(HPROF_TRACE, [&w, t]() {
+            w.putU4(DUMMY_STACK_TRACE_SERIAL + t->id);
+            w.putU4(t->id);
+            w.putU4(0);
+        });
+    }
+
+    // 类名和字段名的 utf8 records, load class records
+    auto addName = [&](const utf8_t *name) {
+        if (ctx.names.size() < ctx.names.capacity())
+            ctx.names.push_back(name);
+        else
+            w.putUtf8Record(name);
+    };
+    forEachClass([&](Class *c) {
+        addName(c->className);
+        for (Field *f : c->fields)
+            addName(f->name);
+    });
+    sort(ctx.names.begin(), ctx.names.end());
+    auto last = unique(ctx.names.begin(), ctx.names.end());
+    for (auto i = ctx.names.begin(); i != last; i++)
+        w.putUtf8Record(*i);
+
+    u4 classSerial = 0;
+    forEachClass([&](Class *c) {
+        w.putRecord(HPROF_LOAD_CLASS, [&w, c, classSerial]() {
+            w.putU4(classSerial + 1);
+            w.putId(c);
+            w.putU4(DUMMY_STACK_TRACE_SERIAL);
+            w.putId(c->className);
+        });
+        classSerial++;
+    });
+    ctx.classes = classSerial;
+
+    // GC roots: 线程对象，栈帧中（保守地）引用的对象
+    w.putRecord(HPROF_HEAP_DUMP_SEGMENT, [&]() {
+        for (Thread *t : g_all_threads) {
+            w.putU1(HPROF_GC_ROOT_THREAD_OBJ);
+            w.putId(t->jThread);
+            w.putU4(t->id);
+            w.putU4(DUMMY_STACK_TRACE_SERIAL + t->id);
+
+            u4 depth = 0;
+            for (Frame *frame = t->getTopFrame(); frame != nullptr; frame = frame->prev, depth++) {
+                Method *m = frame->method;
+                auto ostack = (const slot_t *) (frame + 1);
+                auto root = [&](slot_t v) {
+                    if (ctx.isObject(v)) {
+                        w.putU1(HPROF_GC_ROOT_JAVA_FRAME);
+                        w.putId((const void *) v);
+                        w.putU4(t->id);
+                        w.putU4(depth);
+                    }
+                };
+                for (u2 i = 0; i < m->maxLocals; i++)
+                    root(frame->lvars[i]);
+                for (u2 i = 0; i < m->maxStack; i++)
+                    root(ostack[i]);
+            }
+        }
+    });
+
+    // boot class loader 定义的类作为 GC roots，以及所有的 class dumps
+    w.putRecord(HPROF_HEAP_DUMP_SEGMENT, [&w]() {
+        forEachClass([&w](Class *c) {
+            if (c->loader == bootClassLoader) {
+                w.putU1(HPROF_GC_ROOT_STICKY_CLASS);
+                w.putId(c);
+            }
+            dumpClass(w, c);
+        });
+    });
+
+    auto dumpObject = [&w](Object *o) {
+        if (o->clazz->isArrayClass())
+            dumpArray(w, (Array *) o);
+        else
+            dumpInstance(w, o);
+    };
+
+    // objectArea 中的对象，每个 segment 写到超过 SEGMENT_FLUSH_SIZE 为止
+    address mem = oa->jumpFreelist(ctx.heapBegin);
+    while (mem < ctx.heapEnd) {
+        address segmentBegin = mem;
+        w.putRecord(HPROF_HEAP_DUMP_SEGMENT, [&]() {
+            mem = segmentBegin;
+            while (mem < ctx.heapEnd and w.size() < SEGMENT_FLUSH_SIZE) {
+                dumpObject((jref) mem);
+                mem = oa->jumpFreelist(mem + ((jref) mem)->size());
+            }
+        });
+    }
+
+    // 大对象，每个一个 segment
+    los->forEachObject([&](Object *o) {
+        w.putRecord(HPROF_HEAP_DUMP_SEGMENT, [&]() { dumpObject(o); });
+    });
+
+    w.putRecord(HPROF_HEAP_DUMP_END, []() { });
+
+    los->unlock();
+    oa->unlock();
+}
+
+bool dumpHeap(const char *path)
+{
+    assert(path != nullptr);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == nullptr) {
+        printvm("Unable to create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    printf("Dumping heap to %s ...\n", path);
+
+    const char *header = "JAVA PROFILE 1.0.2";
+    fwrite(header, 1, strlen(header) + 1, fp);
+    u1 head[12];
+    u4 idSize = sizeof(void *);
+    auto now = (uint64_t) duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    for (int i = 0; i < 4; i++)
+        head[i] = (u1) (idSize >> (24 - 8*i));
+    for (int i = 0; i < 8; i++)
+        head[4 + i] = (u1) (now >> (56 - 8*i));
+    fwrite(head, 1, sizeof(head), fp);
+
+    HprofWriter w(fp);
+
+    // 暂停其他线程期间不能分配内存，用到的存储都在这之前准备好
+    DumpContext ctx;
+    Memory *oa = g_heap.objectArea;
+    ctx.oa = oa;
+    ctx.los = g_heap.largeObjectSpace;
+    ctx.heapBegin = oa->getMem();
+    ctx.heapEnd = ctx.heapBegin + oa->getSize();
+    ctx.starts.assign(oa->getSize()/8 + 1, false);
+    size_t names = 0;
+    forEachClass([&names](Class *c) { names += 1 + c->fields.size(); });
+    ctx.names.reserve(names + names/4 + 1024); // 留出暂停之前新加载的类的
+
+    runWorldStopped([&w, &ctx]() { dumpStopped(w, ctx); });
+
+    bool ok = ferror(fp) == 0;
+    fclose(fp);
+    printf("Heap dump file created [%zu objects, %zu classes]\n", ctx.objects, ctx.classes);
+    return ok;
+}
+
+const char *heapDumpFilePath(char *buf, size_t len)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "java_pid%d.hprof", (int) getpid());
+
+    struct stat st;
+    if (heapDumpPath[0] == 0) {
+        snprintf(buf, len, "%s", name);
+    } else if (stat(heapDumpPath, &st) == 0 and S_ISDIR(st.st_mode)) {
+        snprintf(buf, len, "%s/%s", heapDumpPath, name);
+    } else {
+        snprintf(buf, len, "%s", heapDumpPath);
+    }
+    return buf;
+}
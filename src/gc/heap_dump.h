@@ -0,0 +1,24 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_HEAP_DUMP_H
+#define KAYOVM_HEAP_DUMP_H
+
+/*
+ * 以 HPROF 格式（JAVA PROFILE 1.0.2）将堆转储到文件 @path，
+ * 可以用 Eclipse MAT, VisualVM 等工具打开。
+ *
+ * 转储期间暂停其他所有线程（同 gc），得到一致的快照。
+ * 调用者不能在 NoSuspendScope 中。
+ * 成功返回 true.
+ */
+bool dumpHeap(const char *path);
+
+/*
+ * 按 -XX:HeapDumpPath 得到转储文件的路径（写入 @buf），
+ * 未设置或者设置为目录时，文件名为 java_pid<pid>.hprof
+ */
+const char *heapDumpFilePath(char *buf, size_t len);
+
+#endif //KAYOVM_HEAP_DUMP_H
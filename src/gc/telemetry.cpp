@@ -0,0 +1,139 @@
+/*
+ * Author: kayo
+ */
+
+#include <chrono>
+#include <climits>
+#include <sstream>
+#include <unistd.h>
+#include <pthread.h>
+#include "telemetry.h"
+#include "../kayo.h"
+
+using namespace std;
+using namespace std::chrono;
+
+FILE *gcLogFile = nullptr;
+jlong telemetryIntervalMillis = 0;
+char telemetryPath[PATH_MAX] = { 0 };
+
+static const steady_clock::time_point startTime = steady_clock::now();
+
+static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
+static GcStats gcStats;
+
+static double uptimeSeconds()
+{
+    return duration<double>(steady_clock::now() - startTime).count();
+}
+
+void recordGcCycle(uint64_t pauseNanos, size_t usedBefore, size_t usedAfter, size_t capacity)
+{
+    static const uint64_t buckets[] = GC_PAUSE_BUCKETS;
+
+    pthread_mutex_lock(&statsMutex);
+    uint64_t id = gcStats.cycles++;
+    gcStats.totalPauseNanos += pauseNanos;
+    gcStats.maxPauseNanos = max(gcStats.maxPauseNanos, pauseNanos);
+    int i = 0;
+    while (i < GC_PAUSE_BUCKETS_COUNT - 1 and pauseNanos >= buckets[i]*1000000)
+        i++;
+    gcStats.pauseHistogram[i]++;
+    if (usedBefore > usedAfter)
+        gcStats.freedBytes += usedBefore - usedAfter;
+    gcStats.survivedBytes = usedAfter;
+    pthread_mutex_unlock(&statsMutex);
+
+    if (gcLogFile != nullptr) {
+        fprintf(gcLogFile, "[%.3fs][info][gc] GC(%llu) Pause Full (MarkSweep) %zuK->%zuK(%zuK) %.3fms\n",
+                uptimeSeconds(), (unsigned long long) id,
+                usedBefore >> 10, usedAfter >> 10, capacity >> 10, pauseNanos / 1e6);
+        fflush(gcLogFile);
+    }
+}
+
+GcStats getGcStats()
+{
+    pthread_mutex_lock(&statsMutex);
+    GcStats s = gcStats;
+    pthread_mutex_unlock(&statsMutex);
+    return s;
+}
+
+string telemetryToJson()
+{
+    // 分配速率按两次调用之间的差值计算
+    static pthread_mutex_t rateMutex = PTHREAD_MUTEX_INITIALIZER;
+    static double lastTime = 0;
+    static uint64_t lastAllocated = 0;
+
+    double now = uptimeSeconds();
+    uint64_t allocated = g_heap.getAllocatedBytes();
+    pthread_mutex_lock(&rateMutex);
+    double rate = now > lastTime ? (allocated - lastAllocated) / (now - lastTime) : 0;
+    lastTime = now;
+    lastAllocated = allocated;
+    pthread_mutex_unlock(&rateMutex);
+
+    ostringstream os;
+    os << "{\"uptime\":" << now;
+    os << ",\"allocatedBytes\":" << allocated;
+    os << ",\"allocationRate\":" << (uint64_t) rate;
+
+    os << ",\"areas\":[";
+    bool first = true;
+    for (auto &a : g_heap.getAreaStats()) {
+        if (!first)
+            os << ',';
+        first = false;
+        os << "{\"name\":\"" << a.name << "\""
+           << ",\"heap\":" << (a.heap ? "true" : "false")
+           << ",\"capacity\":" << a.capacity
+           << ",\"used\":" << a.used
+           << ",\"free\":" << a.free()
+           << ",\"largestFree\":" << a.largestFree
+           << ",\"freeBlocks\":" << a.freeBlocks
+           << ",\"fragmentation\":" << a.fragmentation() << "}";
+    }
+    os << ']';
+
+    static const uint64_t buckets[] = GC_PAUSE_BUCKETS;
+    GcStats s = getGcStats();
+    os << ",\"gc\":{\"cycles\":" << s.cycles
+       << ",\"totalPauseMillis\":" << s.totalPauseNanos / 1e6
+       << ",\"maxPauseMillis\":" << s.maxPauseNanos / 1e6
+       << ",\"freedBytes\":" << s.freedBytes
+       << ",\"survivedBytes\":" << s.survivedBytes
+       << ",\"pauseHistogram\":{";
+    for (int i = 0; i < GC_PAUSE_BUCKETS_COUNT; i++) {
+        if (i > 0)
+            os << ',';
+        if (i < GC_PAUSE_BUCKETS_COUNT - 1)
+            os << "\"<" << buckets[i] << "ms\":";
+        else
+            os << "\">=" << buckets[i - 1] << "ms\":";
+        os << s.pauseHistogram[i];
+    }
+    os << "}}}";
+    return os.str();
+}
+
+void *telemetryLoop(void *arg)
+{
+    char path[PATH_MAX];
+    if (telemetryPath[0] != 0)
+        snprintf(path, sizeof(path), "%s", telemetryPath);
+    else
+        snprintf(path, sizeof(path), "telemetry_pid%d.json", (int) getpid());
+
+    while (true) {
+        usleep((useconds_t) (telemetryIntervalMillis * 1000));
+        FILE *fp = fopen(path, "a");
+        if (fp == nullptr) {
+            printvm("Unable to open %s\n", path);
+            return nullptr;
+        }
+        fprintf(fp, "%s\n", telemetryToJson().c_str());
+        fclose(fp);
+    }
+}
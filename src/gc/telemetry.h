@@ -0,0 +1,59 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_TELEMETRY_H
+#define KAYOVM_TELEMETRY_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include "../jtypes.h"
+
+/*
+ * GC 和堆的统计数据。
+ *
+ * 三种输出方式：
+ *   -Xlog:gc[:<file>] (或 -verbose:gc)：每次 gc 输出一行日志；
+ *   java.lang.management 的 MemoryPool 和 GarbageCollector MXBeans，参见 native/sun/management/MemoryImpl.cpp；
+ *   -XX:TelemetryInterval=<ms>：由 telemetry 线程定期将 telemetryToJson() 追加到
+ *                                -XX:TelemetryPath=<file>（默认 telemetry_pid<pid>.json），每行一个 JSON 对象。
+ */
+
+// pause 时间直方图的上界（毫秒），最后一个桶为 >= 最后一个上界
+#define GC_PAUSE_BUCKETS { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 }
+#define GC_PAUSE_BUCKETS_COUNT 11
+
+struct GcStats {
+    uint64_t cycles = 0;
+    uint64_t totalPauseNanos = 0;
+    uint64_t maxPauseNanos = 0;
+    uint64_t pauseHistogram[GC_PAUSE_BUCKETS_COUNT] = { 0 };
+
+    uint64_t freedBytes = 0;     // 累计回收的字节数
+    /*
+     * 没有分代，不存在晋升。这里记录每次 gc 后存活的字节数，
+     * 即分代 GC 中会被晋升到老年代的部分。
+     */
+    uint64_t survivedBytes = 0;  // 最近一次 gc 后存活的字节数
+};
+
+// 由 gc() 在每次回收后调用
+void recordGcCycle(uint64_t pauseNanos, size_t usedBefore, size_t usedAfter, size_t capacity);
+
+GcStats getGcStats();
+
+// -Xlog:gc 输出的位置，nullptr 表示不输出
+extern FILE *gcLogFile;
+
+// 定期输出 JSON 的间隔（毫秒），0 表示不输出
+extern jlong telemetryIntervalMillis;
+extern char telemetryPath[];
+
+// 当前的堆和 GC 的统计数据，一个 JSON 对象
+std::string telemetryToJson();
+
+// telemetry 线程
+void *telemetryLoop(void *arg);
+
+#endif //KAYOVM_TELEMETRY_H
@@ -100,8 +100,10 @@ static const char *instruction_names[] = {
         // Reserved [0xca ... 0xff]
         "breakpoint",
         "ldc_quick", "ldc_w_quick", "getfield_quick", "getfield2_quick", "invokestatic_quick", // [0xcb ... 0xcf]
-        "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xd0 ... 0xd7]
-        "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xd8 ... 0xdf]
+        "invokesuper_quick", "invokenonvirtual_quick",
+        "getfield_b_quick", "getfield_c_quick", "getfield_s_quick", "getfield_a_quick", // [0xd2 ... 0xd5]
+        "putfield_b_quick", "putfield_c_quick", "putfield_quick", "putfield2_quick", "putfield_a_quick", // [0xd6 ... 0xda]
+        "invokevirtual_cha_quick", "notused", "notused", "notused", "notused", // [0xdb ... 0xdf]
         "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xe0 ... 0xe7]
         "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xe8 ... 0xef]
         "notused", "notused", "notused", "notused", "notused", "notused", "notused", "notused", // [0xf0 ... 0xf7]
@@ -111,6 +113,61 @@ static const char *instruction_names[] = {
 #endif
 
 
+#if USE_QUICK_INSTRUCTIONS
+static u1 getfieldQuickOpcode(const Field *f)
+{
+    switch (f->descriptor[0]) {
+        case 'Z':
+        case 'B': return OPC_GETFIELD_B_QUICK;
+        case 'C': return OPC_GETFIELD_C_QUICK;
+        case 'S': return OPC_GETFIELD_S_QUICK;
+        case 'I':
+        case 'F': return OPC_GETFIELD_QUICK;
+        case 'J':
+        case 'D': return OPC_GETFIELD2_QUICK;
+        default:  return OPC_GETFIELD_A_QUICK;
+    }
+}
+
+static u1 putfieldQuickOpcode(const Field *f)
+{
+    switch (f->descriptor[0]) {
+        case 'Z':
+        case 'B': return OPC_PUTFIELD_B_QUICK;
+        case 'C':
+        case 'S': return OPC_PUTFIELD_C_QUICK;
+        case 'I':
+        case 'F': return OPC_PUTFIELD_QUICK;
+        case 'J':
+        case 'D': return OPC_PUTFIELD2_QUICK;
+        default:  return OPC_PUTFIELD_A_QUICK;
+    }
+}
+#endif
+
+// 简单方法 getter 和 setter 访问的 field
+static Field *trivialField(Method *m)
+{
+    assert(m->trivial == Method::GETTER || m->trivial == Method::SETTER);
+    if (m->trivialField == nullptr)
+        m->trivialField = m->clazz->cp.resolveField(m->trivialIndex);
+    return m->trivialField;
+}
+
+/*
+ * 构造函数 @m 是否是空的：只调用了父类的空构造函数（递归地）。
+ * 结果记在 m->trivial 中，是空的改为 EMPTY，否则改为 NOT_TRIVIAL.
+ */
+static bool isEmptyInit(Method *m)
+{
+    if (m->trivial == Method::EMPTY_INIT) {
+        Method *init = m->clazz->cp.resolveMethod(m->trivialIndex);
+        bool empty = init->name == S(object_init) && !init->isStatic() && isEmptyInit(init);
+        m->trivial = empty ? Method::EMPTY : Method::NOT_TRIVIAL;
+    }
+    return m->trivial == Method::EMPTY;
+}
+
 /*
  * 执行当前线程栈顶的frame
  */
@@ -220,8 +277,9 @@ static slot_t *exec()
         // Reserved [0xca ... 0xff]
         &&opc_breakpoint,
         &&opc_ldc_quick, &&opc_ldc_w_quick, &&opc_getfield_quick, &&opc_getfield2_quick, &&opc_invokestatic_quick, &&opc_invokesuper_quick, &&opc_invokenonvirtual_quick,
-        &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
-        &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
+        &&opc_getfield_b_quick, &&opc_getfield_c_quick, &&opc_getfield_s_quick, &&opc_getfield_a_quick,
+        &&opc_putfield_b_quick, &&opc_putfield_c_quick, &&opc_putfield_quick, &&opc_putfield2_quick, &&opc_putfield_a_quick,
+        &&opc_invokevirtual_cha_quick, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
         &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
         &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
         &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused, &&opc_notused,
@@ -302,17 +360,14 @@ opc_sipush: // Short Integer push
 
 {
     u2 index;
+    bool wide;
 opc_ldc:
     index = reader->readu1();
-#if USE_QUICK_INSTRUCTIONS
-    reader->setu1(-2, OPC_LDC_QUICK);
-#endif
+    wide = false;
     goto __ldc;
 opc_ldc_w:
     index = reader->readu2();
-#if USE_QUICK_INSTRUCTIONS
-    reader->setu1(-3, OPC_LDC_W_QUICK);
-#endif
+    wide = true;
 __ldc:
     u1 type = cp->type(index);
 
@@ -335,13 +390,22 @@ __ldc:
             thread_throw(new UnknownError(NEW_MSG("unknown type: %d", type)));
             break;
     }
+#if USE_QUICK_INSTRUCTIONS
+    // 常量解析之后才改写，ldc_quick 直接使用常量池中解析的结果
+    if (wide)
+        reader->quicken(-3, OPC_LDC_W_QUICK);
+    else
+        reader->quicken(-2, OPC_LDC_QUICK);
+#endif
     DISPATCH
     
 opc_ldc_quick:
+    BytecodeReader::quickened();
     index = reader->readu1();
     *frame->ostack++ = cp->info(index);
     DISPATCH
 opc_ldc_w_quick:
+    BytecodeReader::quickened();
     index = reader->readu2();
     *frame->ostack++ = cp->info(index);
     DISPATCH
@@ -1015,43 +1079,35 @@ opc_getfield: {
         thread_throw(new NullPointerException);
     }
 
-    *frame->ostack++ = obj->data[field->id];
-    if (field->categoryTwo) {
-        *frame->ostack++ = obj->data[field->id + 1];
-    }
+    obj->getFieldValue(field, frame->ostack);
+    frame->ostack += field->categoryTwo ? 2 : 1;
 #if USE_QUICK_INSTRUCTIONS
-    if (field->id < U2_MAX) {
-        if (!field->categoryTwo)
-            reader->setu1(-3, OPC_GETFIELD_QUICK);
-        else
-            reader->setu1(-3, OPC_GETFIELD2_QUICK);
-        // 用 field->id 替换掉 index
-        reader->setu2(-2, (u2)(field->id));
+    if (field->offset < U2_MAX) {
+        // 用 field->offset 替换掉 index，先写操作数再写操作码，参见 BytecodeReader::quicken
+        reader->setu2(-2, (u2)(field->offset));
+        reader->quicken(-3, getfieldQuickOpcode(field));
     }
 #endif
     DISPATCH
 }
-opc_getfield_quick: {
-    u2 filed_id = reader->readu2();
-    jref obj = frame->popr();
-    if (obj == jnull) {
-        thread_throw(new NullPointerException);
-    }
-
-    *frame->ostack++ = obj->data[filed_id];
-    DISPATCH
-}
-opc_getfield2_quick: {
-    u2 filed_id = reader->readu2();
-    jref obj = frame->popr();
-    if (obj == jnull) {
-        thread_throw(new NullPointerException);
-    }
-
-    *frame->ostack++ = obj->data[filed_id];
-    *frame->ostack++ = obj->data[filed_id + 1];
-    DISPATCH
+#define GETFIELD_QUICK(T, push) \
+{ \
+    BytecodeReader::quickened(); \
+    u2 offset = reader->readu2(); \
+    jref obj = frame->popr(); \
+    if (obj == jnull) { \
+        thread_throw(new NullPointerException); \
+    } \
+    frame->push(*(T *) ((u1 *) obj + offset)); \
+    DISPATCH \
 }
+opc_getfield_quick:   GETFIELD_QUICK(jint, pushi)
+opc_getfield2_quick:  GETFIELD_QUICK(jlong, pushl)
+opc_getfield_b_quick: GETFIELD_QUICK(jbyte, pushi)
+opc_getfield_c_quick: GETFIELD_QUICK(jchar, pushi)
+opc_getfield_s_quick: GETFIELD_QUICK(jshort, pushi)
+opc_getfield_a_quick: GETFIELD_QUICK(jref, pushr)
+#undef GETFIELD_QUICK
 opc_putfield: {
     u2 index = reader->readu2();
     Field *field = cp->resolveField(index);
@@ -1078,8 +1134,33 @@ opc_putfield: {
     }
 
     obj->setFieldValue(field, value);
+#if USE_QUICK_INSTRUCTIONS
+    if (field->offset < U2_MAX) {
+        // 用 field->offset 替换掉 index，先写操作数再写操作码，参见 BytecodeReader::quicken
+        reader->setu2(-2, (u2)(field->offset));
+        reader->quicken(-3, putfieldQuickOpcode(field));
+    }
+#endif
     DISPATCH
 }
+#define PUTFIELD_QUICK(T, pop) \
+{ \
+    BytecodeReader::quickened(); \
+    u2 offset = reader->readu2(); \
+    auto value = (T) frame->pop(); \
+    jref obj = frame->popr(); \
+    if (obj == jnull) { \
+        thread_throw(new NullPointerException); \
+    } \
+    *(T *) ((u1 *) obj + offset) = value; \
+    DISPATCH \
+}
+opc_putfield_quick:   PUTFIELD_QUICK(jint, popi)
+opc_putfield2_quick:  PUTFIELD_QUICK(jlong, popl)
+opc_putfield_b_quick: PUTFIELD_QUICK(jbyte, popi)
+opc_putfield_c_quick: PUTFIELD_QUICK(jchar, popi) // char and short
+opc_putfield_a_quick: PUTFIELD_QUICK(jref, popr)
+#undef PUTFIELD_QUICK
 opc_invokevirtual: {
     // invokevirtual指令用于调用对象的实例方法，根据对象的实际类型进行分派（虚方法分派）。
     u2 index = reader->readu2();
@@ -1096,9 +1177,37 @@ opc_invokevirtual: {
     resolved_method = obj->clazz->vtable[m->vtableIndex];
     assert(resolved_method == obj->clazz->lookupMethod(m->name, m->descriptor));
 
+#if USE_QUICK_INSTRUCTIONS
+    if (!m->isAbstract()) {
+        if (m->isFinal() || m->clazz->isFinal()) {
+            // 不可能被重写
+            reader->quicken(-3, OPC_INVOKENONVIRTUAL_QUICK);
+        } else if (!m->overridden.load(std::memory_order_acquire)) {
+            reader->quicken(-3, OPC_INVOKEVIRTUAL_CHA_QUICK);
+        }
+    }
+#endif
+
     TRACE("obj: %p, %s\n", obj, resolved_method->toString().c_str());
     goto __invoke_method;
 }
+opc_invokevirtual_cha_quick: {
+    BytecodeReader::quickened();
+    u2 index = reader->readu2();
+    resolved_method = (Method *) cp->info(index);
+    if (resolved_method->overridden.load(std::memory_order_acquire)) {
+        // 推测失效了：已加载了重写此方法的子类，恢复为 invokevirtual 重新执行
+        reader->quicken(-3, OPC_INVOKEVIRTUAL);
+        reader->skip(-3);
+        DISPATCH
+    }
+    frame->ostack -= resolved_method->arg_slot_count;
+    auto obj = (jref) frame->ostack[0];
+    if (obj == jnull) {
+        thread_throw(new NullPointerException);
+    }
+    goto __invoke_direct;
+}
 opc_invokespecial: {
     // invokespecial指令用于调用一些需要特殊处理的实例方法，
     // 包括构造函数、私有方法和通过super关键字调用的超类方法。
@@ -1116,11 +1225,11 @@ opc_invokespecial: {
         && !utf8::equals(m->name, S(object_init))) {
         m = clazz->superClass->lookupMethod(m->name, m->descriptor);
 #if USE_QUICK_INSTRUCTIONS
-        reader->setu1(-3, OPC_INVOKESUPER_QUICK);
+        reader->quicken(-3, OPC_INVOKESUPER_QUICK);
 #endif
     } else {
 #if USE_QUICK_INSTRUCTIONS
-        reader->setu1(-3, OPC_INVOKENONVIRTUAL_QUICK);
+        reader->quicken(-3, OPC_INVOKENONVIRTUAL_QUICK);
 #endif
     }
 
@@ -1141,6 +1250,7 @@ opc_invokespecial: {
     goto __invoke_method;
 }
 opc_invokesuper_quick: {
+    BytecodeReader::quickened();
     u2 index = reader->readu2();
     auto m = (Method *) cp->info(index);
     resolved_method = clazz->superClass->lookupMethod(m->name, m->descriptor);
@@ -1152,6 +1262,12 @@ opc_invokesuper_quick: {
     goto __invoke_method;
 }
 opc_invokenonvirtual_quick: {
+    /*
+     * 调用 getter 和 setter 不改写为 getfield 和 putfield 的 quick 指令：
+     * 要同时改写操作码和操作数，正在执行此指令的其他线程可能读到旧的操作码和新的操作数。
+     * 由 __invoke_direct 直接访问 field，不创建栈帧。
+     */
+    BytecodeReader::quickened();
     u2 index = reader->readu2();
     resolved_method = (Method *) cp->info(index);
     frame->ostack -= resolved_method->arg_slot_count;
@@ -1159,7 +1275,7 @@ opc_invokenonvirtual_quick: {
     if (obj == jnull) {
         thread_throw(new NullPointerException);
     }
-    goto __invoke_method;
+    goto __invoke_direct;
 }
 opc_invokestatic: {
     // invokestatic指令用来调用静态方法。
@@ -1178,11 +1294,12 @@ opc_invokestatic: {
     frame->ostack -= m->arg_slot_count;
     resolved_method = m;
 #if USE_QUICK_INSTRUCTIONS
-    reader->setu1(-3, OPC_INVOKESTATIC_QUICK);
+    reader->quicken(-3, OPC_INVOKESTATIC_QUICK);
 #endif
     goto __invoke_method;
 }
 opc_invokestatic_quick: {
+    BytecodeReader::quickened();
     u2 index = reader->readu2();
     resolved_method = (Method *) cp->info(index);
     frame->ostack -= resolved_method->arg_slot_count;
@@ -1286,6 +1403,30 @@ opc_invokedynamic: {
     jvm_abort("never goes here"); // todo
 }
 
+__invoke_direct:
+    /*
+     * 调用的方法是确定的，简单方法（参见 Method::Trivial）直接在这里完成，不创建栈帧。
+     * 参数已出栈，this 已检查不为 null.
+     */
+    switch (resolved_method->trivial) {
+        case Method::GETTER: {
+            Field *f = trivialField(resolved_method);
+            ((jref) frame->ostack[0])->getFieldValue(f, frame->ostack);
+            frame->ostack += f->categoryTwo ? 2 : 1;
+            DISPATCH
+        }
+        case Method::SETTER:
+            ((jref) frame->ostack[0])->setFieldValue(trivialField(resolved_method), frame->ostack + 1);
+            DISPATCH
+        case Method::EMPTY_INIT:
+            if (!isEmptyInit(resolved_method))
+                break;
+            // fall through
+        case Method::EMPTY:
+            DISPATCH
+        default:
+            break;
+    }
 __invoke_method: {
     assert(resolved_method);
     Frame *newFrame = thread->allocFrame(resolved_method, false);
@@ -1294,7 +1435,7 @@ __invoke_method: {
     newFrame->lvars = frame->ostack;
     CHANGE_FRAME(newFrame);    
     if (resolved_method->isSynchronized()) {
-        _this->unlock();
+        _this->lock();
     }
     DISPATCH
 }
@@ -1408,6 +1549,11 @@ opc_athrow: {
             DISPATCH
         }
 
+        // frame 无法处理异常，释放同步方法持有的锁
+        if (frame->method->isSynchronized()) {
+            _this->unlock();
+        }
+
         if (frame->vm_invoke) {
             // frame 由虚拟机调用，则将异常抛给虚拟机
             throw Throwable(eo);
@@ -1567,7 +1713,8 @@ opc_impdep2:
     DISPATCH
 }
 
-slot_t *execJavaFunc(Method *method, const slot_t *args)
+// 在当前线程上创建 @method 的 frame 并执行，异常以 Throwable 抛出时 frame 还没有弹出
+static slot_t *invokeByVM(Method *method, const slot_t *args)
 {
     assert(method != nullptr);
     assert(method->arg_slot_count > 0 ? args != nullptr : true);
@@ -1580,14 +1727,35 @@ slot_t *execJavaFunc(Method *method, const slot_t *args)
         frame->lvars[i] = args[i];
     }
 
+    if (method->isSynchronized()) {
+        // 返回时由 exec() 释放
+        jref _this = method->isStatic() ? (jref) method->clazz : (jref) frame->lvars[0];
+        _this->lock();
+    }
+
+    return exec();
+}
+
+slot_t *execJavaFunc(Method *method, const slot_t *args)
+{
     try {
-        return exec();
+        return invokeByVM(method, args);
     } catch(Throwable &e) {
         // todo
         thread_throw(&e);
     }
 }
 
+slot_t *execJavaFuncThrows(Method *method, const slot_t *args)
+{
+    try {
+        return invokeByVM(method, args);
+    } catch(Throwable &e) {
+        getCurrentThread()->popFrame();
+        throw;
+    }
+}
+
 slot_t *execJavaFunc(Method *method, initializer_list<slot_t> args)
 {
     assert(method != nullptr);
@@ -1626,10 +1794,10 @@ slot_t *execConstructor(Method *constructor, jref _this, Array *args)
         auto o = args->get<jref>(i);
 
         if (c->isPrimClass()) {
-            const slot_t *unbox = o->unbox();
-            realArgs[k++] = *unbox;
+            o->unbox(realArgs + k);
+            k++;
             if (strcmp(o->clazz->className, "long") == 0 || strcmp(o->clazz->className, "double") == 0) // category_two
-                realArgs[k++] = *++unbox;
+                k++;
         } else {
             RSLOT(realArgs + k) = o;
             k++;
@@ -20,6 +20,12 @@ slot_t *execJavaFunc(Method *m, const slot_t *args = nullptr);
 
 slot_t *execJavaFunc(Method *m, std::initializer_list<slot_t> args);
 
+/*
+ * 同 execJavaFunc，但函数抛出的异常不作为未捕获的异常处理，
+ * 而是弹出函数的 frame 后以 Throwable 抛给调用者。
+ */
+slot_t *execJavaFuncThrows(Method *m, const slot_t *args = nullptr);
+
 static inline slot_t *execJavaFunc(Method *m, jref o)
 {
     return execJavaFunc(m, { (slot_t) o });
@@ -256,8 +262,30 @@ slot_t *execConstructor(Method *constructor, jref _this, Array *args);
 #define OPC_INVOKESTATIC_QUICK 207
 #define OPC_INVOKESUPER_QUICK  208
 #define OPC_INVOKENONVIRTUAL_QUICK  209
-//#define OPC_PUTFIELD_QUICK
-//#define OPC_PUTFIELD2_QUICK
+
+/*
+ * 实例变量按类型紧凑存放，quick 版本的 getfield/putfield 按变量的类型区分，
+ * 操作数为变量在对象中的字节偏移。
+ * GETFIELD_QUICK/PUTFIELD_QUICK 用于 int 和 float，
+ * GETFIELD2_QUICK/PUTFIELD2_QUICK 用于 long 和 double，
+ * B 用于 byte 和 boolean，PUTFIELD_C_QUICK 用于 char 和 short。
+ */
+#define OPC_GETFIELD_B_QUICK   210
+#define OPC_GETFIELD_C_QUICK   211
+#define OPC_GETFIELD_S_QUICK   212
+#define OPC_GETFIELD_A_QUICK   213
+#define OPC_PUTFIELD_B_QUICK   214
+#define OPC_PUTFIELD_C_QUICK   215
+#define OPC_PUTFIELD_QUICK     216
+#define OPC_PUTFIELD2_QUICK    217
+#define OPC_PUTFIELD_A_QUICK   218
+
+/*
+ * 解析到的方法当前没有被任何已加载的子类重写（参见 Method::overridden），
+ * 推测调用点总是调用此方法，不经过 vtable 直接调用。
+ * 操作数与 invokevirtual 相同。执行时方法已被重写的话，恢复为 invokevirtual.
+ */
+#define OPC_INVOKEVIRTUAL_CHA_QUICK 219
 //#define OPC_GETSTATIC_QUICK
 //#define OPC_PUTSTATIC_QUICK
 //#define OPC_GETSTATIC2_QUICK
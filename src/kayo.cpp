@@ -16,6 +16,14 @@
 #include "objects/Prims.h"
 #include "objects/Array.h"
 #include "interpreter/interpreter.h"
+#include "gc/gc.h"
+#include "runtime/signals.h"
+#include "runtime/alloc_profiler.h"
+#include "gc/telemetry.h"
+#include "objects/class_archive.h"
+#include "objects/class_prefetcher.h"
+#include "objects/user_class_path.h"
+#include "aot/aot.h"
 
 using namespace std;
 using namespace utf8;
@@ -30,8 +38,6 @@ Heap g_heap;
 
 vector<std::string> jreLibJars;
 vector<std::string> jreExtJars;
-//vector<std::string> userDirs;
-//vector<std::string> userJars;
 
 //StrPool *g_str_pool;
 
@@ -40,12 +46,6 @@ Object *sysThreadGroup;
 vector<Thread *> g_all_threads;
 
 
-static void *gcLoop(void *arg)
-{
-    // todo
-    return nullptr;
-}
-
 static void findJars(const char *path, vector<std::string> &result)
 {
     DIR *dir = opendir(path);
@@ -83,6 +83,9 @@ char javaHome[PATH_MAX] = { 0 };
 static char bootstrap_classpath[PATH_MAX] = { 0 };
 char classpath[PATH_MAX] = { 0 };
 
+bool heapDumpOnOutOfMemoryError = false;
+char heapDumpPath[PATH_MAX] = { 0 };
+
 static void showUsage(const char *name)
 {
 //    printf("Usage: %s [-options] class [arg1 arg2 ...]\n", name);
@@ -112,6 +115,34 @@ static void showUsage(const char *name)
     printf("\t\t   :gc print out results of garbage collection\n");
     printf("\t\t   :jni print out native method dynamic resolution\n");
     printf("  -version\t   print out version number and copyright information\n");// todo
+    printf("  -XX:+HeapDumpOnOutOfMemoryError\n");
+    printf("\t\t   dump the heap in HPROF format when an OutOfMemoryError occurs\n");
+    printf("  -XX:HeapDumpPath=<file or directory>\n");
+    printf("\t\t   where to write heap dumps (default ./java_pid<pid>.hprof)\n");
+    printf("  -Xlog:gc[:<file>] log every garbage collection (-verbose:gc logs to stdout)\n");
+    printf("  -XX:TelemetryInterval=<ms>\n");
+    printf("\t\t   periodically append heap and gc statistics as JSON\n");
+    printf("  -XX:TelemetryPath=<file>\n");
+    printf("\t\t   where to append the statistics (default ./telemetry_pid<pid>.json)\n");
+    printf("  -Xshare:{auto|on|off|dump}\n");
+    printf("\t\t   use (or with dump, create) the class data sharing archive\n");
+    printf("  -XX:SharedArchiveFile=<file>\n");
+    printf("\t\t   class data sharing archive (default <bootclasspath>/kayovm.jsa)\n");
+    printf("  -XX:ClassPrefetchThreads=<n>\n");
+    printf("\t\t   threads that inflate referenced boot classes ahead of use (0 disables)\n");
+    printf("  -XX:DumpLoadedClassList=<file>\n");
+    printf("\t\t   record the name of every loaded class, in load order\n");
+    printf("  -XX:SharedClassListFile=<file>\n");
+    printf("\t\t   preload the listed classes in one sequential pass over the jars;\n");
+    printf("\t\t   with -Xshare:dump, also archive them\n");
+    printf("  -XX:AOTLibrary=<file>\n");
+    printf("\t\t   run the methods precompiled into <file> by kayoaot\n");
+    printf("  -XX:+AllocationProfiling\n");
+    printf("\t\t   sample allocation sites, report as folded stacks on exit or SIGQUIT\n");
+    printf("  -XX:AllocationSampleInterval=<bytes>\n");
+    printf("\t\t   mean bytes allocated per thread between samples (default %d)\n", DEFAULT_ALLOC_SAMPLE_INTERVAL);
+    printf("  -XX:AllocationProfilePath=<prefix>\n");
+    printf("\t\t   report files prefix (default ./alloc_pid<pid>)\n");
     printf("  -? -help\t   print out this message\n");
 
 //    printf("  -Xbootclasspath:%s\n", BCP_MESSAGE);
@@ -193,6 +224,50 @@ static void parseCommandLine(int argc, char *argv[])
             } else if (strcmp(name, "-version") == 0) {
                 showVersionAndCopyright();
                 exit(0);
+            } else if (strcmp(name, "-XX:+HeapDumpOnOutOfMemoryError") == 0) {
+                heapDumpOnOutOfMemoryError = true;
+            } else if (strcmp(name, "-XX:-HeapDumpOnOutOfMemoryError") == 0) {
+                heapDumpOnOutOfMemoryError = false;
+            } else if (strncmp(name, "-XX:HeapDumpPath=", 17) == 0) {
+                strcpy(heapDumpPath, name + 17);
+            } else if (strncmp(name, "-XX:AOTLibrary=", 15) == 0) {
+                strcpy(aotLibraryPath, name + 15);
+            } else if (strcmp(name, "-XX:+AllocationProfiling") == 0) {
+                if (allocSampleInterval == 0)
+                    allocSampleInterval = DEFAULT_ALLOC_SAMPLE_INTERVAL;
+            } else if (strcmp(name, "-XX:-AllocationProfiling") == 0) {
+                allocSampleInterval = 0;
+            } else if (strncmp(name, "-XX:AllocationSampleInterval=", 29) == 0) {
+                allocSampleInterval = strtoul(name + 29, nullptr, 10);
+            } else if (strncmp(name, "-XX:AllocationProfilePath=", 26) == 0) {
+                strcpy(allocProfilePath, name + 26);
+            } else if (strcmp(name, "-Xlog:gc") == 0 or strcmp(name, "-verbose:gc") == 0) {
+                gcLogFile = stdout;
+            } else if (strncmp(name, "-Xlog:gc:", 9) == 0) {
+                gcLogFile = fopen(name + 9, "w");
+                if (gcLogFile == nullptr) {
+                    jvm_abort("can't open gc log file: %s\n", name + 9);
+                }
+            } else if (strncmp(name, "-XX:TelemetryInterval=", 22) == 0) {
+                telemetryIntervalMillis = strtoll(name + 22, nullptr, 10);
+            } else if (strncmp(name, "-XX:TelemetryPath=", 18) == 0) {
+                strcpy(telemetryPath, name + 18);
+            } else if (strcmp(name, "-Xshare:off") == 0) {
+                shareMode = SHARE_OFF;
+            } else if (strcmp(name, "-Xshare:auto") == 0) {
+                shareMode = SHARE_AUTO;
+            } else if (strcmp(name, "-Xshare:on") == 0) {
+                shareMode = SHARE_ON;
+            } else if (strcmp(name, "-Xshare:dump") == 0) {
+                shareMode = SHARE_DUMP;
+            } else if (strncmp(name, "-XX:SharedArchiveFile=", 22) == 0) {
+                strcpy(sharedArchiveFile, name + 22);
+            } else if (strncmp(name, "-XX:ClassPrefetchThreads=", 25) == 0) {
+                classPrefetchThreads = atoi(name + 25);
+            } else if (strncmp(name, "-XX:DumpLoadedClassList=", 24) == 0) {
+                strcpy(dumpLoadedClassList, name + 24);
+            } else if (strncmp(name, "-XX:SharedClassListFile=", 24) == 0) {
+                strcpy(sharedClassListFile, name + 24);
             } else {
                 printf("Unrecognised command line option: %s\n", argv[i]);
                 showUsage(vmName);
@@ -211,7 +286,7 @@ static void parseCommandLine(int argc, char *argv[])
         }
     }
 
-    if (main_class_name[0] == 0) {  // empty  todo
+    if (main_class_name[0] == 0 and shareMode != SHARE_DUMP) {  // empty  todo
         jvm_abort("no input file\n");
     }
 }
@@ -267,23 +342,14 @@ static void initJVM(int argc, char *argv[])
            getcwd(classpath, PATH_MAX); // current working path
         }
     }
-//    else {
-//        const char *delim = ";"; // 各个path以分号分隔
-//        char *path = strtok(user_classpath, delim);
-//        while (path != nullptr) {
-//            const char *suffix = strrchr(path, '.');
-//            if (suffix != nullptr && strcmp(suffix, ".jar") == 0) { // jar file
-//                userJars.emplace_back(path);
-//            } else { // directory
-//                userDirs.emplace_back(path);
-//            }
-//            path = strtok(nullptr, delim);
-//        }
-//    }
-
 
     /* order is important */
     initSymbol();
+    initUserClassPath(classpath);
+    initExtClassPath(jreExtJars);
+    initAot();
+    initClassArchive(bootstrap_classpath);
+    initClassPrefetcher();
     Prims::init();
     initJNI();
     initClassLoader();
@@ -299,6 +365,16 @@ static void initJVM(int argc, char *argv[])
     // VM类的 "initialize~()V" 方法需调用执行
     // 在VM类的类初始化方法中调用了 "initialize" 方法。
     initClass(vm);
+
+    if (shareMode == SHARE_DUMP) {
+        // 启动过程中加载的类就是每次运行都要加载的类，
+        // 再加上类列表中的类（不在启动类路径中的会被忽略）
+        if (sharedClassListFile[0] != 0) {
+            for (auto &name : readClassList(sharedClassListFile))
+                loadBootClass(name.c_str());
+        }
+        exit(dumpClassArchive() ? 0 : -1);
+    }
 }
 
 int main(int argc, char* argv[])
@@ -333,8 +409,15 @@ int main(int argc, char* argv[])
         }
     }
 
-    VMThreadInitInfo gcThreadInfo(gcLoop, GC_THREAD_NAME);
-    createVMThread(&gcThreadInfo); // gc thread
+    VMThreadInitInfo finalizerThreadInfo(finalizerLoop, FINALIZER_THREAD_NAME);
+    createVMThread(&finalizerThreadInfo); // finalizer thread
+    initSignals();
+    initAllocProfiler();
+    VMThreadInitInfo telemetryThreadInfo(telemetryLoop, TELEMETRY_THREAD_NAME);
+    if (telemetryIntervalMillis > 0)
+        createVMThread(&telemetryThreadInfo); // telemetry thread
+    VMThreadInitInfo signalDispatcherInfo(signalDispatcherLoop, SIGNAL_DISPATCHER_THREAD_NAME);
+    createVMThread(&signalDispatcherInfo); // signal dispatcher thread
 
     // 开始在主线程中执行 main 方法
     TRACE("begin to execute main function.\n");
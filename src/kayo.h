@@ -42,13 +42,16 @@ extern std::vector<std::string> jreExtJars;
  * 可以通过 -cp 选项修改，
  * -cp 选项的优先级更高，可以覆盖CLASSPATH环境变量设置。
  * -cp 选项既可以指定目录，也可以指定JAR文件。
+ * 参见 objects/user_class_path.h
  */
-//extern std::vector<std::string> userDirs;
-//extern std::vector<std::string> userJars;
 
 extern char javaHome[];
 extern char classpath[];
 
+// -XX:+HeapDumpOnOutOfMemoryError, -XX:HeapDumpPath=<path>，参见 gc/heap_dump.h
+extern bool heapDumpOnOutOfMemoryError;
+extern char heapDumpPath[];
+
 //extern StrPool *g_str_pool;
 
 // The system Thread group.
@@ -64,7 +67,9 @@ extern std::vector<Thread *> g_all_threads;
 
 
 #define MAIN_THREAD_NAME "main" // name of main thread
-#define GC_THREAD_NAME "gc"
+#define FINALIZER_THREAD_NAME "finalizer"
+#define SIGNAL_DISPATCHER_THREAD_NAME "Signal Dispatcher"
+#define TELEMETRY_THREAD_NAME "telemetry"
 
 #define MSG_MAX_LEN 1024 // message max length
 #define NEW_MSG(...) ({ auto buf = new char[MSG_MAX_LEN]; snprintf(buf, MSG_MAX_LEN, __VA_ARGS__); buf; })
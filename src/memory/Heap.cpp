@@ -1,8 +1,9 @@
 #include "Heap.h"
-#include "../objects/Method.h"
-#include "../objects/Field.h"
-#include "../objects/Class.h"
 #include "../config.h"
+#include "../kayo.h"
+#include "../gc/heap_dump.h"
+#include "../gc/gc.h"
+#include "../runtime/suspend.h"
 
 /*
  * Author: kayo
@@ -10,6 +11,8 @@
 
 using namespace std;
 
+thread_local size_t Heap::unflushedAllocatedBytes = 0;
+
 
 Heap::Heap() noexcept
 {
@@ -45,46 +48,69 @@ Heap::Heap() noexcept
     size -= fieldAreaSize;
 
     objectArea = new Memory(mem, size);
+    largeObjectSpace = new LargeObjectSpace;
 }
 
 Heap::~Heap()
 {
+    delete largeObjectSpace;
     free(raw);
 }
 
-void *Heap::allocClass()
+void *Heap::allocAfterGc(size_t size)
 {
-    return classArea->get(Class::getSize());
+    {
+        // 调用者在 NoSuspendScope 中等待初始化对象头，但此时还没有分配到内存，可以暂停
+        AllowSuspendScope allow;
+        gc();
+    }
+
+    void *p = tryAlloc(size);
+    if (p == nullptr)
+        outOfMemory();
+    return p;
 }
 
-void *Heap::allocMethods(u2 methodsCount)
+void Heap::outOfMemory()
 {
-    assert(methodsCount > 0);
-    return methodArea->get(methodsCount * sizeof(Method));
+    printf("java.lang.OutOfMemoryError: Java heap space\n");
+    if (heapDumpOnOutOfMemoryError) {
+        char path[PATH_MAX];
+        // 调用者在 NoSuspendScope 中等待初始化对象头，但没有分配到内存，转储时要暂停其他线程
+        AllowSuspendScope allow;
+        dumpHeap(heapDumpFilePath(path, sizeof(path)));
+    }
+    jvm_abort("java_lang_OutOfMemoryError"); // todo 抛出 OutOfMemoryError
 }
 
-void *Heap::allocFields(u2 fieldsCount)
+static MemoryAreaStats statsOf(const char *name, bool heap, Memory *m)
 {
-    assert(fieldsCount > 0);
-    return fieldArea->get(fieldsCount * sizeof(Field));
+    size_t free, largestFree, freeBlocks;
+    m->getFreeStats(free, largestFree, freeBlocks);
+    return MemoryAreaStats{ name, heap, m->getSize(), m->getSize() - free, largestFree, freeBlocks };
 }
 
-std::vector<Class *> Heap::getClasses()
+vector<MemoryAreaStats> Heap::getAreaStats()
 {
-    classArea->lock();
-
-    vector<Class *> classes;
-
-    address mem = classArea->getMem();
-    const address end = mem + classArea->getSize();
-
-    while ((mem = classArea->jumpFreelist(mem)) < end) {
-        classes.push_back((Class *) mem);
-        mem += Class::getSize();
-    }
+    vector<MemoryAreaStats> v;
+    v.push_back(statsOf("Object Area", true, objectArea));
+
+    // 大对象空间按需 mmap，没有空闲块
+    size_t los = largeObjectSpace->reservedBytes();
+    v.push_back(MemoryAreaStats{ "Large Object Space", true, los, los, 0, 0 });
+
+    v.push_back(statsOf("Class Area", false, classArea));
+    v.push_back(statsOf("Bytecode Area", false, bytecodeArea));
+    v.push_back(statsOf("Method Area", false, methodArea));
+    v.push_back(statsOf("Field Area", false, fieldArea));
+    return v;
+}
 
-    classArea->unlock();
-    return classes;
+size_t Heap::getObjectsUsed()
+{
+    size_t free, largestFree, freeBlocks;
+    objectArea->getFreeStats(free, largestFree, freeBlocks);
+    return objectArea->getSize() - free + largeObjectSpace->reservedBytes();
 }
 
 string Heap::toString()
@@ -106,5 +132,8 @@ string Heap::toString()
     ss << "objectArea" << endl;
     ss << objectArea->toString() << endl;
 
+    ss << "largeObjectSpace" << endl;
+    ss << largeObjectSpace->reservedBytes() << " bytes reserved" << endl;
+
     return ss.str();
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #define JVM_HEAP_H
 
 #include <cstddef>
+#include <atomic>
 #include <string>
 #include <sstream>
 #include <pthread.h>
@@ -13,13 +14,42 @@
 #include <cassert>
 #include "../jtypes.h"
 #include "Memory.h"
+#include "LargeObjectSpace.h"
+#include "../config.h"
 
 class Class;
 
+// 每个线程累计分配了这么多字节后才加到 Heap::allocatedBytes 中
+#define ALLOC_COUNT_BATCH (64*1024)
+
+// 堆的一个区域的使用情况，参见 Heap::getAreaStats()
+struct MemoryAreaStats {
+    const char *name;
+    bool heap;          // 存放对象的区域（否则为类的元数据）
+    size_t capacity;
+    size_t used;
+    size_t largestFree; // 最大的空闲块
+    size_t freeBlocks;
+
+    size_t free() const
+    {
+        return capacity - used;
+    }
+
+    // 碎片率：空闲空间中不在最大空闲块里的比例，0 表示没有碎片
+    double fragmentation() const
+    {
+        return free() == 0 ? 0 : 1 - (double) largestFree / free();
+    }
+};
+
 class Heap {
     void *raw;
 
-    /* so called method area */
+    /*
+     * so called method area,
+     * 由 Metaspace 管理，参见 Metaspace.h
+     */
 
     Memory *classArea;
     Memory *bytecodeArea;
@@ -29,33 +59,76 @@ class Heap {
     /* real heap saves objects */
     Memory *objectArea;
 
+    /* 大对象单独 mmap，不占用 objectArea */
+    LargeObjectSpace *largeObjectSpace;
+
+    /*
+     * 累计分配的对象字节数，用于计算分配速率。
+     * 各线程先累计在 unflushedAllocatedBytes 中，每满 ALLOC_COUNT_BATCH 字节才加到这里，
+     * 不用每次分配都争用同一个缓存行。所以读到的值比实际少，每个线程最多少 ALLOC_COUNT_BATCH 字节。
+     */
+    std::atomic<uint64_t> allocatedBytes{0};
+    static thread_local size_t unflushedAllocatedBytes;
+
 public:
     Heap() noexcept;
     ~Heap();
 
-    void *allocClass();
-
-    void *allocBytecode(size_t size)
+    void *allocObject(size_t size)
     {
         assert(size > 0);
-        return bytecodeArea->get(size);
+        unflushedAllocatedBytes += size;
+        if (unflushedAllocatedBytes >= ALLOC_COUNT_BATCH)
+            flushAllocatedBytes();
+        void *p = tryAlloc(size);
+        if (p == nullptr)
+            p = allocAfterGc(size);
+        return p;
     }
 
-    void *allocMethods(u2 methodsCount);
+private:
+    void *tryAlloc(size_t size)
+    {
+        if (size >= LARGE_OBJECT_THRESHOLD)
+            return largeObjectSpace->alloc(size);
+        return objectArea->get(size);
+    }
 
-    void *allocFields(u2 fieldsCount);
+    // 分配失败时进行 gc 后再试一次，仍然失败则 OutOfMemoryError
+    void *allocAfterGc(size_t size);
 
-    void *allocObject(size_t size)
+    // 按 -XX:+HeapDumpOnOutOfMemoryError 转储堆，然后退出
+    [[noreturn]] void outOfMemory();
+public:
+
+    // 把当前线程累计的分配字节数加到 allocatedBytes 中，线程结束前也要调用
+    void flushAllocatedBytes()
     {
-        assert(size > 0);
-        return objectArea->get(size);
+        allocatedBytes.fetch_add(unflushedAllocatedBytes, std::memory_order_relaxed);
+        unflushedAllocatedBytes = 0;
     }
 
-    std::vector<Class *> getClasses();
-    
+    uint64_t getAllocatedBytes() const
+    {
+        return allocatedBytes.load(std::memory_order_relaxed);
+    }
+
+    /*
+     * 各个区域的使用情况，依次为：
+     * objectArea, largeObjectSpace, classArea, bytecodeArea, methodArea, fieldArea
+     */
+    std::vector<MemoryAreaStats> getAreaStats();
+
+    // objectArea 和 largeObjectSpace 中已使用的字节数
+    size_t getObjectsUsed();
+
     std::string toString();
 
     friend void gc();
+    friend bool dumpHeap(const char *path);
+
+    // 类的元数据由各个 class loader 的 Metaspace 以 chunk 为单位从 method area 中申请
+    friend class Metaspace;
 };
 
 #endif //JVM_HEAP_H
@@ -0,0 +1,82 @@
+/*
+ * Author: kayo
+ */
+
+#include <cassert>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "LargeObjectSpace.h"
+#include "../runtime/suspend.h"
+
+using namespace std;
+
+LargeObjectSpace::LargeObjectSpace()
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE); // gc 持有锁时会调用 free()
+
+    pthread_mutex_init(&mutex, &attr);
+}
+
+LargeObjectSpace::~LargeObjectSpace()
+{
+    for (auto &o : objects)
+        munmap((void *) o.first, o.second.len);
+}
+
+// 同 Memory，持有时不能被暂停
+void LargeObjectSpace::lock()
+{
+    enterNoSuspend();
+    pthread_mutex_lock(&mutex);
+}
+
+void LargeObjectSpace::unlock()
+{
+    pthread_mutex_unlock(&mutex);
+    exitNoSuspend();
+}
+
+void *LargeObjectSpace::alloc(size_t size)
+{
+    assert(size > 0);
+
+    const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t len = (size + pageSize - 1) & ~(pageSize - 1);
+
+    // mmap 不需要持有锁，匿名映射的页在第一次访问时才由内核分配并清零
+    void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+
+    lock();
+    objects.emplace((address) p, Info(len));
+    reserved += len;
+    unlock();
+    return p;
+}
+
+void LargeObjectSpace::unmap(address p, size_t len)
+{
+    reserved -= len;
+    munmap((void *) p, len);
+}
+
+void LargeObjectSpace::free(address p)
+{
+    lock();
+    auto iter = objects.find(p);
+    assert(iter != objects.end());
+    unmap(p, iter->second.len);
+    objects.erase(iter);
+    unlock();
+}
+
+bool LargeObjectSpace::contains(address p)
+{
+    lock();
+    bool b = objects.find(p) != objects.end();
+    unlock();
+    return b;
+}
@@ -0,0 +1,136 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_LARGE_OBJECT_SPACE_H
+#define KAYOVM_LARGE_OBJECT_SPACE_H
+
+#include <cstddef>
+#include <map>
+#include <pthread.h>
+#include "Memory.h"
+
+class Object;
+
+/*
+ * 大对象空间。
+ *
+ * 大小超过 LARGE_OBJECT_THRESHOLD 的对象（实际上只有大数组）不从 objectArea 分配，
+ * 每个对象单独 mmap 一块匿名内存：
+ *   - 不会在 objectArea 中造成碎片；
+ *   - 匿名页由内核在第一次访问时清零，分配时不需要 memset；
+ *   - 对象被回收时 munmap，内存直接还给操作系统。
+ * GC 的标记位等记录在 objects 表中，标记时不用分配内存，参见 mark() 和 sweep()。
+ */
+class LargeObjectSpace {
+    struct Info {
+        size_t len;             // mmap 的长度（按页对齐）
+        bool marked = false;    // 本次 gc 中已标记
+        bool finalized = false; // 已经交给 finalizer 线程执行过 finalize()
+        bool dead = false;      // 上次 gc 时不可达，等待 sweep() 释放
+
+        explicit Info(size_t len): len(len) { }
+    };
+
+    // 对象的起始地址 -> Info
+    std::map<address, Info> objects;
+    size_t reserved = 0;
+
+    pthread_mutex_t mutex;
+
+    // 调用者持有锁
+    void unmap(address p, size_t len);
+
+public:
+    LargeObjectSpace();
+    ~LargeObjectSpace();
+
+    void lock();
+    void unlock();
+
+    // 申请 @size 字节清零的内存，失败返回 nullptr
+    void *alloc(size_t size);
+
+    // 释放由 alloc() 得到的 @p
+    void free(address p);
+
+    // @p 是否为某个大对象的起始地址
+    bool contains(address p);
+
+    /*
+     * 以下由 gc 在持有锁时调用，除了 sweep() 都不分配也不释放内存，
+     * 可以在暂停其他线程期间调用。
+     */
+
+    // @p 是未标记的大对象时，标记它并返回 true
+    bool mark(address p)
+    {
+        auto iter = objects.find(p);
+        if (iter == objects.end() or iter->second.marked)
+            return false;
+        return iter->second.marked = true;
+    }
+
+    // @p 必须是大对象
+    bool isMarked(address p) const
+    {
+        return objects.at(p).marked;
+    }
+
+    bool isFinalized(address p) const
+    {
+        return objects.at(p).finalized;
+    }
+
+    void setFinalized(address p)
+    {
+        objects.at(p).finalized = true;
+    }
+
+    template <typename Visit>
+    void forEachObject(Visit visit) const
+    {
+        for (auto &o : objects)
+            visit((Object *) o.first);
+    }
+
+    // 把未标记的对象记为待释放，并清除所有的标记
+    void retireUnmarked()
+    {
+        for (auto &o : objects) {
+            o.second.dead = !o.second.marked;
+            o.second.marked = false;
+        }
+    }
+
+    /*
+     * 释放 retireUnmarked() 记下的对象，释放之前对每个调用 @beforeFree(Object *).
+     * 之后分配的对象不受影响，所以可以在恢复其他线程之后再调用。
+     */
+    template <typename BeforeFree>
+    void sweep(BeforeFree beforeFree);
+
+    // 已 mmap 的总字节数
+    size_t reservedBytes() const
+    {
+        return reserved;
+    }
+};
+
+template <typename BeforeFree>
+void LargeObjectSpace::sweep(BeforeFree beforeFree)
+{
+    lock();
+    for (auto iter = objects.begin(); iter != objects.end(); ) {
+        if (!iter->second.dead) {
+            iter++;
+            continue;
+        }
+        beforeFree((Object *) iter->first);
+        unmap(iter->first, iter->second.len);
+        iter = objects.erase(iter);
+    }
+    unlock();
+}
+
+#endif //KAYOVM_LARGE_OBJECT_SPACE_H
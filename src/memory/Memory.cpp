@@ -3,13 +3,16 @@
  */
 
 #include <cassert>
+#include <cstring>
 #include <sstream>
+#include <algorithm>
 #include "Memory.h"
 #include "../kayo.h"
+#include "../runtime/suspend.h"
 
 using namespace std;
 
-Memory::Memory(address mem, size_t size)
+Memory::Memory(address mem, size_t size): mem(mem), size(size)
 {
     assert(mem != 0);
     assert(size > 0);
@@ -32,28 +35,30 @@ Memory::~Memory()
     }
 }
 
+// gc 暂停其他线程后要获取此锁，所以持有时不能被暂停，参见 runtime/suspend.h
 void Memory::lock()
 {
+    enterNoSuspend();
     pthread_mutex_lock(&mutex);
 }
 
 void Memory::unlock()
 {
     pthread_mutex_unlock(&mutex);
+    exitNoSuspend();
 }
 
 address Memory::jumpFreelist(address p)
 {
-    assert(in(p));
+    assert(mem <= p and p <= mem + size);
 
-    Node *curr = freelist;
-    for (; curr != nullptr; curr = curr->next) {
+    // freelist 按地址有序，相邻的空闲块可能没有合并，所以要连续跳过
+    for (Node *curr = freelist; curr != nullptr; curr = curr->next) {
         if (p < curr->head)
             return p; // p is not in freelist
-        auto offset = p - curr->head;
-        if (0 <= offset and offset <= curr->len) {
+        if (p < curr->head + curr->len) {
             // p is in freelist, jump
-            return p + curr->len;
+            p = curr->head + curr->len;
         }
     }
 
@@ -94,12 +99,9 @@ void *Memory::get(size_t len)
     over:
     unlock();
 
-    if (p != nullptr) {
+    if (p != nullptr)
         memset(p, 0, len);
-        return p;
-    }
-
-    jvm_abort("java_lang_OutOfMemoryError"); // todo 堆可以扩张
+    return p; // todo 堆可以扩张
 }
 
 void Memory::back(address p, size_t len)
@@ -160,6 +162,19 @@ void Memory::back(address p, size_t len)
     unlock();
 }
 
+void Memory::getFreeStats(size_t &free, size_t &largestFree, size_t &freeBlocks)
+{
+    free = largestFree = freeBlocks = 0;
+
+    lock();
+    for (auto node = freelist; node != nullptr; node = node->next) {
+        free += node->len;
+        largestFree = max(largestFree, node->len);
+        freeBlocks++;
+    }
+    unlock();
+}
+
 string Memory::toString()
 {
     lock();
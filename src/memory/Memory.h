@@ -37,9 +37,13 @@ public:
     void lock();
     void unlock();
 
+    // 申请 @len 字节清零的内存，空间不足返回 nullptr
     virtual void *get(size_t len);
     void back(address p, size_t len);
 
+    // 统计空闲的总字节数，最大的空闲块的字节数，以及空闲块的个数
+    void getFreeStats(size_t &free, size_t &largestFree, size_t &freeBlocks);
+
     /*
      * 如果不在 freelist 里面，返回 p，
      * 负责跳过此 freelist's Node.
@@ -0,0 +1,161 @@
+/*
+ * Author: kayo
+ */
+
+#include <cassert>
+#include "Metaspace.h"
+#include "../kayo.h"
+#include "../runtime/suspend.h"
+#include "../objects/Class.h"
+#include "../objects/Method.h"
+#include "../objects/Field.h"
+
+using namespace std;
+
+#define ALIGN_UP(size) (((size) + 7) & ~((size_t) 7)) // 8字节对齐
+
+#define CHUNK_HEADER_SIZE chunkHeaderSize()
+
+// 各区域 chunk 的默认大小（不包括 Chunk 头）
+static size_t defaultChunkSize(Metaspace::AreaType type)
+{
+    switch (type) {
+        case Metaspace::CLASS_AREA:    return 16 * ALIGN_UP(Class::getSize());
+        case Metaspace::BYTECODE_AREA: return 64 * 1024;
+        case Metaspace::METHOD_AREA:   return 32 * sizeof(Method);
+        case Metaspace::FIELD_AREA:    return 64 * sizeof(Field);
+        default:
+            NEVER_GO_HERE_ERROR("wrong area type: %d\n", type);
+    }
+}
+
+Memory *Metaspace::areaOf(AreaType type)
+{
+    switch (type) {
+        case Metaspace::CLASS_AREA:    return g_heap.classArea;
+        case Metaspace::BYTECODE_AREA: return g_heap.bytecodeArea;
+        case Metaspace::METHOD_AREA:   return g_heap.methodArea;
+        case Metaspace::FIELD_AREA:    return g_heap.fieldArea;
+        default:
+            NEVER_GO_HERE_ERROR("wrong area type: %d\n", type);
+    }
+}
+
+Metaspace::Metaspace()
+{
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+Metaspace::~Metaspace()
+{
+    for (int t = 0; t < AREAS_COUNT; t++) {
+        for (Chunk *c = chunks[t]; c != nullptr;) {
+            Chunk *next = c->next;
+            areaOf((AreaType) t)->back((address) c, c->size);
+            c = next;
+        }
+        chunks[t] = nullptr;
+    }
+
+    pthread_mutex_destroy(&mutex);
+}
+
+void *Metaspace::alloc(AreaType type, size_t size)
+{
+    assert(size > 0);
+    size = ALIGN_UP(size);
+
+    enterNoSuspend(); // gc 暂停其他线程后要遍历类，持有锁时不能被暂停
+    pthread_mutex_lock(&mutex);
+
+    Chunk *c = chunks[type];
+    if (c == nullptr or c->size - c->used < size) {
+        // 当前 chunk 空间不够了，申请一个新的 chunk
+        size_t chunkSize = CHUNK_HEADER_SIZE + max(size, defaultChunkSize(type));
+        c = (Chunk *) areaOf(type)->get(chunkSize); // get 出来的内存已经清零
+        if (c == nullptr)
+            jvm_abort("java_lang_OutOfMemoryError: Metaspace"); // todo
+        c->next = chunks[type];
+        c->size = chunkSize;
+        c->used = CHUNK_HEADER_SIZE;
+        chunks[type] = c;
+    }
+
+    void *p = (u1 *) c + c->used;
+    c->used += size;
+
+    pthread_mutex_unlock(&mutex);
+    exitNoSuspend();
+    return p;
+}
+
+void *Metaspace::allocClass()
+{
+    return alloc(CLASS_AREA, Class::getSize());
+}
+
+void *Metaspace::allocBytecode(size_t size)
+{
+    return alloc(BYTECODE_AREA, size);
+}
+
+void *Metaspace::allocMethods(u2 methodsCount)
+{
+    assert(methodsCount > 0);
+    return alloc(METHOD_AREA, methodsCount * sizeof(Method));
+}
+
+void *Metaspace::allocFields(u2 fieldsCount)
+{
+    assert(fieldsCount > 0);
+    return alloc(FIELD_AREA, fieldsCount * sizeof(Field));
+}
+
+void *Metaspace::allocVector(size_t size)
+{
+    return alloc(BYTECODE_AREA, size);
+}
+
+size_t Metaspace::classStride()
+{
+    return ALIGN_UP(Class::getSize());
+}
+
+vector<Class *> Metaspace::getClasses()
+{
+    vector<Class *> classes;
+    forEachClass([&classes](Class *c) { classes.push_back(c); });
+    return classes;
+}
+
+bool Metaspace::contains(const void *p)
+{
+    bool found = false;
+
+    enterNoSuspend();
+    pthread_mutex_lock(&mutex);
+    for (auto c : chunks) {
+        for (; c != nullptr and !found; c = c->next)
+            found = (const u1 *) c <= p and p < (const u1 *) c + c->size;
+    }
+    pthread_mutex_unlock(&mutex);
+    exitNoSuspend();
+
+    return found;
+}
+
+size_t Metaspace::reservedBytes()
+{
+    size_t bytes = 0;
+
+    enterNoSuspend();
+    pthread_mutex_lock(&mutex);
+    for (auto c : chunks) {
+        for (; c != nullptr; c = c->next)
+            bytes += c->size;
+    }
+    pthread_mutex_unlock(&mutex);
+    exitNoSuspend();
+
+    return bytes;
+}
@@ -0,0 +1,148 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_METASPACE_H
+#define KAYOVM_METASPACE_H
+
+#include <cstddef>
+#include <vector>
+#include <pthread.h>
+#include "../jtypes.h"
+#include "Memory.h"
+#include "../runtime/suspend.h"
+
+class Class;
+
+/*
+ * 每个 class loader 拥有一个自己的 Metaspace（boot class loader 也有一个）。
+ *
+ * 由此 class loader 定义的类的元数据（Class, Method, Field, bytecode, 常量池等）
+ * 都从它的 Metaspace 中以 bump pointer 的方式分配，分配时不需要查找 freelist。
+ * Metaspace 以 chunk 为单位向 Heap 的各个区域申请内存，
+ * class loader 被卸载时，其 Metaspace 的所有 chunks 一次性归还给 Heap。
+ *
+ * Class 中描述类结构的 vector（methods, fields, vtable, itable, oop map 等）也以 MetaVector
+ * 从 Metaspace 中分配，参见 MetaspaceAllocator.
+ * 其他不常用的元数据（注解、模块信息、bootstrap methods 等）的 vector 仍在 C++ 堆上，
+ * 卸载时由析构函数释放（参见 releaseDetachedLoaders）。
+ */
+class Metaspace {
+public:
+    enum AreaType {
+        CLASS_AREA,
+        BYTECODE_AREA, // bytecode, 常量池，以及 MetaVector 的缓冲区
+        METHOD_AREA,
+        FIELD_AREA,
+        AREAS_COUNT
+    };
+
+private:
+    /*
+     * Chunk 头部保存在 chunk 的起始位置，
+     * 之后的空间用于 bump 分配。
+     */
+    struct Chunk {
+        Chunk *next;
+        size_t size; // 整个 chunk 的大小，包括 Chunk 头
+        size_t used; // 已使用的大小，包括 Chunk 头
+    };
+
+    Chunk *chunks[AREAS_COUNT] = { nullptr };
+
+    static constexpr size_t chunkHeaderSize()
+    {
+        return (sizeof(Chunk) + 7) & ~(size_t) 7; // 8字节对齐
+    }
+
+    pthread_mutex_t mutex;
+
+    void *alloc(AreaType type, size_t size);
+
+    static Memory *areaOf(AreaType type);
+
+    // class area 中每个 Class 占用的字节数
+    static size_t classStride();
+
+public:
+    Metaspace();
+
+    // 将所有 chunks 归还给 Heap
+    ~Metaspace();
+
+    void *allocClass();
+    void *allocBytecode(size_t size);
+    void *allocMethods(u2 methodsCount);
+    void *allocFields(u2 fieldsCount);
+
+    // 为 MetaspaceAllocator 分配 @size 字节
+    void *allocVector(size_t size);
+
+    // 得到在此 Metaspace 中分配的所有类
+    std::vector<Class *> getClasses();
+
+    /*
+     * 对在此 Metaspace 中分配的每个类调用 @visit(Class *)。
+     * 不分配内存，gc 暂停其他线程期间也可以调用。
+     */
+    template <typename Visit>
+    void forEachClass(Visit visit);
+
+    // @p 是否位于此 Metaspace 的某个 chunk 中
+    bool contains(const void *p);
+
+    // 此 Metaspace 已向 Heap 申请的字节数
+    size_t reservedBytes();
+};
+
+/*
+ * 从 Metaspace 中分配内存的 allocator.
+ * Metaspace 是 bump 分配的，deallocate 不归还内存，内存随 Metaspace 一起释放，
+ * 所以 vector 增长时旧的缓冲区就浪费了，大小已知时要先 reserve.
+ */
+template <typename T>
+class MetaspaceAllocator {
+public:
+    using value_type = T;
+
+    Metaspace *metaspace;
+
+    explicit MetaspaceAllocator(Metaspace *metaspace): metaspace(metaspace) { }
+
+    template <typename U>
+    MetaspaceAllocator(const MetaspaceAllocator<U> &a): metaspace(a.metaspace) { }
+
+    T *allocate(size_t n)
+    {
+        return (T *) metaspace->allocVector(n * sizeof(T));
+    }
+
+    void deallocate(T *, size_t) { }
+
+    template <typename U>
+    bool operator==(const MetaspaceAllocator<U> &a) const { return metaspace == a.metaspace; }
+
+    template <typename U>
+    bool operator!=(const MetaspaceAllocator<U> &a) const { return metaspace != a.metaspace; }
+};
+
+template <typename T>
+using MetaVector = std::vector<T, MetaspaceAllocator<T>>;
+
+template <typename Visit>
+void Metaspace::forEachClass(Visit visit)
+{
+    const size_t stride = classStride();
+
+    enterNoSuspend();
+    pthread_mutex_lock(&mutex);
+    // class area 的 chunks 中只存放 Class，且大小一致，可以直接遍历
+    for (Chunk *c = chunks[CLASS_AREA]; c != nullptr; c = c->next) {
+        for (size_t offset = chunkHeaderSize(); offset < c->used; offset += stride)
+            visit((Class *) ((u1 *) c + offset));
+    }
+    pthread_mutex_unlock(&mutex);
+    exitNoSuspend();
+}
+
+#endif //KAYOVM_METASPACE_H
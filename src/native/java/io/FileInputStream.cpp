@@ -79,7 +79,7 @@ static void readBytes(Frame *frame)
     jint len = frame->getLocalAsInt(3);
 
     FILE *file = getFileHandle(_this);
-    jbyte *arr = ((jbyte *) b->data) + off;
+    jbyte *arr = ((jbyte *) b->data()) + off;
     size_t n = fread(arr, sizeof(jbyte), len, file);
 
     frame->pushi(n);
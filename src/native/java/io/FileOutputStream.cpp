@@ -85,7 +85,7 @@ static void writeBytes(Frame *frame)
     bool append = frame->getLocalAsBool(4);
 
     // todo
-    auto data = (jbyte *) b->data;
+    auto data = (jbyte *) b->data();
     write_bytes(_this, data + off, len, append);
     /*
     fdObj := fosObj.GetFieldValue("fd~Ljava/io/FileDescriptor;").(*heap.Object)
@@ -413,7 +413,8 @@ static void getEnclosingMethod0(Frame *frame)
 //private native java.security.ProtectionDomain getProtectionDomain0();
 static void getProtectionDomain0(Frame *frame)
 {
-    jvm_abort("getProtectionDomain0");
+    auto _this = frame->getLocalAsRef<Class>(0);
+    frame->pushr(_this->protectionDomain);
 }
 
 // Generic signature handling
@@ -481,7 +482,7 @@ static void getDeclaredFields0(Frame *frame)
                 (slot_t) stringClass->intern(cls->fields[i]->name), // name
                 (slot_t) cls->fields[i]->getType(), // type
                 cls->fields[i]->modifiers, /* modifiers */
-                (slot_t) cls->fields[i]->id, /* slot   todo */
+                (slot_t) cls->fields[i]->offset, /* slot, 实例变量的字节偏移 */
                 (slot_t) nullptr, /* signature  todo */
                 (slot_t) nullptr, /* annotations  todo */
         });
@@ -36,23 +36,27 @@ static void getClass(Frame *frame)
 // public final native void notifyAll();
 static void notifyAll(Frame *frame)
 {
-//    jref this = frame_locals_getr(frame, 0);
-    // todo
+    jref _this = frame->getLocalAsRef(0);
+    _this->notifyAll();
 }
 
 // public final native void notify();
 static void notify(Frame *frame)
 {
-//    jref this = frame_locals_getr(frame, 0);
-    // todo
+    jref _this = frame->getLocalAsRef(0);
+    _this->notify();
 }
 
 // public final native void wait(long timeout) throws InterruptedException;
 static void wait(Frame *frame)
 {
-//    jref this = frame_locals_getr(frame, 0);
-//    jlong timeout = slot_getl(frame->local_vars + 1);
-    // todo
+    jref _this = frame->getLocalAsRef(0);
+    jlong timeout = frame->getLocalAsLong(1);
+    if (timeout < 0) {
+        throw IllegalArgumentException("timeout value is negative");
+    }
+
+    _this->wait(timeout, 0);
 }
 
 void java_lang_Object_registerNatives()
@@ -30,7 +30,7 @@ static void getSystemPackages0(Frame *frame)
     auto size = packages.size();
 
     auto ao = newArray(loadArrayClass(S(array_java_lang_String)), size);
-    auto p = (Object **) ao->data;
+    auto p = (Object **) ao->data();
     for (auto pkg : packages) {
         *p++ = newString(pkg);
     }
@@ -6,6 +6,7 @@
 #include "../../registry.h"
 #include "../../../objects/slot.h"
 #include "../../../runtime/Frame.h"
+#include "../../../gc/gc.h"
 
 // public native int availableProcessors();
 static void availableProcessors(Frame *frame)
@@ -37,7 +38,7 @@ static void maxMemory(Frame *frame)
 // public native void gc();
 static void gc(Frame *frame)
 {
-    jvm_abort("gc");
+    ::gc();
 }
 
 /* Wormhole for calling java.lang.ref.Finalizer.runFinalization */
@@ -28,48 +28,29 @@ static void yield(Frame *frame)
 // public static native void sleep(long millis) throws InterruptedException;
 static void sleep(Frame *frame)
 {
-    jvm_abort("error\n");
-
     jlong millis = frame->getLocalAsLong(0);
     if (millis < 0) {
         throw IllegalArgumentException("timeout value is negative");
     }
 
-    // todo
-
-//    vars := frame.LocalVars()
-//    millis := vars.GetLong(0)
-//
-//    thread := frame.Thread()
-//    if millis < 0 {
-//        thread.ThrowIllegalArgumentException("timeout value is negative")
-//        return
-//    }
-//
-//    m := millis * int64(time.Millisecond)
-//    d := time.Duration(m)
-//    interrupted := thread.Sleep(d)
-//
-//    if interrupted {
-//                thread.ThrowInterruptedException("sleep interrupted")
-//        }
+    getCurrentThread()->sleep(millis, 0);
 }
 
 // private native void interrupt0();
 static void interrupt0(Frame *frame)
 {
-    jvm_abort("error\n");
-
     jref _this = frame->getLocalAsRef(0);
-    // todo
+    Thread::from(_this)->interrupt();
 }
 
 // private native boolean isInterrupted(boolean ClearInterrupted);
 static void isInterrupted(Frame *frame)
 {
     jref _this = frame->getLocalAsRef(0);
+    jbool clearInterrupted = frame->getLocalAsBool(1);
 
-    frame->pushi(0); // todo
+    bool b = Thread::from(_this)->isInterrupted(clearInterrupted != 0);
+    frame->pushi(b ? 1 : 0);
 }
 
 /*
@@ -137,7 +118,12 @@ static void countStackFrames(Frame *frame)
 // public static native boolean holdsLock(Object obj);
 static void holdsLock(Frame *frame)
 {
-    jvm_abort("holdsLock"); // todo
+    jref obj = frame->getLocalAsRef(0);
+    if (obj == jnull) {
+        throw NullPointerException();
+    }
+
+    frame->pushi(obj->isLockedBy(getCurrentThread()) ? 1 : 0);
 }
 
 // private native static StackTraceElement[][] dumpThreads(Thread[] threads);
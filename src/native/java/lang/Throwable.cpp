@@ -50,7 +50,7 @@ static void fillInStackTrace(Frame *frame)
     }
 
     auto backtrace = newArray(loadArrayClass(S(array_java_lang_Object)), num);
-    auto trace = (Object **) backtrace->data;
+    auto trace = (Object **) backtrace->data();
 
     Class *c = loadBootClass(S(java_lang_StackTraceElement));
     for (int i = 0; f != nullptr; f = f->prev) {
@@ -0,0 +1,135 @@
+#include "../../../registry.h"
+#include "../../../../runtime/Frame.h"
+#include "../../../../objects/Object.h"
+#include "../../../../objects/Array.h"
+#include "../../../../runtime/Thread.h"
+#include "../../../../../zlib/zlib.h"
+
+/*
+ * Author: kayo
+ */
+
+/*
+ * 用自带的 zlib 实现 java.util.zip.Inflater，
+ * addr 是 z_stream *。
+ */
+
+static inline z_stream *getStream(Frame *frame)
+{
+    return (z_stream *) (intptr_t) frame->getLocalAsLong(0);
+}
+
+// private static native void initIDs();
+static void initIDs(Frame *frame)
+{
+    // need to do nothing
+}
+
+// private native static long init(boolean nowrap);
+static void init(Frame *frame)
+{
+    jbool nowrap = frame->getLocalAsBool(0);
+
+    auto strm = new z_stream;
+    memset(strm, 0, sizeof(*strm));
+    int ret = inflateInit2(strm, nowrap ? -MAX_WBITS : MAX_WBITS);
+    if (ret != Z_OK) {
+        delete strm;
+        thread_throw(new InternalError(NEW_MSG("inflateInit2 failed: %d", ret)));
+    }
+    frame->pushl((jlong) (intptr_t) strm);
+}
+
+// private native static void setDictionary(long addr, byte[] b, int off, int len);
+static void setDictionary(Frame *frame)
+{
+    z_stream *strm = getStream(frame);
+    auto b = frame->getLocalAsRef<Array>(2);
+    jint off = frame->getLocalAsInt(3);
+    jint len = frame->getLocalAsInt(4);
+
+    int ret = inflateSetDictionary(strm, (const Bytef *) b->index(off), (uInt) len);
+    if (ret == Z_STREAM_ERROR or ret == Z_DATA_ERROR) {
+        thread_throw(new IllegalArgumentException(NEW_MSG("%s", strm->msg != nullptr ? strm->msg : "bad dictionary")));
+    }
+}
+
+// private native int inflateBytes(long addr, byte[] b, int off, int len) throws DataFormatException;
+static void inflateBytes(Frame *frame)
+{
+    jref _this = frame->getLocalAsRef(0);
+    auto strm = (z_stream *) (intptr_t) frame->getLocalAsLong(1);
+    auto b = frame->getLocalAsRef<Array>(3);
+    jint off = frame->getLocalAsInt(4);
+    jint len = frame->getLocalAsInt(5);
+
+    // 输入在 this.buf[this.off, this.off + this.len)
+    auto buf = _this->getInstFieldValue<jarrref>("buf", "[B");
+    jint thisOff = _this->getInstFieldValue<jint>("off", "I");
+    jint thisLen = _this->getInstFieldValue<jint>("len", "I");
+
+    strm->next_in = (Bytef *) buf->index(thisOff);
+    strm->avail_in = (uInt) thisLen;
+    strm->next_out = (Bytef *) b->index(off);
+    strm->avail_out = (uInt) len;
+
+    int ret = inflate(strm, Z_PARTIAL_FLUSH);
+    switch (ret) {
+        case Z_STREAM_END:
+            _this->setFieldValue("finished", "Z", (slot_t) 1);
+            // fall through
+        case Z_OK:
+            thisOff += thisLen - strm->avail_in;
+            _this->setFieldValue("off", "I", (slot_t) thisOff);
+            _this->setFieldValue("len", "I", (slot_t) strm->avail_in);
+            frame->pushi(len - strm->avail_out);
+            return;
+        case Z_NEED_DICT:
+            _this->setFieldValue("needDict", "Z", (slot_t) 1);
+            thisOff += thisLen - strm->avail_in;
+            _this->setFieldValue("off", "I", (slot_t) thisOff);
+            _this->setFieldValue("len", "I", (slot_t) strm->avail_in);
+            frame->pushi(0);
+            return;
+        case Z_BUF_ERROR:
+            frame->pushi(0);
+            return;
+        case Z_DATA_ERROR:
+            thread_throw(new DataFormatException(NEW_MSG("%s", strm->msg != nullptr ? strm->msg : "invalid data")));
+        default:
+            thread_throw(new InternalError(NEW_MSG("inflate failed: %d", ret)));
+    }
+}
+
+// private native static int getAdler(long addr);
+static void getAdler(Frame *frame)
+{
+    frame->pushi((jint) getStream(frame)->adler);
+}
+
+// private native static void reset(long addr);
+static void reset(Frame *frame)
+{
+    inflateReset(getStream(frame));
+}
+
+// private native static void end(long addr);
+static void end(Frame *frame)
+{
+    z_stream *strm = getStream(frame);
+    inflateEnd(strm);
+    delete strm;
+}
+
+void java_util_zip_Inflater_registerNatives()
+{
+#undef C
+#define C "java/util/zip/Inflater"
+    registerNative(C, "initIDs", "()V", initIDs);
+    registerNative(C, "init", "(Z)J", init);
+    registerNative(C, "setDictionary", "(J[BII)V", setDictionary);
+    registerNative(C, "inflateBytes", "(J[BII)I", inflateBytes);
+    registerNative(C, "getAdler", "(J)I", getAdler);
+    registerNative(C, "reset", "(J)V", reset);
+    registerNative(C, "end", "(J)V", end);
+}
@@ -1,251 +1,223 @@
 #include "../../../registry.h"
 #include "../../../../runtime/Frame.h"
 #include "../../../../objects/Object.h"
-#include "../../../../../zlib/minizip/unzip.h"
+#include "../../../../objects/Array.h"
+#include "../../../../runtime/Thread.h"
+#include "../../../../util/JarFile.h"
 
 /*
  * Author: kayo
  */
 
+/*
+ * jzfile 是 JarFile *，jzentry 是 const JarFile::Entry *，
+ * entry 属于 jzfile，随 jzfile 一起释放。
+ */
+
+#define JZENTRY_NAME    0
+#define JZENTRY_EXTRA   1
+#define JZENTRY_COMMENT 2
+
+static inline u2 le2(const u1 *p)
+{
+    return (u2) (p[0] | (p[1] << 8));
+}
+
+static inline u4 le4(const u1 *p)
+{
+    return (u4) p[0] | ((u4) p[1] << 8) | ((u4) p[2] << 16) | ((u4) p[3] << 24);
+}
+
+static jarrref newByteArray(const u1 *bytes, size_t len)
+{
+    jarrref arr = newArray(loadBootClass(S(array_B)), (jint) len);
+    memcpy(arr->data(), bytes, len);
+    return arr;
+}
+
 // private static native void initIDs();
-void initIDs(Frame *frame)
+static void initIDs(Frame *frame)
 {
-    // todo
+    // need to do nothing
 }
 
 // private static native long open(String name, int mode, long lastModified, boolean usemmap) throws IOException;
-void open(Frame *frame)
+static void open(Frame *frame)
 {
+    // 总是以只读方式 mmap 打开，忽略其他参数
     auto name = frame->getLocalAsRef(0)->toUtf8();
-    // todo 其他几个参数怎么搞？？
-    unzFile jzfile = unzOpen64(name);
+    JarFile *jzfile = JarFile::open(name);
     if (jzfile == nullptr) {
-        throw IOException(name);
+        thread_throw(new ZipException(NEW_MSG("error in opening zip file: %s", name)));
     }
-    frame->pushl((jlong) (jzfile));
+    frame->pushl((jlong) (intptr_t) jzfile);
+}
+
+static inline JarFile *getJzfile(Frame *frame)
+{
+    return (JarFile *) (intptr_t) frame->getLocalAsLong(0);
+}
+
+static inline const JarFile::Entry *getJzentry(Frame *frame, int index)
+{
+    return (const JarFile::Entry *) (intptr_t) frame->getLocalAsLong(index);
 }
 
 // private static native boolean startsWithLOC(long jzfile);
-void startsWithLOC(Frame *frame)
+static void startsWithLOC(Frame *frame)
 {
-    // todo
-    frame->pushi(1);
+    frame->pushi(getJzfile(frame)->startsWithLOC() ? 1 : 0);
 }
 
 // private static native int getTotal(long jzfile);
-void getTotal(Frame *frame)
+static void getTotal(Frame *frame)
 {
-    auto jzfile = (unzFile) frame->getLocalAsLong(0);
-
-    unz_global_info64 info;
-    if (unzGetGlobalInfo64(jzfile, &info) != UNZ_OK) {
-        // todo error
-        jvm_abort("unzGetGlobalInfo64 failed\n");
-    }
-    frame->pushi(info.number_entry);
+    frame->pushi((jint) getJzfile(frame)->size());
 }
 
 // private static native long getNextEntry(long jzfile, int i);
-void getNextEntry(Frame *frame)
+static void getNextEntry(Frame *frame)
 {
-/*
- * 	vars := frame.LocalVars()
-	jzfile := vars.GetLong(0)
-	i := vars.GetInt(2)
-
-	jzentry := getJzentry(jzfile, i)
-
-	stack := frame.OperandStack()
-	stack.PushLong(jzentry)
- */
-    // todo
-    jvm_abort("getNextEntry");
+    JarFile *jzfile = getJzfile(frame);
+    jint i = frame->getLocalAsInt(2);
+    frame->pushl((jlong) (intptr_t) jzfile->get((size_t) i));
 }
 
-// // private static native void freeEntry(long jzfile, long jzentry);
-void freeEntry(Frame *frame)
+// private static native void freeEntry(long jzfile, long jzentry);
+static void freeEntry(Frame *frame)
 {
-    // todo
+    // entry 属于 jzfile，在 close 时一起释放
 }
 
 // private static native long getEntry(long jzfile, byte[] name, boolean addSlash);
-void getEntry(Frame *frame)
-{
-    // todo
-    /*
-     * 	vars := frame.LocalVars()
-	jzfile := vars.GetLong(0)
-	nameObj := vars.GetRef(2)
-	//addSlash := vars.GetBoolean(3)
-
-	// todo
-	name := nameObj.GoBytes()
-	jzentry := getJzentry2(jzfile, name)
-
-	stack := frame.OperandStack()
-	stack.PushLong(jzentry)
-     */
-    jvm_abort("getEntry");
+static void getEntry(Frame *frame)
+{
+    JarFile *jzfile = getJzfile(frame);
+    auto name = frame->getLocalAsRef<Array>(2);
+    jbool addSlash = frame->getLocalAsBool(3);
+
+    auto bytes = (const char *) name->data();
+    const JarFile::Entry *e = jzfile->find(bytes, name->len);
+    if (e == nullptr and addSlash and (name->len == 0 or bytes[name->len - 1] != '/')) {
+        char buf[name->len + 1];
+        memcpy(buf, bytes, name->len);
+        buf[name->len] = '/';
+        e = jzfile->find(buf, name->len + 1);
+    }
+    frame->pushl((jlong) (intptr_t) e);
 }
 
 // private static native byte[] getEntryBytes(long jzentry, int type);
-void getEntryBytes(Frame *frame)
-{
-    jvm_abort("getEntryBytes");
-// todo
-    /*
-     * 	vars := frame.LocalVars()
-	jzentry := vars.GetLong(0)
-	_type := vars.GetInt(2)
-
-	goBytes := _getEntryBytes(jzentry, _type)
-	jBytes := jutil.CastUint8sToInt8s(goBytes)
-	byteArr := heap.NewByteArray(jBytes)
-
-	stack := frame.OperandStack()
-	stack.PushRef(byteArr)
-     */
-
-    /*
-    func _getEntryBytes(jzentry int64, _type int32) []byte {
-	entry := getEntryFile(jzentry)
-	switch _type {
-	case JZENTRY_NAME:
-		return []byte(entry.Name)
-	case JZENTRY_EXTRA:
-		return entry.Extra
-	case JZENTRY_COMMENT:
-		return []byte(entry.Comment)
-	}
-	jutil.Panicf("BAD type: %v", _type)
-	return nil
-}
-     */
+static void getEntryBytes(Frame *frame)
+{
+    const JarFile::Entry *e = getJzentry(frame, 0);
+    jint type = frame->getLocalAsInt(2);
+
+    u2 extraLen = le2(e->cen + 30);
+    u2 commentLen = le2(e->cen + 32);
+    switch (type) {
+        case JZENTRY_NAME:
+            frame->pushr(newByteArray(e->name, e->nameLen));
+            break;
+        case JZENTRY_EXTRA:
+            frame->pushr(extraLen == 0 ? jnull : newByteArray(e->name + e->nameLen, extraLen));
+            break;
+        case JZENTRY_COMMENT:
+            frame->pushr(commentLen == 0 ? jnull : newByteArray(e->name + e->nameLen + extraLen, commentLen));
+            break;
+        default:
+            frame->pushr(jnull);
+    }
 }
 
 // private static native int getEntryFlag(long jzentry);
-void getEntryFlag(Frame *frame)
+static void getEntryFlag(Frame *frame)
 {
-    jvm_abort("getEntryFlag");
-/*
- * todo
- * 	entry := _getEntryPop(frame)
-	flag := int32(entry.Flags)
-
-	stack := frame.OperandStack()
-	stack.PushInt(flag)
- */
+    frame->pushi(le2(getJzentry(frame, 0)->cen + 8));
 }
 
 // private static native long getEntryTime(long jzentry);
-void getEntryTime(Frame *frame)
+static void getEntryTime(Frame *frame)
 {
-    jvm_abort("getEntryTime");
-/*
- * todo
- * 	entry := _getEntryPop(frame)
-	modDate := entry.ModifiedDate
-	modTime := entry.ModifiedTime
-	time := int64(modDate)<<16 | int64(modTime)
-
-	stack := frame.OperandStack()
-	stack.PushLong(time)
- */
+    // MS-DOS 格式的时间，高16位为日期，低16位为时间
+    frame->pushl(le4(getJzentry(frame, 0)->cen + 12));
 }
 
 // private static native long getEntryCrc(long jzentry);
-void getEntryCrc(Frame *frame)
+static void getEntryCrc(Frame *frame)
 {
-    jvm_abort("getEntryCrc");
-    /*
-     * todo
-     * 	entry := _getEntryPop(frame)
-	crc := int64(entry.CRC32)
-
-	stack := frame.OperandStack()
-	stack.PushLong(crc)
-     */
+    frame->pushl(le4(getJzentry(frame, 0)->cen + 16));
 }
 
 // private static native long getEntrySize(long jzentry);
-void getEntrySize(Frame *frame)
+static void getEntrySize(Frame *frame)
 {
-    jvm_abort("getEntrySize");
-/*
- * todo
- * 	entry := _getEntryPop(frame)
-	size := int64(entry.UncompressedSize64)
-
-	stack := frame.OperandStack()
-	stack.PushLong(size)
- */
+    frame->pushl(getJzentry(frame, 0)->uncompressedSize);
 }
 
 // private static native long getEntryCSize(long jzentry);
-void getEntryCSize(Frame *frame)
+static void getEntryCSize(Frame *frame)
 {
-    jvm_abort("getEntryCSize");
-    /*
-     * todo
-     *
-     * 	// entry := _getEntryPop(frame)
-	// size := int64(entry.CompressedSize64)
+    frame->pushl(getJzentry(frame, 0)->compressedSize);
+}
 
-	// stack := frame.OperandStack()
-	// stack.PushLong(size)
+// private static native int getEntryMethod(long jzentry);
+static void getEntryMethod(Frame *frame)
+{
+    frame->pushi(getJzentry(frame, 0)->method);
+}
 
-	// todo
-	getEntrySize(frame)
+/*
+ * 读取 entry 在文件中（压缩后）的数据，从 @pos 开始，
+ * DEFLATED 的数据由 Java 层的 Inflater 解压。
+ *
+ * private static native int read(long jzfile, long jzentry, long pos, byte[] b, int off, int len);
+ */
+static void read(Frame *frame)
+{
+    JarFile *jzfile = getJzfile(frame);
+    const JarFile::Entry *e = getJzentry(frame, 2);
+    jlong pos = frame->getLocalAsLong(4);
+    auto b = frame->getLocalAsRef<Array>(6);
+    jint off = frame->getLocalAsInt(7);
+    jint len = frame->getLocalAsInt(8);
+
+    if (off < 0 or len < 0 or off + len > b->len) {
+        thread_throw(new ArrayIndexOutOfBoundsException);
+    }
+
+    const u1 *data = jzfile->data(e);
+    if (data == nullptr) {
+        thread_throw(new ZipException(NEW_MSG("invalid LOC header: %s", jzfile->getPath())));
+    }
 
-     */
+    if (pos < 0 or pos >= e->compressedSize) {
+        thread_throw(new ZipException(NEW_MSG("specified offset out of range: %lld", (long long) pos)));
+    }
+    jint n = (jint) std::min<jlong>(len, e->compressedSize - pos);
+    memcpy(b->index(off), data + pos, (size_t) n);
+    frame->pushi(n);
 }
 
-// private static native int getEntryMethod(long jzentry);
-void getEntryMethod(Frame *frame)
+// private static native byte[] getCommentBytes(long jzfile);
+static void getCommentBytes(Frame *frame)
 {
-    jvm_abort("getEntryMethod");
-    /*
-     * todo
-     * 	// entry := _getEntryPop(frame)
-	// method := int32(entry.Method)
-
-	// todo
-	stack := frame.OperandStack()
-	stack.PushInt(0)
-     */
-
-    /*
-     * func _getEntryPop(frame *runtime.Frame) *gozip.File {
-	vars := frame.LocalVars()
-	jzentry := vars.GetLong(0)
-
-	entry := getEntryFile(jzentry)
-	return entry
+    u2 commentLen;
+    const u1 *comment = getJzfile(frame)->getComment(commentLen);
+    frame->pushr(commentLen == 0 ? jnull : newByteArray(comment, commentLen));
 }
-     */
+
+// private static native void close(long jzfile);
+static void close(Frame *frame)
+{
+    delete getJzfile(frame);
 }
 
-// private static native int read(long jzfile, long jzentry, long pos, byte[] b, int off, int len);
-void read(Frame *frame)
+// private static native String getZipMessage(long jzfile);
+static void getZipMessage(Frame *frame)
 {
-    jvm_abort("read");
-/*
- * todo
- * 	vars := frame.LocalVars()
-	//jzfile := vars.GetLong(0)
-	jzentry := vars.GetLong(2)
-	pos := vars.GetLong(4)
-	byteArr := vars.GetRef(6)
-	off := vars.GetInt(7)
-	_len := vars.GetInt(8)
-
-	goBytes := byteArr.GoBytes()
-	goBytes = goBytes[off : off+_len]
-	n := readEntry(jzentry, pos, goBytes)
-
-	stack := frame.OperandStack()
-	stack.PushInt(int32(n))
- */
+    // 错误都在发生时以异常抛出
+    frame->pushr(jnull);
 }
 
 void java_util_zip_ZipFile_registerNatives()
@@ -266,5 +238,8 @@ void java_util_zip_ZipFile_registerNatives()
     registerNative(C, "getEntrySize", "(J)J", getEntrySize);
     registerNative(C, "getEntryCSize", "(J)J", getEntryCSize);
     registerNative(C, "getEntryMethod", "(J)I", getEntryMethod);
-    registerNative(C, "read", "((JJJ[BII)I", read);
+    registerNative(C, "read", "(JJJ[BII)I", read);
+    registerNative(C, "getCommentBytes", "(J)[B", getCommentBytes);
+    registerNative(C, "close", "(J)V", close);
+    registerNative(C, "getZipMessage", "(J)Ljava/lang/String;", getZipMessage);
 }
@@ -108,11 +108,16 @@ void sun_reflect_ConstantPool_registerNatives();
 
 void sun_management_VMManagementImpl_registerNatives();
 void sun_management_ThreadImpl_registerNatives();
+void sun_management_MemoryImpl_registerNatives();
+void sun_management_MemoryPoolImpl_registerNatives();
+void sun_management_MemoryManagerImpl_registerNatives();
+void sun_management_GarbageCollectorImpl_registerNatives();
 
 void java_security_AccessController_registerNatives();
 
 void java_util_concurrent_atomic_AtomicLong_registerNatives();
 void java_util_zip_ZipFile_registerNatives();
+void java_util_zip_Inflater_registerNatives();
 
 static struct {
     const char *className;
@@ -163,11 +168,16 @@ static struct {
 
         { "sun/management/VMManagementImpl", sun_management_VMManagementImpl_registerNatives },
         { "sun/management/ThreadImpl", sun_management_ThreadImpl_registerNatives },
+        { "sun/management/MemoryImpl", sun_management_MemoryImpl_registerNatives },
+        { "sun/management/MemoryPoolImpl", sun_management_MemoryPoolImpl_registerNatives },
+        { "sun/management/MemoryManagerImpl", sun_management_MemoryManagerImpl_registerNatives },
+        { "sun/management/GarbageCollectorImpl", sun_management_GarbageCollectorImpl_registerNatives },
 
         { "java/security/AccessController", java_security_AccessController_registerNatives },
 
         { "java/util/concurrent/atomic/AtomicLong", java_util_concurrent_atomic_AtomicLong_registerNatives },
         { "java/util/zip/ZipFile", java_util_zip_ZipFile_registerNatives },
+        { "java/util/zip/Inflater", java_util_zip_Inflater_registerNatives },
 };
 
 // 注册所有的本地方法  // todo 不要一次全注册，需要时再注册
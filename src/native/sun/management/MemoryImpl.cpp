@@ -0,0 +1,239 @@
+/*
+ * Author: kayo
+ */
+
+#include <mutex>
+#include <unordered_map>
+#include "../../registry.h"
+#include "../../../kayo.h"
+#include "../../../runtime/Frame.h"
+#include "../../../objects/Object.h"
+#include "../../../objects/Array.h"
+#include "../../../objects/class_loader.h"
+#include "../../../interpreter/interpreter.h"
+#include "../../../memory/Heap.h"
+#include "../../../gc/telemetry.h"
+
+using namespace std;
+
+/*
+ * 内存池与 Heap::getAreaStats() 返回的各个区域一一对应，
+ * 垃圾收集器只有一个（MarkSweep），它管理所有的堆内存池。
+ */
+
+#define GC_NAME "MarkSweep"
+
+static mutex peakMutex;
+static unordered_map<string, size_t> peaks;
+
+static jref newMemoryUsage(jlong init, jlong used, jlong committed, jlong max)
+{
+    Class *c = loadBootClass("java/lang/management/MemoryUsage");
+    initClass(c);
+    jref usage = newObject(c);
+    usage->setFieldValue("init", "J", (const slot_t *) &init);
+    usage->setFieldValue("used", "J", (const slot_t *) &used);
+    usage->setFieldValue("committed", "J", (const slot_t *) &committed);
+    usage->setFieldValue("max", "J", (const slot_t *) &max);
+    return usage;
+}
+
+static size_t updatePeak(const MemoryAreaStats &a)
+{
+    lock_guard<mutex> lock(peakMutex);
+    size_t &peak = peaks[a.name];
+    peak = max(peak, a.used);
+    return peak;
+}
+
+static bool findArea(jref pool, MemoryAreaStats &area)
+{
+    jstrref name = pool->getInstFieldValue<jstrref>("name", "Ljava/lang/String;");
+    const utf8_t *utf8 = name->toUtf8();
+    bool found = false;
+    for (auto &a : g_heap.getAreaStats()) {
+        if (utf8::equals(a.name, utf8)) {
+            area = a;
+            found = true;
+            break;
+        }
+    }
+    delete[] utf8;
+    return found;
+}
+
+// private native MemoryPoolMXBean[] getMemoryPools0();
+static void getMemoryPools0(Frame *frame)
+{
+    Class *c = loadBootClass("sun/management/MemoryImpl");
+    Method *create = c->getDeclaredStaticMethod("createMemoryPool",
+                                                "(Ljava/lang/String;ZJJ)Ljava/lang/management/MemoryPoolMXBean;");
+
+    auto areas = g_heap.getAreaStats();
+    jarrref pools = newArray(loadBootClass("[Ljava/lang/management/MemoryPoolMXBean;"), areas.size());
+    for (size_t i = 0; i < areas.size(); i++) {
+        // 不支持阈值，都设为 -1
+        slot_t args[6];
+        RSLOT(args) = newString(areas[i].name);
+        ISLOT(args + 1) = areas[i].heap ? 1 : 0;
+        LSLOT(args + 2) = -1;
+        LSLOT(args + 4) = -1;
+        pools->set(i, RSLOT(execJavaFunc(create, args)));
+    }
+    frame->pushr(pools);
+}
+
+// private native MemoryManagerMXBean[] getMemoryManagers0();
+static void getMemoryManagers0(Frame *frame)
+{
+    Class *c = loadBootClass("sun/management/MemoryImpl");
+    Method *create = c->getDeclaredStaticMethod("createGarbageCollector",
+                                                "(Ljava/lang/String;Ljava/lang/String;)Ljava/lang/management/MemoryManagerMXBean;");
+
+    jarrref mgrs = newArray(loadBootClass("[Ljava/lang/management/MemoryManagerMXBean;"), 1);
+    mgrs->set(0, RSLOT(execJavaFunc(create, newString(GC_NAME), newString(GC_NAME))));
+    frame->pushr(mgrs);
+}
+
+// private native MemoryUsage getMemoryUsage0(boolean heap);
+static void getMemoryUsage0(Frame *frame)
+{
+    jbool heap = frame->getLocalAsBool(1);
+
+    jlong used = 0, committed = 0;
+    for (auto &a : g_heap.getAreaStats()) {
+        if (a.heap == (heap != 0)) {
+            used += a.used;
+            committed += a.capacity;
+        }
+    }
+    frame->pushr(newMemoryUsage(committed, used, committed, committed));
+}
+
+// private native void setVerboseGC(boolean value);
+static void setVerboseGC(Frame *frame)
+{
+    jbool value = frame->getLocalAsBool(1);
+    if (value) {
+        if (gcLogFile == nullptr)
+            gcLogFile = stdout;
+    } else if (gcLogFile == stdout) {
+        gcLogFile = nullptr;
+    }
+}
+
+// private native MemoryUsage getUsage0();
+static void getUsage0(Frame *frame)
+{
+    jref _this = frame->getLocalAsRef(0);
+    MemoryAreaStats a;
+    if (!findArea(_this, a)) {
+        frame->pushr(jnull);
+        return;
+    }
+    updatePeak(a);
+    frame->pushr(newMemoryUsage(a.capacity, a.used, a.capacity, a.capacity));
+}
+
+// private native MemoryUsage getPeakUsage0();
+static void getPeakUsage0(Frame *frame)
+{
+    jref _this = frame->getLocalAsRef(0);
+    MemoryAreaStats a;
+    if (!findArea(_this, a)) {
+        frame->pushr(jnull);
+        return;
+    }
+    frame->pushr(newMemoryUsage(a.capacity, updatePeak(a), a.capacity, a.capacity));
+}
+
+// private native MemoryUsage getCollectionUsage0();
+static void getCollectionUsage0(Frame *frame)
+{
+    // 不记录每个池在 gc 之后的使用量
+    frame->pushr(jnull);
+}
+
+// private native void resetPeakUsage0();
+static void resetPeakUsage0(Frame *frame)
+{
+    jref _this = frame->getLocalAsRef(0);
+    MemoryAreaStats a;
+    if (findArea(_this, a)) {
+        lock_guard<mutex> lock(peakMutex);
+        peaks[a.name] = a.used;
+    }
+}
+
+// private native void setUsageThreshold0(long current, long newThreshold);
+// private native void setCollectionThreshold0(long current, long newThreshold);
+static void setThreshold0(Frame *frame)
+{
+    // 不支持阈值
+}
+
+// private native MemoryManagerMXBean[] getMemoryManagers0();
+static void getPoolMemoryManagers0(Frame *frame)
+{
+    Class *c = loadBootClass("sun/management/MemoryImpl");
+    Method *m = c->getDeclaredStaticMethod("getMemoryManagers", "()[Ljava/lang/management/MemoryManagerMXBean;");
+    frame->pushr(RSLOT(execJavaFunc(m)));
+}
+
+// private native MemoryPoolMXBean[] getMemoryPools0();
+static void getManagerMemoryPools0(Frame *frame)
+{
+    Class *c = loadBootClass("sun/management/MemoryImpl");
+    Method *m = c->getDeclaredStaticMethod("getMemoryPools", "()[Ljava/lang/management/MemoryPoolMXBean;");
+    frame->pushr(RSLOT(execJavaFunc(m)));
+}
+
+// public native long getCollectionCount();
+static void getCollectionCount(Frame *frame)
+{
+    frame->pushl((jlong) getGcStats().cycles);
+}
+
+// public native long getCollectionTime();
+static void getCollectionTime(Frame *frame)
+{
+    frame->pushl((jlong) (getGcStats().totalPauseNanos / 1000000));
+}
+
+void sun_management_MemoryImpl_registerNatives()
+{
+#undef C
+#define C "sun/management/MemoryImpl"
+    registerNative(C, "getMemoryPools0", "()[Ljava/lang/management/MemoryPoolMXBean;", getMemoryPools0);
+    registerNative(C, "getMemoryManagers0", "()[Ljava/lang/management/MemoryManagerMXBean;", getMemoryManagers0);
+    registerNative(C, "getMemoryUsage0", "(Z)Ljava/lang/management/MemoryUsage;", getMemoryUsage0);
+    registerNative(C, "setVerboseGC", "(Z)V", setVerboseGC);
+}
+
+void sun_management_MemoryPoolImpl_registerNatives()
+{
+#undef C
+#define C "sun/management/MemoryPoolImpl"
+    registerNative(C, "getUsage0", "()Ljava/lang/management/MemoryUsage;", getUsage0);
+    registerNative(C, "getPeakUsage0", "()Ljava/lang/management/MemoryUsage;", getPeakUsage0);
+    registerNative(C, "getCollectionUsage0", "()Ljava/lang/management/MemoryUsage;", getCollectionUsage0);
+    registerNative(C, "resetPeakUsage0", "()V", resetPeakUsage0);
+    registerNative(C, "setUsageThreshold0", "(JJ)V", setThreshold0);
+    registerNative(C, "setCollectionThreshold0", "(JJ)V", setThreshold0);
+    registerNative(C, "getMemoryManagers0", "()[Ljava/lang/management/MemoryManagerMXBean;", getPoolMemoryManagers0);
+}
+
+void sun_management_MemoryManagerImpl_registerNatives()
+{
+#undef C
+#define C "sun/management/MemoryManagerImpl"
+    registerNative(C, "getMemoryPools0", "()[Ljava/lang/management/MemoryPoolMXBean;", getManagerMemoryPools0);
+}
+
+void sun_management_GarbageCollectorImpl_registerNatives()
+{
+#undef C
+#define C "sun/management/GarbageCollectorImpl"
+    registerNative(C, "getCollectionCount", "()J", getCollectionCount);
+    registerNative(C, "getCollectionTime", "()J", getCollectionTime);
+}
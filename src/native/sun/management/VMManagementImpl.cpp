@@ -1,6 +1,7 @@
 #include "../../registry.h"
 #include "../../../runtime/Frame.h"
 #include "../../../objects/Object.h"
+#include "../../../gc/telemetry.h"
 
 /*
  * Author: kayo
@@ -44,6 +45,10 @@ static void isThreadAllocatedMemoryEnabled(Frame *frame)
 
 // Memory Subsystem
 // public native boolean getVerboseGC();
+static void getVerboseGC(Frame *frame)
+{
+    frame->pushi(gcLogFile != nullptr ? 1 : 0);
+}
 
 // private native int getProcessId();
 
@@ -70,4 +75,5 @@ void sun_management_VMManagementImpl_registerNatives()
     registerNative(C, "isThreadContentionMonitoringEnabled", "()Z", isThreadContentionMonitoringEnabled);
     registerNative(C, "isThreadCpuTimeEnabled", "()Z", isThreadCpuTimeEnabled);
     registerNative(C, "isThreadAllocatedMemoryEnabled", "()Z", isThreadAllocatedMemoryEnabled);
+    registerNative(C, "getVerboseGC", "()Z", getVerboseGC);
 }
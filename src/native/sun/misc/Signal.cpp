@@ -1,6 +1,9 @@
+#include <csignal>
 #include "../../registry.h"
 #include "../../../objects/slot.h"
 #include "../../../runtime/Frame.h"
+#include "../../../runtime/signals.h"
+#include "../../../objects/Object.h"
 
 /*
  * Author: kayo
@@ -9,24 +12,23 @@
 // private static native int findSignal(String string);
 static void findSignal(Frame *frame)
 {
-    jref name = frame->getLocalAsRef(0);
-    frame->pushi(0); // todo
+    jstrref name = frame->getLocalAsRef(0);
+    frame->pushi(findSignal(name->toUtf8()));
 }
 
 // private static native long handle0(int i, long l);
 static void handle0(Frame *frame)
 {
-//    jint i = slot_geti(frame->local_vars);
-//    jlong l = slot_getl(frame->local_vars + 1);
-
-    frame->pushl(0); // todo
+    jint sig = frame->getLocalAsInt(0);
+    jlong handler = frame->getLocalAsLong(1);
+    frame->pushl(setJavaSignalHandler(sig, handler));
 }
 
 // private static native void raise0(int i);
 static void raise0(Frame *frame)
 {
-//    jint i = slot_geti(frame->local_vars);
-    // todo
+    jint sig = frame->getLocalAsInt(0);
+    raise(sig);
 }
 
 void sun_misc_Signal_registerNatives()
@@ -8,34 +8,57 @@
 #include "../../../util/endianness.h"
 #include "../../../objects/Array.h"
 #include "../../../runtime/Frame.h"
+#include "../../../runtime/Thread.h"
 
-/* todo
-http://www.docjar.com/docs/api/sun/misc/Unsafe.html#park%28boolean,%20long%29
-Block current Thread, returning when a balancing
-unpark occurs, or a balancing unpark has
-already occurred, or the Thread is interrupted, or, if not
-absolute and time is not zero, the given time nanoseconds have
-elapsed, or if absolute, the given deadline in milliseconds
-since Epoch has passed, or spuriously (i.e., returning for no
-"reason"). Note: This operation is in the Unsafe class only
-because unpark is, so it would be strange to place it
-elsewhere.
-*/
-
-// public native void park(boolean isAbsolute, long time);
+/*
+ * Block current Thread, returning when a balancing
+ * unpark occurs, or a balancing unpark has
+ * already occurred, or the Thread is interrupted, or, if not
+ * absolute and time is not zero, the given time nanoseconds have
+ * elapsed, or if absolute, the given deadline in milliseconds
+ * since Epoch has passed, or spuriously (i.e., returning for no
+ * "reason").
+ *
+ * public native void park(boolean isAbsolute, long time);
+ */
 static void park(Frame *frame)
 {
-    jvm_abort("park");
+    jbool isAbsolute = frame->getLocalAsBool(1);
+    jlong time = frame->getLocalAsLong(2);
+    getCurrentThread()->park(is_jtrue(isAbsolute), time);
 }
 
-//  public native void unpark(Object thread);
+/*
+ * 给线程一个许可，如果线程阻塞在 park 中，将其唤醒。
+ * 线程还没有启动时（没有关联的 Thread）不做任何事。
+ *
+ * public native void unpark(Object thread);
+ */
 static void unpark(Frame *frame)
 {
-    jvm_abort("unpark");
+    jref jThread = frame->getLocalAsRef(1);
+    if (jThread == jnull)
+        return;
+
+    Thread *t = Thread::from(jThread);
+    if (t != nullptr)
+        t->unpark();
 }
 
 /*************************************    compare and swap    ************************************/
 
+/*
+ * 对象中的偏移量都是字节偏移（从对象的起始处算起）：
+ * 实例变量的偏移参见 objectFieldOffset，数组元素的偏移为 arrayBaseOffset + index * arrayIndexScale。
+ * 如果 o 为 null，则 offset 为绝对地址（参见 allocateMemory）。
+ */
+static inline void *fieldAddress(jref o, jlong offset)
+{
+    if (o == jnull)
+        return (void *) (intptr_t) offset;
+    return (u1 *) o + offset;
+}
+
 /*
  * 第一个参数为需要改变的对象，
  * 第二个为偏移量(参见函数 objectFieldOffset)，
@@ -54,14 +77,7 @@ static void compareAndSwapInt(Frame *frame)
     jint expected = frame->getLocalAsInt(4);
     jint x = frame->getLocalAsInt(5);
 
-    jint *old;
-    if (o->isArrayObject()) {
-        old = (jint *)(((Array *) o)->index(offset));
-    } else {
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        old = o->data + offset;
-    }
-
+    auto old = (jint *) fieldAddress(o, offset);
     bool b = __sync_bool_compare_and_swap(old, expected, x);
     frame->pushi(b ? 1 : 0);
 }
@@ -74,16 +90,9 @@ static void compareAndSwapLong(Frame *frame)
     jlong expected = frame->getLocalAsLong(4);
     jlong x = frame->getLocalAsLong(6);
 
-    jlong *old;
-    if (o->isArrayObject()) {
-        Array *ao = dynamic_cast<Array *>(o);  // todo
-        old = (jlong *)(ao->index(offset));
-    } else {
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        old = (jlong *)(o->data + offset);
-    }
-
-    bool b = __sync_bool_compare_and_swap(old, expected, x);  // todo
+    // long 类型的变量和数组元素都是8字节对齐的
+    auto old = (jlong *) fieldAddress(o, offset);
+    bool b = __sync_bool_compare_and_swap(old, expected, x);
     frame->pushi(b ? 1 : 0);
 }
 
@@ -95,16 +104,7 @@ static void compareAndSwapObject(Frame *frame)
     jref expected = frame->getLocalAsRef(4);
     jref x = frame->getLocalAsRef(5);
 
-    jref *old;
-    if (o->isArrayObject()) {
-        Array *ao = dynamic_cast<Array *>(o);  // todo
-        old = (jref *)(ao->index(offset));
-//        old = arrobj_get(jref, o, offset);
-    } else {
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        old = (jref *)(o->data + offset);
-    }
-
+    auto old = (jref *) fieldAddress(o, offset);
     bool b = __sync_bool_compare_and_swap(old, expected, x);
     frame->pushi(b ? 1 : 0);
 }
@@ -148,299 +148,165 @@ static void staticFieldBase(Frame *frame)
 // public native int arrayBaseOffset(Class<?> type)
 static void arrayBaseOffset(Frame *frame)
 {
-    frame->pushi(0);//frame->operandStack.push((jint)0);  // todo
+    frame->pushi((jint) Array::headerSize());
 }
 
 // public native int arrayIndexScale(Class<?> type)
 static void arrayIndexScale(Frame *frame)
 {
-    frame->pushi(1); // todo
+    auto type = frame->getLocalAsRef<Class>(1);
+    frame->pushi((jint) type->getEleSize());
 }
 
 // public native long objectFieldOffset(Field field)
 static void objectFieldOffset(Frame *frame)
 {
     jref field = frame->getLocalAsRef(1);
+    // java/lang/reflect/Field 的 slot 保存的就是实例变量的字节偏移
     auto offset = field->getInstFieldValue<jint>(S(slot), S(I));
     frame->pushl(offset);
 }
 
-// public native boolean getBoolean(Object o, long offset);
-static void getBoolean(Frame *frame)
-{
-    jvm_abort("getBoolean");
+#define OBJ_GET(func, T, push) \
+static void func(Frame *frame) \
+{ \
+    jref o = frame->getLocalAsRef(1); \
+    jlong offset = frame->getLocalAsLong(2); \
+    frame->push(*(T *) fieldAddress(o, offset)); \
 }
 
-// public native void putBoolean(Object o, long offset, boolean x);
-static void putBoolean(Frame *frame)
-{
-    jvm_abort("putBoolean");
+#define OBJ_PUT(func, T, getLocal) \
+static void func(Frame *frame) \
+{ \
+    jref o = frame->getLocalAsRef(1); \
+    jlong offset = frame->getLocalAsLong(2); \
+    auto x = (T) frame->getLocal(4); \
+    *(T *) fieldAddress(o, offset) = x; \
 }
 
-// public native byte getByte(Object o, long offset);
-static void obj_getByte(Frame *frame)
-{
-    jvm_abort("obj_getByte");
+// volatile 的读写使用原子操作，long 和 double 在32位平台上也是原子的
+#define OBJ_GET_VOLATILE(func, T, push) \
+static void func(Frame *frame) \
+{ \
+    jref o = frame->getLocalAsRef(1); \
+    jlong offset = frame->getLocalAsLong(2); \
+    T value; \
+    __atomic_load((T *) fieldAddress(o, offset), &value, __ATOMIC_SEQ_CST); \
+    frame->push(value); \
 }
 
-// public native void putByte(Object o, long offset, byte x);
-static void obj_putByte(Frame *frame)
-{
-    jvm_abort("obj_putByte");
+#define OBJ_PUT_VOLATILE(func, T, getLocal) \
+static void func(Frame *frame) \
+{ \
+    jref o = frame->getLocalAsRef(1); \
+    jlong offset = frame->getLocalAsLong(2); \
+    auto x = (T) frame->getLocal(4); \
+    __atomic_store((T *) fieldAddress(o, offset), &x, __ATOMIC_SEQ_CST); \
 }
 
-// public native char getChar(Object o, long offset);
-static void obj_getChar(Frame *frame)
-{
-    jvm_abort("obj_getChar");
+// Ordered/Lazy 版本的写只需保证之前的写操作不会重排到其后
+#define OBJ_PUT_ORDERED(func, T, getLocal) \
+static void func(Frame *frame) \
+{ \
+    jref o = frame->getLocalAsRef(1); \
+    jlong offset = frame->getLocalAsLong(2); \
+    auto x = (T) frame->getLocal(4); \
+    __atomic_store((T *) fieldAddress(o, offset), &x, __ATOMIC_RELEASE); \
 }
 
+// public native boolean getBoolean(Object o, long offset);
+OBJ_GET(getBoolean, jbool, pushi)
+// public native void putBoolean(Object o, long offset, boolean x);
+OBJ_PUT(putBoolean, jbool, getLocalAsInt)
+// public native byte getByte(Object o, long offset);
+OBJ_GET(obj_getByte, jbyte, pushi)
+// public native void putByte(Object o, long offset, byte x);
+OBJ_PUT(obj_putByte, jbyte, getLocalAsInt)
+// public native char getChar(Object o, long offset);
+OBJ_GET(obj_getChar, jchar, pushi)
 // public native void putChar(Object o, long offset, char x);
-static void obj_putChar(Frame *frame)
-{
-    jvm_abort("obj_putChar");
-}
-
+OBJ_PUT(obj_putChar, jchar, getLocalAsInt)
 // public native short getShort(Object o, long offset);
-static void obj_getShort(Frame *frame)
-{
-    jvm_abort("obj_getShort");
-}
-
+OBJ_GET(obj_getShort, jshort, pushi)
 // public native void putShort(Object o, long offset, short x);
-static void obj_putShort(Frame *frame)
-{
-    jvm_abort("obj_putShort");
-}
-
+OBJ_PUT(obj_putShort, jshort, getLocalAsInt)
 // public native int getInt(Object o, long offset);
-static void obj_getInt(Frame *frame)
-{
-    jvm_abort("obj_getInt");
-}
-
+OBJ_GET(obj_getInt, jint, pushi)
 // public native void putInt(Object o, long offset, int x);
-static void obj_putInt(Frame *frame)
-{
-    jvm_abort("obj_putInt");
-}
-
+OBJ_PUT(obj_putInt, jint, getLocalAsInt)
 // public native long getLong(Object o, long offset);
-static void obj_getLong(Frame *frame)
-{
-    jvm_abort("obj_getLong");
-}
-
+OBJ_GET(obj_getLong, jlong, pushl)
 // public native void putLong(Object o, long offset, long x);
-static void obj_putLong(Frame *frame)
-{
-    jvm_abort("obj_putLong");
-}
-
+OBJ_PUT(obj_putLong, jlong, getLocalAsLong)
 // public native float getFloat(Object o, long offset);
-static void obj_getFloat(Frame *frame)
-{
-    jvm_abort("obj_getFloat");
-}
-
+OBJ_GET(obj_getFloat, jfloat, pushf)
 // public native void putFloat(Object o, long offset, float x);
-static void obj_putFloat(Frame *frame)
-{
-    jvm_abort("obj_putFloat");
-}
-
+OBJ_PUT(obj_putFloat, jfloat, getLocalAsFloat)
 // public native double getDouble(Object o, long offset);
-static void obj_getDouble(Frame *frame)
-{
-    jvm_abort("obj_getDouble");
-}
-
+OBJ_GET(obj_getDouble, jdouble, pushd)
 // public native void putDouble(Object o, long offset, double x);
-static void obj_putDouble(Frame *frame)
-{
-    jvm_abort("obj_putDouble");
-}
-
+OBJ_PUT(obj_putDouble, jdouble, getLocalAsDouble)
 // public native Object getObject(Object o, long offset);
-static void getObject(Frame *frame)
-{
-    jvm_abort("getObject");
-}
-
+OBJ_GET(getObject, jref, pushr)
 // public native void putObject(Object o, long offset, Object x);
-static void putObject(Frame *frame)
-{
-    jvm_abort("putObject");
-}
+OBJ_PUT(putObject, jref, getLocalAsRef)
 
 // public native boolean getBooleanVolatile(Object o, long offset);
-static void getBooleanVolatile(Frame *frame)
-{
-    jvm_abort("getBooleanVolatile");
-}
-
+OBJ_GET_VOLATILE(getBooleanVolatile, jbool, pushi)
 // public native byte getByteVolatile(Object o, long offset);
-static void getByteVolatile(Frame *frame)
-{
-    jvm_abort("getByteVolatile");
-}
-
+OBJ_GET_VOLATILE(getByteVolatile, jbyte, pushi)
 // public native char getCharVolatile(Object o, long offset);
-static void getCharVolatile(Frame *frame)
-{
-    jvm_abort("getCharVolatile");
-}
-
+OBJ_GET_VOLATILE(getCharVolatile, jchar, pushi)
 // public native short getShortVolatile(Object o, long offset);
-static void getShortVolatile(Frame *frame)
-{
-    jvm_abort("getShortVolatile");
-}
-
+OBJ_GET_VOLATILE(getShortVolatile, jshort, pushi)
 // public native int getIntVolatile(Object o, long offset);
-static void getIntVolatile(Frame *frame)
-{
-    // todo Volatile
-    jref o = frame->getLocalAsRef(1); // first argument
-    jlong offset = frame->getLocalAsLong(2);
-
-    jint value;
-    if (o->isArrayObject()) {
-        Array *ao = dynamic_cast<Array *>(o);  // todo
-        value = ao->get<jint>(offset);
-//        value = arrobj_get(jint, o, offset);  // todo
-    } else {
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        value = o->data[offset];//o->getInstFieldValue<jint>(offset);  // todo
-    }
-    frame->pushi(value);
-}
-
+OBJ_GET_VOLATILE(getIntVolatile, jint, pushi)
 // public native long getLongVolatile(Object o, long offset);
-static void getLongVolatile(Frame *frame)
-{
-    jvm_abort("getLongVolatile");
-}
-
+OBJ_GET_VOLATILE(getLongVolatile, jlong, pushl)
 // public native float getFloatVolatile(Object o, long offset);
-static void getFloatVolatile(Frame *frame)
-{
-    jvm_abort("getFloatVolatile");
-}
-
+OBJ_GET_VOLATILE(getFloatVolatile, jfloat, pushf)
 // public native double getDoubleVolatile(Object o, long offset);
-static void getDoubleVolatile(Frame *frame)
-{
-    jvm_abort("getDoubleVolatile");
-}
+OBJ_GET_VOLATILE(getDoubleVolatile, jdouble, pushd)
+// public native Object getObjectVolatile(Object o, long offset);
+OBJ_GET_VOLATILE(getObjectVolatile, jref, pushr)
 
 // public native void putIntVolatile(Object o, long offset, int x);
-static void putIntVolatile(Frame *frame)
-{
-    jvm_abort("putIntVolatile");
-}
-
+OBJ_PUT_VOLATILE(putIntVolatile, jint, getLocalAsInt)
 // public native void putBooleanVolatile(Object o, long offset, boolean x);
-static void putBooleanVolatile(Frame *frame)
-{
-    jvm_abort("putBooleanVolatile");
-}
-
+OBJ_PUT_VOLATILE(putBooleanVolatile, jbool, getLocalAsInt)
 // public native void putByteVolatile(Object o, long offset, byte x);
-static void putByteVolatile(Frame *frame)
-{
-    jvm_abort("putByteVolatile");
-}
-
+OBJ_PUT_VOLATILE(putByteVolatile, jbyte, getLocalAsInt)
 // public native void putShortVolatile(Object o, long offset, short x);
-static void putShortVolatile(Frame *frame)
-{
-    jvm_abort("putShortVolatile");
-}
-
+OBJ_PUT_VOLATILE(putShortVolatile, jshort, getLocalAsInt)
 // public native void putCharVolatile(Object o, long offset, char x);
-static void putCharVolatile(Frame *frame)
-{
-    jvm_abort("putCharVolatile");
-}
-
+OBJ_PUT_VOLATILE(putCharVolatile, jchar, getLocalAsInt)
 // public native void putLongVolatile(Object o, long offset, long x);
-static void putLongVolatile(Frame *frame)
-{
-    jvm_abort("putLongVolatile");
-}
-
+OBJ_PUT_VOLATILE(putLongVolatile, jlong, getLocalAsLong)
 // public native void putFloatVolatile(Object o, long offset, float x);
-static void putFloatVolatile(Frame *frame)
-{
-    jvm_abort("putFloatVolatile");
-}
-
+OBJ_PUT_VOLATILE(putFloatVolatile, jfloat, getLocalAsFloat)
 // public native void putDoubleVolatile(Object o, long offset, double x);
-static void putDoubleVolatile(Frame *frame)
-{
-    jvm_abort("putDoubleVolatile");
-}
-// -------------------------
-// public native Object getObjectVolatile(Object o, long offset);
-static void getObjectVolatile(Frame *frame)
-{
-    // todo Volatile
-    jref o = frame->getLocalAsRef(1); // first argument
-    jlong offset = frame->getLocalAsLong(2);
-
-    jref value;
-    if (o->isArrayObject()) {
-        Array *ao = dynamic_cast<Array *>(o);  // todo
-        value = ao->get<jref>(offset);
-    } else {
-        assert(0 <= offset && offset < o->clazz->instFieldsCount);
-        value = *(jref *)(o->data + offset);//o->getInstFieldValue<jref>(offset);  // todo
-    }
-    frame->pushr(value);
-}
-
+OBJ_PUT_VOLATILE(putDoubleVolatile, jdouble, getLocalAsDouble)
 // public native void putObjectVolatile(Object o, long offset, Object x);
-static void putObjectVolatile(Frame *frame)
-{
-    // todo Volatile
-    jref o = frame->getLocalAsRef(1);
-    jlong offset = frame->getLocalAsLong(2);
-    jref x = frame->getLocalAsRef(4);
-
-    if (o->isArrayObject()) {
-        auto arr = (Array *) o;
-        arr->set(offset, x);
-    } else {
-        o->setFieldValue(offset, x);
-    }
-}
+OBJ_PUT_VOLATILE(putObjectVolatile, jref, getLocalAsRef)
 
 // public native Object getOrderedObject(Object o, long offset);
-static void getOrderedObject(Frame *frame)
-{
-    jvm_abort("getOrderedObject");
-}
-
+OBJ_GET_VOLATILE(getOrderedObject, jref, pushr)
 // public native void putOrderedObject(Object o, long offset, Object x);
-static void putOrderedObject(Frame *frame)
-{
-    jvm_abort("putOrderedObject");
-}
+OBJ_PUT_ORDERED(putOrderedObject, jref, getLocalAsRef)
 
 /** Ordered/Lazy version of {@link #putIntVolatile(Object, long, int)}  */
 // public native void putOrderedInt(Object o, long offset, int x);
-static void putOrderedInt(Frame *frame)
-{
-    jvm_abort("putOrderedInt");
-}
+OBJ_PUT_ORDERED(putOrderedInt, jint, getLocalAsInt)
 
 /** Ordered/Lazy version of {@link #putLongVolatile(Object, long, long)} */
 // public native void putOrderedLong(Object o, long offset, long x);
-static void putOrderedLong(Frame *frame)
-{
-    jvm_abort("putOrderedLong");
-}
+OBJ_PUT_ORDERED(putOrderedLong, jlong, getLocalAsLong)
+
+#undef OBJ_GET
+#undef OBJ_PUT
+#undef OBJ_GET_VOLATILE
+#undef OBJ_PUT_VOLATILE
+#undef OBJ_PUT_ORDERED
 
 /*************************************    unsafe memory    ************************************/
 // todo 说明 unsafe memory
@@ -710,7 +576,8 @@ static void defineAnonymousClass(Frame *frame)
 //  public native void monitorEnter(Object o);
 static void monitorEnter(Frame *frame)
 {
-    jvm_abort("monitorEnter"); // todo
+    jref o = frame->getLocalAsRef(1);
+    o->lock();
 }
 
 /**
@@ -720,7 +587,8 @@ static void monitorEnter(Frame *frame)
 // public native void monitorExit(Object o);
 static void monitorExit(Frame *frame)
 {
-    jvm_abort("monitorExit"); // todo
+    jref o = frame->getLocalAsRef(1);
+    o->unlock();
 }
 
 /**
@@ -731,7 +599,8 @@ static void monitorExit(Frame *frame)
 // public native boolean tryMonitorEnter(Object o);
 static void tryMonitorEnter(Frame *frame)
 {
-    jvm_abort("tryMonitorEnter"); // todo
+    jref o = frame->getLocalAsRef(1);
+    frame->pushi(o->tryLock() ? 1 : 0);
 }
 
 /** Throw the exception without telling the verifier. */
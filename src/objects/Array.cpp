@@ -6,6 +6,8 @@
 #include <cassert>
 #include "Array.h"
 #include "../runtime/Thread.h"
+#include "../runtime/alloc_profiler.h"
+#include "../runtime/suspend.h"
 #include "Prims.h"
 
 using namespace std;
@@ -14,7 +16,10 @@ Array *Array::newArray(Class *ac, jint arrLen)
 {
     assert(ac != nullptr);
     assert(ac->isArrayClass());
-    size_t size = sizeof(Array) + ac->getEleSize()*arrLen;
+    size_t size = OBJECT_ALIGN_UP(headerSize() + ac->getEleSize()*arrLen);
+    profileAllocation(ac, size);
+    // 对象头初始化之前不能被 gc 看到，参见 runtime/suspend.h
+    NoSuspendScope scope;
     return new(g_heap.allocObject(size)) Array(ac, arrLen);
 }
 
@@ -24,7 +29,9 @@ Array *Array::newMultiArray(Class *ac, jint dim, const jint lens[])
     assert(dim >= 1);
     assert(ac->isArrayClass());
 
-    size_t size = sizeof(Array) + ac->getEleSize()*lens[0];
+    size_t size = OBJECT_ALIGN_UP(headerSize() + ac->getEleSize()*lens[0]);
+    profileAllocation(ac, size);
+    NoSuspendScope scope;
     return new(g_heap.allocObject(size)) Array(ac, dim, lens);
 }
 
@@ -36,7 +43,6 @@ Array::Array(Class *ac, jint arrLen): Object(ac), len(arrLen)
 
     // java 数组创建后要赋默认值，0, 0.0, false,'\0', NULL 之类的
     // heap 申请对象时已经清零了。
-    data = (slot_t *) (this + 1);
 }
 
 Array::Array(Class *ac, jint dim, const jint lens[]): Object(ac), len(lens[0])
@@ -46,8 +52,6 @@ Array::Array(Class *ac, jint dim, const jint lens[]): Object(ac), len(lens[0])
     assert(ac->isArrayClass());
     assert(len >= 0); // 长度为0的array是合法的
 
-    data = (slot_t *) (this + 1);
-
     for (int d = 1; d < dim; d++) {
         for (int i = 0; i < len; i++) {
             set(i, newMultiArray(ac->componentClass(), dim - 1, lens + 1));
@@ -64,16 +68,25 @@ void Array::set(int index0, jref value)
 {
     assert(0 <= index0 && index0 < len);
 
-    auto data = (slot_t *) index(index0);
     if (value == jnull) {
-        *data = (slot_t) jnull;
+        set<jref>(index0, jnull);
     } else if (isPrimArray()) {
-        const slot_t *unbox = value->unbox();
-        *data = *unbox;
-        if (clazz->eleSize > sizeof(slot_t))
-            *++data = *++unbox;
+        slot_t v[2];
+        value->unbox(v);
+        switch (clazz->className[1]) {
+            case 'Z':
+            case 'B': set<jbyte>(index0, (jbyte) ISLOT(v)); break;
+            case 'C': set<jchar>(index0, (jchar) ISLOT(v)); break;
+            case 'S': set<jshort>(index0, (jshort) ISLOT(v)); break;
+            case 'I': set<jint>(index0, ISLOT(v)); break;
+            case 'F': set<jfloat>(index0, FSLOT(v)); break;
+            case 'J': set<jlong>(index0, LSLOT(v)); break;
+            case 'D': set<jdouble>(index0, DSLOT(v)); break;
+            default:
+                NEVER_GO_HERE_ERROR("%s\n", clazz->className);
+        }
     } else {
-        *data = (slot_t) value;
+        set<jref>(index0, value);
     }
 }
 
@@ -109,21 +122,8 @@ void Array::copy(Array *dst, jint dst_pos, const Array *src, jint src_pos, jint
     memcpy(dst->index(dst_pos), src->index(src_pos), src->clazz->getEleSize() * len);
 }
 
-size_t Array::size() const
-{
-    return sizeof(Array) + clazz->getEleSize()*len;
-}
-
 //Array *Array::clone() const
 //{
     //size_t s = size();
   //  return (Array *) memcpy(g_heap.allocObject(s), this, s);
 //}
-
-string Array::toString() const
-{
-    // todo
-    string s;
-    return s;
-}
-
@@ -10,7 +10,12 @@
 #include "Object.h"
 #include "Class.h"
 
-// Object of array
+/*
+ * Object of array
+ *
+ * 数组长度紧跟在对象头之后，数组元素从 headerSize() 处开始存放，
+ * 按8字节对齐，保证 long 和 double 数组的元素是对齐的。
+ */
 class Array: public Object {
     Array(Class *ac, jint arrLen);
     Array(Class *ac, jint dim, const jint lens[]);
@@ -21,7 +26,16 @@ public:
     static Array *newArray(Class *ac, jint arrLen);
     static Array *newMultiArray(Class *ac, jint dim, const jint lens[]);
 
-    bool isArrayObject() const override { return true; }
+    static size_t headerSize()
+    {
+        return OBJECT_ALIGN_UP(sizeof(Array));
+    }
+
+    void *data() const
+    {
+        return (u1 *) this + headerSize();
+    }
+
     bool isPrimArray() const;
 
     bool checkBounds(jint index)
@@ -32,7 +46,7 @@ public:
     void *index(jint index0) const
     {
         assert(0 <= index0 && index0 < len);
-        return ((u1 *) (data)) + clazz->getEleSize()*index0;
+        return ((u1 *) data()) + clazz->getEleSize()*index0;
     }
 
     template <typename T>
@@ -51,9 +65,7 @@ public:
 
 
     static void copy(Array *dst, jint dst_pos, const Array *src, jint src_pos, jint len);
-    size_t size() const override;
     //Array *clone() const;
-    std::string toString() const override;
 };
 
 static inline Array *newArray(Class *ac, jint arrLen)
@@ -13,26 +13,96 @@
 #include "Array.h"
 #include "../interpreter/interpreter.h"
 #include "Prims.h"
+#include "class_archive.h"
+#include "../aot/aot.h"
+#include "../runtime/suspend.h"
 
 using namespace std;
 using namespace utf8;
 
-void Class::calcFieldsId()
+void Class::layoutFields()
 {
-    int insId = 0;
+    size_t offset = instHeaderSize;
     if (superClass != nullptr) {
-        insId = superClass->instFieldsCount; // todo 父类的私有变量是不是也算在了里面，不过问题不大，浪费点空间吧了
+        offset = max(offset, superClass->instSize);
+        fieldGaps = superClass->fieldGaps;
+        oopMap = superClass->oopMap;
     }
 
-    for(auto f : fields) {
-        if (!f->isStatic()) {
-            f->id = insId++;
-            if (f->categoryTwo)
-                insId++;
+    // 对齐 offset，跳过的字节记为空隙
+    auto alignTo = [&](size_t align) {
+        size_t aligned = (offset + align - 1) & ~(align - 1);
+        if (aligned > offset)
+            fieldGaps.emplace_back(offset, aligned - offset);
+        offset = aligned;
+    };
+
+    // 尝试将大小为 size 的变量放入某个空隙中
+    auto fillGap = [&](Field *f, size_t size) {
+        for (auto iter = fieldGaps.begin(); iter != fieldGaps.end(); iter++) {
+            size_t start = iter->first;
+            size_t end = start + iter->second;
+            size_t aligned = (start + size - 1) & ~(size - 1);
+            if (aligned + size > end)
+                continue;
+
+            f->offset = (int) aligned;
+            fieldGaps.erase(iter);
+            // 空隙剩下的部分
+            if (aligned > start)
+                fieldGaps.emplace_back(start, aligned - start);
+            if (aligned + size < end)
+                fieldGaps.emplace_back(aligned + size, end - (aligned + size));
+            return true;
+        }
+        return false;
+    };
+
+    vector<Field *> refs;
+    vector<Field *> prims[4]; // 8, 4, 2, 1 字节
+    for (auto f : fields) {
+        if (f->isStatic())
+            continue;
+        if (!f->isPrim()) {
+            refs.push_back(f);
+            continue;
+        }
+        switch (f->getSize()) {
+            case 8: prims[0].push_back(f); break;
+            case 4: prims[1].push_back(f); break;
+            case 2: prims[2].push_back(f); break;
+            default: prims[3].push_back(f); break;
+        }
+    }
+
+    // 引用类型的变量连续存放，不填入空隙
+    if (!refs.empty()) {
+        alignTo(sizeof(jref));
+        // 与父类的最后一段相邻则合并
+        if (!oopMap.empty() and oopMap.back().offset + oopMap.back().count*sizeof(jref) == offset)
+            oopMap.back().count += refs.size();
+        else
+            oopMap.push_back({ (u2) offset, (u2) refs.size() });
+
+        for (auto f : refs) {
+            f->offset = (int) offset;
+            offset += sizeof(jref);
         }
     }
 
-    instFieldsCount = insId;
+    // 基本类型的变量从大到小放置，小的变量优先填入空隙
+    for (auto &group : prims) {
+        for (auto f : group) {
+            size_t size = f->getSize();
+            if (!fillGap(f, size)) {
+                alignTo(size);
+                f->offset = (int) offset;
+                offset += size;
+            }
+        }
+    }
+
+    instSize = offset;
 }
 
 Class::InnerClass::InnerClass(ConstantPool &cp, BytecodeReader &r)
@@ -227,15 +297,18 @@ void Class::createVtable()
     }
 
     // 将父类的vtable复制过来
+    vtable.reserve(superClass->vtable.size() + methods.size());
     vtable.assign(superClass->vtable.begin(), superClass->vtable.end());
 
     for (auto m : methods) {
         if (m->isVirtual()) {
             auto iter = find_if(vtable.begin(), vtable.end(), [=](Method *m0){
-                return utf8::equals(m->name, m0->name) && utf8::equals(m->descriptor, m0->descriptor); });
+                return m->name == m0->name && m->descriptor == m0->descriptor; });
             if (iter != vtable.end()) {
                 // 重写了父类的方法，更新
                 m->vtableIndex = (*iter)->vtableIndex;
+                // 被重写的方法不能再直接调用了
+                (*iter)->overridden.store(true, memory_order_release);
                 *iter = m;
             } else {
                 // 子类定义了要给新方法，加到 vtable 后面
@@ -246,12 +319,6 @@ void Class::createVtable()
     }
 }
 
-Class::ITable::ITable(const Class::ITable &itable)
-{
-    interfaces.assign(itable.interfaces.begin(), itable.interfaces.end());
-    methods.assign(itable.methods.begin(), itable.methods.end());
-}
-
 Class::ITable& Class::ITable::operator=(const Class::ITable &itable)
 {
     interfaces.assign(itable.interfaces.begin(), itable.interfaces.end());
@@ -292,7 +359,7 @@ void Class::createItable()
     // 遍历 itable.methods，检查有没有接口函数在本类中被重写了。
     for (auto m : itable.methods) {
         for (auto m0 : methods) {
-            if (utf8::equals(m->name, m0->name) && utf8::equals(m->descriptor, m0->descriptor)) {
+            if (m->name == m0->name && m->descriptor == m0->descriptor) {
                 m = m0; // 重写了接口方法，更新
                 break;
             }
@@ -301,7 +368,7 @@ void Class::createItable()
 
     for (auto ifc : interfaces) {
         for (auto tmp : itable.interfaces) {
-            if (utf8::equals(tmp.first->className, ifc->className)) {
+            if (tmp.first->className == ifc->className) {
                 // 此接口已经在 itable.interfaces 中了
                 goto next;
             }
@@ -310,7 +377,7 @@ void Class::createItable()
         itable.interfaces.emplace_back(ifc, itable.methods.size());
         for (auto m : ifc->methods) {
             for (auto m0 : methods) {
-                if (utf8::equals(m->name, m0->name) && utf8::equals(m->descriptor, m0->descriptor)) {
+                if (m->name == m0->name && m->descriptor == m0->descriptor) {
                     m = m0; // 重写了接口方法，更新
                     break;
                 }
@@ -336,8 +403,7 @@ const void Class::genPkgName()
             free(pkg);
             pkgName = hashed;
         } else {
-            pkgName = pkg;
-            save(pkgName);
+            pkgName = save(pkg);
         }
     }
 }
@@ -371,80 +437,21 @@ Class::Class(Object *loader, u1 *bytecode, size_t len)
 //        thread_throw(new ClassFormatError("bad class version")); // todo
     }
 
+    Metaspace *metaspace = getMetaspace(loader);
+    // boot class loader 的字符串永不释放，不需要 owner
+    const void *utf8Owner = loader != bootClassLoader ? metaspace : nullptr;
+
     // init constant pool
-    new (&cp) ConstantPool(this, r.readu2());
-    for (u2 i = 1; i < cp.size; i++) {
-        u1 tag = r.readu1();
-        cp.type(i, tag);
-        switch (tag) {
-            case CONSTANT_Class:
-            case CONSTANT_String:
-            case CONSTANT_MethodType:
-            case CONSTANT_Module:
-            case CONSTANT_Package:
-                cp.info(i, r.readu2());
-                break;
-            case CONSTANT_NameAndType:
-            case CONSTANT_Fieldref:
-            case CONSTANT_Methodref:
-            case CONSTANT_InterfaceMethodref:
-            case CONSTANT_Dynamic:
-            case CONSTANT_InvokeDynamic: {
-                u2 index1 = r.readu2();
-                u2 index2 = r.readu2();
-                cp.info(i, (index2 << 16) + index1); //  CP_INFO(cp, i) = (index2 << 16) + index1;
-                break;
-            }
-            case CONSTANT_Integer: {
-                u1 bytes[4];
-                r.readBytes(bytes, 4);
-                cp._int(i, bytes_to_int32(bytes)); // CP_INT(cp, i) = bytes_to_int32(bytes);
-                break;
-            }
-            case CONSTANT_Float: {
-                u1 bytes[4];
-                r.readBytes(bytes, 4);
-                cp._float(i, bytes_to_float(bytes));
-                // CP_FLOAT(cp, i) = bytes_to_float(bytes);
-                break;
-            }
-            case CONSTANT_Long: {
-                u1 bytes[8];
-                r.readBytes(bytes, 8);
-                cp._long(i, bytes_to_int64(bytes));
-                cp.type(++i, CONSTANT_Placeholder);
-                break;
-            }
-            case CONSTANT_Double: {
-                u1 bytes[8];
-                r.readBytes(bytes, 8);
-                cp._double(i, bytes_to_double(bytes));
-                cp.type(++i, CONSTANT_Placeholder);
-                break;
-            }
-            case CONSTANT_Utf8: {
-                u2 utf8_len = r.readu2();
-                char buf[utf8_len + 1];
-                r.readBytes((u1 *) buf, utf8_len);
-                buf[utf8_len] = 0;
-
-                const char *utf8 = find(buf);
-                if (utf8 == nullptr) {
-                    utf8 = strdup(buf);
-                    utf8 = save(utf8);
-                }
-                cp.info(i, (slot_t) utf8);
-                break;
-            }
-            case CONSTANT_MethodHandle: {
-                u2 index1 = r.readu1(); // 这里确实是 readu1, reference_kind
-                u2 index2 = r.readu2(); // reference_index
-                cp.info(i, (index2 << 16) + index1);
-                break;
+    new (&cp) ConstantPool(this, r.readu2(), *metaspace);
+    if (loader != bootClassLoader or !restoreArchivedConstantPool(bytecode, cp, r)) {
+        cp.parse(r, [utf8Owner](const char *buf) {
+            const char *utf8 = find(buf, utf8Owner);
+            if (utf8 == nullptr) {
+                utf8 = strdup(buf);
+                utf8 = save(utf8, utf8Owner);
             }
-            default:
-                thread_throw(new ClassFormatError(NEW_MSG("bad constant tag: %d\n", tag)));
-        }
+            return (slot_t) utf8;
+        });
     }
 
     modifiers = r.readu2();
@@ -460,13 +467,14 @@ Class::Class(Object *loader, u1 *bytecode, size_t len)
 
     // parse interfaces
     u2 interfacesCount = r.readu2();
+    interfaces.reserve(interfacesCount);
     for (u2 i = 0; i < interfacesCount; i++)
         interfaces.push_back(cp.resolveClass(r.readu2()));
 
     // parse fields
     u2 fieldsCount = r.readu2();
     if (fieldsCount > 0) {
-        Field *fieldsMem = (Field *) g_heap.allocFields(fieldsCount);
+        Field *fieldsMem = (Field *) metaspace->allocFields(fieldsCount);
         fields.resize(fieldsCount);
         auto lastField = fieldsCount - 1;
         for (u2 i = 0; i < fieldsCount; i++) {
@@ -479,12 +487,14 @@ Class::Class(Object *loader, u1 *bytecode, size_t len)
         }
     }
 
-    calcFieldsId();
+    if (className == S(java_lang_Class))
+        instHeaderSize = sizeof(Class);
+    layoutFields();
 
     // parse methods
     u2 methodsCount = r.readu2();
     if (methodsCount > 0) {
-        Method *methodsMem = (Method *) g_heap.allocMethods(methodsCount);
+        Method *methodsMem = (Method *) metaspace->allocMethods(methodsCount);
         methods.resize(methodsCount);
         auto lastMethod = methodsCount - 1;
         for (u2 i = 0; i < methodsCount; i++) {
@@ -498,17 +508,48 @@ Class::Class(Object *loader, u1 *bytecode, size_t len)
     }
 
     parseAttribute(r); // parse class attributes
+    buildMemberIndex();
+
+    if (superClass != nullptr) {
+        refType = superClass->refType;
+        finalizable = superClass->finalizable;
+    }
+    if (loader == bootClassLoader) {
+        if (className == S(java_lang_ref_SoftReference))
+            refType = REF_TYPE_SOFT;
+        else if (className == S(java_lang_ref_WeakReference))
+            refType = REF_TYPE_WEAK;
+        else if (className == S(java_lang_ref_PhantomReference))
+            refType = REF_TYPE_PHANTOM;
+    }
+    Method *fin = getDeclaredMethod(S(finalize), S(___V), false);
+    if (fin != nullptr and !fin->isStatic()) {
+        // 空的 finalize() 只有一条 return 指令
+        finalizable = superClass != nullptr and fin->codeLen > 1;
+    }
+
+    bindAotMethods(this, bytecode, len);
 
     createVtable(); // todo 接口有没有必要创建 vtable
     createItable();
 
-    data = (slot_t *)(this + 1);
     state = LOADED;
 }
 
-Class::Class(const char *className)
-        : Object(classClass), modifiers(Modifier::MOD_PUBLIC), loader(nullptr), superClass(objectClass),
-          inited(true), className(utf8::dup(className)) /* 形参className可能非持久，复制一份 */
+// 形参 @className 可能非持久，换成池中的规范字符串，由 @loader 定义的数组类的类名随 @loader 一起释放
+static const utf8_t *saveClassName(Object *loader, const char *className)
+{
+    if (loader == bootClassLoader)
+        return utf8::intern(className);
+
+    Metaspace *owner = getMetaspace(loader);
+    const utf8_t *name = utf8::find(className, owner);
+    return name != nullptr ? name : utf8::save(strdup(className), owner);
+}
+
+Class::Class(Object *loader, const char *className)
+        : Object(classClass), modifiers(Modifier::MOD_PUBLIC), loader(loader), superClass(objectClass),
+          inited(true), className(saveClassName(loader, className))
 {
     assert(className != nullptr);
     assert(className[0] == '[' || Prims::isPrimClassName(className));
@@ -516,20 +557,49 @@ Class::Class(const char *className)
     pkgName = "";
 
     if (className[0] == '[') {
+        interfaces.reserve(2);
         interfaces.push_back(loadBootClass(S(java_lang_Cloneable)));
         interfaces.push_back(loadBootClass(S(java_io_Serializable)));
+        instHeaderSize = Array::headerSize();
+        refArray = className[1] == 'L' or className[1] == '[';
     }
 
+    buildMemberIndex();
     createVtable();
 
-    data = (slot_t *)(this + 1);
     state = LOADED;
 }
 
 Class::~Class()
 {
-    // todo something else
+    // Method 和 Field 都是 placement new 在 Metaspace 中的，
+    // 这里只调用析构函数释放它们自己持有的资源，内存随 Metaspace 一起释放。
+    for (auto m : methods)
+        m->~Method();
+    for (auto f : fields)
+        f->~Field();
+
+    delete methodIndex;
+    delete fieldIndex;
+}
+
+void Class::buildMemberIndex()
+{
+    // 装载因子不超过 1/2，给继承来的成员也留些位置
+    methodIndex = new ConcurrentTable<Method, MemberTraits<Method>>(methods.size()*2 + 8);
+    for (auto m : methods)
+        methodIndex->putIfAbsent(m);
 
+    fieldIndex = new ConcurrentTable<Field, MemberTraits<Field>>(fields.size()*2 + 8);
+    instFieldsByOffset.reserve(fields.size());
+    for (auto f : fields) {
+        fieldIndex->putIfAbsent(f);
+        if (!f->isStatic())
+            instFieldsByOffset.push_back(f);
+    }
+
+    sort(instFieldsByOffset.begin(), instFieldsByOffset.end(),
+         [](Field *f1, Field *f2) { return f1->offset < f2->offset; });
 }
 
 void Class::clinit()
@@ -564,23 +634,47 @@ void Class::clinit()
     pthread_mutex_unlock(&clinitLock);
 }
 
-Field *Class::lookupField(const utf8_t *name, const utf8_t *descriptor)
+/*
+ * Method 和 Field 的 name 和 descriptor 都来自常量池，是 utf8 池中的规范字符串，
+ * 把查询用的字符串也换成规范字符串后，只需比较指针。
+ * 池中没有的字符串不可能是任何成员的名字或描述符，返回 false.
+ */
+static inline bool canonicalize(const utf8_t *&name, const utf8_t *&descriptor)
 {
-    for (auto f : fields) {
-        if (utf8::equals(f->name, name) && utf8::equals(f->descriptor, descriptor))
-            return f;
-    }
+    name = utf8::canonical(name);
+    descriptor = utf8::canonical(descriptor);
+    return name != nullptr and descriptor != nullptr;
+}
 
-    // todo 在父类中查找
-    struct Field *field;
-    if (superClass != nullptr) {
-        if ((field = superClass->lookupField(name, descriptor)) != nullptr)
-            return field;
-    }
+Field *Class::findField(const utf8_t *name, const utf8_t *descriptor)
+{
+    Field *field = fieldIndex->find({ name, descriptor });
+    if (field != nullptr)
+        return field;
 
-    // todo 在父接口中查找
-    for (auto c : interfaces) {
-        if ((field = c->lookupField(name, descriptor)) != nullptr)
+    // 先在父类中查找，再在父接口中查找，找到的缓存到本类的索引中
+    if (superClass != nullptr)
+        field = superClass->findField(name, descriptor);
+
+    for (size_t i = 0; field == nullptr and i < interfaces.size(); i++)
+        field = interfaces[i]->findField(name, descriptor);
+
+    if (field != nullptr)
+        fieldIndex->putIfAbsent(field);
+    return field;
+}
+
+Field *Class::lookupField(const utf8_t *name, const utf8_t *descriptor)
+{
+    // 调用者传入的一般已是规范字符串，先直接查，找不到再换成规范字符串重新查
+    Field *field = findField(name, descriptor);
+    if (field != nullptr)
+        return field;
+
+    const utf8_t *n = name, *d = descriptor;
+    if (canonicalize(n, d) and (n != name or d != descriptor)) {
+        field = findField(n, d);
+        if (field != nullptr)
             return field;
     }
 
@@ -607,29 +701,48 @@ Field *Class::lookupInstField(const utf8_t *name, const utf8_t *descriptor)
     return field;
 }
 
-Field *Class::getDeclaredInstField(int id, bool ensureExist)
+Field *Class::getDeclaredInstField(int offset, bool ensureExist)
 {
-    for (auto f : fields) {
-        if (!f->isStatic() && f->id == id)
-            return f;
-    }
+    auto iter = lower_bound(instFieldsByOffset.begin(), instFieldsByOffset.end(), offset,
+                            [](Field *f, int off) { return f->offset < off; });
+    if (iter != instFieldsByOffset.end() and (*iter)->offset == offset)
+        return *iter;
 
     if (ensureExist) {
         // not find, but ensure exist, so...
-        thread_throw(new NoSuchFieldError(NEW_MSG("%s, id = %d.", className, id)));
+        thread_throw(new NoSuchFieldError(NEW_MSG("%s, offset = %d.", className, offset)));
     }
 
     // not find
     return nullptr;
 }
 
-Method *Class::getDeclaredMethod(const utf8_t *name, const utf8_t *descriptor, bool ensureExist)
+/*
+ * 调用者传入的一般已是规范字符串（来自常量池或 S() 符号），先直接查索引，
+ * 找不到再换成规范字符串重新查一次。
+ * 索引中也缓存有继承来的方法，要排除掉。
+ */
+template <typename Index, typename Filter>
+static Method *findDeclaredMethod(Class *c, Index *index,
+                                  const utf8_t *name, const utf8_t *descriptor, Filter filter)
 {
-    for (auto m : methods) {
-        if (utf8::equals(m->name, name) && utf8::equals(m->descriptor, descriptor))
-            return m;
+    Method *m = index->find({ name, descriptor });
+    if (m == nullptr) {
+        const utf8_t *n = name, *d = descriptor;
+        if (!canonicalize(n, d) or (n == name and d == descriptor))
+            return nullptr;
+        m = index->find({ n, d });
     }
 
+    return m != nullptr and m->clazz == c and filter(m) ? m : nullptr;
+}
+
+Method *Class::getDeclaredMethod(const utf8_t *name, const utf8_t *descriptor, bool ensureExist)
+{
+    Method *m = findDeclaredMethod(this, methodIndex, name, descriptor, [](Method *m) { return true; });
+    if (m != nullptr)
+        return m;
+
     if (ensureExist) {
         // not find, but ensure exist, so...
         thread_throw(new NoSuchMethodError(NEW_MSG("%s~%s~%s\n", className, name, descriptor)));
@@ -641,10 +754,9 @@ Method *Class::getDeclaredMethod(const utf8_t *name, const utf8_t *descriptor, b
 
 Method *Class::getDeclaredStaticMethod(const utf8_t *name, const utf8_t *descriptor, bool ensureExist)
 {
-    for (auto m : methods) {
-        if (m->isStatic() && utf8::equals(m->name, name) && utf8::equals(m->descriptor, descriptor))
-            return m;
-    }
+    Method *m = findDeclaredMethod(this, methodIndex, name, descriptor, [](Method *m) { return m->isStatic(); });
+    if (m != nullptr)
+        return m;
 
     if (ensureExist) {
         // I don't find it, but you ensure exist, so...
@@ -657,10 +769,9 @@ Method *Class::getDeclaredStaticMethod(const utf8_t *name, const utf8_t *descrip
 
 Method *Class::getDeclaredInstMethod(const utf8_t *name, const utf8_t *descriptor, bool ensureExist)
 {
-    for (auto m : methods) {
-        if (!m->isStatic() && utf8::equals(m->name, name) && utf8::equals(m->descriptor, descriptor))
-            return m;
-    }
+    Method *m = findDeclaredMethod(this, methodIndex, name, descriptor, [](Method *m) { return !m->isStatic(); });
+    if (m != nullptr)
+        return m;
 
     if (ensureExist) {
         // not find, but ensure exist, so...
@@ -676,8 +787,12 @@ vector<Method *> Class::getDeclaredMethods(const utf8_t *name, bool public_only)
     assert(name != nullptr);
     vector<Method *> declaredMethods;
 
+    name = utf8::canonical(name);
+    if (name == nullptr)
+        return declaredMethods;
+
     for (auto m : methods) {
-        if ((!public_only || m->isPublic()) && (utf8::equals(m->name, name)))
+        if ((!public_only || m->isPublic()) && m->name == name)
             declaredMethods.push_back(m);
     }
 
@@ -711,26 +826,33 @@ vector<Method *> Class::getConstructors(bool public_only)
     return getDeclaredMethods(S(object_init), public_only);
 }
 
-Method *Class::lookupMethod(const char *name, const char *descriptor)
+Method *Class::findMethod(const utf8_t *name, const utf8_t *descriptor)
 {
-    Method *method = getDeclaredMethod(name, descriptor, false);
-    if (method != nullptr) {
+    Method *method = methodIndex->find({ name, descriptor });
+    if (method != nullptr)
         return method;
-    }
 
-    // todo 在父类中查找
-    if (superClass != nullptr) {
-        if ((method = superClass->lookupMethod(name, descriptor)) != nullptr)
-            return method;
-    }
+    if (superClass != nullptr)
+        method = superClass->findMethod(name, descriptor);
 
-    // todo 在父接口中查找
-    for (auto c : interfaces) {
-        if ((method = c->lookupMethod(name, descriptor)) != nullptr)
-            return method;
-    }
+    for (size_t i = 0; method == nullptr and i < interfaces.size(); i++)
+        method = interfaces[i]->findMethod(name, descriptor);
 
-    return nullptr;
+    if (method != nullptr)
+        methodIndex->putIfAbsent(method);
+    return method;
+}
+
+Method *Class::lookupMethod(const char *name, const char *descriptor)
+{
+    Method *method = findMethod(name, descriptor);
+    if (method != nullptr)
+        return method;
+
+    const utf8_t *n = name, *d = descriptor;
+    if (!canonicalize(n, d) or (n == name and d == descriptor))
+        return nullptr;
+    return findMethod(n, d);
 }
 
 Method *Class::lookupStaticMethod(const char *name, const char *descriptor)
@@ -803,24 +925,26 @@ bool Class::isPrimArrayClass() const
     return strchr("ZBCSIFJD", className[1]) != nullptr;
 }
 
-Class *Class::arrayClass() const
+Class *Class::arrayClass()
 {
+    if (arrClass != nullptr)
+        return arrClass;
+
     char buf[strlen(className) + 8]; // big enough
 
-    // 数组
     if (className[0] == '[') {
+        // 数组
         sprintf(buf, "[%s", className);
-        return loadArrayClass(buf);
+        arrClass = loadClass(loader, buf);
+    } else if (const char *tmp = Prims::getArrayClassName(className); tmp != nullptr) {
+        // 基本类型
+        arrClass = loadArrayClass(tmp);
+    } else {
+        // 类引用，数组类和本类由同一个 loader 定义
+        sprintf(buf, "[L%s;", className);
+        arrClass = loadClass(loader, buf);
     }
-
-    // 基本类型
-    const char *tmp = Prims::getArrayClassName(className);
-    if (tmp != nullptr)
-        return loadArrayClass(tmp);
-
-    // 类引用
-    sprintf(buf, "[L%s;", className);
-    return loadArrayClass(buf);
+    return arrClass;
 }
 
 string Class::toString() const
@@ -883,7 +1007,7 @@ Class *Class::componentClass()
 
     // 判断 component's type
     if (*compName == '[') {
-        compClass = loadArrayClass(compName);
+        compClass = loadClass(loader, compName);
         return compClass;
     }
 
@@ -903,7 +1027,8 @@ Class *Class::componentClass()
         char buf[last + 1];
         strncpy(buf, compName, (size_t) last);
         buf[last] = 0;
-        compClass = loadClass(loader, buf); // todo bug! ! 对于 ArrayClass 这个loader是bootClassLoader, 无法loader用户类
+        // 数组类由元素类的 defining loader 定义
+        compClass = loadClass(loader, buf);
         return compClass;
     }
 }
@@ -948,6 +1073,8 @@ Object *Class::intern(Object *so)
     assert(this == stringClass);
     assert(so->clazz == stringClass);
 
+    // gc 暂停其他线程后要遍历字符串池，持有锁时不能被暂停
+    NoSuspendScope scope;
     pthread_mutex_lock(&strpoolMutex);
     // return either the newly inserted element
     // or the equivalent element already in the set
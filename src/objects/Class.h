@@ -18,6 +18,8 @@
 #include "Object.h"
 #include "../util/BytecodeReader.h"
 #include "../classfile/Attribute.h"
+#include "../memory/Metaspace.h"
+#include "../util/ConcurrentTable.h"
 
 class Field;
 class Method;
@@ -49,19 +51,28 @@ public:
     // 可能为null，表示 bootstrap class loader.
     Object *loader;
 
+    // 以下描述类结构的 vector 从 @loader 的 Metaspace 中分配，随类一起卸载
+    MetaspaceAllocator<char> metaAllocator() const
+    {
+        return MetaspaceAllocator<char>(getMetaspace(loader));
+    }
+
+    // java/security/ProtectionDomain，可能为null
+    Object *protectionDomain = nullptr;
+
     Class *superClass = nullptr;
 
     /*
      * 本类明确实现的interfaces，父类实现的不包括在内。
      * 但如果父类实现，本类也声明了实现的接口，则包括在内。
      */
-    std::vector<Class *> interfaces;
+    MetaVector<Class *> interfaces { metaAllocator() };
 
     /*
      * 本类中定义的所有方法（不包括继承而来的）
      * 所有的 public functions 都放在了最前面
      */
-	std::vector<Method *> methods;
+    MetaVector<Method *> methods { metaAllocator() };
     u2 publicMethodsCount = 0;
 
     /*
@@ -74,27 +85,66 @@ public:
      *
      * todo 接口中的变量怎么处理
      */
-    std::vector<Field *> fields;
+    MetaVector<Field *> fields { metaAllocator() };
     u2 publicFieldsCount = 0;
 
-    // instFieldsCount 有可能大于 fieldsCount，因为 instFieldsCount 包含了继承过来的 field.
-    // 类型二统计为两个数量
-    int instFieldsCount = 0;
+    /*
+     * 此类实例的大小（字节，未对齐），包括对象头以及所有的实例变量（包括继承来的）。
+     * 子类的实例变量从此处开始布局。
+     */
+    size_t instSize = 0;
+
+    // 实例变量布局中因对齐而留下的空隙 <offset, size>，子类的小字段可以填进去
+    MetaVector<std::pair<u2, u2>> fieldGaps { metaAllocator() };
+
+    /*
+     * 实例中引用类型变量的分布（oop map），包括继承来的，在布局实例变量时计算。
+     * 每个类的引用类型变量是连续存放的，所以每一层继承最多贡献一段。
+     * GC 扫描对象时只需遍历这几段，不用再遍历 fields 和解析描述符。
+     */
+    struct OopMapBlock {
+        u2 offset; // 第一个引用的字节偏移
+        u2 count;  // 连续的引用个数
+    };
+    MetaVector<OopMapBlock> oopMap { metaAllocator() };
+
+    // 数组类的元素是否为引用类型（包括多维数组）
+    bool refArray = false;
+
+    /*
+     * java/lang/ref/Reference 的子类的种类，由子类继承。
+     * GC 对这些类的对象不经由 referent 标记，参见 gc.cpp
+     */
+    enum RefType {
+        REF_TYPE_NONE,
+        REF_TYPE_SOFT,
+        REF_TYPE_WEAK,
+        REF_TYPE_PHANTOM
+    } refType = REF_TYPE_NONE;
+
+    // 是否有非平凡的 finalize() 方法（不是 Object 的，方法体也不是空的）
+    bool finalizable = false;
+
+    /*
+     * 此类实例的对象头大小，实例变量（数组类则为数组元素）从此偏移处开始存放。
+     * 普通类为 sizeof(Object)，数组类见 Array::headerSize()，
+     * java/lang/Class 的实例就是 Class 本身，为 sizeof(Class)。
+     */
+    size_t instHeaderSize = sizeof(Object);
 
     // vtable 只保存虚方法。
     // 该类所有函数自有函数（除了private, static, final, abstract）和 父类的函数虚拟表。
-    std::vector<Method *> vtable;
+    MetaVector<Method *> vtable { metaAllocator() };
 
     struct ITable {
-        std::vector<std::pair<Class *, size_t /* offset */>> interfaces;
-        std::vector<Method *> methods;
+        MetaVector<std::pair<Class *, size_t /* offset */>> interfaces;
+        MetaVector<Method *> methods;
 
-        ITable() = default;
-        ITable(const ITable &itable);
+        explicit ITable(const MetaspaceAllocator<char> &a): interfaces(a), methods(a) { }
         ITable& operator=(const ITable &itable);
     };
 
-    ITable itable;
+    ITable itable { metaAllocator() };
 
     struct {
         Class *clazz = nullptr;       // the immediately enclosing class
@@ -143,8 +193,13 @@ public:
     std::vector<Annotation> rtInvisiAnnos; // runtime invisible annotations
 
 private:
-    // 计算字段的个数，同时给它们编号
-    void calcFieldsId();
+    /*
+     * 计算实例变量在对象中的布局：
+     * 引用类型的变量放在一起（方便 GC 扫描），其余按 8/4/2/1 字节从大到小放置，
+     * 并且优先填充父类（以及自身对齐时）留下的空隙。
+     * 每个变量都按其大小对齐，保证 long 和 double 可以原子访问。
+     */
+    void layoutFields();
     void parseAttribute(BytecodeReader &r);
 
     // 根据类名生成包名
@@ -153,6 +208,55 @@ private:
     void createVtable();
     void createItable();
 
+    /*
+     * 在本类及父类、父接口中查找，找不到返回 null.
+     * @name 和 @descriptor 必须是 utf8 池中的规范字符串，只比较指针。
+     */
+    Field *findField(const utf8_t *name, const utf8_t *descriptor);
+    Method *findMethod(const utf8_t *name, const utf8_t *descriptor);
+
+    struct MemberKey {
+        const utf8_t *name;
+        const utf8_t *descriptor;
+    };
+
+    // 成员的键是 (name, descriptor) 两个规范字符串的指针
+    template <typename T>
+    struct MemberTraits {
+        using Key = MemberKey;
+
+        static Key key(const T *t)
+        {
+            return { t->name, t->descriptor };
+        }
+
+        static size_t hash(Key k)
+        {
+            auto h = (size_t) k.name * 31 + (size_t) k.descriptor;
+            return h ^ (h >> 7) ^ (h >> 16);
+        }
+
+        static bool equals(Key k1, Key k2)
+        {
+            return k1.name == k2.name and k1.descriptor == k2.descriptor;
+        }
+    };
+
+    /*
+     * 方法和变量的哈希索引。
+     * 链接时放入本类声明的所有成员；之后在父类、父接口中解析到的成员也缓存在这里，
+     * 所以第二次查找继承来的成员时不用再沿继承链查找。
+     * 同一个类中 (name, descriptor) 相同的成员只有一个，并且本类声明的成员先放入，
+     * 所以缓存进来的继承成员不会遮住本类的成员。
+     */
+    ConcurrentTable<Method, MemberTraits<Method>> *methodIndex = nullptr;
+    ConcurrentTable<Field, MemberTraits<Field>> *fieldIndex = nullptr;
+
+    // 本类声明的实例变量，按 offset 排序
+    MetaVector<Field *> instFieldsByOffset { metaAllocator() };
+
+    void buildMemberIndex();
+
     u1 *bytecode = nullptr;
 
     pthread_mutex_t clinitLock = PTHREAD_MUTEX_INITIALIZER;
@@ -160,24 +264,29 @@ private:
     Class(Object *loader, u1 *bytecode, size_t len);
 
     // 创建数组或 primitive class，这两种类型的类由虚拟机直接生成。
-    explicit Class(const char *className);
+    Class(Object *loader, const char *className);
 
     static Class *newClass(Object *loader, u1 *bytecode, size_t len)
     {
-        void *mem = g_heap.allocClass();
+        void *mem = getMetaspace(loader)->allocClass();
         auto c = new(mem) Class(loader, bytecode, len);
         c->state = LOADED;
         return c;
     }
 
-    static Class *newClass(const char *className)
+    /*
+     * primitive class 由 boot class loader 创建，
+     * 数组类由其元素类的 defining loader 创建（基本类型的数组由 boot class loader 创建）。
+     */
+    static Class *newClass(Object *loader, const char *className)
     {
-        void *mem = g_heap.allocClass();
-        auto c = new(mem) Class(className);
+        void *mem = getMetaspace(loader)->allocClass();
+        auto c = new(mem) Class(loader, className);
         c->state = LOADED;
         return c;
     }
 public:
+    // 只在 class loader 被卸载时调用，Class 本身的内存随 Metaspace 一起释放
     ~Class();
 
     /*
@@ -200,11 +309,6 @@ public:
         return sizeof(Class) + sizeof(slot_t)*CLASS_CLASS_INST_FIELDS_COUNT;
     }
 
-    size_t size() const override
-    {
-        return getSize();
-    }
-
     /*
      * 比较两个类是否相等
      */
@@ -217,7 +321,8 @@ public:
     Field *lookupStaticField(const char *name, const char *descriptor);
     Field *lookupInstField(const char *name, const char *descriptor);
 
-    Field *getDeclaredInstField(int id, bool ensureExist = true);
+    // 由实例变量的字节偏移得到本类中定义的实例变量
+    Field *getDeclaredInstField(int offset, bool ensureExist = true);
 
     Method *lookupMethod(const char *name, const char *descriptor);
     Method *lookupStaticMethod(const char *name, const char *descriptor);
@@ -260,9 +365,7 @@ public:
       */
     bool isPrimArrayClass() const;
 
-    bool isArrayObject() const override { return false; }
-
-    Class *arrayClass() const;
+    Class *arrayClass();
 
     std::string toString() const;
 
@@ -407,6 +510,7 @@ public:
 private:
     Class *compClass = nullptr; // component class
     Class *eleClass = nullptr;  // element class
+    Class *arrClass = nullptr;  // 以本类为 component class 的数组类，参见 arrayClass()
 public:
     size_t eleSize = 0;
 
@@ -451,7 +555,10 @@ public:
 
     friend void initClassLoader();
     friend Class *loadBootClass(const utf8_t *name);
+    friend Class *loadArrayClass(Object *classLoader, const utf8_t *arrClassName);
     friend Class *defineClass(jref classLoader, u1 *bytecode, size_t len);
+    friend void releaseDetachedLoaders();
+    friend void gc();
 };
 
 #endif //JVM_JCLASS_H
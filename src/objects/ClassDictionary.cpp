@@ -0,0 +1,43 @@
+/*
+ * Author: kayo
+ */
+
+#include "ClassDictionary.h"
+#include "Class.h"
+#include "../runtime/Thread.h"
+
+using namespace std;
+
+ClassDictionary::Traits::Key ClassDictionary::Traits::key(const Class *c)
+{
+    return c->className;
+}
+
+bool ClassDictionary::beginLoad(const utf8_t *name, Class *&c)
+{
+    unique_lock<mutex> lock(placeholderMutex);
+    while (true) {
+        c = find(name);
+        if (c != nullptr)
+            return false;
+
+        auto iter = placeholders.find(name);
+        if (iter == placeholders.end())
+            break;
+        if (iter->second == this_thread::get_id()) {
+            lock.unlock();
+            thread_throw(new ClassCircularityError(name));
+        }
+        placeholderCond.wait(lock);
+    }
+
+    placeholders.emplace(name, this_thread::get_id());
+    return true;
+}
+
+void ClassDictionary::endLoad(const utf8_t *name)
+{
+    lock_guard<mutex> lock(placeholderMutex);
+    placeholders.erase(name);
+    placeholderCond.notify_all();
+}
@@ -0,0 +1,108 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_CLASS_DICTIONARY_H
+#define KAYOVM_CLASS_DICTIONARY_H
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <condition_variable>
+#include "../util/encoding.h"
+#include "../util/ConcurrentTable.h"
+
+class Class;
+
+/*
+ * 一个 class loader 的已加载类表：类名 -> Class *.
+ *
+ * 查找是无锁的（参见 ConcurrentTable），插入在表的锁内进行。
+ *
+ * 另外维护正在加载的类的占位符（placeholder）：
+ * 同一个类名同时只有一个线程在加载，其他线程等它完成后直接使用其结果。
+ */
+class ClassDictionary {
+    struct Traits {
+        using Key = const utf8_t *;
+        static Key key(const Class *c);
+        static size_t hash(Key k) { return utf8::hash(k); }
+        static bool equals(Key k1, Key k2) { return utf8::equals(k1, k2); }
+    };
+
+    ConcurrentTable<Class, Traits> classes;
+
+    std::mutex placeholderMutex;
+    std::condition_variable placeholderCond;
+    std::unordered_map<std::string, std::thread::id> placeholders; // 类名 -> 正在加载它的线程
+
+public:
+    Class *find(const utf8_t *name) const
+    {
+        return classes.find(name);
+    }
+
+    /*
+     * 如果已有同名的类，返回它；否则加入 @c 并返回 @c.
+     */
+    Class *add(Class *c)
+    {
+        return classes.putIfAbsent(c);
+    }
+
+    template <typename Pred>
+    size_t removeIf(Pred pred)
+    {
+        return classes.removeIf(pred);
+    }
+
+    template <typename Visit>
+    void forEach(Visit visit) const
+    {
+        classes.forEach(visit);
+    }
+
+    size_t size() const
+    {
+        return classes.size();
+    }
+
+    /*
+     * 加载类 @name，保证同一个类名只被一个线程加载。
+     *
+     * 已加载时直接返回；其他线程正在加载时等待，然后返回它的结果；
+     * 否则放置占位符，调用 @load() 加载（@load 返回 nullptr 表示没找到），
+     * 把结果加入表中，移除占位符并唤醒等待的线程。
+     *
+     * 本线程在加载 @name 的过程中又要加载 @name（比如类是自己的父类），
+     * 抛出 ClassCircularityError.
+     */
+    template <typename Load>
+    Class *loadOnce(const utf8_t *name, Load load)
+    {
+        Class *c = find(name);
+        if (c != nullptr)
+            return c;
+
+        if (!beginLoad(name, c))
+            return c;
+
+        // 加载失败（包括抛出异常）时也要移除占位符
+        struct Guard {
+            ClassDictionary *d;
+            const utf8_t *name;
+            ~Guard() { d->endLoad(name); }
+        } guard { this, name };
+
+        c = load();
+        return c != nullptr ? add(c) : nullptr;
+    }
+
+private:
+    // 放置了占位符返回 true；其他线程已加载完成返回 false，结果写入 @c
+    bool beginLoad(const utf8_t *name, Class *&c);
+    void endLoad(const utf8_t *name);
+};
+
+#endif //KAYOVM_CLASS_DICTIONARY_H
@@ -4,6 +4,7 @@
 #include "Method.h"
 #include "../interpreter/interpreter.h"
 #include "invoke.h"
+#include "../runtime/Thread.h"
 
 /*
  * Author: kayo
@@ -12,6 +13,77 @@
 using namespace method_type;
 using namespace method_handles;
 
+void ConstantPool::parse(BytecodeReader &r, const std::function<slot_t(const char *utf8)> &saveUtf8)
+{
+    for (u2 i = 1; i < size; i++) {
+        u1 tag = r.readu1();
+        type(i, tag);
+        switch (tag) {
+            case CONSTANT_Class:
+            case CONSTANT_String:
+            case CONSTANT_MethodType:
+            case CONSTANT_Module:
+            case CONSTANT_Package:
+                info(i, r.readu2());
+                break;
+            case CONSTANT_NameAndType:
+            case CONSTANT_Fieldref:
+            case CONSTANT_Methodref:
+            case CONSTANT_InterfaceMethodref:
+            case CONSTANT_Dynamic:
+            case CONSTANT_InvokeDynamic: {
+                u2 index1 = r.readu2();
+                u2 index2 = r.readu2();
+                info(i, (index2 << 16) + index1); //  CP_INFO(cp, i) = (index2 << 16) + index1;
+                break;
+            }
+            case CONSTANT_Integer: {
+                u1 bytes[4];
+                r.readBytes(bytes, 4);
+                _int(i, bytes_to_int32(bytes)); // CP_INT(cp, i) = bytes_to_int32(bytes);
+                break;
+            }
+            case CONSTANT_Float: {
+                u1 bytes[4];
+                r.readBytes(bytes, 4);
+                _float(i, bytes_to_float(bytes));
+                // CP_FLOAT(cp, i) = bytes_to_float(bytes);
+                break;
+            }
+            case CONSTANT_Long: {
+                u1 bytes[8];
+                r.readBytes(bytes, 8);
+                _long(i, bytes_to_int64(bytes));
+                type(++i, CONSTANT_Placeholder);
+                break;
+            }
+            case CONSTANT_Double: {
+                u1 bytes[8];
+                r.readBytes(bytes, 8);
+                _double(i, bytes_to_double(bytes));
+                type(++i, CONSTANT_Placeholder);
+                break;
+            }
+            case CONSTANT_Utf8: {
+                u2 utf8_len = r.readu2();
+                char buf[utf8_len + 1];
+                r.readBytes((u1 *) buf, utf8_len);
+                buf[utf8_len] = 0;
+                info(i, saveUtf8(buf));
+                break;
+            }
+            case CONSTANT_MethodHandle: {
+                u2 index1 = r.readu1(); // 这里确实是 readu1, reference_kind
+                u2 index2 = r.readu2(); // reference_index
+                info(i, (index2 << 16) + index1);
+                break;
+            }
+            default:
+                thread_throw(new ClassFormatError(NEW_MSG("bad constant tag: %d\n", tag)));
+        }
+    }
+}
+
 Class *ConstantPool::resolveClass(u2 i)
 {
     assert(0 < i && i < size);
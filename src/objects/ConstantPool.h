@@ -5,9 +5,11 @@
 #ifndef KAYOVM_CONSTANTPOOL_H
 #define KAYOVM_CONSTANTPOOL_H
 
+#include <functional>
 #include "slot.h"
 #include "../util/BytecodeReader.h"
 #include "../classfile/constant.h"
+#include "../memory/Metaspace.h"
 
 class Class;
 class Method;
@@ -22,21 +24,16 @@ struct ConstantPool {
 
     ConstantPool() = default;
 
-    explicit ConstantPool(Class *clazz, u2 size): clazz(clazz), size(size)
+    // 常量池分配在 @clazz 的 defining loader 的 Metaspace 中，随其一起释放
+    explicit ConstantPool(Class *clazz, u2 size, Metaspace &metaspace): clazz(clazz), size(size)
     {
         assert(clazz != nullptr);
         assert(size > 0);
 
-        _type = new u1[size];
+        _type = (u1 *) metaspace.allocBytecode(size * sizeof(u1));
         _type[0] = CONSTANT_Invalid; // constant pool 从 1 开始计数，第0位无效
 
-        _info = new slot_t[size];
-    }
-
-    ~ConstantPool()
-    {
-        delete[] _type;
-        delete[] _info;
+        _info = (slot_t *) metaspace.allocBytecode(size * sizeof(slot_t));
     }
 
     u1 type(u2 i)
@@ -294,6 +291,12 @@ struct ConstantPool {
         *(jdouble *)(_info + i) = newDouble;
     }
 
+    /*
+     * 从 @r 的当前位置读取 class 文件中 size-1 个常量，r 停在常量池之后。
+     * CONSTANT_Utf8 的内容（以'\0'结尾，不可长期持有）交给 @saveUtf8，其返回值写入 info.
+     */
+    void parse(BytecodeReader &r, const std::function<slot_t(const char *utf8)> &saveUtf8);
+
     Class *resolveClass(u2 i);
     Method *resolveMethod(u2 i);
     Method *resolveInterfaceMethod(u2 i);
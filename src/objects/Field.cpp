@@ -56,7 +56,7 @@ Field::Field(Class *c, BytecodeReader &r)
                     staticValue.f = cp._float(index);
                 } else if (d == 'D') {
                     staticValue.d = cp._double(index);
-                } else if(equals(descriptor, S(sig_java_lang_String))) {
+                } else if(descriptor == S(sig_java_lang_String)) {
                     staticValue.r = cp.resolveString(index);
                 }
             }
@@ -104,9 +104,32 @@ bool Field::isPrim() const
     return Prims::descriptor2className(*descriptor) != nullptr;
 }
 
+size_t Field::getSize() const
+{
+    switch (*descriptor) {
+        case 'Z':
+        case 'B':
+            return sizeof(jbyte);
+        case 'C':
+            return sizeof(jchar);
+        case 'S':
+            return sizeof(jshort);
+        case 'I':
+            return sizeof(jint);
+        case 'F':
+            return sizeof(jfloat);
+        case 'J':
+            return sizeof(jlong);
+        case 'D':
+            return sizeof(jdouble);
+        default: // reference
+            return sizeof(jref);
+    }
+}
+
 string Field::toString() const
 {
     ostringstream oss;
-    oss << clazz->className << "~" << name << "~" << descriptor << "~" << id;
+    oss << clazz->className << "~" << name << "~" << descriptor << "~" << offset;
     return oss.str();
 }
@@ -48,7 +48,8 @@ public:
             slot_t data[2] = { 0, 0 };
         } staticValue;
 
-        int id = 0;
+        // 实例变量在对象中的字节偏移，从对象的起始处（对象头）算起，参见 Class::layoutFields()
+        int offset = 0;
     };
 
     std::vector<Annotation> rtVisiAnnos;   // runtime visible annotations
@@ -61,6 +62,9 @@ public:
 
     bool isPrim() const;
 
+    // 实例变量在对象中所占的字节数
+    size_t getSize() const;
+
     std::string toString() const;
 
     bool isPublic() const    { return Modifier::isPublic(modifiers); }
@@ -147,6 +147,8 @@ Object *Method::getType()
 Array *Method::getExceptionTypes()
 {
     if (exceptionTypes == nullptr) {
+        parseCodeAttrs();
+
         int count = 0;
         Class *types[exceptionTables.size()];
         for (auto t : exceptionTables) {
@@ -253,7 +255,8 @@ void Method::calArgsSlotsCount()
 }
 
 /*
- * 解析方法的 code 属性
+ * 解析方法的 code 属性，
+ * 只读取 code 本身，之后的异常处理表和属性等到用到时再由 parseCodeAttrs 解析。
  */
 void Method::parseCodeAttr(BytecodeReader &r)
 {
@@ -262,52 +265,126 @@ void Method::parseCodeAttr(BytecodeReader &r)
     codeLen = r.readu4();
     code = r.currPos();
     r.skip(codeLen);
+    codeAttrs = r.currPos();
+}
 
-    // parse exception tables
-    int exception_tables_count = r.readu2();
-    for (int i = 0; i < exception_tables_count; i++) {
-        exceptionTables.emplace_back(ExceptionTable(clazz, r));
-    }
+void Method::parseCodeAttrs()
+{
+    call_once(codeAttrsParsed, [this]() {
+        if (codeAttrs == nullptr) // native or abstract
+            return;
 
-    // parse attributes of code's attribute
-    u2 attr_count = r.readu2();
-    for (int k = 0; k < attr_count; k++) {
-        const char *attr_name = clazz->cp.utf8(r.readu2());
-        u4 attr_len = r.readu4();
+        BytecodeReader r(codeAttrs, codeAttrsLen);
 
-        if (S(LineNumberTable) == attr_name) {
-            int count = r.readu2();
-            for (int i = 0; i < count; i++)
-                lineNumberTables.emplace_back(LineNumberTable(r));
-        } else if (S(StackMapTable) == attr_name) {
-            r.skip(attr_len); // todo
-        } else if (S(LocalVariableTable) == attr_name) {
-//            u2 num = readu2(reader);
-//            struct local_variable_table tables[num];
-//            for (int i = 0; i < num; i++) {
-//                tables[i].start_pc = readu2(reader);
-//                tables[i].length = readu2(reader);
-//                tables[i].name_index = readu2(reader);
-//                tables[i].descriptor_index = readu2(reader);
-//                tables[i].index = readu2(reader);
-//            }
-            r.skip(attr_len); // todo
-        } else if (S(LocalVariableTypeTable) == attr_name) {
-//            u2 num = readu2(reader);
-//            struct local_variable_type_table tables[num];
-//            for (int i = 0; i < num; i++) {
-//                tables[i].start_pc = readu2(reader);
-//                tables[i].length = readu2(reader);
-//                tables[i].name_index = readu2(reader);
-//                tables[i].signature_index = readu2(reader);
-//                tables[i].index = readu2(reader);
-//            }
-            r.skip(attr_len); // todo
-        } else {
-            // unknown attribute
-            r.skip(attr_len);
+        // parse exception tables
+        int exception_tables_count = r.readu2();
+        exceptionTables.reserve(exception_tables_count);
+        for (int i = 0; i < exception_tables_count; i++) {
+            exceptionTables.emplace_back(ExceptionTable(clazz, r));
         }
-    }
+
+        // parse attributes of code's attribute
+        u2 attr_count = r.readu2();
+        for (int k = 0; k < attr_count; k++) {
+            const char *attr_name = clazz->cp.utf8(r.readu2());
+            u4 attr_len = r.readu4();
+
+            if (S(LineNumberTable) == attr_name) {
+                int count = r.readu2();
+                for (int i = 0; i < count; i++)
+                    lineNumberTables.emplace_back(LineNumberTable(r));
+            } else if (S(StackMapTable) == attr_name) {
+                r.skip(attr_len); // todo
+            } else if (S(LocalVariableTable) == attr_name) {
+//                u2 num = readu2(reader);
+//                struct local_variable_table tables[num];
+//                for (int i = 0; i < num; i++) {
+//                    tables[i].start_pc = readu2(reader);
+//                    tables[i].length = readu2(reader);
+//                    tables[i].name_index = readu2(reader);
+//                    tables[i].descriptor_index = readu2(reader);
+//                    tables[i].index = readu2(reader);
+//                }
+                r.skip(attr_len); // todo
+            } else if (S(LocalVariableTypeTable) == attr_name) {
+//                u2 num = readu2(reader);
+//                struct local_variable_type_table tables[num];
+//                for (int i = 0; i < num; i++) {
+//                    tables[i].start_pc = readu2(reader);
+//                    tables[i].length = readu2(reader);
+//                    tables[i].name_index = readu2(reader);
+//                    tables[i].signature_index = readu2(reader);
+//                    tables[i].index = readu2(reader);
+//                }
+                r.skip(attr_len); // todo
+            } else {
+                // unknown attribute
+                r.skip(attr_len);
+            }
+        }
+    });
+}
+
+void Method::parseReflectionAttrs()
+{
+    call_once(reflectionAttrsParsed, [this]() {
+        auto ra = new ReflectionAttrs;
+        ConstantPool &cp = clazz->cp;
+        BytecodeReader r(attrs, attrsLen);
+
+        for (int i = 0; i < attrCount; i++) {
+            const char *attr_name = cp.utf8(r.readu2());
+            u4 attr_len = r.readu4();
+
+            if (S(MethodParameters) == attr_name) {
+                u1 num = r.readu1(); // 这里就是 u1，不是u2
+                for (u2 k = 0; k < num; k++)
+                    ra->parameters.emplace_back(cp, r);
+            } else if (S(Exceptions) == attr_name) {
+                u2 num = r.readu2();
+                for (u2 j = 0; j < num; j++)
+                    ra->checkedExceptions.push_back(r.readu2());
+            } else if (S(RuntimeVisibleParameterAnnotations) == attr_name) {
+                u2 num = r.readu2();
+                ra->rtVisiParaAnnos.resize(num);
+                for (u2 j = 0; j < num; j++) {
+                    u2 numAnnos = r.readu2();
+                    for (u2 k = 0; k < numAnnos; k++)
+                        ra->rtVisiParaAnnos[j].emplace_back(r);
+                }
+            } else if (S(RuntimeInvisibleParameterAnnotations) == attr_name) {
+                u2 num = r.readu2();
+                ra->rtInvisiParaAnnos.resize(num);
+                for (u2 j = 0; j < num; j++) {
+                    u2 numAnnos = r.readu2();
+                    for (u2 k = 0; k < numAnnos; k++)
+                        ra->rtInvisiParaAnnos[j].emplace_back(r);
+                }
+            } else if (S(RuntimeVisibleAnnotations) == attr_name) {
+                u2 num = r.readu2();
+                for (u2 j = 0; j < num; j++)
+                    ra->rtVisiAnnos.emplace_back(r);
+            } else if (S(RuntimeInvisibleAnnotations) == attr_name) {
+                u2 num = r.readu2();
+                for (u2 j = 0; j < num; j++)
+                    ra->rtInvisiAnnos.emplace_back(r);
+            } else if (S(AnnotationDefault) == attr_name) {
+                ra->annotationDefault.read(r);
+            } else {
+                // 其他属性在构造方法时已经解析过了
+                r.skip(attr_len);
+            }
+        }
+
+        reflection = ra;
+    });
+}
+
+const Method::ReflectionAttrs &Method::reflectionAttrs()
+{
+    parseReflectionAttrs();
+    assert(reflection != nullptr);
+    return *reflection;
 }
 
 Method::LineNumberTable::LineNumberTable(BytecodeReader &r)
@@ -341,57 +418,30 @@ Method::Method(Class *c, BytecodeReader &r)
     calArgsSlotsCount();
 
     // parse method's attributes
+    // 只解析执行必需的和很小的属性，其余的只记下位置，用到时再解析
+    attrs = r.currPos();
+    attrCount = attr_count;
     for (int i = 0; i < attr_count; i++) {
         const char *attr_name = cp.utf8(r.readu2());
         u4 attr_len = r.readu4();
 
         if (S(Code) == attr_name) {
+            u1 *end = r.currPos() + attr_len;
             parseCodeAttr(r);
+            codeAttrsLen = end - codeAttrs;
+            r.skip(codeAttrsLen);
         } else if (S(Deprecated) == attr_name) {
             deprecated = true;
         } else if (S(Synthetic) == attr_name) {
             setSynthetic();
         } else if (S(Signature) == attr_name) {
             signature = cp.utf8(r.readu2());
-        } else if (S(MethodParameters) == attr_name) {
-            u1 num = r.readu1(); // 这里就是 u1，不是u2
-            for (u2 k = 0; k < num; k++)
-                parameters.emplace_back(cp, r);
-        } else if (S(Exceptions) == attr_name) {
-            u2 num = r.readu2();
-            for (u2 j = 0; j < num; j++)
-                checkedExceptions.push_back(r.readu2());
-        } else if (S(RuntimeVisibleParameterAnnotations) == attr_name) {
-            u2 num = r.readu2();
-            rtVisiParaAnnos.resize(num);
-            for (u2 j = 0; j < num; j++) {
-                u2 numAnnos = r.readu2();
-                for (u2 k = 0; k < numAnnos; k++)
-                    rtVisiParaAnnos[j].emplace_back(r);
-            }
-        } else if (S(RuntimeInvisibleParameterAnnotations) == attr_name) {
-            u2 num = r.readu2();
-            rtInvisiParaAnnos.resize(num);
-            for (u2 j = 0; j < num; j++) {
-                u2 numAnnos = r.readu2();
-                for (u2 k = 0; k < numAnnos; k++)
-                    rtInvisiParaAnnos[j].emplace_back(r);
-            }
-        } else if (S(RuntimeVisibleAnnotations) == attr_name) {
-            u2 num = r.readu2();
-            for (u2 j = 0; j < num; j++)
-                rtVisiAnnos.emplace_back(r);
-        } else if (S(RuntimeInvisibleAnnotations) == attr_name) {
-            u2 num = r.readu2();
-            for (u2 j = 0; j < num; j++)
-                rtInvisiAnnos.emplace_back(r);
-        } else if (S(AnnotationDefault) == attr_name) {
-            annotationDefault.read(r);
         } else {
-            // unknown attribute
+            // MethodParameters, Exceptions, annotations 等，由 parseReflectionAttrs 解析
             r.skip(attr_len);
         }
     }
+    attrsLen = r.currPos() - attrs;
 
     if (isNative()) {
         // 本地方法帧的操作数栈至少要能容纳返回值，
@@ -401,33 +451,119 @@ Method::Method(Class *c, BytecodeReader &r)
         // 所以把argSlotCount赋给maxLocals字段刚好。
         maxLocals = arg_slot_count;
 
-        codeLen = 2;
-        auto code = new u1[codeLen];
-        code[0] = OPC_INVOKENATIVE;
-        const char *t = strchr(descriptor, ')'); // find return
-        assert(t != nullptr);
-
-        ++t;
-        if (*t == 'V') {
-            code[1] = OPC_RETURN;
-        } else if (*t == 'D') {
-            code[1] = OPC_DRETURN;
-        } else if (*t == 'F') {
-            code[1] = OPC_FRETURN;
-        } else if (*t == 'J') {
-            code[1] = OPC_LRETURN;
-        } else if (*t == 'L' || *t == '[') {
-            code[1] = OPC_ARETURN;
-        } else {
-            code[1] = OPC_IRETURN;
+        setInvokeNativeStub();
+        nativeMethod = findNative(clazz->className, name, descriptor);
+    } else {
+        detectTrivial();
+    }
+}
+
+// 描述符 @d 表示的值在操作数栈上的类型：I（包括 Z, B, C, S）, J, F, D, A（引用）, V
+static char stackKind(const utf8_t *d)
+{
+    switch (*d) {
+        case 'Z': case 'B': case 'C': case 'S': case 'I': return 'I';
+        case 'L': case '[': return 'A';
+        default: return *d;
+    }
+}
+
+void Method::detectTrivial()
+{
+    if (code == nullptr or isStatic() or isSynchronized())
+        return;
+    // 有异常处理表的不算
+    if (codeAttrs == nullptr or codeAttrs[0] != 0 or codeAttrs[1] != 0)
+        return;
+
+    auto index = [this](int pc) { return (u2) (code[pc] << 8 | code[pc + 1]); };
+    ConstantPool &cp = clazz->cp;
+    // 访问的 field 的类型，不是 Fieldref 的返回 0
+    auto fieldKind = [&cp](u2 i) { return cp.type(i) == CONSTANT_Fieldref ? stackKind(cp.fieldType(i)) : 0; };
+    const utf8_t *ret = strchr(descriptor, ')') + 1;
+
+    /*
+     * getter 和 setter 除了代码的形状，参数和返回值也要与 field 一致：
+     * getter 没有参数，setter 只有一个参数，
+     * 这样调用点的参数恰好是 getfield 或 putfield 的操作数。
+     */
+    if (codeLen == 1 and code[0] == OPC_RETURN) {
+        trivial = EMPTY;
+    } else if (codeLen == 5 and code[0] == OPC_ALOAD_0 and code[1] == OPC_GETFIELD
+               and OPC_IRETURN <= code[4] and code[4] <= OPC_ARETURN) {
+        char kind = fieldKind(index(2));
+        if (arg_slot_count == 1 and kind == "IJFDA"[code[4] - OPC_IRETURN] and kind == stackKind(ret)) {
+            trivial = GETTER;
+            trivialIndex = index(2);
+        }
+    } else if (codeLen == 6 and code[0] == OPC_ALOAD_0 and code[2] == OPC_PUTFIELD and code[5] == OPC_RETURN) {
+        char load;
+        switch (code[1]) {
+            case OPC_ILOAD_1: load = 'I'; break;
+            case OPC_LLOAD_1: load = 'J'; break;
+            case OPC_FLOAD_1: load = 'F'; break;
+            case OPC_DLOAD_1: load = 'D'; break;
+            case OPC_ALOAD_1: load = 'A'; break;
+            default: return;
         }
+        char kind = fieldKind(index(3));
+        int slots = (kind == 'J' or kind == 'D') ? 2 : 1;
+        if (arg_slot_count == 1 + slots and kind == load and kind == stackKind(descriptor + 1)) {
+            trivial = SETTER;
+            trivialIndex = index(3);
+        }
+    } else if (codeLen == 5 and name == S(object_init) and code[0] == OPC_ALOAD_0
+               and code[1] == OPC_INVOKESPECIAL and code[4] == OPC_RETURN) {
+        trivial = EMPTY_INIT;
+        trivialIndex = index(2);
+    }
+}
 
-        this->code = code;
-        nativeMethod = findNative(clazz->className, name, descriptor);
+/*
+ * 方法体只有两条指令：invokenative 调用 nativeMethod，
+ * 然后用与返回值类型对应的 return 指令返回 nativeMethod 压入操作数栈的返回值。
+ */
+void Method::setInvokeNativeStub()
+{
+    codeLen = 2;
+    auto code = (u1 *) getMetaspace(clazz->loader)->allocBytecode(codeLen);
+    code[0] = OPC_INVOKENATIVE;
+    const char *t = strchr(descriptor, ')'); // find return
+    assert(t != nullptr);
+
+    ++t;
+    if (*t == 'V') {
+        code[1] = OPC_RETURN;
+    } else if (*t == 'D') {
+        code[1] = OPC_DRETURN;
+    } else if (*t == 'F') {
+        code[1] = OPC_FRETURN;
+    } else if (*t == 'J') {
+        code[1] = OPC_LRETURN;
+    } else if (*t == 'L' || *t == '[') {
+        code[1] = OPC_ARETURN;
+    } else {
+        code[1] = OPC_IRETURN;
     }
+
+    this->code = code;
 }
 
-jint Method::getLineNumber(int pc) const
+void Method::bindCompiledCode(native_method_t fn)
+{
+    assert(fn != nullptr);
+    assert(!isNative());
+
+    // maxStack 和 maxLocals 保持不变，编译后的代码把它们用作操作数栈和局部变量表
+    setInvokeNativeStub();
+    nativeMethod = fn;
+    // 异常处理表和行号表中的 pc 对编译后的代码没有意义
+    // （编译的方法没有异常处理表）
+    codeAttrs = nullptr;
+    compiled = true;
+}
+
+jint Method::getLineNumber(int pc)
 {
     // native函数没有字节码
     if (isNative()) {
@@ -439,6 +575,8 @@ jint Method::getLineNumber(int pc) const
      * 如果方法没有行号表，自然也就查不到pc对应的行号，这种情况下返回–1
      todo
      */
+    parseCodeAttrs();
+
     // 从后往前查
     for (auto iter = lineNumberTables.rbegin(); iter != lineNumberTables.rend(); iter++) {
         if (pc >= iter->start_pc)
@@ -449,6 +587,8 @@ jint Method::getLineNumber(int pc) const
 
 int Method::findExceptionHandler(Class *exceptionType, size_t pc)
 {
+    parseCodeAttrs();
+
     for (auto t : exceptionTables) {
         // jvms: The start pc is inclusive and end pc is exclusive
         if (t.startPc <= pc && pc < t.endPc) {
@@ -472,6 +612,8 @@ string Method::toString() const
     oss << "method";
     if (isNative())
         oss << "(native)";
+    else if (compiled)
+        oss << "(compiled)";
     oss << ": "  << clazz->className << "~" << name << "~" << descriptor;
     return oss.str();
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include <cstddef>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <atomic>
 #include "../classfile/Attribute.h"
 #include "../native/registry.h"
 #include "../symbol.h"
@@ -17,6 +19,7 @@
 
 
 class Array;
+class Field;
 
 class Method {
 //    Array *parameterTypes = nullptr; // [Ljava/lang/Class;
@@ -38,6 +41,30 @@ public:
     int vtableIndex = -1;
     int itableIndex = -1;
 
+    /*
+     * 类层次分析（CHA）：此虚方法是否已被某个已加载的子类重写。
+     * 子类创建 vtable 时设置，设置后不再清除。
+     * 解释器把未被重写的方法的调用点改为直接调用（不经过 vtable），
+     * 设置后这些调用点恢复为 invokevirtual，参见 interpreter.cpp
+     */
+    std::atomic_bool overridden{false};
+
+    /*
+     * 简单方法的形状，解析方法时识别。
+     * 调用的方法确定时（final 的，或者类层次分析得出未被重写），
+     * 解释器在调用点直接完成这些方法，不创建栈帧，参见 interpreter.cpp 中的 __invoke_direct
+     */
+    enum Trivial: u1 {
+        NOT_TRIVIAL,
+        EMPTY,      // return
+        GETTER,     // aload_0; getfield #trivialIndex; xreturn，没有参数
+        SETTER,     // aload_0; xload_1; putfield #trivialIndex; return，只有一个与 field 同类型的参数
+        EMPTY_INIT, // <init>: aload_0; invokespecial #trivialIndex; return，被调用的构造函数也是空的话等同于 EMPTY
+    };
+    Trivial trivial = NOT_TRIVIAL;
+    u2 trivialIndex = 0;
+    Field *trivialField = nullptr; // 解析后的 trivialIndex（GETTER 和 SETTER）
+
     u2 maxStack = 0;
     u2 maxLocals = 0;
     u2 arg_slot_count = 0;
@@ -53,12 +80,14 @@ public:
 
         explicit LineNumberTable(BytecodeReader &r);
     };
-    std::vector<LineNumberTable> lineNumberTables;
 
     u1 *code = nullptr;
     size_t codeLen = 0;
 
-    native_method_t nativeMethod = nullptr; // present only if native
+    native_method_t nativeMethod = nullptr; // present only if native or compiled
+
+    // 是否已绑定了预先编译的代码（参见 aot/aot.h），此时 nativeMethod 指向编译后的代码
+    bool compiled = false;
 
     struct Parameter {
         const utf8_t *name = nullptr;
@@ -66,31 +95,66 @@ public:
 
         explicit Parameter(ConstantPool &cp, BytecodeReader &r);
     };
-    std::vector<Parameter> parameters;
 
     /*
-     * Each value in the exception_index_table array must be a valid index into
-     * the constant_pool table. The constant_pool entry at that index must be a
-     * CONSTANT_Class_info structure representing a class type that this
-     * method is declared to throw.
+     * 只有反射才会用到的属性。
+     * 大部分方法从不被反射访问，所以类解析时只记下属性在 class 文件中的位置，
+     * 第一次调用 reflectionAttrs() 时才解析。
      */
-    // checked exceptions the method may throw.
-    std::vector<u2> checkedExceptions;
+    struct ReflectionAttrs {
+        std::vector<Parameter> parameters;
+
+        /*
+         * Each value in the exception_index_table array must be a valid index into
+         * the constant_pool table. The constant_pool entry at that index must be a
+         * CONSTANT_Class_info structure representing a class type that this
+         * method is declared to throw.
+         */
+        // checked exceptions the method may throw.
+        std::vector<u2> checkedExceptions;
 
-    std::vector<std::vector<Annotation>> rtVisiParaAnnos;   // runtime visible parameter annotations
-    std::vector<std::vector<Annotation>> rtInvisiParaAnnos; // runtime invisible parameter annotations
+        std::vector<std::vector<Annotation>> rtVisiParaAnnos;   // runtime visible parameter annotations
+        std::vector<std::vector<Annotation>> rtInvisiParaAnnos; // runtime invisible parameter annotations
 
-    std::vector<Annotation> rtVisiAnnos;   // runtime visible annotations
-    std::vector<Annotation> rtInvisiAnnos; // runtime invisible annotations
+        std::vector<Annotation> rtVisiAnnos;   // runtime visible annotations
+        std::vector<Annotation> rtInvisiAnnos; // runtime invisible annotations
+
+        ElementValue annotationDefault;
+    };
+
+    const ReflectionAttrs &reflectionAttrs();
 
-    ElementValue annotationDefault;
 private:
+    /*
+     * 方法的属性和 Code 属性中 code 之后的部分（异常处理表和 LineNumberTable 等），
+     * 在 class 文件中的位置。class 文件的字节在类的生命期内一直存在（code 也指向其中），
+     * 所以可以推迟到第一次用到时再解析。
+     */
+    u1 *attrs = nullptr;
+    size_t attrsLen = 0;
+    u2 attrCount = 0;
+    u1 *codeAttrs = nullptr; // 指向 exception_table_length
+    size_t codeAttrsLen = 0;
+
+    std::once_flag codeAttrsParsed;
+    std::once_flag reflectionAttrsParsed;
+    ReflectionAttrs *reflection = nullptr;
+
     void calArgsSlotsCount();
     void parseCodeAttr(BytecodeReader &r);
+    void setInvokeNativeStub();
+    void detectTrivial();
+
+    // 解析异常处理表和行号表
+    void parseCodeAttrs();
+    void parseReflectionAttrs();
 
 public:
     Method(Class *c, BytecodeReader &r);
 
+    // 改为调用预先编译的代码 @fn
+    void bindCompiledCode(native_method_t fn);
+
     /*
      * 判断此方法是否由 invokevirtual 指令调用，
      * final方法虽然非虚，但也由 invokevirtual 调用。
@@ -100,7 +164,7 @@ public:
      */
     bool isVirtual() const
     {
-        return !isPrivate() && !isStatic() && !utf8::equals(name, S(object_init));
+        return !isPrivate() && !isStatic() && name != S(object_init);
     }
 
     static u2 calArgsSlotsCount(const utf8_t *descriptor, bool isStatic);
@@ -115,7 +179,7 @@ public:
     Object *getType();
     Array *getExceptionTypes();
 
-    jint getLineNumber(int pc) const;
+    jint getLineNumber(int pc);
 
     /*
      * @pc, 发生异常的位置
@@ -160,12 +224,14 @@ private:
     };
 
     std::vector<ExceptionTable> exceptionTables;
+    std::vector<LineNumberTable> lineNumberTables;
 
 public:
     ~Method()
     {
         for (auto &t : exceptionTables)
             delete t.catchType;
+        delete reflection;
     }
 };
 
@@ -3,6 +3,7 @@
  */
 
 #include <sstream>
+#include <sched.h>
 #include "../symbol.h"
 #include "class_loader.h"
 #include "Object.h"
@@ -11,34 +12,228 @@
 #include "Array.h"
 #include "../interpreter/interpreter.h"
 #include "Prims.h"
+#include "../runtime/Thread.h"
+#include "../runtime/Monitor.h"
+#include "../runtime/alloc_profiler.h"
+#include "../runtime/suspend.h"
 
 using namespace std;
 using namespace utf8;
 
 Object::Object(Class *c): clazz(c)
 {
-    data = (slot_t *) (this + 1);
+}
+
+slot_t *Object::data() const
+{
+    assert(clazz != nullptr);
+    return (slot_t *) ((u1 *) this + clazz->instHeaderSize);
+}
+
+#define SHAPE_BIT   1
+#define COUNT_SHIFT 1
+#define COUNT_BITS  8
+#define COUNT_MASK  ((((uintptr_t) 1 << COUNT_BITS) - 1) << COUNT_SHIFT)
+#define TID_SHIFT   (COUNT_SHIFT + COUNT_BITS)
+#define TID_MASK    (~(uintptr_t) 0 << TID_SHIFT)
+
+#define THIN_LOCKED(thread) (((uintptr_t) (thread)->id) << TID_SHIFT)
+#define IS_INFLATED(lock_word) (((lock_word) & SHAPE_BIT) != 0)
+#define MONITOR_OF(lock_word) ((Monitor *) ((lock_word) & ~(uintptr_t) SHAPE_BIT))
+
+#define COUNT_OF(lock_word) ((int) (((lock_word) & COUNT_MASK) >> COUNT_SHIFT))
+#define OWNER_OF(lock_word) (Thread::fromId((u4) ((lock_word) >> TID_SHIFT)))
+
+// 竞争 thin lock 时自旋的次数，超过后将其膨胀
+#define THIN_LOCK_SPIN_COUNT 64
+
+bool Object::inflate(Thread *owner, uintptr_t expectedLockWord, int count)
+{
+    assert(owner != nullptr);
+    assert(!IS_INFLATED(expectedLockWord));
 
-    pthread_mutexattr_t attr;
-    pthread_mutexattr_init(&attr);
-    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE); // 同一线程可重入的锁
+    auto mon = new Monitor(owner, count);
+    if (__sync_bool_compare_and_swap(&lockWord, expectedLockWord, (uintptr_t) mon | SHAPE_BIT))
+        return true;
 
-    pthread_mutex_init(&mutex, &attr);
+    // 持有者已经释放或者重入了 thin lock，或者别的线程已经膨胀了
+    delete mon;
+    return false;
 }
 
 void Object::lock()
 {
-    pthread_mutex_lock(&mutex);
+    Thread *self = getCurrentThread();
+    const uintptr_t thinLocked = THIN_LOCKED(self);
+
+    for (int spin = 0; ; spin++) {
+        uintptr_t lw = lockWord;
+
+        if (lw == 0) {
+            // 未加锁，直接获取 thin lock
+            if (__sync_bool_compare_and_swap(&lockWord, 0, thinLocked))
+                return;
+            continue;
+        }
+
+        if (IS_INFLATED(lw)) {
+            MONITOR_OF(lw)->lock(self);
+            return;
+        }
+
+        if ((lw & TID_MASK) == thinLocked) {
+            // 重入，竞争者可能正在膨胀此锁，所以也要 CAS
+            if ((lw & COUNT_MASK) != COUNT_MASK) {
+                if (__sync_bool_compare_and_swap(&lockWord, lw, lw + ((uintptr_t) 1 << COUNT_SHIFT)))
+                    return;
+            } else {
+                // 重入次数溢出，膨胀后由 Monitor 记录重入次数
+                inflate(self, lw, COUNT_OF(lw));
+            }
+            continue;
+        }
+
+        /*
+         * 发生竞争。
+         * 先短暂自旋等待持有者释放 thin lock，仍未获得则代替持有者将其膨胀，
+         * 然后由 Monitor 负责自旋或阻塞。
+         */
+        if (spin < THIN_LOCK_SPIN_COUNT) {
+            sched_yield();
+        } else {
+            Thread *owner = OWNER_OF(lw);
+            assert(owner != nullptr);
+            inflate(owner, lw, COUNT_OF(lw));
+        }
+    }
+}
+
+bool Object::tryLock()
+{
+    Thread *self = getCurrentThread();
+    const uintptr_t thinLocked = THIN_LOCKED(self);
+
+    while (true) {
+        uintptr_t lw = lockWord;
+
+        if (lw == 0) {
+            if (__sync_bool_compare_and_swap(&lockWord, 0, thinLocked))
+                return true;
+        } else if (IS_INFLATED(lw)) {
+            return MONITOR_OF(lw)->tryLock(self);
+        } else if ((lw & TID_MASK) == thinLocked) {
+            if ((lw & COUNT_MASK) == COUNT_MASK)
+                inflate(self, lw, COUNT_OF(lw));
+            else if (__sync_bool_compare_and_swap(&lockWord, lw, lw + ((uintptr_t) 1 << COUNT_SHIFT)))
+                return true;
+        } else {
+            return false;
+        }
+    }
 }
 
 void Object::unlock()
 {
-    pthread_mutex_unlock(&mutex);
+    Thread *self = getCurrentThread();
+    const uintptr_t thinLocked = THIN_LOCKED(self);
+
+    while (true) {
+        uintptr_t lw = lockWord;
+
+        if (IS_INFLATED(lw)) {
+            if (!MONITOR_OF(lw)->unlock(self))
+                thread_throw(new IllegalMonitorStateException);
+            return;
+        }
+
+        if ((lw & TID_MASK) != thinLocked or lw == 0) {
+            // 当前线程并未持有此锁
+            thread_throw(new IllegalMonitorStateException);
+        }
+
+        // 重入次数减一，或者释放锁
+        uintptr_t newLw = (lw & COUNT_MASK) != 0 ? lw - ((uintptr_t) 1 << COUNT_SHIFT) : 0;
+        // 保证临界区中的写操作在释放锁之前完成
+        __sync_synchronize();
+        if (__sync_bool_compare_and_swap(&lockWord, lw, newLw))
+            return;
+        // 失败说明竞争者将其膨胀了，重试
+    }
+}
+
+bool Object::isLockedBy(Thread *thread) const
+{
+    assert(thread != nullptr);
+
+    uintptr_t lw = lockWord;
+    if (IS_INFLATED(lw))
+        return MONITOR_OF(lw)->isOwner(thread);
+    return lw != 0 and (lw & TID_MASK) == THIN_LOCKED(thread);
+}
+
+void Object::wait(jlong ms, jint ns)
+{
+    Thread *self = getCurrentThread();
+
+    while (true) {
+        uintptr_t lw = lockWord;
+
+        if (IS_INFLATED(lw)) {
+            if (!MONITOR_OF(lw)->timedwait(self, ms, ns))
+                thread_throw(new IllegalMonitorStateException);
+            return;
+        }
+
+        if (lw == 0 or (lw & TID_MASK) != THIN_LOCKED(self))
+            thread_throw(new IllegalMonitorStateException);
+
+        // wait 需要 wait set，先膨胀
+        inflate(self, lw, COUNT_OF(lw));
+    }
+}
+
+void Object::notify()
+{
+    Thread *self = getCurrentThread();
+    uintptr_t lw = lockWord;
+
+    if (IS_INFLATED(lw)) {
+        if (!MONITOR_OF(lw)->notify(self))
+            thread_throw(new IllegalMonitorStateException);
+    } else if (lw == 0 or (lw & TID_MASK) != THIN_LOCKED(self)) {
+        thread_throw(new IllegalMonitorStateException);
+    }
+    // 未膨胀的锁上不可能有线程在 wait
+}
+
+void Object::notifyAll()
+{
+    Thread *self = getCurrentThread();
+    uintptr_t lw = lockWord;
+
+    if (IS_INFLATED(lw)) {
+        if (!MONITOR_OF(lw)->notifyAll(self))
+            thread_throw(new IllegalMonitorStateException);
+    } else if (lw == 0 or (lw & TID_MASK) != THIN_LOCKED(self)) {
+        thread_throw(new IllegalMonitorStateException);
+    }
+}
+
+void Object::releaseMonitor()
+{
+    uintptr_t lw = lockWord;
+    if (IS_INFLATED(lw)) {
+        delete MONITOR_OF(lw);
+    }
+    lockWord = 0;
 }
 
 Object *Object::newObject(Class *c)
 {
-    size_t size = sizeof(Object) + c->instFieldsCount * sizeof(slot_t);
+    size_t size = OBJECT_ALIGN_UP(c->instSize);
+    profileAllocation(c, size);
+    // 对象头初始化之前不能被 gc 看到，参见 runtime/suspend.h
+    NoSuspendScope scope;
     return new(g_heap.allocObject(size)) Object(c);
 }
 
@@ -52,7 +247,7 @@ Object *Object::newString(const utf8_t *str)
 
     // set java/lang/String 的 value 变量赋值
     Array *value = newArray(loadBootClass(S(array_C) /* [C */ ), len);
-    toUnicode(str, (unicode_t *) (value->data));
+    toUnicode(str, (unicode_t *) (value->data()));
     strobj->setFieldValue(S(value), S(array_C), (slot_t) value);
 
     return strobj;
@@ -61,7 +256,11 @@ Object *Object::newString(const utf8_t *str)
 Object *Object::clone() const
 {
     size_t s = size();
-    return (Object *) memcpy(g_heap.allocObject(s), this, s);
+    profileAllocation(clazz, s);
+    NoSuspendScope scope;
+    auto o = (Object *) memcpy(g_heap.allocObject(s), this, s);
+    o->lockWord = 0; // 复制出来的对象未加锁
+    return o;
 }
 
 void Object::setFieldValue(Field *f, slot_t v)
@@ -70,10 +269,11 @@ void Object::setFieldValue(Field *f, slot_t v)
     assert(!f->isStatic());
 
     if (!f->categoryTwo) {
-        data[f->id] = v;
+        setFieldValue(f, &v);
     } else { // categoryTwo
-        data[f->id] = 0; // 高字节清零
-        data[f->id + 1] = v; // 低字节存值
+        assert(f->descriptor[0] == 'J');
+        auto addr = (u1 *) this + f->offset;
+        *(jlong *) addr = (jlong) v;
     }
 }
 
@@ -81,9 +281,33 @@ void Object::setFieldValue(Field *f, const slot_t *value)
 {
     assert(f != nullptr && !f->isStatic() && value != nullptr);
 
-    data[f->id] = value[0];
-    if (f->categoryTwo) {
-        data[f->id + 1] = value[1];
+    auto addr = (u1 *) this + f->offset;
+    switch (f->descriptor[0]) {
+        case 'Z':
+        case 'B':
+            *(jbyte *) addr = (jbyte) ISLOT(value);
+            break;
+        case 'C':
+            *(jchar *) addr = (jchar) ISLOT(value);
+            break;
+        case 'S':
+            *(jshort *) addr = (jshort) ISLOT(value);
+            break;
+        case 'I':
+            *(jint *) addr = ISLOT(value);
+            break;
+        case 'F':
+            *(jfloat *) addr = FSLOT(value);
+            break;
+        case 'J':
+            *(jlong *) addr = LSLOT(value);
+            break;
+        case 'D':
+            *(jdouble *) addr = DSLOT(value);
+            break;
+        default: // reference
+            *(jref *) addr = RSLOT(value);
+            break;
     }
 }
 
@@ -99,29 +323,47 @@ void Object::setFieldValue(const char *name, const char *descriptor, const slot_
     setFieldValue(clazz->lookupInstField(name, descriptor), value);
 }
 
-void Object::setFieldValue(int id, jref value)
+void Object::getFieldValue(Field *f, slot_t *value) const
 {
-    Field *f = clazz->getDeclaredInstField(id);
+    assert(f != nullptr && !f->isStatic() && value != nullptr);
 
-    if (value == jnull) {
-        data[id] = (slot_t) jnull;
-    } else if (f->isPrim()) {
-        const slot_t *unbox = value->unbox();
-        data[id] = *unbox;
-        if (f->categoryTwo)
-            data[id+1] = *++unbox;
-    } else {
-        data[id] = (slot_t) value;
+    auto addr = (const u1 *) this + f->offset;
+    switch (f->descriptor[0]) {
+        case 'Z':
+        case 'B':
+            ISLOT(value) = *(const jbyte *) addr;
+            break;
+        case 'C':
+            ISLOT(value) = *(const jchar *) addr;
+            break;
+        case 'S':
+            ISLOT(value) = *(const jshort *) addr;
+            break;
+        case 'I':
+            ISLOT(value) = *(const jint *) addr;
+            break;
+        case 'F':
+            FSLOT(value) = *(const jfloat *) addr;
+            break;
+        case 'J':
+            LSLOT(value) = *(const jlong *) addr;
+            break;
+        case 'D':
+            DSLOT(value) = *(const jdouble *) addr;
+            break;
+        default: // reference
+            RSLOT(value) = *(const jref *) addr;
+            break;
     }
 }
 
-const slot_t *Object::getInstFieldValue0(const char *name, const char *descriptor) const
+const void *Object::getInstFieldValue0(const char *name, const char *descriptor) const
 {
     assert(name != nullptr && descriptor != nullptr);
 
     Field *f = clazz->lookupField(name, descriptor);
     assert(f != nullptr);
-    return data + f->id;
+    return (const u1 *) this + f->offset;
 }
 
 bool Object::isInstanceOf(Class *c) const
@@ -131,7 +373,7 @@ bool Object::isInstanceOf(Class *c) const
     return clazz->isSubclassOf(c);
 }
 
-const slot_t *Object::unbox() const
+void Object::unbox(slot_t *value) const
 {
     if (!clazz->isPrimClass()) {
         jvm_abort(""); // todo
@@ -142,18 +384,22 @@ const slot_t *Object::unbox() const
     if (f == nullptr) {
         jvm_abort("error, %s, %s\n", S(value), clazz->className); // todo
     }
-    return data + f->id;
+    getFieldValue(f, value);
 }
 
 size_t Object::size() const
 {
     assert(clazz != nullptr);
-    return sizeof(*this) + clazz->instFieldsCount * sizeof(slot_t);
+    if (clazz->isArrayClass()) {
+        auto arr = (const Array *) this;
+        return OBJECT_ALIGN_UP(clazz->instHeaderSize + clazz->getEleSize()*arr->len);
+    }
+    return OBJECT_ALIGN_UP(clazz->instSize);
 }
 
 bool Object::isArrayObject() const
 {
-    return clazz->className[0] == '[';
+    return clazz->isArrayClass();
 }
 
 utf8_t *Object::toUtf8() const
@@ -163,13 +409,16 @@ utf8_t *Object::toUtf8() const
     assert(clazz == stringClass);
 
     auto value = getInstFieldValue<Array *>(S(value), S(array_C));
-    return unicode::toUtf8((const unicode_t *) (value->data), value->len);
+    return unicode::toUtf8((const unicode_t *) (value->data()), value->len);
 }
 
 string Object::toString() const
 {
     ostringstream os;
-    os << "Object(" << this << "), " << clazz->className;
+    if (isArrayObject())
+        os << "Array(" << this << "), " << clazz->className << ", len = " << ((const Array *) this)->len;
+    else
+        os << "Object(" << this << "), " << clazz->className;
     return os.str();
 }
 
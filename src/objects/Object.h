@@ -11,49 +11,100 @@
 #include "Field.h"
 
 class Class;
+class Thread;
 
+// 对象的大小按8字节对齐，保证每个对象的起始地址都是8字节对齐的
+#define OBJECT_ALIGN_UP(size) (((size) + 7) & ~((size_t) 7))
+
+/*
+ * 对象头只有两个字：lock word 和 class pointer，没有虚函数表指针。
+ * 对象的类型相关的操作（大小，是否是数组等）都通过 clazz 来分派。
+ *
+ * 普通对象的布局：
+ * |lockWord|clazz|实例变量...|
+ *
+ * 数组对象的布局，参见 Array.h:
+ * |lockWord|clazz|len|(padding)|数组元素...|
+ *
+ * java/lang/Class 对象（即 Class）的实例变量放在 Class 的 C++ 成员之后。
+ */
 class Object {
+    /*
+     * 对象锁（thin lock），绝大多数对象从不加锁，或者只被一个线程加锁，
+     * 所以只在发生竞争时才膨胀为 Monitor。
+     *
+     * thin lock（最低位为0）:
+     * |    owner thread id    | count(8 bits) | 0 |
+     * 值为 0 表示未加锁，count 为重入的次数。
+     *
+     * inflated lock（最低位为1）:
+     * |            Monitor *                  | 1 |
+     */
+    volatile uintptr_t lockWord = 0;
+
 public:
-    // 对象头，放在Object类的最开始处
-    union {
-        struct {
-            unsigned int marked: 2;
-        };
-        uintptr_t allFlags; // 以指针的大小对齐 todo 这样对齐有什么用
-    };
+    Class *clazz;
 
 private:
-    pthread_mutex_t mutex; // 同一线程可重入的锁
+    /*
+     * 将 @owner 持有的 thin lock 膨胀为 Monitor，Monitor 直接由 @owner 持有。
+     * 竞争者可以代替持有者膨胀，所以需要 CAS，
+     * 如果 lockWord 已不是 @expectedLockWord，返回 false.
+     */
+    bool inflate(Thread *owner, uintptr_t expectedLockWord, int count);
 public:
     void lock();
+    bool tryLock();
     void unlock();
 
+    bool isLockedBy(Thread *thread) const;
+
+    /*
+     * Object.wait/notify/notifyAll 的实现，
+     * 当前线程未持有此对象的锁时抛出 IllegalMonitorStateException.
+     * ms == 0 and ns == 0 表示不超时。
+     */
+    void wait(jlong ms = 0, jint ns = 0);
+    void notify();
+    void notifyAll();
+
+    // 对象被回收时（Class 对象在其 class loader 被卸载时）调用，释放膨胀出的 Monitor
+    void releaseMonitor();
+
 protected:
     explicit Object(Class *c);
 
 public:
-    // 保存所有实例变量的值
-    // 包括此Object中定义的和继承来的。
-    // 特殊的，对于数组对象，保存数组的值
-    slot_t *data;
-    Class *clazz;
+    /*
+     * 实例数据（实例变量，对于数组对象则是数组的值）的起始地址，
+     * 紧跟在对象头之后，由 clazz 记录的对象头大小计算得出。
+     * 实例变量按字节偏移访问，参见 Field::offset.
+     */
+    slot_t *data() const;
 
     static Object *newObject(Class *c);
     static Object *newString(const utf8_t *str);
 
-    virtual size_t size() const;
+    size_t size() const;
 
-    virtual bool isArrayObject() const;
+    bool isArrayObject() const;
     Object *clone() const;
 
-    void setFieldValue(Field *f, slot_t v); // only for category one field
+    /*
+     * 实例变量按其类型紧凑地存放在对象中（参见 Class::layoutFields()），
+     * 而操作数栈等处以 slot 的格式存放（long 和 double 占两个 slot），
+     * 以下函数在两种格式之间转换。
+     */
+    void setFieldValue(Field *f, slot_t v); // 对于 long 类型的 field，@v 为其值
     void setFieldValue(Field *f, const slot_t *value);
-    void setFieldValue(const char *name, const char *descriptor, slot_t v); // only for category one field
+    void setFieldValue(const char *name, const char *descriptor, slot_t v);
     void setFieldValue(const char *name, const char *descriptor, const slot_t *value);
-    void setFieldValue(int id, jref value);
+
+    // 将实例变量的值以 slot 的格式写入 @value
+    void getFieldValue(Field *f, slot_t *value) const;
 
 private:
-    const slot_t *getInstFieldValue0(const char *name, const char *descriptor) const;
+    const void *getInstFieldValue0(const char *name, const char *descriptor) const;
 public:
     template <typename T>
     T getInstFieldValue(const char *name, const char *descriptor) const
@@ -65,15 +116,15 @@ public:
     T getInstFieldValue(const Field *f) const
     {
         assert(f != nullptr);
-        return * (T *) (data + f->id);
+        return * (T *) ((const u1 *) this + f->offset);
     }
 
     bool isInstanceOf(Class *c) const;
 
-    const slot_t *unbox() const; // present only if primitive Object
+    void unbox(slot_t *value) const; // present only if primitive Object
     utf8_t *toUtf8() const;       // present only if String Object
 
-    virtual std::string toString() const;
+    std::string toString() const;
 };
 
 static inline Object *newObject(Class *c)
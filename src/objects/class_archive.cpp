@@ -0,0 +1,405 @@
+/*
+ * Author: kayo
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "class_archive.h"
+#include "class_loader.h"
+#include "Class.h"
+#include "Prims.h"
+#include "ConstantPool.h"
+#include "../kayo.h"
+#include "../util/JarFile.h"
+
+using namespace std;
+
+#define ARCHIVE_MAGIC "KAYOCDS"
+#define ARCHIVE_VERSION 2
+#define ARCHIVE_DEFAULT_NAME "kayovm.jsa"
+
+ShareMode shareMode = SHARE_AUTO;
+char sharedArchiveFile[PATH_MAX] = { 0 };
+
+/*
+ * 档案的布局：
+ *   ArchiveHeader
+ *   ArchivedJar[jarCount]     启动类路径上的 jar，顺序与 jreLibJars 相同
+ *   ArchivedClass[classCount] 按类名排序
+ *   字符串区（以'\0'结尾，同时是解析后的常量池中 CONSTANT_Utf8 的内容）
+ *   每个类的 class 文件（8字节对齐），解析后的常量池的 info（slot_t[cpCount]，8字节对齐）和 type（u1[cpCount]）
+ * 所有的 offset 都相对于档案的开头。
+ *
+ * 常量池的 info 与 ConstantPool::parse 的结果相同，只是 CONSTANT_Utf8 的 info 是字符串的 offset，
+ * 定义类时换成 utf8 池中的规范字符串。
+ */
+struct ArchiveHeader {
+    char magic[8];
+    u4 version;
+    u4 jarCount;
+    u4 classCount;
+    u4 vmVersionOffset;
+    u4 slotSize;        // sizeof(slot_t)，常量池的 info 与之相关
+    u4 pad;
+    u8 archiveSize;
+};
+
+struct ArchivedJar {
+    u4 pathOffset;
+    u4 pad;
+    u8 size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+};
+
+struct ArchivedClass {
+    u4 nameOffset;
+    u4 dataOffset;
+    u4 dataLen;
+    u4 cpCount;       // 同 constant_pool_count
+    u4 cpEnd;         // 常量池之后的第一个字节在 class 文件中的位置
+    u4 cpInfoOffset;
+    u4 cpTypeOffset;
+    u4 pad;
+};
+
+static char archiveFile[PATH_MAX];
+
+static u1 *archive = nullptr;
+static const ArchiveHeader *header = nullptr;
+static const ArchivedClass *classes = nullptr;
+
+static bool statJar(const string &path, struct stat &st)
+{
+    return stat(path.c_str(), &st) == 0;
+}
+
+static inline const char *str(u4 offset)
+{
+    return (const char *) archive + offset;
+}
+
+// 从 @offset 开始到档案结尾之间有 '\0'，即 str(@offset) 不会越界
+static inline bool validString(u4 offset, size_t size)
+{
+    return offset < size and memchr(archive + offset, 0, size - offset) != nullptr;
+}
+
+/*
+ * 档案有效返回 nullptr，否则返回原因。
+ * 档案文件可能被截断或损坏，所有的 offset 都要先检查不越界再使用。
+ */
+static const char *validate(size_t size)
+{
+    if (size < sizeof(ArchiveHeader) or memcmp(header->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0)
+        return "bad magic";
+    if (header->version != ARCHIVE_VERSION or header->archiveSize != size)
+        return "version or size mismatch";
+
+    u8 tablesEnd = sizeof(ArchiveHeader) + (u8) sizeof(ArchivedJar)*header->jarCount
+                   + (u8) sizeof(ArchivedClass)*header->classCount;
+    if (tablesEnd > size)
+        return "truncated";
+    if (!validString(header->vmVersionOffset, size))
+        return "corrupted";
+    if (strcmp(str(header->vmVersionOffset), VM_VERSION) != 0 or header->slotSize != sizeof(slot_t))
+        return "created by a different VM";
+
+    auto jars = (const ArchivedJar *) (header + 1);
+    for (u4 i = 0; i < header->jarCount; i++) {
+        if (!validString(jars[i].pathOffset, size))
+            return "corrupted";
+    }
+    auto table = (const ArchivedClass *) (jars + header->jarCount);
+    for (u4 i = 0; i < header->classCount; i++) {
+        const ArchivedClass &c = table[i];
+        if (!validString(c.nameOffset, size)
+            or c.dataOffset < tablesEnd or (u8) c.dataOffset + c.dataLen > size
+            or (i > 0 and c.dataOffset <= table[i - 1].dataOffset)  // 参见 restoreArchivedConstantPool
+            or c.cpCount == 0 or c.cpCount > 0xffff or c.cpEnd > c.dataLen
+            or c.cpInfoOffset < tablesEnd or c.cpInfoOffset % sizeof(slot_t) != 0 or (u8) c.cpInfoOffset + (u8) sizeof(slot_t)*c.cpCount > size
+            or c.cpTypeOffset < tablesEnd or (u8) c.cpTypeOffset + c.cpCount > size)
+            return "corrupted";
+    }
+
+    // 启动类路径上的 jar 必须与生成档案时完全相同
+    if (header->jarCount != jreLibJars.size())
+        return "boot class path mismatch";
+    for (u4 i = 0; i < header->jarCount; i++) {
+        struct stat st;
+        if (jreLibJars[i] != str(jars[i].pathOffset) or !statJar(jreLibJars[i], st))
+            return "boot class path mismatch";
+        if ((u8) st.st_size != jars[i].size
+            or st.st_mtim.tv_sec != jars[i].mtimeSec or st.st_mtim.tv_nsec != jars[i].mtimeNsec)
+            return "jar has been modified";
+    }
+    return nullptr;
+}
+
+void initClassArchive(const char *bootClassPath)
+{
+    if (sharedArchiveFile[0] != 0)
+        snprintf(archiveFile, sizeof(archiveFile), "%s", sharedArchiveFile);
+    else
+        snprintf(archiveFile, sizeof(archiveFile), "%s/%s", bootClassPath, ARCHIVE_DEFAULT_NAME);
+
+    if (shareMode != SHARE_AUTO and shareMode != SHARE_ON)
+        return;
+
+    const char *path = archiveFile;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (shareMode == SHARE_ON)
+            jvm_abort("Unable to use shared archive: can't open %s\n", path);
+        return;
+    }
+
+    struct stat st;
+    void *mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 and st.st_size > 0) {
+        // 私有可写的映射：解释器会改写方法的字节码，写时复制不会影响档案文件
+        mem = mmap(nullptr, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mem == MAP_FAILED) {
+        if (shareMode == SHARE_ON)
+            jvm_abort("Unable to use shared archive: can't map %s\n", path);
+        return;
+    }
+
+    archive = (u1 *) mem;
+    header = (const ArchiveHeader *) archive;
+    const char *reason = validate((size_t) st.st_size);
+    if (reason != nullptr) {
+        munmap(mem, (size_t) st.st_size);
+        archive = nullptr;
+        header = nullptr;
+        if (shareMode == SHARE_ON)
+            jvm_abort("Unable to use shared archive %s: %s\n", path, reason);
+        return;
+    }
+    classes = (const ArchivedClass *) ((const ArchivedJar *) (header + 1) + header->jarCount);
+}
+
+u1 *findArchivedClass(const utf8_t *name, size_t &len)
+{
+    if (archive == nullptr)
+        return nullptr;
+
+    // classes 按类名排序，二分查找
+    auto end = classes + header->classCount;
+    auto iter = lower_bound(classes, end, name, [](const ArchivedClass &c, const utf8_t *name) {
+        return strcmp(str(c.nameOffset), name) < 0;
+    });
+    if (iter == end or strcmp(str(iter->nameOffset), name) != 0)
+        return nullptr;
+
+    len = iter->dataLen;
+    return archive + iter->dataOffset;
+}
+
+bool restoreArchivedConstantPool(const u1 *bytecode, ConstantPool &cp, BytecodeReader &r)
+{
+    if (archive == nullptr or bytecode < archive or bytecode >= archive + header->archiveSize)
+        return false;
+
+    // classes 按类名排序，class 文件也按这个顺序存放，所以 dataOffset 是递增的
+    auto offset = (u4) (bytecode - archive);
+    auto end = classes + header->classCount;
+    auto c = lower_bound(classes, end, offset, [](const ArchivedClass &c, u4 offset) {
+        return c.dataOffset < offset;
+    });
+    if (c == end or c->dataOffset != offset or c->cpCount != cp.size)
+        return false;
+
+    const u1 *types = archive + c->cpTypeOffset;
+    auto info = (const slot_t *) (archive + c->cpInfoOffset);
+    // 档案损坏时退回去解析 class 文件
+    for (u4 i = 1; i < c->cpCount; i++) {
+        if (types[i] == CONSTANT_Utf8 and !validString((u4) info[i], header->archiveSize))
+            return false;
+    }
+
+    memcpy(cp._type + 1, types + 1, c->cpCount - 1);
+    memcpy(cp._info + 1, info + 1, sizeof(slot_t)*(c->cpCount - 1));
+    for (u4 i = 1; i < c->cpCount; i++) {
+        // 档案一直映射着，池中还没有的字符串直接使用档案中的，不用复制
+        if (types[i] == CONSTANT_Utf8)
+            cp._info[i] = (slot_t) utf8::save(str((u4) info[i]));
+    }
+    r.pc = c->cpEnd;
+    return true;
+}
+
+/* ---------------------------- dump ---------------------------- */
+
+static const JarFile::Entry *findInBootJars(const utf8_t *className, JarFile *&jar)
+{
+    string name = string(className) + ".class";
+    for (auto &path : jreLibJars) {
+        jar = openJar(path.c_str());
+        if (jar == nullptr)
+            continue;
+        const JarFile::Entry *e = jar->find(name.c_str());
+        if (e != nullptr)
+            return e;
+    }
+    return nullptr;
+}
+
+/*
+ * 解析 class 文件 @bytecode 的常量池，结果写入 @types 和 @info，
+ * CONSTANT_Utf8 的 info 是 @addString 返回的 offset. 常量池之后的位置写入 @c.cpEnd.
+ * 这些类都已经成功加载过，class 文件不会有错误。
+ */
+static void parseConstantPool(vector<u1> &bytecode, ArchivedClass &c, vector<u1> &types, vector<slot_t> &info,
+                              const function<u4(const char *)> &addString)
+{
+    BytecodeReader r(bytecode.data(), bytecode.size());
+    r.skip(8); // magic, minor_version, major_version
+    c.cpCount = r.readu2();
+    types.assign(c.cpCount, CONSTANT_Invalid);
+    info.assign(c.cpCount, 0);
+
+    ConstantPool cp;
+    cp.size = (u2) c.cpCount;
+    cp._type = types.data();
+    cp._info = info.data();
+    cp.parse(r, [&addString](const char *utf8) { return (slot_t) addString(utf8); });
+    c.cpEnd = (u4) r.pc;
+}
+
+bool dumpClassArchive()
+{
+    const char *path = archiveFile;
+
+    // 收集 boot class loader 从 jar 中加载的类，数组类和基本类型类由虚拟机生成，不需要保存
+    vector<const utf8_t *> names;
+    for (Class *c : getAllClasses()) {
+        if (c->loader == bootClassLoader and !c->isArrayClass() and !c->isPrimClass())
+            names.push_back(c->className);
+    }
+    sort(names.begin(), names.end(), [](const utf8_t *a, const utf8_t *b) { return strcmp(a, b) < 0; });
+
+    // 计算布局
+    string strings;
+    unordered_map<string, u4> stringOffsets;
+    function<u4(const char *)> addString = [&strings, &stringOffsets](const char *s) {
+        auto iter = stringOffsets.emplace(s, (u4) strings.size());
+        if (iter.second)
+            strings.append(s).push_back('\0');
+        return iter.first->second;
+    };
+
+    ArchiveHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    h.version = ARCHIVE_VERSION;
+    h.jarCount = (u4) jreLibJars.size();
+    h.classCount = (u4) names.size();
+    h.slotSize = sizeof(slot_t);
+
+    size_t tablesEnd = sizeof(ArchiveHeader) + sizeof(ArchivedJar)*h.jarCount + sizeof(ArchivedClass)*h.classCount;
+
+    vector<ArchivedJar> jars(h.jarCount);
+    for (u4 i = 0; i < h.jarCount; i++) {
+        struct stat st;
+        if (!statJar(jreLibJars[i], st)) {
+            printvm("Unable to stat %s\n", jreLibJars[i].c_str());
+            return false;
+        }
+        jars[i].pathOffset = addString(jreLibJars[i].c_str());
+        jars[i].pad = 0;
+        jars[i].size = (u8) st.st_size;
+        jars[i].mtimeSec = st.st_mtim.tv_sec;
+        jars[i].mtimeNsec = st.st_mtim.tv_nsec;
+    }
+    h.vmVersionOffset = addString(VM_VERSION);
+
+    vector<ArchivedClass> table(h.classCount);
+    vector<vector<u1>> bytecodes(h.classCount);
+    vector<vector<u1>> cpTypes(h.classCount);
+    vector<vector<slot_t>> cpInfos(h.classCount);
+    for (u4 i = 0; i < h.classCount; i++) {
+        JarFile *jar;
+        const JarFile::Entry *e = findInBootJars(names[i], jar);
+        if (e == nullptr) {
+            printvm("Unable to find class in boot class path: %s\n", names[i]);
+            return false;
+        }
+        // 从 jar 重新读取：已加载的类的字节码被解释器改写过，而 jar 的映射是只读的，与文件一致
+        bytecodes[i].resize(e->uncompressedSize);
+        if (!jar->read(e, bytecodes[i].data())) {
+            printvm("Unable to read class %s from %s\n", names[i], jar->getPath());
+            return false;
+        }
+        memset(&table[i], 0, sizeof(ArchivedClass));
+        table[i].nameOffset = addString(names[i]);
+        table[i].dataLen = e->uncompressedSize;
+        parseConstantPool(bytecodes[i], table[i], cpTypes[i], cpInfos[i], addString);
+    }
+
+    size_t offset = tablesEnd + strings.size();
+    for (auto &c : table) {
+        offset = (offset + 7) & ~(size_t) 7;
+        c.dataOffset = (u4) offset;
+        offset += c.dataLen;
+        offset = (offset + 7) & ~(size_t) 7;
+        c.cpInfoOffset = (u4) offset;
+        offset += sizeof(slot_t)*c.cpCount;
+        c.cpTypeOffset = (u4) offset;
+        offset += c.cpCount;
+    }
+    h.archiveSize = offset;
+
+    for (auto &j : jars)
+        j.pathOffset += tablesEnd;
+    for (u4 i = 0; i < h.classCount; i++) {
+        table[i].nameOffset += tablesEnd;
+        for (u4 j = 1; j < table[i].cpCount; j++) {
+            if (cpTypes[i][j] == CONSTANT_Utf8)
+                cpInfos[i][j] += tablesEnd;
+        }
+    }
+    h.vmVersionOffset += tablesEnd;
+
+    // 写入
+    unique_ptr<u1[]> buf(new u1[h.archiveSize]());
+    u1 *p = buf.get();
+    memcpy(p, &h, sizeof(h));
+    memcpy(p + sizeof(h), jars.data(), sizeof(ArchivedJar)*h.jarCount);
+    memcpy(p + sizeof(h) + sizeof(ArchivedJar)*h.jarCount, table.data(), sizeof(ArchivedClass)*h.classCount);
+    memcpy(p + tablesEnd, strings.data(), strings.size());
+    for (u4 i = 0; i < h.classCount; i++) {
+        memcpy(p + table[i].dataOffset, bytecodes[i].data(), table[i].dataLen);
+        memcpy(p + table[i].cpInfoOffset, cpInfos[i].data(), sizeof(slot_t)*table[i].cpCount);
+        memcpy(p + table[i].cpTypeOffset, cpTypes[i].data(), table[i].cpCount);
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == nullptr) {
+        printvm("Unable to create shared archive file %s\n", path);
+        return false;
+    }
+    bool ok = fwrite(p, 1, h.archiveSize, fp) == h.archiveSize;
+    ok = (fclose(fp) == 0) and ok;
+    if (!ok) {
+        printvm("Unable to write shared archive file %s\n", path);
+        unlink(path);
+        return false;
+    }
+
+    printvm("Dumped %u classes to shared archive file %s (%llu bytes)\n",
+            h.classCount, path, (unsigned long long) h.archiveSize);
+    return true;
+}
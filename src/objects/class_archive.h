@@ -0,0 +1,66 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_CLASS_ARCHIVE_H
+#define KAYOVM_CLASS_ARCHIVE_H
+
+#include "../jtypes.h"
+
+struct ConstantPool;
+class BytecodeReader;
+
+/*
+ * 类数据共享（class data sharing）档案。
+ *
+ * -Xshare:dump 在虚拟机启动之后，把 boot class loader 从 jar 中加载的所有类
+ * 解压后的 class 文件和解析后的常量池写入档案，同时记录启动类路径上每个 jar 的大小和修改时间。
+ * 之后的运行把档案 mmap 进来（MAP_PRIVATE），校验 jar 没有变化后，
+ * loadBootClass 直接用档案中的字节定义类，不再查找 jar 和解压，
+ * 常量池直接从档案中复制，其中的字符串直接使用档案中的，不再逐项解析和复制。
+ *
+ * 档案中只有偏移，没有指针，可以映射在任意地址。
+ *
+ * 字段和方法表，vtable 等其他元数据不在档案中，每次运行仍然重新解析：
+ * 它们有大量指向 Metaspace 和其他类的指针，共享它们需要整个元数据可重定位。
+ */
+
+enum ShareMode {
+    SHARE_OFF,  // 不使用档案
+    SHARE_AUTO, // 档案存在且有效时使用（默认）
+    SHARE_ON,   // 必须使用档案，否则退出
+    SHARE_DUMP  // 生成档案后退出
+};
+
+// -Xshare:off|auto|on|dump
+extern ShareMode shareMode;
+
+// -XX:SharedArchiveFile=<path>，为空时使用启动类路径下的 kayovm.jsa
+extern char sharedArchiveFile[];
+
+/*
+ * 按 shareMode 映射并校验档案，需要在加载任何 boot class 之前调用。
+ * @bootClassPath: 启动类路径，用来确定档案的默认位置
+ */
+void initClassArchive(const char *bootClassPath);
+
+/*
+ * 在档案中查找类 @name，找到时返回 class 文件的字节（可写，不需要拷贝）
+ * 并将其长度写入 @len，否则返回 nullptr.
+ */
+u1 *findArchivedClass(const utf8_t *name, size_t &len);
+
+/*
+ * @bytecode 是 findArchivedClass 返回的 class 文件时，用档案中解析好的常量池填充 @cp
+ * （@cp 已按 constant_pool_count 分配好），并把 @r 移到常量池之后，返回 true.
+ * 否则（或者档案中的常量池损坏）什么也不做，返回 false，由调用者解析 class 文件。
+ */
+bool restoreArchivedConstantPool(const u1 *bytecode, ConstantPool &cp, BytecodeReader &r);
+
+/*
+ * 把当前 boot class loader 从 jar 中加载的类写入档案。
+ * 成功返回 true.
+ */
+bool dumpClassArchive();
+
+#endif //KAYOVM_CLASS_ARCHIVE_H
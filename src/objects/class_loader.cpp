@@ -2,8 +2,11 @@
  * Author: kayo
  */
 
+#include <mutex>
+#include <atomic>
 #include <memory>
 #include <sstream>
+#include <algorithm>
 #include <unordered_set>
 #include <unordered_map>
 #include "class_loader.h"
@@ -11,9 +14,15 @@
 #include "Class.h"
 #include "Array.h"
 #include "../interpreter/interpreter.h"
-#include "../../zlib/minizip/unzip.h"
+#include "../util/JarFile.h"
+#include "class_archive.h"
+#include "class_prefetcher.h"
+#include "user_class_path.h"
+#include "ClassDictionary.h"
 #include "../runtime/Thread.h"
 #include "Prims.h"
+#include "../memory/Metaspace.h"
+#include "../runtime/alloc_profiler.h"
 
 using namespace std;
 using namespace utf8;
@@ -25,62 +34,70 @@ using namespace utf8;
 #define TRACE(...)
 #endif
 
-using class_map = unordered_map<const utf8_t *, Class *, utf8::Hash, utf8::Comparator>;
-
+static mutex bootPackagesMutex;
 static utf8_set bootPackages;
-static class_map bootClasses;
+static ClassDictionary bootClasses;
 
-// 保存每个class loader（不包括 boot class loader）的 classes
-// pair.first: class loader
-// pair.second: the classes loaded by @key class loader.
-static vector<pair<Object *, class_map>> classes;
+static Metaspace bootMetaspace;
 
-static unique_ptr<pair<u1 *, size_t>> read_class_from_jar(const char *jar_path, const char *class_name)
+LoaderData::LoaderData(Object *loader): loader(loader), metaspace(new Metaspace)
 {
-    unzFile jar_file = unzOpen64(jar_path);
-    if (jar_file == nullptr) {
-        thread_throw(new IOException(NEW_MSG("unzOpen64 failed: %s\n", jar_path)));
-    }
+}
+
+// class loader -> LoaderData，查找无锁
+static ConcurrentTable<LoaderData, LoaderData::Traits> loaders(16);
+
+ConcurrentTable<LoaderData, LoaderData::Traits> &getLoaderTable()
+{
+    return loaders;
+}
+
+static LoaderData *getLoaderData(Object *classLoader)
+{
+    assert(classLoader != bootClassLoader);
+    return loaders.findOrCreate(classLoader, [=] { return new LoaderData(classLoader); });
+}
+
+Metaspace *getMetaspace(Object *classLoader)
+{
+    if (classLoader == bootClassLoader)
+        return &bootMetaspace;
+    return getLoaderData(classLoader)->metaspace;
+}
 
-    if (unzGoToFirstFile(jar_file) != UNZ_OK) {
-        unzClose(jar_file);
-        thread_throw(new IOException(NEW_MSG("unzGoToFirstFile failed: %s\n", jar_path)));
+static unique_ptr<pair<u1 *, size_t>> read_class_from_jar(const char *jar_path, const char *class_name)
+{
+    JarFile *jar = openJar(jar_path);
+    if (jar == nullptr) {
+        thread_throw(new IOException(NEW_MSG("open jar failed: %s\n", jar_path)));
     }
 
     char buf[strlen(class_name) + 8];
     strcat(strcpy(buf, class_name), ".class");
 
-    int k = unzLocateFile(jar_file, buf, 1);
-    if (k != UNZ_OK) {
+    const JarFile::Entry *entry = jar->find(buf);
+    if (entry == nullptr) {
         // not found
-        unzClose(jar_file);
         return nullptr;
     }
 
     // find out!
-    if (unzOpenCurrentFile(jar_file) != UNZ_OK) {
-        unzClose(jar_file);
-        thread_throw(new IOException(NEW_MSG("unzOpenCurrentFile failed: %s\n", jar_path)));
+    // 解释器会改写类的字节码，所以即使是 STORED 的类也要拷贝一份，不能直接使用 jar 的映射
+    auto bytecode = (u1 *) bootMetaspace.allocBytecode(entry->uncompressedSize);
+    if (!jar->read(entry, bytecode)) {
+        thread_throw(new IOException(NEW_MSG("read %s failed: %s.\n", buf, jar_path)));
     }
-
-    unz_file_info64 file_info;
-    unzGetCurrentFileInfo64(jar_file, &file_info, buf, sizeof(buf), nullptr, 0, nullptr, 0);
-
-    auto bytecode = (u1 *) g_heap.allocBytecode(file_info.uncompressed_size); //new u1[file_info.uncompressed_size];
-    int size = unzReadCurrentFile(jar_file, bytecode, (unsigned int)(file_info.uncompressed_size));
-    unzCloseCurrentFile(jar_file);
-    unzClose(jar_file);
-    if (size != file_info.uncompressed_size) {
-        thread_throw(new IOException(NEW_MSG("unzReadCurrentFile failed: %s.\n", jar_path)));
-    }
-    return make_unique<pair<u1 *, size_t>>(bytecode, file_info.uncompressed_size);
+    return make_unique<pair<u1 *, size_t>>(bytecode, entry->uncompressedSize);
 }
 
-void addClassToClassLoader(Object *classLoader, Class *c)
+/*
+ * 把 @c 加入 @classLoader 的已加载类表，
+ * 返回表中的类（表中已有同名的类时返回那个类）。
+ */
+static Class *addClassToClassLoader(Object *classLoader, Class *c)
 {
     if (classLoader == bootClassLoader) {
-        bootClasses.insert(make_pair(c->className, c));
-        return;
+        return bootClasses.add(c);
     }
 
     // Invoked by the VM to record every loaded class with this loader.
@@ -89,16 +106,44 @@ void addClassToClassLoader(Object *classLoader, Class *c)
 //    assert(m != nullptr);
 //    execJavaFunc(m, { (slot_t) classLoader, (slot_t) c });
 
-    for (auto &p : classes) {
-        if (p.first == classLoader) {
-            p.second.insert(make_pair(c->className, c));
-            return;
-        }
+    return getLoaderData(classLoader)->classes.add(c);
+}
+
+static ClassDictionary &dictionaryOf(Object *classLoader)
+{
+    return classLoader == bootClassLoader ? bootClasses : getLoaderData(classLoader)->classes;
+}
+
+// 数组类记在其 defining loader 的已加载类表中，元数据分配在它的 Metaspace 中
+Class *loadArrayClass(Object *classLoader, const utf8_t *name)
+{
+    assert(name != nullptr and name[0] == '[');
+
+    const utf8_t *ele = name;
+    while (*ele == '[')
+        ele++;
+
+    Object *definingLoader = bootClassLoader;
+    if (*ele == 'L') {
+        size_t len = strlen(ele); // Lxx/xx/xx;
+        if (len < 3 or ele[len - 1] != ';')
+            return nullptr;
+        char eleName[len - 1];
+        memcpy(eleName, ele + 1, len - 2);
+        eleName[len - 2] = 0;
+
+        Class *eleClass = classLoader == bootClassLoader
+                          ? loadBootClass(eleName) : loadClass(classLoader, eleName);
+        if (eleClass == nullptr)
+            return nullptr;
+        definingLoader = eleClass->loader;
+    } else if (ele[0] == 0 or ele[1] != 0 or ele[0] == 'V' or Prims::descriptor2className(ele[0]) == nullptr) {
+        return nullptr;
     }
 
-    // not find this classLoader, add classLoader first.
-    classes.emplace_back(make_pair(classLoader, class_map()));
-    classes.back().second.insert(make_pair(c->className, c));
+    return dictionaryOf(definingLoader).loadOnce(name, [=]() -> Class * {
+        return Class::newClass(definingLoader, name);
+    });
 }
 
 Class *loadBootClass(const utf8_t *name)
@@ -106,33 +151,49 @@ Class *loadBootClass(const utf8_t *name)
     assert(name != nullptr);
     //assert(isSlashName(name));
 
-    auto iter = bootClasses.find(name);
-    if (iter != bootClasses.end()) {
-        TRACE("find loaded class (%s) from pool.", className);
-        return iter->second;
-    }
+    if (name[0] == '[')
+        return loadArrayClass(bootClassLoader, name);
+
+    // 同一个类只由一个线程加载，其他线程等待其结果
+    return bootClasses.loadOnce(name, [name]() -> Class * {
+        Class *c = nullptr;
+        if (Prims::isPrimClassName(name)) {
+            c = Class::newClass(bootClassLoader, name);
+        } else {
+            // 先从类数据共享档案中找，档案已校验过与启动类路径一致，
+            // 再看后台是否已经预取了此类
+            size_t len;
+            u1 *bytecode = findArchivedClass(name, len);
+            if (bytecode == nullptr)
+                bytecode = takePrefetchedClass(name, len);
+
+            for (auto iter = jreLibJars.begin(); bytecode == nullptr and iter != jreLibJars.end(); iter++) {
+                auto content = read_class_from_jar(iter->c_str(), name);
+                if (content) { // find out
+                    bytecode = content->first;
+                    len = content->second;
+                }
+            }
 
-    Class *c = nullptr;
-    if (name[0] == '[' or Prims::isPrimClassName(name)) {
-        c = Class::newClass(name);
-    } else {
-        for (auto &jar : jreLibJars) {
-            auto content = read_class_from_jar(jar.c_str(), name);
-            if (content) { // find out
-                c = defineClass(bootClassLoader, content->first, content->second);
+            if (bytecode != nullptr) {
+                // 解析此类的同时，后台预取它引用的类
+                prefetchReferencedClasses(name, bytecode, len);
+                c = defineClass(bootClassLoader, bytecode, len);
             }
         }
-    }
 
-    if (c != nullptr) {
-        bootPackages.insert(c->pkgName);
-        addClassToClassLoader(bootClassLoader, c);
-    }
-    return c;
+        if (c != nullptr) {
+            lock_guard<mutex> lock(bootPackagesMutex);
+            bootPackages.insert(c->pkgName);
+            recordLoadedClass(c->className);
+        }
+        return c;
+    });
 }
 
 const utf8_t *getBootPackage(const utf8_t *name)
 {
+    lock_guard<mutex> lock(bootPackagesMutex);
     auto iter = bootPackages.find(name);
     return iter != bootPackages.end() ? *iter : nullptr;
 }
@@ -148,20 +209,109 @@ Class *findLoadedClass(Object *classLoader, const utf8_t *name)
     //assert(isSlashName(name));
 
     if (classLoader == nullptr) {
-        auto iter = bootClasses.find(name);
-        return iter != bootClasses.end() ? iter->second : nullptr;
+        return bootClasses.find(name);
     }
 
     // is not boot classLoader
-    for (auto &p : classes) {
-        if (p.first == classLoader) {
-            auto iter = p.second.find(name);
-            return iter != p.second.end() ? iter->second : nullptr;
-        }
+    LoaderData *d = loaders.find(classLoader);
+    return d != nullptr ? d->classes.find(name) : nullptr;
+}
+
+/*
+ * 系统类加载器（sun/misc/Launcher$AppClassLoader）要加载的类
+ * 直接由虚拟机在用户类路径上查找并定义，不用回调 Java 层的 loadClass.
+ */
+static bool isAppClassLoader(Object *classLoader)
+{
+    return classLoader != nullptr
+           and utf8::equals(classLoader->clazz->className, "sun/misc/Launcher$AppClassLoader");
+}
+
+/*
+ * 系统类加载器能找到的类是否都在 findUserClass 的范围内。
+ * 不在的有：用户类路径中虚拟机不处理的项（参见 isUserClassPathComplete），
+ * 以及之后通过 URLClassLoader.addURL 加入的 URL（可能不是 file:）。
+ * 虚拟机第一次替系统类加载器加载类（main class）时还没有执行用户代码，
+ * 记下此时 URLClassPath 中 URL 的个数，之后变多了就是有 URL 被加入。
+ */
+static atomic<jint> appClassPathUrls(-1);
+
+static bool isAppClassPathHandled(Object *appClassLoader)
+{
+    if (!isUserClassPathComplete())
+        return false;
+
+    auto ucp = appClassLoader->getInstFieldValue<jref>("ucp", "Lsun/misc/URLClassPath;");
+    auto path = ucp != nullptr ? ucp->getInstFieldValue<jref>("path", "Ljava/util/ArrayList;") : nullptr;
+    if (path == nullptr)
+        return false;
+
+    jint urls = path->getInstFieldValue<jint>("size", "I");
+    jint expected = -1;
+    if (appClassPathUrls.compare_exchange_strong(expected, urls))
+        return true;
+    return urls <= expected;
+}
+
+/*
+ * 由虚拟机直接定义的用户类没有经过 URLClassLoader.defineClass，
+ * 在这里补上它会做的事：为类所在的包定义 Package，设置类的 ProtectionDomain.
+ * 不读取 jar 的 manifest，Package 中的规范和实现信息都为空，也不密封。
+ */
+static mutex appDomainsMutex;
+// key: 类路径项的 URL，这些 ProtectionDomain 同时被系统类加载器的 pdcache 引用，不会被回收
+static unordered_map<const char *, jref> appDomains;
+
+static jref appProtectionDomain(Object *classLoader, const char *codeSource)
+{
+    {
+        lock_guard<mutex> lock(appDomainsMutex);
+        auto iter = appDomains.find(codeSource);
+        if (iter != appDomains.end())
+            return iter->second;
     }
 
-    // not find
-    return nullptr;
+    // new URL(codeSource)
+    Class *urlClass = initClass(loadBootClass("java/net/URL"));
+    jref url = newObject(urlClass);
+    execJavaFunc(urlClass->getConstructor("(Ljava/lang/String;)V"), url, newString(codeSource));
+
+    // new CodeSource(url, (Certificate[]) null)
+    Class *csClass = initClass(loadBootClass("java/security/CodeSource"));
+    jref cs = newObject(csClass);
+    execJavaFunc(csClass->getConstructor("(Ljava/net/URL;[Ljava/security/cert/Certificate;)V"), cs, url, jnull);
+
+    // protected final ProtectionDomain getProtectionDomain(CodeSource cs)
+    Method *m = classLoader->clazz->lookupInstMethod("getProtectionDomain",
+                                                     "(Ljava/security/CodeSource;)Ljava/security/ProtectionDomain;");
+    jref pd = *(jref *) execJavaFunc(m, classLoader, cs);
+
+    lock_guard<mutex> lock(appDomainsMutex);
+    return appDomains.emplace(codeSource, pd).first->second;
+}
+
+static void defineAppPackage(Object *classLoader, Class *c)
+{
+    if (c->pkgName[0] == 0) // 无名包
+        return;
+
+    jstrref name = newString(c->pkgName);
+    // protected Package getPackage(String name)
+    Method *get = classLoader->clazz->lookupInstMethod("getPackage", "(Ljava/lang/String;)Ljava/lang/Package;");
+    if (*(jref *) execJavaFunc(get, classLoader, name) != jnull)
+        return;
+
+    // protected Package definePackage(String name, String specTitle, String specVersion, String specVendor,
+    //                                 String implTitle, String implVersion, String implVendor, URL sealBase)
+    Method *define = classLoader->clazz->lookupInstMethod("definePackage",
+            "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;"
+            "Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/net/URL;)Ljava/lang/Package;");
+    slot_t args[] = { (slot_t) classLoader, (slot_t) name, 0, 0, 0, 0, 0, 0, 0 };
+    try {
+        execJavaFuncThrows(define, args);
+    } catch (Throwable &) {
+        // IllegalArgumentException：其他线程已经定义了这个包，同 URLClassLoader.definePackageInternal
+    }
 }
 
 Class *loadClass(Object *classLoader, const utf8_t *name)
@@ -174,12 +324,42 @@ Class *loadClass(Object *classLoader, const utf8_t *name)
     if (c != nullptr)
         return c;
 
+    if (slashName[0] == '[') {
+        c = loadArrayClass(classLoader, slashName);
+        // @classLoader 是 @c 的 initiating loader
+        if (c != nullptr and c->loader != classLoader)
+            c = addClassToClassLoader(classLoader, c);
+        return c;
+    }
+
     // 先尝试用boot class loader load the class
     c = loadBootClass(slashName);
     if (c != nullptr || classLoader == nullptr)
         return c;
 
-    // todo 再尝试用扩展classLoader load the class
+    // 扩展类路径上有的类按双亲委派由扩展类加载器加载，交给 Java 层
+    if (isAppClassLoader(classLoader) and !isExtClass(slashName)) {
+        c = getLoaderData(classLoader)->classes.loadOnce(slashName, [=]() -> Class * {
+            size_t len;
+            const char *codeSource;
+            u1 *bytecode = findUserClass(slashName, len, getMetaspace(classLoader), &codeSource);
+            if (bytecode == nullptr)
+                return nullptr;
+            Class *k = defineClass(classLoader, bytecode, len);
+            k->protectionDomain = appProtectionDomain(classLoader, codeSource);
+            defineAppPackage(classLoader, k);
+            return k;
+        });
+        if (c != nullptr) {
+            recordLoadedClass(c->className);
+            return c;
+        }
+        // 启动类路径和扩展类路径上都没有，用户类路径上也没有，
+        // Java 层也一定找不到，不用再去执行 ClassLoader.loadClass
+        if (isAppClassPathHandled(classLoader))
+            thread_throw(new ClassNotFoundException(slash2DotsDup(name)));
+        // 交给 Java 层
+    }
 
     // public Class<?> loadClass(String name) throws ClassNotFoundException
     Method *m = classLoader->clazz->lookupInstMethod("loadClass", "(Ljava/lang/String;)Ljava/lang/Class;");
@@ -189,7 +369,11 @@ Class *loadClass(Object *classLoader, const utf8_t *name)
     slot_t *slot = execJavaFunc(m, classLoader, newString(dotName));
     assert(slot != nullptr);
     c =  *(Class **) slot;
-    addClassToClassLoader(classLoader, c);
+    if (c != nullptr) {
+        // @classLoader 是 @c 的 initiating loader
+        c = addClassToClassLoader(classLoader, c);
+        recordLoadedClass(c->className);
+    }
     return c;
 }
 
@@ -201,8 +385,20 @@ Class *defineClass(jref classLoader, u1 *bytecode, size_t len)
 Class *defineClass(jref classLoader, jstrref name,
                    jarrref bytecode, jint off, jint len, jref protectionDomain, jstrref source)
 {
-    auto data = (u1 *) bytecode->data;
-    return defineClass(classLoader, data + off, len);
+    // 复制一份到 class loader 的 Metaspace 中，
+    // 类的元数据（如 Method::code）会直接引用 bytecode，
+    // 而 Java 数组 @bytecode 随时可能被回收。
+    auto data = (u1 *) getMetaspace(classLoader)->allocBytecode(len);
+    memcpy(data, (u1 *) bytecode->data() + off, len);
+    Class *c = defineClass(classLoader, data, len);
+    c->protectionDomain = protectionDomain;
+
+    // @classLoader 是 @c 的 defining loader，同一个 loader 不能两次定义同名的类
+    // （parallel capable 的 loader 可能在多个线程中同时定义同一个类）
+    if (addClassToClassLoader(classLoader, c) != c) {
+        thread_throw(new LinkageError(NEW_MSG("duplicate class definition: %s", c->className)));
+    }
+    return c;
 }
 
 Class *initClass(Class *c)
@@ -212,7 +408,9 @@ Class *initClass(Class *c)
     // todo
     c->clinit();
 
-    c->state = Class::INITED;
+    // 同一线程在 <clinit> 中递归初始化时 clinit() 直接返回，此时类还没有初始化完成
+    if (c->state != Class::INITING)
+        c->state = Class::INITED;
     return c;
 }
 
@@ -226,6 +424,79 @@ Class *linkClass(Class *c)
     return c;
 }
 
+// 已从表中移除、等待释放的 LoaderData，经由 nextDetached 链接
+static LoaderData *detachedLoaders;
+
+void detachUnreachableLoaders()
+{
+    // 不在表中的 LoaderData 不会被 forEach 访问到，先收集再移除
+    loaders.forEach([](LoaderData *d) {
+        if (!d->scanned) {
+            TRACE("unload class loader %p.", d->loader);
+            d->nextDetached = detachedLoaders;
+            detachedLoaders = d;
+        }
+    });
+    if (detachedLoaders == nullptr)
+        return;
+
+    loaders.removeIf([](LoaderData *d) { return !d->scanned; });
+
+    // @c 由被卸载的 loader 定义（数组类由其元素类的 defining loader 定义）。
+    // 此时 loader 对象还没有被回收，可以按地址比较
+    auto definedByDetached = [](Class *c) {
+        for (LoaderData *d = detachedLoaders; d != nullptr; d = d->nextDetached) {
+            if (c->loader == d->loader)
+                return true;
+        }
+        return false;
+    };
+
+    // 其他 loader 作为 initiating loader 记录的、由被卸载的 loader 定义的类。
+    // boot class loader 只记录由它自己定义的类
+    loaders.forEach([&](LoaderData *x) { x->classes.removeIf(definedByDetached); });
+}
+
+void releaseDetachedLoaders()
+{
+    LoaderData *d = detachedLoaders;
+    detachedLoaders = nullptr;
+
+    while (d != nullptr) {
+        LoaderData *next = d->nextDetached;
+
+        // 在类的元数据释放之前
+        retireAllocSites(d->metaspace);
+
+        d->metaspace->forEachClass([](Class *c) {
+            // Class 对象不在堆中，不会被 sweep，在这里释放在它上面膨胀出的 Monitor
+            c->releaseMonitor();
+            c->~Class();
+        });
+        utf8::release(d->metaspace);
+        delete d->metaspace; // 所有元数据一次性归还
+        delete d;
+        d = next;
+    }
+}
+
+vector<Object *> getClassLoaders()
+{
+    vector<Object *> v;
+    loaders.forEach([&v](LoaderData *d) { v.push_back(d->loader); });
+    return v;
+}
+
+vector<Class *> getAllClasses()
+{
+    vector<Class *> v = bootMetaspace.getClasses();
+    loaders.forEach([&v](LoaderData *d) {
+        auto classes = d->metaspace->getClasses();
+        v.insert(v.end(), classes.begin(), classes.end());
+    });
+    return v;
+}
+
 Object *getSystemClassLoader()
 {
     Class *scl = loadBootClass(S(java_lang_ClassLoader));
@@ -245,11 +516,15 @@ void initClassLoader()
     objectClass = loadBootClass(S(java_lang_Object));
     classClass = loadBootClass(S(java_lang_Class));
 
-    if (classClass->instFieldsCount != CLASS_CLASS_INST_FIELDS_COUNT) {
+    if (classClass->instSize > Class::getSize()) {
         jvm_abort("What the fuck! java/lang/Class.java 文件有变动？！"); // todo
     }
 
-    objectClass->clazz = classClass->clazz = classClass;
+    // java/lang/Class 加载之前加载的类（其父类和接口等）还没有 clazz
+    for (Class *c : getAllClasses()) {
+        if (c->clazz == nullptr)
+            c->clazz = classClass;
+    }
 
     stringClass = loadBootClass(S(java_lang_String));
     stringClass->buildStrPool();
@@ -258,9 +533,7 @@ void initClassLoader()
 void printBootClassLoader()
 {
     printvm("boot class loader.\n");
-    for (auto iter : bootClasses) {
-        printvm("%s\n", iter.first);
-    }
+    bootClasses.forEach([](Class *c) { printvm("%s\n", c->className); });
     printvm("\n");
 }
 
@@ -271,14 +544,11 @@ void printClassLoader(Object *classLoader)
         return;
     }
 
-    for (auto iter : classes) {
-        if (iter.first == classLoader) {
-            printvm("class loader %p.\n", classLoader);
-            for (auto k : iter.second) {
-                printvm("%s\n", k.first);
-            }
-            printvm("\n");
-        }
+    LoaderData *d = loaders.find(classLoader);
+    if (d != nullptr) {
+        printvm("class loader %p.\n", classLoader);
+        d->classes.forEach([](Class *c) { printvm("%s\n", c->className); });
+        printvm("\n");
     }
 }
 
@@ -286,12 +556,9 @@ void printAllClassLoaders()
 {
     printBootClassLoader();
 
-    for (auto iter : classes) {
-        printvm("class loader %p.\n", iter.first);
-        for (auto k : iter.second) {
-            printvm("%s\n", k.first);
-        }
+    loaders.forEach([](LoaderData *d) {
+        printvm("class loader %p.\n", d->loader);
+        d->classes.forEach([](Class *c) { printvm("%s\n", c->className); });
         printvm("\n");
-    }
+    });
 }
-
@@ -7,18 +7,22 @@
 
 #include <cassert>
 #include <cstring>
+#include <vector>
 #include <unordered_set>
 #include "../util/encoding.h"
+#include "ClassDictionary.h"
 
 class Object;
 class Class;
+class Metaspace;
 
 // Cache 常用的类
 extern Class *objectClass;
 extern Class *classClass;
 extern Class *stringClass;
 
-// java.lang.Class 类中实例变量的 slots count
+// java.lang.Class 类中实例变量最多占用的 slots count，
+// 按 slot 计算的上界，实际按类型紧凑存放，参见 Class::layoutFields()
 const static int CLASS_CLASS_INST_FIELDS_COUNT = 12; // 12 slots
 
 void initClassLoader();
@@ -27,11 +31,19 @@ void initClassLoader();
 
 Class *loadBootClass(const utf8_t *name);
 
+/*
+ * 加载数组类 @arrClassName，@classLoader 为其 initiating loader，用它加载元素类。
+ * 数组类由其元素类的 defining loader 定义（基本类型的数组由 boot class loader 定义），
+ * 和元素类一起卸载。元素类不存在时返回 null.
+ */
+Class *loadArrayClass(Object *classLoader, const utf8_t *arrClassName);
+
+// 元素类为基本类型或由 boot class loader 定义的数组类
 static inline Class *loadArrayClass(const utf8_t *arrClassName)
 {
     assert(arrClassName != nullptr);
     assert(arrClassName[0] == '['); // must be array class name
-    return loadBootClass(arrClassName);
+    return loadArrayClass(bootClassLoader, arrClassName);
 };
 
 using utf8_set = std::unordered_set<const utf8_t *, utf8::Hash, utf8::Comparator>;
@@ -58,6 +70,72 @@ Class *defineClass(jref classLoader, jstrref name,
 
 Class *initClass(Class *c);
 
+/*
+ * 得到 @classLoader 的 Metaspace，由 @classLoader 定义的类的元数据都从中分配。
+ * boot class loader 的 Metaspace 永不释放。
+ */
+Metaspace *getMetaspace(Object *classLoader);
+
+/*
+ * 卸载 class loader 分两步进行：
+ *
+ * detachUnreachableLoaders: 由 gc 在暂停其他线程期间调用（不分配内存），
+ * 把本次 gc 中没有被扫描（LoaderData::scanned 为 false）的 loaders 从表中移除，
+ * 并从其他 loaders 的已加载类表中移除由它们定义的类。
+ * 这样恢复其他线程之后，即使 loader 对象的地址被新的对象重用，也不会查找到它们。
+ *
+ * releaseDetachedLoaders: 恢复其他线程之后调用，
+ * 释放被移除的 loaders 定义的所有类的元数据、只被这些类使用的utf8字符串，以及它们的已加载类表。
+ * 此时按 LoaderData 和 Metaspace 释放，不再使用 loader 对象的地址。
+ */
+void detachUnreachableLoaders();
+void releaseDetachedLoaders();
+
+// 得到所有的 class loaders（不包括 boot class loader）
+std::vector<Object *> getClassLoaders();
+
+// 每个class loader（不包括 boot class loader）的数据
+struct LoaderData {
+    Object *loader;
+
+    // the classes loaded by @loader(@loader 为其 initiating loader).
+    ClassDictionary classes;
+
+    // 由 @loader 定义的类（@loader 为其 defining loader）的元数据都分配在这里
+    Metaspace *metaspace;
+
+    // gc 用：@loader 可达，由它定义的类已经作为根扫描过了
+    bool scanned = false;
+
+    // 已从表中移除、等待释放的下一个 LoaderData，参见 detachUnreachableLoaders
+    LoaderData *nextDetached = nullptr;
+
+    explicit LoaderData(Object *loader);
+
+    struct Traits {
+        using Key = const Object *;
+        static Key key(const LoaderData *d) { return d->loader; }
+        // 对象不会移动，可以按地址散列
+        static size_t hash(Key k) { return (size_t) k >> 3; }
+        static bool equals(Key k1, Key k2) { return k1 == k2; }
+    };
+};
+
+ConcurrentTable<LoaderData, LoaderData::Traits> &getLoaderTable();
+
+/*
+ * 对每个 class loader 的 LoaderData 调用 @visit(LoaderData *)。
+ * 无锁，不分配内存，gc 暂停其他线程期间也可以调用。
+ */
+template <typename Visit>
+void forEachLoaderData(Visit visit)
+{
+    getLoaderTable().forEach(visit);
+}
+
+// 得到所有已定义的类（包括 boot class loader 定义的）
+std::vector<Class *> getAllClasses();
+
 Class *linkClass(Class *c);
 
 /*
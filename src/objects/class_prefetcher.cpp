@@ -0,0 +1,435 @@
+/*
+ * Author: kayo
+ */
+
+#include <deque>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
+#include <unistd.h>
+#include "class_prefetcher.h"
+#include "class_loader.h"
+#include "class_archive.h"
+#include "../kayo.h"
+#include "../classfile/constant.h"
+#include "../memory/Metaspace.h"
+#include "../util/JarFile.h"
+
+using namespace std;
+
+#define MAX_PREFETCH_THREADS 4
+
+// 排队等待预取的类的上限，超过时丢弃新的预取请求
+#define MAX_QUEUED_CLASSES 4096
+
+// prefetches 中记录的类的上限，超过时丢弃新的预取请求
+#define MAX_PREFETCH_ENTRIES 16384
+
+// 已解压但还没有被取走的字节数的上限，超过时丢弃最早预取的
+#define MAX_PREFETCHED_BYTES (32*1024*1024)
+
+int classPrefetchThreads = -1;
+char dumpLoadedClassList[PATH_MAX] = { 0 };
+char sharedClassListFile[PATH_MAX] = { 0 };
+
+namespace {
+
+/*
+ * 预取到的字节在 C++ 堆上，
+ * 被取走时复制到 boot class loader 的 Metaspace 中并释放，
+ * 一直没有被取走的在超过 MAX_PREFETCHED_BYTES 时被丢弃。
+ * 被取走的，以及请求线程自己加载了的类从 prefetches 中删除，之后由 enqueue 根据是否已加载来跳过。
+ */
+struct Prefetch {
+    enum {
+        QUEUED,   // 等待工作线程处理
+        LOADING,  // 工作线程正在查找、解压
+        DONE,     // 已解压，等待请求线程取走
+        MISSING   // 启动类路径中没有此类
+    } state;
+    u1 *bytecode = nullptr;
+    size_t len = 0;
+    bool waited = false; // 有请求线程在等待，不能丢弃
+};
+
+mutex prefetchMutex;
+condition_variable queueCond; // 通知工作线程有新的任务
+condition_variable doneCond;  // 通知请求线程有类预取完成
+
+unordered_map<string, Prefetch> prefetches;
+deque<string> queue;
+
+// 按完成的顺序，可能有已经被取走的类名
+deque<string> doneOrder;
+size_t prefetchedBytes = 0;
+
+void release(Prefetch &p)
+{
+    free(p.bytecode);
+    prefetchedBytes -= p.len;
+    p.bytecode = nullptr;
+}
+
+// 调用者需持有 prefetchMutex
+void evict()
+{
+    while (prefetchedBytes > MAX_PREFETCHED_BYTES and !doneOrder.empty()) {
+        auto iter = prefetches.find(doneOrder.front());
+        doneOrder.pop_front();
+        if (iter != prefetches.end() and iter->second.state == Prefetch::DONE and !iter->second.waited) {
+            release(iter->second);
+            prefetches.erase(iter);
+        }
+    }
+}
+
+bool enabled = false;
+
+/*
+ * 快速扫描 class 文件，得到其父类、接口（@supers）
+ * 和常量池中引用的其他类（@refs），不分配任何元数据。
+ * class 文件格式错误时返回 false，留给 Class::Class 去报告。
+ */
+bool scanClassFile(const u1 *bytecode, size_t len, vector<string> &supers, vector<string> &refs)
+{
+    size_t pos = 8; // magic, minor_version, major_version
+    auto has = [&](size_t n) { return pos + n <= len; };
+    auto u2at = [&](size_t p) { return (u2) ((bytecode[p] << 8) | bytecode[p + 1]); };
+
+    if (!has(2))
+        return false;
+    u2 cpCount = u2at(pos);
+    pos += 2;
+
+    vector<size_t> utf8s(cpCount, 0);   // CONSTANT_Utf8 在 @bytecode 中的位置
+    vector<u2> classes(cpCount, 0);     // CONSTANT_Class 的 name_index
+    for (u2 i = 1; i < cpCount; i++) {
+        if (!has(1))
+            return false;
+        u1 tag = bytecode[pos++];
+        switch (tag) {
+            case CONSTANT_Utf8:
+                if (!has(2))
+                    return false;
+                utf8s[i] = pos;
+                pos += 2 + u2at(pos);
+                break;
+            case CONSTANT_Class:
+                if (!has(2))
+                    return false;
+                classes[i] = u2at(pos);
+                pos += 2;
+                break;
+            case CONSTANT_String:
+            case CONSTANT_MethodType:
+            case CONSTANT_Module:
+            case CONSTANT_Package:
+                pos += 2;
+                break;
+            case CONSTANT_MethodHandle:
+                pos += 3;
+                break;
+            case CONSTANT_Integer:
+            case CONSTANT_Float:
+            case CONSTANT_NameAndType:
+            case CONSTANT_Fieldref:
+            case CONSTANT_Methodref:
+            case CONSTANT_InterfaceMethodref:
+            case CONSTANT_Dynamic:
+            case CONSTANT_InvokeDynamic:
+                pos += 4;
+                break;
+            case CONSTANT_Long:
+            case CONSTANT_Double:
+                pos += 8;
+                i++;
+                break;
+            default:
+                return false;
+        }
+        if (pos > len)
+            return false;
+    }
+
+    auto className = [&](u2 classIndex, string &name) {
+        if (classIndex == 0 or classIndex >= cpCount)
+            return false;
+        u2 nameIndex = classes[classIndex];
+        if (nameIndex == 0 or nameIndex >= cpCount or utf8s[nameIndex] == 0)
+            return false;
+        size_t p = utf8s[nameIndex];
+        name.assign((const char *) bytecode + p + 2, u2at(p));
+        return name[0] != '['; // 数组类由虚拟机生成，不需要预取
+    };
+
+    // access_flags, this_class, super_class, interfaces_count, interfaces[]
+    if (!has(8))
+        return false;
+    u2 thisClass = u2at(pos + 2);
+    string name;
+    if (className(u2at(pos + 4), name))
+        supers.push_back(name);
+    u2 interfacesCount = u2at(pos + 6);
+    pos += 8;
+    if (!has(2 * interfacesCount))
+        return false;
+    for (u2 i = 0; i < interfacesCount; i++, pos += 2) {
+        if (className(u2at(pos), name))
+            supers.push_back(name);
+    }
+
+    for (u2 i = 1; i < cpCount; i++) {
+        if (classes[i] != 0 and i != thisClass and className(i, name))
+            refs.push_back(name);
+    }
+    return true;
+}
+
+// 调用者需持有 prefetchMutex
+// @bounded: 是否受 MAX_QUEUED_CLASSES 的限制（类列表中的类不受限制）
+void enqueue(const string &name, bool bounded = true)
+{
+    if (bounded and queue.size() >= MAX_QUEUED_CLASSES)
+        return;
+    if (prefetches.size() >= MAX_PREFETCH_ENTRIES)
+        return;
+    if (prefetches.find(name) != prefetches.end())
+        return;
+    if (findLoadedClass(bootClassLoader, name.c_str()) != nullptr)
+        return;
+
+    // 档案中的类可以直接使用，不需要预取
+    size_t len;
+    if (findArchivedClass(name.c_str(), len) != nullptr)
+        return;
+
+    prefetches[name].state = Prefetch::QUEUED;
+    queue.push_back(name);
+    queueCond.notify_one();
+}
+
+/*
+ * 在启动类路径中查找并解压 @name，不抛出异常。
+ * 返回的字节由 malloc 分配。
+ */
+u1 *fetch(const string &name, size_t &len)
+{
+    string entryName = name + ".class";
+    for (auto &path : jreLibJars) {
+        JarFile *jar = openJar(path.c_str());
+        if (jar == nullptr)
+            continue;
+        const JarFile::Entry *e = jar->find(entryName.c_str());
+        if (e == nullptr)
+            continue;
+
+        len = e->uncompressedSize;
+        auto bytecode = (u1 *) malloc(len);
+        if (bytecode == nullptr)
+            return nullptr;
+        if (!jar->read(e, bytecode)) {
+            free(bytecode);
+            return nullptr;
+        }
+        return bytecode;
+    }
+    return nullptr;
+}
+
+void prefetchLoop()
+{
+    while (true) {
+        string name;
+        {
+            unique_lock<mutex> lock(prefetchMutex);
+            queueCond.wait(lock, [] { return !queue.empty(); });
+            name = move(queue.front());
+            queue.pop_front();
+
+            auto iter = prefetches.find(name);
+            if (iter == prefetches.end() or iter->second.state != Prefetch::QUEUED) // 请求线程已经自己加载了
+                continue;
+            iter->second.state = Prefetch::LOADING;
+        }
+
+        size_t len = 0;
+        u1 *bytecode = fetch(name, len);
+
+        vector<string> supers, refs;
+        if (bytecode != nullptr)
+            scanClassFile(bytecode, len, supers, refs);
+
+        lock_guard<mutex> lock(prefetchMutex);
+        // LOADING 状态的类不会被删除
+        Prefetch &p = prefetches[name];
+        p.bytecode = bytecode;
+        p.len = len;
+        p.state = bytecode != nullptr ? Prefetch::DONE : Prefetch::MISSING;
+        if (bytecode != nullptr) {
+            prefetchedBytes += len;
+            doneOrder.push_back(name);
+            evict();
+        }
+        doneCond.notify_all();
+
+        // 定义此类时一定会加载它的父类和接口
+        for (auto &s : supers)
+            enqueue(s);
+    }
+}
+
+/*
+ * 预取类列表中的类：先找出每个类所在的 jar 和它在 jar 中的偏移，
+ * 按 (jar, 偏移) 排序后依次入队，工作线程按此顺序顺序地扫过 jar.
+ */
+void replayClassList(string path)
+{
+    struct Located {
+        size_t jar;
+        u8 offset;
+        string name;
+    };
+
+    vector<Located> located;
+    for (auto &name : readClassList(path.c_str())) {
+        string entryName = name + ".class";
+        for (size_t i = 0; i < jreLibJars.size(); i++) {
+            JarFile *jar = openJar(jreLibJars[i].c_str());
+            const JarFile::Entry *e = jar != nullptr ? jar->find(entryName.c_str()) : nullptr;
+            if (e != nullptr) {
+                located.push_back({ i, e->localHeaderOffset, name });
+                break;
+            }
+        }
+    }
+
+    sort(located.begin(), located.end(), [](const Located &a, const Located &b) {
+        return a.jar != b.jar ? a.jar < b.jar : a.offset < b.offset;
+    });
+
+    lock_guard<mutex> lock(prefetchMutex);
+    for (auto &l : located)
+        enqueue(l.name, false);
+}
+
+mutex recordMutex;
+FILE *recordFile = nullptr;
+unordered_set<string> recorded;
+
+}
+
+void initClassPrefetcher()
+{
+    int n = classPrefetchThreads;
+    if (n < 0) {
+        // 留一个 CPU 给请求线程
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n = (int) min<long>(max<long>(cpus - 1, 0), MAX_PREFETCH_THREADS);
+    }
+    if (n == 0 and sharedClassListFile[0] != 0)
+        n = 1;
+
+    if (dumpLoadedClassList[0] != 0) {
+        recordFile = fopen(dumpLoadedClassList, "w");
+        if (recordFile == nullptr) {
+            printvm("Unable to create class list file %s\n", dumpLoadedClassList);
+        }
+    }
+
+    if (n == 0)
+        return;
+
+    for (int i = 0; i < n; i++)
+        thread(prefetchLoop).detach();
+    enabled = true;
+
+    if (sharedClassListFile[0] != 0) {
+        thread(replayClassList, string(sharedClassListFile)).detach();
+    }
+}
+
+vector<string> readClassList(const char *path)
+{
+    vector<string> names;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty() and line[0] != '#')
+            names.push_back(line);
+    }
+    return names;
+}
+
+void recordLoadedClass(const utf8_t *name)
+{
+    if (recordFile == nullptr or name[0] == '[')
+        return;
+
+    lock_guard<mutex> lock(recordMutex);
+    if (recorded.insert(name).second) {
+        fprintf(recordFile, "%s\n", name);
+        fflush(recordFile);
+    }
+}
+
+void prefetchReferencedClasses(const utf8_t *name, const u1 *bytecode, size_t len)
+{
+    if (!enabled)
+        return;
+
+    vector<string> supers, refs;
+    if (!scanClassFile(bytecode, len, supers, refs))
+        return;
+
+    lock_guard<mutex> lock(prefetchMutex);
+    // 父类和接口马上就要用到，排在前面
+    for (auto &s : supers)
+        enqueue(s);
+    for (auto &r : refs)
+        enqueue(r);
+}
+
+u1 *takePrefetchedClass(const utf8_t *name, size_t &len)
+{
+    if (!enabled)
+        return nullptr;
+
+    unique_lock<mutex> lock(prefetchMutex);
+    auto iter = prefetches.find(name);
+    if (iter == prefetches.end())
+        return nullptr;
+
+    Prefetch &p = iter->second;
+    if (p.state == Prefetch::QUEUED) {
+        // 不等排队了，自己加载，工作线程会跳过它
+        prefetches.erase(iter);
+        return nullptr;
+    }
+
+    // 等待时 p 不会被删除：同一个类只有一个请求线程，LOADING 和 waited 的类都不会被删除
+    p.waited = true;
+    doneCond.wait(lock, [&p] { return p.state != Prefetch::LOADING; });
+    if (p.state != Prefetch::DONE) // MISSING 留着，不用再去查找
+        return nullptr;
+
+    len = p.len;
+    u1 *bytecode = p.bytecode;
+    prefetchedBytes -= len;
+    prefetches.erase(iter);
+    lock.unlock();
+
+    // 类的元数据会直接引用这些字节，复制到 Metaspace 中，与类的生命周期相同
+    auto copy = (u1 *) getMetaspace(bootClassLoader)->allocBytecode(len);
+    memcpy(copy, bytecode, len);
+    free(bytecode);
+    return copy;
+}
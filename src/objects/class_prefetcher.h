@@ -0,0 +1,69 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_CLASS_PREFETCHER_H
+#define KAYOVM_CLASS_PREFETCHER_H
+
+#include <string>
+#include <vector>
+#include "../jtypes.h"
+
+/*
+ * boot class 的后台预取。
+ *
+ * 每当 boot class loader 定义了一个类，就把它的父类、接口以及常量池中引用的类
+ * 交给一组工作线程，工作线程在 jar 中查找并解压这些类（并继续预取它们的父类和接口），
+ * 请求线程随后加载这些类时可以直接拿到解压好的字节。
+ *
+ * 同一个类名在任何时刻最多只有一个线程在处理：
+ * 请求线程遇到正在预取的类会等待其完成，遇到还在排队的类则自己加载，并取消预取。
+ *
+ * 解析（Class::Class）仍在请求线程中进行，
+ * 因为它需要修改 utf8 常量池、可能抛出 Java 异常，并且要递归加载父类。
+ */
+
+// -XX:ClassPrefetchThreads=<n>，0 表示不预取，小于 0 表示按 CPU 数决定
+extern int classPrefetchThreads;
+
+/*
+ * -XX:DumpLoadedClassList=<file>
+ * 按加载的顺序把每个加载的类名（每行一个）记录到文件中。
+ */
+extern char dumpLoadedClassList[];
+
+/*
+ * -XX:SharedClassListFile=<file>
+ * 启动时在后台按 jar 中的偏移顺序预取文件中列出的类，
+ * 把对 jar 的随机访问变成一次顺序的扫描。文件通常由 -XX:DumpLoadedClassList 生成。
+ * 指定此选项时即使 -XX:ClassPrefetchThreads=0 也至少有一个工作线程。
+ */
+extern char sharedClassListFile[];
+
+/*
+ * 启动预取线程，如果指定了 -XX:SharedClassListFile，开始预取其中的类。
+ * 需要在 initClassLoader 之前调用。
+ */
+void initClassPrefetcher();
+
+// 读取类列表文件，忽略空行和以 '#' 开头的行。文件不存在时返回空列表。
+std::vector<std::string> readClassList(const char *path);
+
+// 类 @name 被加载了，记录到 -XX:DumpLoadedClassList 中（同一个类只记录一次）
+void recordLoadedClass(const utf8_t *name);
+
+/*
+ * boot class loader 定义了类 @name 之后调用，
+ * 预取 @bytecode 中引用的、还没有被加载的类。
+ */
+void prefetchReferencedClasses(const utf8_t *name, const u1 *bytecode, size_t len);
+
+/*
+ * 取得类 @name 预取到的字节，没有预取到时返回 nullptr（调用者需要自己加载）。
+ * 如果 @name 正在被预取，等待其完成。
+ * 返回的字节在 boot class loader 的 Metaspace 中，
+ * 与类的生命周期相同。此后不会再预取 @name（已加载的类不会被预取）。
+ */
+u1 *takePrefetchedClass(const utf8_t *name, size_t &len);
+
+#endif //KAYOVM_CLASS_PREFETCHER_H
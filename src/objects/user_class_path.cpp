@@ -0,0 +1,249 @@
+/*
+ * Author: kayo
+ */
+
+#include <mutex>
+#include <cassert>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "user_class_path.h"
+#include "../util/JarFile.h"
+#include "../memory/Metaspace.h"
+
+using namespace std;
+
+struct ClassPathEntry {
+    string path;
+    JarFile *jar; // null 表示目录
+    string url;   // 作为 CodeSource 的 URL
+};
+
+// 按 -cp 中出现的顺序
+static vector<ClassPathEntry> entries;
+
+// 扩展类路径上的 jar
+static vector<JarFile *> extJars;
+
+// 用户类路径上的每一项都由 entries 处理，参见 isUserClassPathComplete
+static bool complete = true;
+
+// 目录的 URL 以 '/' 结尾，与 sun.misc.URLClassPath 一致
+static string toUrl(const string &path, bool dir)
+{
+    char abs[PATH_MAX];
+    string url = "file:";
+    url += realpath(path.empty() ? "." : path.c_str(), abs) != nullptr ? abs : path.c_str();
+    if (dir and url.back() != '/')
+        url += '/';
+    return url;
+}
+
+// 用户类路径上找不到的名字
+static mutex missesMutex;
+static unordered_set<string> misses;
+
+static bool isJarName(const string &path)
+{
+    auto i = path.rfind('.');
+    if (i == string::npos)
+        return false;
+    return strcasecmp(path.c_str() + i, ".jar") == 0 or strcasecmp(path.c_str() + i, ".zip") == 0;
+}
+
+// manifest 中是否有 Class-Path 属性（属性名不区分大小写）
+static bool hasManifestClassPath(JarFile *jar)
+{
+    const JarFile::Entry *e = jar->find("META-INF/MANIFEST.MF");
+    if (e == nullptr)
+        return false;
+
+    string manifest(e->uncompressedSize, '\0');
+    if (!jar->read(e, (u1 *) &manifest[0]))
+        return true; // 读不出来就当作有，交给 Java 层
+    // 逐行检查行首
+    for (size_t i = 0; ; i++) {
+        if (strncasecmp(manifest.c_str() + i, "Class-Path:", 11) == 0)
+            return true;
+        i = manifest.find('\n', i);
+        if (i == string::npos)
+            return false;
+    }
+}
+
+static void addJar(const string &path)
+{
+    JarFile *jar = openJar(path.c_str());
+    if (jar == nullptr) {
+        complete = false; // 比如 jar 损坏，让 Java 层去报告
+        return;
+    }
+    entries.push_back({ path, jar, toUrl(path, false) });
+    // Class-Path 引用的 jar 由 URLClassPath 打开，这里不处理
+    if (hasManifestClassPath(jar))
+        complete = false;
+}
+
+// dir/* 表示目录下所有的 jar 文件（不包括子目录）
+static void addJarsInDir(const string &dir)
+{
+    DIR *d = opendir(dir.empty() ? "." : dir.c_str());
+    if (d == nullptr)
+        return;
+
+    vector<string> jars;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != nullptr) {
+        string path = dir.empty() ? entry->d_name : dir + "/" + entry->d_name;
+        struct stat st;
+        if (isJarName(path) and stat(path.c_str(), &st) == 0 and S_ISREG(st.st_mode))
+            jars.push_back(path);
+    }
+    closedir(d);
+
+    // readdir 的顺序不确定，排个序保证每次运行一致
+    sort(jars.begin(), jars.end());
+    for (auto &path : jars)
+        addJar(path);
+}
+
+void initUserClassPath(const char *classpath)
+{
+    assert(classpath != nullptr);
+
+    const char *p = classpath;
+    while (true) {
+        const char *end = strchr(p, ':');
+        string item = end != nullptr ? string(p, end) : string(p);
+
+        if (item == "*") {
+            addJarsInDir("");
+        } else if (item.size() >= 2 and item.compare(item.size() - 2, 2, "/*") == 0) {
+            addJarsInDir(item.substr(0, item.size() - 2));
+        } else if (!item.empty()) {
+            struct stat st;
+            if (stat(item.c_str(), &st) == 0) {
+                if (S_ISDIR(st.st_mode))
+                    entries.push_back({ item, nullptr, toUrl(item, true) });
+                else if (S_ISREG(st.st_mode))
+                    addJar(item);
+                else
+                    complete = false;
+            }
+        }
+
+        if (end == nullptr)
+            break;
+        p = end + 1;
+    }
+}
+
+bool isUserClassPathComplete()
+{
+    return complete;
+}
+
+void initExtClassPath(const vector<string> &jars)
+{
+    for (auto &path : jars) {
+        JarFile *jar = openJar(path.c_str());
+        if (jar != nullptr)
+            extJars.push_back(jar);
+    }
+}
+
+bool isExtClass(const utf8_t *className)
+{
+    assert(className != nullptr);
+    if (extJars.empty())
+        return false;
+
+    char buf[strlen(className) + 8];
+    strcat(strcpy(buf, className), ".class");
+    return any_of(extJars.begin(), extJars.end(), [&](JarFile *jar) { return jar->find(buf) != nullptr; });
+}
+
+static u1 *readFromDir(const string &dir, const char *name, size_t &len, Metaspace *metaspace)
+{
+    string path = dir + "/" + name;
+    // 直接 open，不存在时也只有这一次系统调用
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    u1 *data = nullptr;
+    struct stat st;
+    if (fstat(fd, &st) == 0 and S_ISREG(st.st_mode)) {
+        auto size = (size_t) st.st_size;
+        data = (u1 *) metaspace->allocBytecode(size);
+        size_t n = 0;
+        while (n < size) {
+            ssize_t k = read(fd, data + n, size - n);
+            if (k <= 0)
+                break;
+            n += k;
+        }
+        if (n == size)
+            len = size;
+        else
+            data = nullptr; // 读取失败，已分配的空间随 Metaspace 一起释放
+    }
+
+    close(fd);
+    return data;
+}
+
+u1 *findOnUserClassPath(const char *name, size_t &len, Metaspace *metaspace, const char **codeSource)
+{
+    assert(name != nullptr);
+
+    {
+        lock_guard<mutex> lock(missesMutex);
+        if (misses.find(name) != misses.end())
+            return nullptr;
+    }
+
+    for (auto &e : entries) {
+        if (e.jar == nullptr) {
+            u1 *data = readFromDir(e.path, name, len, metaspace);
+            if (data != nullptr) {
+                if (codeSource != nullptr)
+                    *codeSource = e.url.c_str();
+                return data;
+            }
+            continue;
+        }
+
+        const JarFile::Entry *entry = e.jar->find(name);
+        if (entry == nullptr)
+            continue;
+
+        len = entry->uncompressedSize;
+        if (codeSource != nullptr)
+            *codeSource = e.url.c_str();
+        auto data = (u1 *) metaspace->allocBytecode(len);
+        if (e.jar->read(entry, data))
+            return data;
+    }
+
+    lock_guard<mutex> lock(missesMutex);
+    misses.emplace(name);
+    return nullptr;
+}
+
+u1 *findUserClass(const utf8_t *className, size_t &len, Metaspace *metaspace, const char **codeSource)
+{
+    assert(className != nullptr);
+
+    char buf[strlen(className) + 8];
+    strcat(strcpy(buf, className), ".class");
+    return findOnUserClassPath(buf, len, metaspace, codeSource);
+}
@@ -0,0 +1,60 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_USER_CLASS_PATH_H
+#define KAYOVM_USER_CLASS_PATH_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "../jtypes.h"
+
+class Metaspace;
+
+/*
+ * 用户类路径（user classpath）我们自己实现的类，以及第三方类库位于用户类路径
+ *
+ * 用户类路径的默认值是当前目录。可以设置CLASSPATH环境变量来修改用户类路径。
+ * 可以通过 -cp 选项修改，
+ * -cp 选项的优先级更高，可以覆盖CLASSPATH环境变量设置。
+ * -cp 选项既可以指定目录，也可以指定JAR文件，各项之间以 ':' 分隔。
+ * 以 '*' 结尾的项（如 lib/ 后跟 *）表示该目录下所有的 jar 文件。
+ *
+ * 系统类加载器的类由虚拟机直接在用户类路径上查找，不用回调 Java 层的 ClassLoader.
+ * 扩展类路径上有的类除外，它们仍按双亲委派由扩展类加载器加载。
+ */
+
+/*
+ * 解析 @classpath，不存在的项被忽略。
+ */
+void initUserClassPath(const char *classpath);
+
+/*
+ * 用户类路径上的每一项是否都由 findOnUserClassPath 处理。
+ * 不处理的有：打不开的 jar，以及 manifest 中有 Class-Path 的 jar（它引用的 jar 由 Java 层打开）。
+ * 为 true 时，findUserClass 找不到的类在系统类加载器中也一定找不到。
+ */
+bool isUserClassPathComplete();
+
+// 打开扩展类路径上的 jar，用于 isExtClass
+void initExtClassPath(const std::vector<std::string> &jars);
+
+// 扩展类路径上是否有类 @className（不带 .class 后缀）
+bool isExtClass(const utf8_t *className);
+
+/*
+ * 按用户类路径中各项的顺序查找 @name（如 a/b/C.class），
+ * 找到返回其内容，@len 为长度；内容分配在 @metaspace 中。
+ * @codeSource 不为 null 时，写入找到它的目录或 jar 的 URL（如 file:/a/b/ 或 file:/a/b.jar），
+ * 这个字符串在虚拟机运行期间一直有效。
+ *
+ * jar 使用与启动类路径相同的哈希索引（参见 util/JarFile.h）。
+ * 找不到的名字记在负缓存中，再次查找时不用再访问文件系统。
+ */
+u1 *findOnUserClassPath(const char *name, size_t &len, Metaspace *metaspace, const char **codeSource = nullptr);
+
+// 查找用户类 @className（不带 .class 后缀）
+u1 *findUserClass(const utf8_t *className, size_t &len, Metaspace *metaspace, const char **codeSource = nullptr);
+
+#endif //KAYOVM_USER_CLASS_PATH_H
@@ -2,91 +2,284 @@
  * Author: kayo
  */
 
+#include <cerrno>
+#include <ctime>
 #include "Monitor.h"
 #include "Thread.h"
 
-Monitor::Monitor()
+#define SPIN_LIMIT_MIN 16
+#define SPIN_LIMIT_MAX (16*1024)
+
+static inline void spinPause()
 {
-    pthread_mutexattr_t attr;
-    pthread_mutexattr_init(&attr);
-    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE); // 同一线程可重入的锁
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__ ("pause");
+#endif
+}
 
-    pthread_mutex_init(&mutex, &attr);
+void Monitor::Queue::append(Thread *t)
+{
+    assert(t != nullptr);
+    t->monNext = nullptr;
+    if (tail == nullptr) {
+        head = tail = t;
+    } else {
+        tail->monNext = t;
+        tail = t;
+    }
 }
 
-void Monitor::lock(Thread *thread)
+Thread *Monitor::Queue::removeFirst()
 {
-    assert(thread != nullptr);
+    Thread *t = head;
+    if (t != nullptr) {
+        head = t->monNext;
+        if (head == nullptr)
+            tail = nullptr;
+        t->monNext = nullptr;
+    }
+    return t;
+}
 
-    if(owner == thread) {
-        count++;
-    } else {
-        entering++;
-    //    disableSuspend(thread);
-        thread->setStatus(BLOCKED);
-        pthread_mutex_lock(&mutex);
-        thread->setStatus(RUNNING);
-    //    enableSuspend(thread);
-        entering--;
-        owner = thread;
+bool Monitor::Queue::remove(Thread *t)
+{
+    Thread *prev = nullptr;
+    for (Thread *curr = head; curr != nullptr; prev = curr, curr = curr->monNext) {
+        if (curr == t) {
+            if (prev == nullptr)
+                head = curr->monNext;
+            else
+                prev->monNext = curr->monNext;
+            if (tail == curr)
+                tail = prev;
+            curr->monNext = nullptr;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Monitor::Queue::contains(Thread *t)
+{
+    for (Thread *curr = head; curr != nullptr; curr = curr->monNext) {
+        if (curr == t)
+            return true;
     }
+    return false;
+}
+
+Monitor::Monitor(Thread *owner, int count): owner(owner), count(count), spinLimit(SPIN_LIMIT_MIN)
+{
+    pthread_mutex_init(&mutex, nullptr);
 }
 
 bool Monitor::tryLock(Thread *thread)
 {
     assert(thread != nullptr);
 
-    if(owner == thread) {
+    if (owner == thread) {
         count++;
-    } else {
-        if(pthread_mutex_trylock(&mutex) != 0)
-            return false;
-        owner = thread;
+        return true;
     }
 
-    return true;
+    return owner == nullptr and __sync_bool_compare_and_swap(&owner, nullptr, thread);
 }
 
-void Monitor::unlock(Thread *thread)
+void Monitor::lock(Thread *thread)
 {
     assert(thread != nullptr);
 
-    if(owner == thread) {
-        if(count == 0) {
-            owner = nullptr;
-            pthread_mutex_unlock(&mutex);
-        } else {
-            count--;
+    if (tryLock(thread))
+        return;
+
+    // 先自旋，持有者往往很快就会释放
+    int limit = spinLimit;
+    for (int i = 0; i < limit; i++) {
+        spinPause();
+        if (owner == nullptr and __sync_bool_compare_and_swap(&owner, nullptr, thread)) {
+            // 自旋成功了，下次可以多自旋一会
+            if (spinLimit < SPIN_LIMIT_MAX)
+                spinLimit *= 2;
+            return;
         }
     }
+
+    if (spinLimit > SPIN_LIMIT_MIN)
+        spinLimit /= 2;
+
+    // 自旋失败，进入 entry queue 阻塞等待
+    thread->setStatus(BLOCKED);
+    pthread_mutex_lock(&mutex);
+    entryQueue.append(thread);
+
+    while (true) {
+        // 与 unlock 中的 barrier 配对：
+        // 要么这里看到 owner 为空，要么 unlock 看到 entry queue 中的本线程。
+        __sync_synchronize();
+        if (owner == nullptr and __sync_bool_compare_and_swap(&owner, nullptr, thread))
+            break;
+
+        pthread_cond_wait(&thread->waitCond, &mutex);
+        // 被唤醒时已被移出 entry queue，如果竞争失败了要重新排队。
+        if (!entryQueue.contains(thread))
+            entryQueue.append(thread);
+    }
+
+    entryQueue.remove(thread);
+    pthread_mutex_unlock(&mutex);
+    thread->setStatus(RUNNING);
 }
 
-bool Monitor::wait(Thread *thread)
+void Monitor::wakeUpEntering()
+{
+    Thread *t = entryQueue.removeFirst();
+    if (t != nullptr)
+        pthread_cond_signal(&t->waitCond);
+}
+
+bool Monitor::unlock(Thread *thread)
 {
     assert(thread != nullptr);
 
-    // Check we own the monitor
-    if(owner != thread)
-        return false; // todo
+    if (owner != thread)
+        return false;
+
+    if (count > 0) {
+        count--;
+        return true;
+    }
+
+    __sync_synchronize(); // 保证临界区中的写操作在释放之前完成
+    owner = nullptr;
+    __sync_synchronize();
+
+    if (entryQueue.head != nullptr) {
+        pthread_mutex_lock(&mutex);
+        wakeUpEntering();
+        pthread_mutex_unlock(&mutex);
+    }
 
-    // todo ...................
-    //pthread_cond_wait()
+    return true;
 }
 
-bool Monitor::timedwait(Thread *thread, long long ms, int ns)
+bool Monitor::wait(Thread *thread)
+{
+    return timedwait(thread, 0, 0);
+}
+
+bool Monitor::timedwait(Thread *thread, jlong ms, jint ns)
 {
     assert(thread != nullptr);
+    assert(ms >= 0 and ns >= 0);
+
+    // Check we own the monitor
+    if (owner != thread)
+        return false;
+
+    bool timed = ms > 0 or ns > 0;
+    struct timespec deadline;
+    if (timed) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        jlong nsec = deadline.tv_nsec + (ms % 1000) * 1000000 + ns;
+        deadline.tv_sec += ms / 1000 + nsec / 1000000000;
+        deadline.tv_nsec = nsec % 1000000000;
+    }
+
+    pthread_mutex_lock(&mutex);
+
+    // 与 Thread::interrupt 中的 barrier 配对
+    thread->waitMon = this;
+    __sync_synchronize();
+
+    bool interrupted = thread->interrupted;
+    if (!interrupted) {
+        int oldCount = count;
+        thread->notified = false;
+        waitSet.append(thread);
+
+        // 完全释放 Monitor，并唤醒一个等待进入的线程
+        count = 0;
+        __sync_synchronize();
+        owner = nullptr;
+        wakeUpEntering();
+
+        thread->setStatus(timed ? OBJECT_TIMED_WAIT : OBJECT_WAIT);
+        bool timeout = false;
+        while (!thread->notified and !thread->interrupted and !timeout) {
+            if (timed)
+                timeout = pthread_cond_timedwait(&thread->waitCond, &mutex, &deadline) == ETIMEDOUT;
+            else
+                pthread_cond_wait(&thread->waitCond, &mutex);
+        }
+
+        // 超时或被中断，本线程还在 wait set 中
+        if (!thread->notified)
+            waitSet.remove(thread);
+
+        thread->waitMon = nullptr;
+        pthread_mutex_unlock(&mutex);
+
+        // 重新获取 Monitor
+        lock(thread);
+        count = oldCount;
+        thread->setStatus(RUNNING);
 
-    // todo ...................
-    //pthread_cond_timedwait()
+        interrupted = thread->interrupted;
+    } else {
+        thread->waitMon = nullptr;
+        pthread_mutex_unlock(&mutex);
+    }
+
+    if (interrupted) {
+        thread->interrupted = false;
+        thread_throw(new InterruptedException);
+    }
+
+    return true;
 }
 
 bool Monitor::notify(Thread *thread)
 {
     assert(thread != nullptr);
+
+    if (owner != thread)
+        return false;
+
+    pthread_mutex_lock(&mutex);
+    Thread *t = waitSet.removeFirst();
+    if (t != nullptr) {
+        t->notified = true;
+        pthread_cond_signal(&t->waitCond);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    return true;
 }
 
 bool Monitor::notifyAll(Thread *thread)
 {
     assert(thread != nullptr);
+
+    if (owner != thread)
+        return false;
+
+    pthread_mutex_lock(&mutex);
+    for (Thread *t; (t = waitSet.removeFirst()) != nullptr;) {
+        t->notified = true;
+        pthread_cond_signal(&t->waitCond);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    return true;
+}
+
+void Monitor::interrupt(Thread *waiter)
+{
+    assert(waiter != nullptr);
+
+    // 持有 mutex 再唤醒，保证 @waiter 不会在检查中断状态后错过唤醒
+    pthread_mutex_lock(&mutex);
+    if (waiter->waitMon == this)
+        pthread_cond_signal(&waiter->waitCond);
+    pthread_mutex_unlock(&mutex);
 }
@@ -6,35 +6,83 @@
 #define KAYOVM_MONITOR_H
 
 #include <pthread.h>
+#include "../jtypes.h"
 
 class Thread;
 
+/*
+ * 膨胀后的对象锁，由对象的 lock word 指向，参见 Object.h
+ *
+ * 获取 Monitor 时先自适应地自旋，自旋失败后进入 entry queue 阻塞等待。
+ * 调用 wait 的线程进入 wait set，被 notify、中断或超时后离开 wait set，
+ * 再重新竞争 Monitor。
+ *
+ * 线程在 entry queue 和 wait set 中都阻塞在自己的 Thread::waitCond 上，
+ * 一个线程同一时刻最多在一个队列中。
+ */
 class Monitor {
+    // 保护 entry queue 和 wait set
     pthread_mutex_t mutex;
-    pthread_cond_t cond;
-    Thread *owner = nullptr;
-    int count = 0;
-    int waiting = 0;
-    int notifying = 0;
-    int interrupting = 0;
-    int entering = 0;
- //   Monitor *next;
-//    char in_use;
+
+    Thread *volatile owner = nullptr;
+    int count = 0; // 重入次数
+
+    // 先进先出的线程队列，以 Thread::monNext 链接
+    struct Queue {
+        Thread *head = nullptr;
+        Thread *tail = nullptr;
+
+        void append(Thread *t);
+        Thread *removeFirst();
+        bool remove(Thread *t);
+        bool contains(Thread *t);
+    };
+
+    Queue entryQueue;
+    Queue waitSet;
+
+    /*
+     * 自旋的次数，自旋成功时增加，失败时减少。
+     * 多个线程并发修改也无所谓，只是一个估计值。
+     */
+    int spinLimit;
+
+    // 调用时需持有 mutex
+    void wakeUpEntering();
+
 public:
-    Monitor();
+    /*
+     * 对象的 thin lock 膨胀时，Monitor 直接由其 thin lock 的持有者持有，
+     * 并继承 thin lock 的重入次数。
+     */
+    explicit Monitor(Thread *owner = nullptr, int count = 0);
 
     void lock(Thread *thread);
 
     bool tryLock(Thread *thread);
 
-    void unlock(Thread *thread);
+    // return false if @thread is not the owner.
+    bool unlock(Thread *thread);
 
+    bool isOwner(Thread *thread) const { return owner == thread; }
+
+    /*
+     * 当前线程在此 Monitor 上等待，直到被 notify、中断或超时，然后重新获取 Monitor。
+     * 如果等待时被中断，清除中断状态并抛出 InterruptedException.
+     *
+     * return false if @thread is not the owner.
+     */
     bool wait(Thread *thread);
 
-    bool timedwait(Thread *thread, long long ms, int ns);
+    // ms == 0 and ns == 0 表示不超时
+    bool timedwait(Thread *thread, jlong ms, jint ns);
 
+    // return false if @thread is not the owner.
     bool notify(Thread *thread);
     bool notifyAll(Thread *thread);
+
+    // 唤醒在此 Monitor 上 wait 的 @waiter，由中断 @waiter 的线程调用
+    void interrupt(Thread *waiter);
 };
 
 
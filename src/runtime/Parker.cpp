@@ -0,0 +1,65 @@
+/*
+ * Author: kayo
+ */
+
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "Parker.h"
+
+using namespace std;
+
+static_assert(sizeof(atomic<int>) == sizeof(int), "futex word must be a plain int");
+
+// 超时的秒数上限（从现在算起），防止 32 位的 time_t 溢出
+#define MAX_PARK_SECS 100000000
+
+static inline int *futexWord(atomic<int> &a)
+{
+    return reinterpret_cast<int *>(&a);
+}
+
+void Parker::futexWake()
+{
+    syscall(SYS_futex, futexWord(permit), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+void Parker::park(bool isAbsolute, jlong time)
+{
+    // 宣告将要阻塞，失败说明在这之前被 unpark 了
+    int expected = 0;
+    if (!permit.compare_exchange_strong(expected, -1, memory_order_acq_rel)) {
+        permit.store(0, memory_order_relaxed);
+        return;
+    }
+
+    struct timespec ts;
+    struct timespec *timeout = nullptr;
+    int op = FUTEX_WAIT_PRIVATE;
+
+    if (isAbsolute) {
+        // 绝对时间用 FUTEX_WAIT_BITSET，超时时间以 CLOCK_REALTIME 计
+        jlong secs = time / 1000;
+        jlong maxSecs = (jlong) ::time(nullptr) + MAX_PARK_SECS;
+        ts.tv_sec = secs > maxSecs ? maxSecs : secs;
+        ts.tv_nsec = (time % 1000) * 1000000;
+        timeout = &ts;
+        op = FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME;
+    } else if (time > 0) {
+        // 相对时间，FUTEX_WAIT 以 CLOCK_MONOTONIC 计，不受系统时间调整的影响
+        jlong secs = time / 1000000000;
+        ts.tv_sec = secs > MAX_PARK_SECS ? MAX_PARK_SECS : secs;
+        ts.tv_nsec = time % 1000000000;
+        timeout = &ts;
+    }
+
+    /*
+     * permit 已不是 -1（在这之前被 unpark 了）时立即返回 EAGAIN，所以不会丢失唤醒。
+     * 被信号打断（EINTR）当作伪唤醒处理，由调用者重新检查条件。
+     */
+    syscall(SYS_futex, futexWord(permit), op, -1, timeout, nullptr, FUTEX_BITSET_MATCH_ANY);
+
+    // 无论是被唤醒还是超时，都消耗掉可能的许可，恢复为 0
+    permit.exchange(0, memory_order_acquire);
+}
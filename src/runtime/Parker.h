@@ -0,0 +1,52 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_PARKER_H
+#define KAYOVM_PARKER_H
+
+#include <atomic>
+#include "../jtypes.h"
+
+/*
+ * 每个线程一个，实现 sun/misc/Unsafe 的 park 和 unpark（即 LockSupport）。
+ *
+ * permit 只有一个字：
+ *   0：没有许可；
+ *   1：有许可（unpark 过，还没有被 park 消耗）；
+ *  -1：线程阻塞在 park 中，在 permit 上 futex wait.
+ *
+ * 没有竞争时 park 和 unpark 都只是一次原子操作，只有线程真正需要阻塞或唤醒时才进入内核。
+ */
+class Parker {
+    std::atomic<int> permit{0};
+
+    void futexWake();
+
+public:
+    // 如果有许可，消耗掉并返回 true
+    bool tryPark()
+    {
+        return permit.load(std::memory_order_relaxed) == 1
+               and permit.exchange(0, std::memory_order_acquire) == 1;
+    }
+
+    /*
+     * 阻塞直到被 unpark 或超时，也可能没有原因的返回（伪唤醒）。
+     * @isAbsolute 为 true 时，@time 是从 Epoch 算起的毫秒数表示的截止时间；
+     * 否则 @time 是以纳秒为单位的相对时间，为 0 表示不超时。
+     * 调用者保证 @time 有效：相对时间不小于 0，绝对时间大于 0.
+     */
+    void park(bool isAbsolute, jlong time);
+
+    void unpark()
+    {
+        // 已经有许可了，什么也不用做
+        if (permit.load(std::memory_order_relaxed) == 1)
+            return;
+        if (permit.exchange(1, std::memory_order_release) == -1)
+            futexWake();
+    }
+};
+
+#endif //KAYOVM_PARKER_H
@@ -3,6 +3,11 @@
  */
 
 #include <pthread.h>
+#include <semaphore.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
 #include "../kayo.h"
 #include "../debug.h"
 #include "../objects/class_loader.h"
@@ -13,6 +18,9 @@
 #include "../objects/Class.h"
 #include "../objects/Field.h"
 #include "../objects/Array.h"
+#include "Monitor.h"
+#include "suspend.h"
+#include "alloc_profiler.h"
 
 #if TRACE_THREAD
 #define TRACE PRINT_TRACE
@@ -48,6 +56,7 @@ Thread *mainThread;
 Thread *initMainThread()
 {
     pthread_key_create(&thread_key, nullptr);
+    initSuspend();
 
     threadClass = loadBootClass(S(java_lang_Thread));
 
@@ -84,7 +93,9 @@ void createVMThread(VMThreadInitInfo *info)
         auto a = (VMThreadInitInfo *) args;
         auto newThread = new Thread();
         newThread->setThreadGroupAndName(sysThreadGroup, a->threadName);
-        return a->start(nullptr);
+        void *result = a->start(nullptr);
+        newThread->finish();
+        return result;
     };
 
     pthread_t tid;
@@ -101,7 +112,9 @@ void createCustomerThread(Object *jThread)
     static auto start = [](void *args0) {
         auto __jThread = (jref) args0;
         auto newThread = new Thread(__jThread);
-        return (void *) execJavaFunc(runMethod, __jThread);
+        auto result = (void *) execJavaFunc(runMethod, __jThread);
+        newThread->finish();
+        return result;
     };
 
     pthread_t tid;
@@ -117,11 +130,31 @@ Thread::Thread(Object *jThread0, jint priority): jThread(jThread0)
 {
     assert(THREAD_MIN_PRIORITY <= priority && priority <= THREAD_MAX_PRIORITY);
 
+    pthread_cond_init(&waitCond, nullptr);
+    pthread_mutex_init(&sleepMutex, nullptr);
+
+    tid = pthread_self();
+    if (allocSampleInterval > 0)
+        allocSampleCountdown = nextSampleInterval();
+
+    pthread_attr_t attr;
+    void *stackAddr;
+    size_t stackSize;
+    pthread_getattr_np(tid, &attr);
+    pthread_attr_getstack(&attr, &stackAddr, &stackSize);
+    pthread_attr_destroy(&attr);
+    stackTop = (uintptr_t) stackAddr + stackSize;
+
+    /*
+     * 先登记线程，再分配对象：
+     * 登记后线程的 C 栈才会被 gc 扫描，而分配对象可能引起 gc.
+     * 持有 newThreadMutex 时不能分配，gc 暂停其他线程时要获取它。
+     */
     pthread_mutex_lock(&newThreadMutex);
     saveCurrentThread(this);
     g_all_threads.push_back(this);
-
-    tid = pthread_self();
+    id = g_all_threads.size();
+    pthread_mutex_unlock(&newThreadMutex);
 
     if (jThread == nullptr)
         jThread = newObject(threadClass);
@@ -130,14 +163,24 @@ Thread::Thread(Object *jThread0, jint priority): jThread(jThread0)
     jThread->setFieldValue(S(priority), S(I), (slot_t) priority);
 //    if (vmEnv.sysThreadGroup != nullptr)   todo
 //        setThreadGroupAndName(vmEnv.sysThreadGroup, nullptr);
+}
+
+void Thread::finish()
+{
+    assert(this == getCurrentThread());
+
+    g_heap.flushAllocatedBytes();
+    pthread_mutex_lock(&newThreadMutex);
+    clearVMStack();
+    exited = true;
     pthread_mutex_unlock(&newThreadMutex);
 }
 
 Thread *Thread::from(Object *jThread0)
 {
     assert(jThread0 != nullptr);
-    assert(0 <= eetopField->id && eetopField->id < jThread0->clazz->instFieldsCount);
-    return *(Thread **)(jThread0->data + eetopField->id);//jThread0->getInstFieldValue<Thread *>(eetopField);
+    // private long eetop;
+    return (Thread *) (intptr_t) jThread0->getInstFieldValue<jlong>(eetopField);
 }
 
 Thread *Thread::from(jlong threadId)
@@ -153,6 +196,16 @@ Thread *Thread::from(jlong threadId)
     return nullptr;
 }
 
+Thread *Thread::fromId(u4 id)
+{
+    assert(id > 0);
+
+    pthread_mutex_lock(&newThreadMutex);
+    Thread *t = id <= g_all_threads.size() ? g_all_threads[id - 1] : nullptr;
+    pthread_mutex_unlock(&newThreadMutex);
+    return t;
+}
+
 void Thread::setThreadGroupAndName(Object *threadGroup, const char *threadName)
 {
     assert(threadGroup != nullptr);
@@ -181,6 +234,182 @@ bool Thread::isAlive()
     return false;
 }
 
+void Thread::interrupt()
+{
+    interrupted = true;
+    // 与 Monitor::timedwait 中的 barrier 配对：
+    // 要么被中断线程看到中断状态，要么这里看到它正在 wait 的 Monitor。
+    __sync_synchronize();
+
+    Monitor *mon = waitMon;
+    if (mon != nullptr)
+        mon->interrupt(this);
+
+    pthread_mutex_lock(&sleepMutex);
+    pthread_cond_signal(&waitCond);
+    pthread_mutex_unlock(&sleepMutex);
+
+    // 唤醒 park 中的线程，在设置中断状态之后，保证其不会错过中断
+    parker.unpark();
+}
+
+bool Thread::isInterrupted(bool clearInterrupted)
+{
+    bool b = interrupted;
+    if (b and clearInterrupted)
+        interrupted = false;
+    return b;
+}
+
+void Thread::sleep(jlong millis, jint nanos)
+{
+    assert(millis >= 0 and nanos >= 0);
+    assert(this == getCurrentThread());
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    jlong nsec = deadline.tv_nsec + (millis % 1000) * 1000000 + nanos;
+    deadline.tv_sec += millis / 1000 + nsec / 1000000000;
+    deadline.tv_nsec = nsec % 1000000000;
+
+    setStatus(SLEEPING);
+    pthread_mutex_lock(&sleepMutex);
+    while (!interrupted) {
+        if (pthread_cond_timedwait(&waitCond, &sleepMutex, &deadline) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&sleepMutex);
+    setStatus(RUNNING);
+
+    if (isInterrupted(true)) {
+        thread_throw(new InterruptedException);
+    }
+}
+
+void Thread::park(bool isAbsolute, jlong time)
+{
+    assert(this == getCurrentThread());
+
+    if (parker.tryPark())
+        return;
+    if (interrupted)
+        return;
+    if (time < 0 or (isAbsolute and time == 0))
+        return;
+
+    setStatus(!isAbsolute and time == 0 ? PARKED : TIMED_PARKED);
+    parker.park(isAbsolute, time);
+    setStatus(RUNNING);
+}
+
+/* Stop-the-world，参见 suspend.h */
+
+thread_local volatile sig_atomic_t noSuspendDepth = 0;
+thread_local volatile sig_atomic_t suspendPending = 0;
+
+static volatile sig_atomic_t worldStopped = 0;
+
+/*
+ * 第几次 stopTheWorld()，以及当前线程最近一次在第几次中暂停。
+ * 上一次恢复时的信号可能在下一次暂停开始后才被处理，
+ * 用它们保证每个线程每次只暂停（并应答）一次。
+ */
+static volatile sig_atomic_t stopRound = 0;
+static thread_local sig_atomic_t suspendedRound = 0;
+
+// 线程暂停和恢复时各 post 一次
+static sem_t suspendAck;
+
+// stopTheWorld() 暂停了的线程数
+static int suspendedCount;
+
+// 只能调用 async-signal-safe 的函数
+static void suspendHandler(int sig)
+{
+    if (!worldStopped or suspendedRound == stopRound)
+        return; // startTheWorld() 用来唤醒的信号，或者这次已经暂停过了
+    if (noSuspendDepth > 0) {
+        // 离开 NoSuspendScope 时再暂停
+        suspendPending = 1;
+        return;
+    }
+
+    int savedErrno = errno;
+    suspendPending = 0;
+    suspendedRound = stopRound;
+    auto t = (Thread *) pthread_getspecific(thread_key);
+    // 被打断时的寄存器保存在此栈帧之上
+    t->suspendedSp = (uintptr_t) &t;
+    sem_post(&suspendAck);
+
+    sigset_t mask;
+    sigfillset(&mask);
+    sigdelset(&mask, SUSPEND_SIGNAL);
+    while (worldStopped)
+        sigsuspend(&mask);
+
+    t->suspendedSp = 0;
+    sem_post(&suspendAck);
+    errno = savedErrno;
+}
+
+void initSuspend()
+{
+    sem_init(&suspendAck, 0, 0);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = suspendHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SUSPEND_SIGNAL, &sa, nullptr);
+}
+
+void suspendDeferred()
+{
+    // 在信号处理函数中暂停
+    pthread_kill(pthread_self(), SUSPEND_SIGNAL);
+}
+
+static void waitAcks(int count)
+{
+    for (int i = 0; i < count; i++) {
+        while (sem_wait(&suspendAck) != 0)
+            ; // EINTR
+    }
+}
+
+void stopTheWorld()
+{
+    assert(noSuspendDepth == 0);
+
+    // 暂停期间持有，不能创建新线程，线程也不能结束
+    pthread_mutex_lock(&newThreadMutex);
+    stopRound = stopRound + 1;
+    worldStopped = 1;
+
+    Thread *self = getCurrentThread();
+    suspendedCount = 0;
+    for (Thread *t : g_all_threads) {
+        if (t != self and !t->exited and pthread_kill(t->tid, SUSPEND_SIGNAL) == 0)
+            suspendedCount++;
+    }
+    waitAcks(suspendedCount);
+}
+
+void startTheWorld()
+{
+    worldStopped = 0;
+
+    Thread *self = getCurrentThread();
+    for (Thread *t : g_all_threads) {
+        if (t != self and !t->exited)
+            pthread_kill(t->tid, SUSPEND_SIGNAL);
+    }
+    waitAcks(suspendedCount);
+    pthread_mutex_unlock(&newThreadMutex);
+}
+
 Frame *Thread::allocFrame(Method *m, bool vm_invoke)
 {
     assert(m != nullptr);
@@ -11,6 +11,7 @@
 #include "../jtypes.h"
 #include "../throwables.h"
 #include "../util/encoding.h"
+#include "Parker.h"
 
 class Object;
 class ClassLoader;
@@ -88,25 +89,87 @@ class Thread {
     u1 vmStack[VM_STACK_SIZE]; // 虚拟机栈，一个线程只有一个虚拟机栈
     Frame *topFrame = nullptr;
 
+    /*
+     * 线程阻塞在 Monitor 的 entry queue 或 wait set 上，以及 sleep 时，
+     * 都等待在 waitCond 上。
+     */
+    pthread_cond_t waitCond;
+    pthread_mutex_t sleepMutex;
+
+    Thread *monNext = nullptr;   // Monitor 队列中的下一个线程
+    Monitor *waitMon = nullptr;  // 正在 wait 的 Monitor
+    bool notified = false;
+    volatile bool interrupted = false;
+
+    // 用于 Unsafe.park/unpark
+    Parker parker;
+
 public:
+    // 距离下一次分配采样还要分配的字节数，参见 alloc_profiler.h
+    jlong allocSampleCountdown = 0;
+
     // 所关联的 Object of java.lang.Thread
     Object *jThread = nullptr;
 
     // 所关联的 POSIX thread 对应的id
     pthread_t tid;
 
+    // 虚拟机内部的线程编号，从1开始，用于对象的 thin lock
+    u4 id;
+
+    /*
+     * 线程的 C 栈的最高地址，以及被暂停时的栈顶（参见 suspend.h），
+     * gc 保守地扫描两者之间的部分。
+     */
+    uintptr_t stackTop = 0;
+    volatile uintptr_t suspendedSp = 0;
+
+    // 线程已结束，不再被暂停和扫描
+    volatile bool exited = false;
+
     explicit Thread(Object *jThread = nullptr, jint priority = THREAD_NORM_PRIORITY);
 
     void setThreadGroupAndName(Object *threadGroup, const char *threadName);
 
+    // 线程的 start routine 结束前调用
+    void finish();
+
     static Thread *from(Object *jThread0);
     static Thread *from(jlong threadId);
 
+    // 由虚拟机内部的线程编号得到线程
+    static Thread *fromId(u4 id);
+
     void setStatus(jint status);
     jint getStatus();
 
     bool isAlive();
 
+    /*
+     * 中断此线程，
+     * 如果此线程正在 wait 或 sleep，将其唤醒，由其抛出 InterruptedException.
+     */
+    void interrupt();
+
+    bool isInterrupted(bool clearInterrupted);
+
+    /*
+     * 当前线程睡眠，可被中断。
+     * 如果睡眠时被中断，清除中断状态并抛出 InterruptedException.
+     */
+    void sleep(jlong millis, jint nanos);
+
+    /*
+     * 当前线程 park，参见 Parker::park
+     * 有许可、已被中断或截止时间已过时立即返回，不清除中断状态也不抛出异常。
+     */
+    void park(bool isAbsolute, jlong time);
+
+    void unpark()
+    {
+        parker.unpark();
+    }
+
     void clearVMStack()
     {
         topFrame = nullptr;
@@ -135,7 +198,7 @@ public:
      */
     Array *dump(int maxDepth);
 
-    //friend Monitor;
+    friend class Monitor;
 };
 
 extern Thread *mainThread;
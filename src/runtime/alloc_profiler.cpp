@@ -0,0 +1,223 @@
+/*
+ * Author: kayo
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <climits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unistd.h>
+#include "alloc_profiler.h"
+#include "Frame.h"
+#include "../kayo.h"
+#include "../objects/Class.h"
+#include "../objects/Method.h"
+#include "../memory/Metaspace.h"
+
+using namespace std;
+
+size_t allocSampleInterval = 0;
+char allocProfilePath[PATH_MAX] = { 0 };
+
+// 最多记录的栈帧数，更深的栈只保留最内层的部分
+#define MAX_SAMPLE_DEPTH 64
+
+namespace {
+/*
+ * 分配点：[Class *, Method *, pc, Method *, pc, ...]，栈帧从内到外
+ * 卸载 class loader 时，引用其类的分配点移到 retiredSites 中，参见 retireAllocSites
+ */
+using SiteKey = vector<uintptr_t>;
+
+struct SiteKeyHash {
+    size_t operator()(const SiteKey &k) const
+    {
+        size_t h = 0;
+        for (uintptr_t x : k)
+            h = h*31 + x;
+        return h;
+    }
+};
+
+struct SiteStats {
+    uint64_t count = 0; // 估计的分配次数
+    uint64_t bytes = 0; // 估计的分配字节数
+};
+}
+
+static pthread_mutex_t sitesMutex = PTHREAD_MUTEX_INITIALIZER;
+static unordered_map<SiteKey, SiteStats, SiteKeyHash> sites;
+
+// 已卸载的类的分配点，key 为 folded stack
+static unordered_map<string, SiteStats> retiredSites;
+
+jlong nextSampleInterval()
+{
+    static __thread unsigned int seed;
+    if (seed == 0)
+        seed = (unsigned int) (uintptr_t) &seed ^ (unsigned int) time(nullptr);
+    double u = (rand_r(&seed) + 1.0) / ((double) RAND_MAX + 2.0); // (0, 1)
+    return (jlong) (-log(u) * allocSampleInterval) + 1;
+}
+
+void sampleAllocation(Thread *thread, Class *c, size_t size)
+{
+    assert(thread != nullptr and c != nullptr);
+
+    // 每个样本代表这段间隔内分配的所有字节，大于间隔的对象代表它自己
+    uint64_t weight = max<uint64_t>(size, allocSampleInterval);
+    thread->allocSampleCountdown = nextSampleInterval();
+
+    SiteKey key;
+    key.reserve(1 + 2*MAX_SAMPLE_DEPTH);
+    key.push_back((uintptr_t) c);
+    int depth = 0;
+    for (Frame *f = thread->getTopFrame(); f != nullptr and depth < MAX_SAMPLE_DEPTH; f = f->prev, depth++) {
+        key.push_back((uintptr_t) f->method);
+        key.push_back((uintptr_t) f->reader.pc);
+    }
+
+    pthread_mutex_lock(&sitesMutex);
+    SiteStats &s = sites[key];
+    s.count += max<uint64_t>(weight/max<size_t>(size, 1), 1);
+    s.bytes += weight;
+    pthread_mutex_unlock(&sitesMutex);
+}
+
+// 类名转为 folded stacks 中可用的形式（不能包含 ';' 和空格），如 [Ljava/lang/String; -> java/lang/String[]
+static string readableClassName(const utf8_t *className)
+{
+    int dim = 0;
+    while (className[dim] == '[')
+        dim++;
+
+    string name;
+    if (dim == 0) {
+        name = className;
+    } else if (className[dim] == 'L') {
+        name.assign(className + dim + 1, strlen(className + dim + 1) - 1);
+    } else {
+        switch (className[dim]) {
+            case 'Z': name = "boolean"; break;
+            case 'B': name = "byte"; break;
+            case 'C': name = "char"; break;
+            case 'S': name = "short"; break;
+            case 'I': name = "int"; break;
+            case 'J': name = "long"; break;
+            case 'F': name = "float"; break;
+            case 'D': name = "double"; break;
+            default: name = className + dim; break;
+        }
+    }
+
+    for (int i = 0; i < dim; i++)
+        name += "[]";
+    return name;
+}
+
+static void writeFolded(const char *path, vector<pair<string, SiteStats>> &stacks, bool byBytes)
+{
+    sort(stacks.begin(), stacks.end(), [byBytes](const pair<string, SiteStats> &x, const pair<string, SiteStats> &y) {
+        return byBytes ? x.second.bytes > y.second.bytes : x.second.count > y.second.count;
+    });
+
+    FILE *fp = fopen(path, "w");
+    if (fp == nullptr) {
+        printvm("Unable to create %s\n", path);
+        return;
+    }
+    for (auto &s : stacks) {
+        fprintf(fp, "%s %llu\n", s.first.c_str(),
+                (unsigned long long) (byBytes ? s.second.bytes : s.second.count));
+    }
+    fclose(fp);
+}
+
+// 分配点在报告中的形式，栈帧从外到内
+static string foldedStack(const SiteKey &k)
+{
+    string stack;
+    // 栈帧在 key 中从内到外
+    for (auto i = (long) k.size() - 2; i >= 1; i -= 2) {
+        auto m = (Method *) k[i];
+        stack += m->clazz->className;
+        stack += '.';
+        stack += m->name;
+        jint line = m->getLineNumber((int) k[i + 1]);
+        if (line >= 0)
+            stack += ":" + to_string(line);
+        stack += ';';
+    }
+    stack += readableClassName(((Class *) k[0])->className);
+    return stack;
+}
+
+static void addStats(unordered_map<string, SiteStats> &folded, const string &stack, const SiteStats &stats)
+{
+    SiteStats &s = folded[stack];
+    s.count += stats.count;
+    s.bytes += stats.bytes;
+}
+
+void retireAllocSites(Metaspace *metaspace)
+{
+    if (allocSampleInterval == 0)
+        return;
+
+    pthread_mutex_lock(&sitesMutex);
+    for (auto iter = sites.begin(); iter != sites.end(); ) {
+        const SiteKey &k = iter->first;
+        // 数组类和其元素类分配在同一个 Metaspace 中
+        bool refers = metaspace->contains((const void *) k[0]);
+        for (size_t i = 1; !refers and i < k.size(); i += 2)
+            refers = metaspace->contains((const void *) k[i]);
+
+        if (refers) {
+            addStats(retiredSites, foldedStack(k), iter->second);
+            iter = sites.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+    pthread_mutex_unlock(&sitesMutex);
+}
+
+void dumpAllocProfile()
+{
+    if (allocSampleInterval == 0)
+        return;
+
+    // 相同的调用栈（不同 pc 但在同一行）合并
+    unordered_map<string, SiteStats> folded;
+
+    pthread_mutex_lock(&sitesMutex);
+    folded = retiredSites;
+    for (auto &site : sites)
+        addStats(folded, foldedStack(site.first), site.second);
+    pthread_mutex_unlock(&sitesMutex);
+
+    vector<pair<string, SiteStats>> stacks(folded.begin(), folded.end());
+
+    char prefix[PATH_MAX];
+    if (allocProfilePath[0] != 0)
+        snprintf(prefix, sizeof(prefix), "%s", allocProfilePath);
+    else
+        snprintf(prefix, sizeof(prefix), "alloc_pid%d", (int) getpid());
+
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s.bytes.folded", prefix);
+    writeFolded(path, stacks, true);
+    snprintf(path, sizeof(path), "%s.count.folded", prefix);
+    writeFolded(path, stacks, false);
+
+    printf("Allocation profile (%zu sites) written to %s.{bytes,count}.folded\n", stacks.size(), prefix);
+}
+
+void initAllocProfiler()
+{
+    if (allocSampleInterval > 0)
+        atexit(dumpAllocProfile);
+}
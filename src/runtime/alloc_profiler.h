@@ -0,0 +1,80 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_ALLOC_PROFILER_H
+#define KAYOVM_ALLOC_PROFILER_H
+
+#include <cstddef>
+#include "Thread.h"
+
+class Class;
+class Object;
+
+/*
+ * 采样的分配分析器。
+ *
+ * 每个线程每分配约 allocSampleInterval 字节（随机化，避免与分配模式同步）
+ * 记录一次当前线程的调用栈（Method + pc）和所分配的类，按分配点聚合。
+ * 未采样的分配只需要一次减法和比较，
+ * 所以可以在生产环境中一直开着（-XX:+AllocationProfiling）。
+ *
+ * 虚拟机退出时，或者收到 SIGQUIT 时，输出 folded stacks 格式的报告，
+ * 可以直接用 flamegraph.pl 生成火焰图。
+ */
+
+// 采样间隔（字节），0 表示关闭
+extern size_t allocSampleInterval;
+
+#define DEFAULT_ALLOC_SAMPLE_INTERVAL (512*1024) // 512Kb
+
+// 报告文件的前缀，为空时使用 alloc_pid<pid>
+extern char allocProfilePath[];
+
+void sampleAllocation(Thread *thread, Class *c, size_t size);
+
+/*
+ * 下一次采样前要分配的字节数，服从均值为 allocSampleInterval 的指数分布。
+ * 新线程的 allocSampleCountdown 也由此初始化，否则每个线程的第一次分配都会被采样。
+ */
+jlong nextSampleInterval();
+
+/*
+ * 在 Object::newObject, Array::newArray, Array::newMultiArray, Object::clone 中调用，
+ * @size: 所分配对象的字节数
+ */
+static inline void profileAllocation(Class *c, size_t size)
+{
+    if (allocSampleInterval == 0)
+        return;
+
+    Thread *thread = getCurrentThread();
+    if (thread == nullptr) // 主线程创建之前
+        return;
+
+    thread->allocSampleCountdown -= (jlong) size;
+    if (thread->allocSampleCountdown <= 0)
+        sampleAllocation(thread, c, size);
+}
+
+// 如果开启了分配分析，注册虚拟机退出时输出报告
+void initAllocProfiler();
+
+class Metaspace;
+
+/*
+ * 释放一个被卸载的 class loader 的 Metaspace 之前调用。
+ * 引用了分配在 @metaspace 中的类或方法的分配点在这时转为报告中的字符串，不再引用元数据。
+ * 按 Metaspace 而不是 class loader 判断：调用时 class loader 对象已被回收，其地址可能已被重用。
+ */
+void retireAllocSites(Metaspace *metaspace);
+
+/*
+ * 输出报告：
+ *   <prefix>.bytes.folded  每个分配点估计的分配字节数，按字节数降序；
+ *   <prefix>.count.folded  每个分配点估计的分配次数，按次数降序。
+ * 调用栈从外到内，最后一帧为所分配的类。
+ */
+void dumpAllocProfile();
+
+#endif //KAYOVM_ALLOC_PROFILER_H
@@ -0,0 +1,155 @@
+/*
+ * Author: kayo
+ */
+
+#include <csignal>
+#include <cstring>
+#include <climits>
+#include <semaphore.h>
+#include "signals.h"
+#include "../kayo.h"
+#include "../objects/Class.h"
+#include "../objects/class_loader.h"
+#include "../interpreter/interpreter.h"
+#include "../gc/heap_dump.h"
+#include "alloc_profiler.h"
+#include "suspend.h"
+
+#define JAVA_SIG_DFL 0
+#define JAVA_SIG_IGN 1
+#define JAVA_SIG_DISPATCH 2
+
+static sem_t signalSem;
+
+// 每个信号收到但还未处理的次数
+static volatile int pendingSignals[NSIG];
+
+// 哪些信号交给 sun/misc/Signal.dispatch 处理
+static volatile bool javaHandled[NSIG];
+
+static const struct {
+    const char *name;
+    int sig;
+} signalNames[] = {
+        { "HUP", SIGHUP },
+        { "INT", SIGINT },
+        { "QUIT", SIGQUIT },
+        { "ILL", SIGILL },
+        { "TRAP", SIGTRAP },
+        { "ABRT", SIGABRT },
+        { "BUS", SIGBUS },
+        { "FPE", SIGFPE },
+        { "KILL", SIGKILL },
+        { "USR1", SIGUSR1 },
+        { "SEGV", SIGSEGV },
+        { "USR2", SIGUSR2 },
+        { "PIPE", SIGPIPE },
+        { "ALRM", SIGALRM },
+        { "TERM", SIGTERM },
+        { "CHLD", SIGCHLD },
+        { "CONT", SIGCONT },
+        { "STOP", SIGSTOP },
+        { "TSTP", SIGTSTP },
+        { "TTIN", SIGTTIN },
+        { "TTOU", SIGTTOU },
+        { "URG", SIGURG },
+        { "XCPU", SIGXCPU },
+        { "XFSZ", SIGXFSZ },
+        { "VTALRM", SIGVTALRM },
+        { "PROF", SIGPROF },
+        { "WINCH", SIGWINCH },
+        { "IO", SIGIO },
+        { "SYS", SIGSYS },
+};
+
+// 只能调用 async-signal-safe 的函数
+static void signalHandler(int sig)
+{
+    __sync_fetch_and_add(&pendingSignals[sig], 1);
+    sem_post(&signalSem);
+}
+
+static void installHandler(int sig, void (*handler)(int))
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(sig, &sa, nullptr);
+}
+
+void initSignals()
+{
+    sem_init(&signalSem, 0, 0);
+    installHandler(SIGQUIT, signalHandler);
+}
+
+jint findSignal(const char *name)
+{
+    assert(name != nullptr);
+    for (auto &s : signalNames) {
+        if (strcmp(s.name, name) == 0)
+            return s.sig;
+    }
+    return -1;
+}
+
+jlong setJavaSignalHandler(jint sig, jlong handler)
+{
+    // 虚拟机自己使用的，以及不能捕获的信号
+    if (sig <= 0 or sig >= NSIG or sig == SIGQUIT or sig == SUSPEND_SIGNAL or sig == SIGKILL or sig == SIGSTOP
+        or sig == SIGSEGV or sig == SIGBUS or sig == SIGFPE or sig == SIGILL)
+        return -1;
+
+    struct sigaction old;
+    sigaction(sig, nullptr, &old);
+    jlong prev = javaHandled[sig] ? JAVA_SIG_DISPATCH : (old.sa_handler == SIG_IGN ? JAVA_SIG_IGN : JAVA_SIG_DFL);
+
+    switch (handler) {
+        case JAVA_SIG_DFL:
+            javaHandled[sig] = false;
+            installHandler(sig, SIG_DFL);
+            break;
+        case JAVA_SIG_IGN:
+            javaHandled[sig] = false;
+            installHandler(sig, SIG_IGN);
+            break;
+        case JAVA_SIG_DISPATCH:
+            javaHandled[sig] = true;
+            installHandler(sig, signalHandler);
+            break;
+        default:
+            return -1;
+    }
+    return prev;
+}
+
+static void dispatch(int sig)
+{
+    if (javaHandled[sig]) {
+        // private static void dispatch(int number);
+        Class *c = loadBootClass("sun/misc/Signal");
+        Method *m = c->lookupStaticMethod("dispatch", "(I)V");
+        execJavaFunc(m, { (slot_t) sig });
+    } else if (sig == SIGQUIT) {
+        char path[PATH_MAX];
+        dumpHeap(heapDumpFilePath(path, sizeof(path)));
+        dumpAllocProfile();
+    }
+}
+
+void *signalDispatcherLoop(void *arg)
+{
+    while (true) {
+        if (sem_wait(&signalSem) != 0)
+            continue; // EINTR
+
+        for (int sig = 1; sig < NSIG; sig++) {
+            while (pendingSignals[sig] > 0) {
+                __sync_fetch_and_sub(&pendingSignals[sig], 1);
+                dispatch(sig);
+            }
+        }
+    }
+}
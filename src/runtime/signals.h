@@ -0,0 +1,32 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_SIGNALS_H
+#define KAYOVM_SIGNALS_H
+
+#include "../jtypes.h"
+
+/*
+ * 信号处理函数只记录收到的信号，真正的处理在 Signal Dispatcher 线程中进行：
+ *   - SIGQUIT 由虚拟机保留，用于转储堆（参见 gc/heap_dump.h）和输出分配分析报告
+ *     （如果开启了，参见 alloc_profiler.h），kill -QUIT <pid>；
+ *   - SIGUSR2 由虚拟机保留，gc 用它暂停其他线程（参见 suspend.h），不经过 Signal Dispatcher；
+ *   - 其他由 sun/misc/Signal.handle 注册的信号，调用 sun/misc/Signal.dispatch(int).
+ */
+void initSignals();
+
+// Signal Dispatcher 线程
+void *signalDispatcherLoop(void *arg);
+
+// 由信号名（不带 SIG 前缀，如 "INT"）得到信号的值，不支持的信号返回 -1
+jint findSignal(const char *name);
+
+/*
+ * sun/misc/Signal.handle0 的实现。
+ * @handler: 0 表示 SIG_DFL，1 表示 SIG_IGN，2 表示交给 sun/misc/Signal.dispatch 处理。
+ * 返回之前的 handler（同样的编码），信号不能被处理时返回 -1.
+ */
+jlong setJavaSignalHandler(jint sig, jlong handler);
+
+#endif //KAYOVM_SIGNALS_H
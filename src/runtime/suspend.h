@@ -0,0 +1,95 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_SUSPEND_H
+#define KAYOVM_SUSPEND_H
+
+#include <csignal>
+#include <atomic>
+
+/*
+ * Stop-the-world：gc 时暂停除当前线程以外的所有 Java 线程。
+ *
+ * 用 SIGUSR2（由虚拟机保留）通知线程暂停，线程阻塞在信号处理函数中直到 startTheWorld()。
+ * 信号可以在任意位置打断线程，包括阻塞在系统调用中的线程。
+ * 被打断时的寄存器由内核保存在线程的栈上，gc 保守地扫描被暂停线程的整个 C 栈，
+ * 所以本地代码中只保存在 C++ 局部变量里的对象也不会被回收。
+ *
+ * 线程在 NoSuspendScope 中时不会被暂停，信号处理函数只记下请求，离开时再暂停自己。
+ * 以下情况要在 NoSuspendScope 中：
+ *   - 从分配对象的内存到对象头初始化完成，否则 gc 遍历堆时会遇到不完整的对象；
+ *   - 持有 gc 在暂停其他线程之后还要获取的锁：堆和 Metaspace 的锁，字符串池的锁。
+ * NoSuspendScope 中不能阻塞在其他的锁上，不能执行 Java 代码，也不能进行 gc.
+ */
+
+#define SUSPEND_SIGNAL SIGUSR2
+
+// 当前线程所在的 NoSuspendScope 的层数，以及被推迟的暂停请求
+extern thread_local volatile sig_atomic_t noSuspendDepth;
+extern thread_local volatile sig_atomic_t suspendPending;
+
+// 暂停当前线程，直到 startTheWorld()，用于处理被推迟的暂停请求
+void suspendDeferred();
+
+static inline void enterNoSuspend()
+{
+    noSuspendDepth = noSuspendDepth + 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+static inline void exitNoSuspend()
+{
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    noSuspendDepth = noSuspendDepth - 1;
+    if (noSuspendDepth == 0 and suspendPending)
+        suspendDeferred();
+}
+
+class NoSuspendScope {
+public:
+    NoSuspendScope() { enterNoSuspend(); }
+    ~NoSuspendScope() { exitNoSuspend(); }
+
+    NoSuspendScope(const NoSuspendScope &) = delete;
+    NoSuspendScope &operator=(const NoSuspendScope &) = delete;
+};
+
+/*
+ * 在 NoSuspendScope 中临时允许暂停，用于在分配失败时进行 gc.
+ * 调用者要保证此时没有不完整的对象，也没有持有上述的锁。
+ */
+class AllowSuspendScope {
+    sig_atomic_t depth;
+public:
+    AllowSuspendScope(): depth(noSuspendDepth)
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        noSuspendDepth = 0;
+        if (suspendPending)
+            suspendDeferred();
+    }
+
+    ~AllowSuspendScope()
+    {
+        noSuspendDepth = depth;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+
+    AllowSuspendScope(const AllowSuspendScope &) = delete;
+    AllowSuspendScope &operator=(const AllowSuspendScope &) = delete;
+};
+
+// 安装暂停信号的处理函数，在创建其他线程之前调用
+void initSuspend();
+
+/*
+ * 暂停除当前线程以外的所有线程，返回时它们都已暂停。
+ * 暂停期间不能创建新线程。当前线程不能在 NoSuspendScope 中。
+ */
+void stopTheWorld();
+
+// 恢复被 stopTheWorld() 暂停的线程
+void startTheWorld();
+
+#endif //KAYOVM_SUSPEND_H
@@ -12,6 +12,7 @@ const char *symbol_values[] = {
 
 void initSymbol()
 {
-    for (const char *s : symbol_values)
-        utf8::save(s);
+    // 换成池中的规范字符串，使 S() 符号可以直接用指针比较
+    for (const char *&s : symbol_values)
+        s = utf8::save(s);
 }
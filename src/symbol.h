@@ -28,16 +28,20 @@ extern const char *symbol_values[];
     action(data, "data"), \
     action(name, "name"), \
     action(root, "root"), \
+    action(next, "next"), \
+    action(lock, "lock"), \
     action(exit, "exit"), \
     action(slot, "slot"), \
     action(type, "type"), \
     action(flag, "flag"), \
     action(clazz, "clazz"), \
+    action(clock, "clock"), \
     action(queue, "queue"), \
     action(group, "group"), \
     action(count, "count"), \
     action(value, "value"), \
     action(create, "create"), \
+    action(pending, "pending"), \
     action(daemon, "daemon"), \
     action(thread, "thread"), \
     action(vmData, "vmData"), \
@@ -50,6 +54,8 @@ extern const char *symbol_values[];
     action(vmThread, "vmThread"), \
     action(priority, "priority"), \
     action(threadId, "threadId"), \
+    action(timestamp, "timestamp"), \
+    action(discovered, "discovered"), \
     action(finalize, "finalize"), \
     action(hashtable, "hashtable"), \
     action(backtrace, "backtrace"), \
@@ -166,6 +172,7 @@ extern const char *symbol_values[];
     action(java_lang_Error, "java/lang/Error"), \
     action(java_lang_UnknownError, "java/lang/UnknownError"), \
     action(java_lang_LinkageError, "java/lang/LinkageError"), \
+    action(java_lang_ClassCircularityError, "java/lang/ClassCircularityError"), \
     action(java_lang_InternalError, "java/lang/InternalError"), \
     action(java_lang_ClassFormatError, "java/lang/ClassFormatError"), \
     action(java_lang_OutOfMemoryError, "java/lang/OutOfMemoryError"), \
@@ -197,6 +204,8 @@ extern const char *symbol_values[];
     action(java_lang_StringIndexOutOfBoundsException, "java/lang/StringIndexOutOfBoundsException"), \
     action(java_io_IOException, "java/io/IOException"), \
     action(java_io_FileNotFoundException, "java/io/FileNotFoundException"), \
+    action(java_util_zip_ZipException, "java/util/zip/ZipException"), \
+    action(java_util_zip_DataFormatException, "java/util/zip/DataFormatException"), \
     \
     /* Array class names */\
     action(array_V, "[V"), \
@@ -232,7 +241,9 @@ extern const char *symbol_values[];
     action(sig_java_lang_reflect_VMMethod, "Ljava/lang/reflect/VMMethod;"), \
     action(sig_java_lang_reflect_Constructor, "Ljava/lang/reflect/Constructor;"), \
     action(sig_java_lang_reflect_VMConstructor, "Ljava/lang/reflect/VMConstructor;"), \
+    action(sig_java_lang_ref_Reference, "Ljava/lang/ref/Reference;"), \
     action(sig_java_lang_ref_ReferenceQueue, "Ljava/lang/ref/ReferenceQueue;"), \
+    action(sig_java_lang_ref_Reference_Lock, "Ljava/lang/ref/Reference$Lock;"), \
     action(sig_java_security_ProtectionDomain, "Ljava/security/ProtectionDomain;"), \
     action(sig_java_lang_Thread_UncaughtExceptionHandler, "Ljava/lang/Thread$UncaughtExceptionHandler;"), \
     \
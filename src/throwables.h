@@ -54,14 +54,23 @@ DefineThrowableClass(NoSuchFieldError,               S(java_lang_NoSuchFieldErro
 DefineThrowableClass(NoSuchMethodError,              S(java_lang_NoSuchMethodError));
 DefineThrowableClass(NegativeArraySizeException,     S(java_lang_NegativeArraySizeException));
 DefineThrowableClass(ClassCastException,             S(java_lang_ClassCastException));
+DefineThrowableClass(ArithmeticException,            S(java_lang_ArithmeticException));
 DefineThrowableClass(ClassFormatError,               S(java_lang_ClassFormatError));
 DefineThrowableClass(StackOverflowError,             S(java_lang_StackOverflowError));
 DefineThrowableClass(IllegalArgumentException,       S(java_lang_IllegalArgumentException));
+DefineThrowableClass(IllegalMonitorStateException,   S(java_lang_IllegalMonitorStateException));
+DefineThrowableClass(InterruptedException,           S(java_lang_InterruptedException));
+DefineThrowableClass(LinkageError,                   S(java_lang_LinkageError));
+DefineThrowableClass(ClassCircularityError,          S(java_lang_ClassCircularityError));
 
 /* package java.io */
 DefineThrowableClass(IOException,           S(java_io_IOException));
 DefineThrowableClass(FileNotFoundException, S(java_io_FileNotFoundException));
 
+/* package java.util.zip */
+DefineThrowableClass(ZipException,          S(java_util_zip_ZipException));
+DefineThrowableClass(DataFormatException,   S(java_util_zip_DataFormatException));
+
 #undef DefineThrowableClass
 
 #endif //KAYOVM_THROWABLES_H
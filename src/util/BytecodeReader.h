@@ -5,6 +5,7 @@
 #ifndef JVM_BYTECODE_READER_H
 #define JVM_BYTECODE_READER_H
 
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include "../jtypes.h"
@@ -43,6 +44,27 @@ public:
         bytecode[pc0 + 1] = (u1) value;
     }
 
+    /*
+     * 把位于 @offset 的指令改写为 @opcode（quickening）。
+     * 其他线程可能正在执行同一段 bytecode：
+     * 先改写操作数（setu2，如果操作数的含义变了），以及把解析的结果写入常量池，
+     * 最后以 release 写入操作码，读到新操作码的线程一定能看到新的操作数和解析的结果。
+     * 执行 quick 指令的一方在读操作数之前用 acquire 与之配对，参见 quickened().
+     */
+    void quicken(int offset, u1 opcode)
+    {
+        size_t pc0 = pc + offset;
+        assert(pc0 < len);
+        std::atomic_thread_fence(std::memory_order_release);
+        bytecode[pc0] = opcode;
+    }
+
+    // quick 指令读操作数之前调用，与 quicken() 配对
+    static void quickened()
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+
     bool hasMore()
     {
         return pc < len;
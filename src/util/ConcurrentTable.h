@@ -0,0 +1,259 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_CONCURRENT_TABLE_H
+#define KAYOVM_CONCURRENT_TABLE_H
+
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cassert>
+#include "../runtime/suspend.h"
+
+/*
+ * 读无锁的哈希表，存放 T *，键由 T 本身给出（Traits::key）。
+ *
+ * 开放寻址、线性探测。每个槽是一个 atomic<T *>，写入者在 insertMutex 下用 release 写入，
+ * 读者用 acquire 读取，所以读者看到的 T 一定是构造完成的。
+ * 扩容时建一张新表，填好后整体发布；旧表不立即释放（读者可能还在用），
+ * 而是放入 RetiredTables，由 gc 在读者都离开之后释放。
+ * 删除留下墓碑（TOMBSTONE），在下次扩容时清除，墓碑多时按原大小重建，旧表同样放入 RetiredTables.
+ *
+ * 查找、遍历和持有 insertMutex 时都在 NoSuspendScope 中：
+ * gc 暂停其他线程后可以获取 insertMutex 删除元素，
+ * 恢复其他线程之后就不会再有线程持有被删除的元素或被替换下来的旧表，可以释放它们
+ * （参见 detachUnreachableLoaders 和 RetiredTables）。
+ *
+ * Traits 需要提供：
+ *   using Key = ...;
+ *   static Key key(const T *t);
+ *   static size_t hash(Key k);
+ *   static bool equals(Key k1, Key k2);
+ */
+/*
+ * 所有 ConcurrentTable 被替换下来、等待释放的旧表。
+ *
+ * 读者都在 NoSuspendScope 中，gc 暂停其他线程时已经没有线程在读旧表了：
+ * gc 在暂停期间取走当时的所有旧表（takeAll，不分配内存），恢复其他线程之后释放它们（freeAll）。
+ * 之后才被替换下来的表可能还有读者，留到下次 gc.
+ */
+class RetiredTables {
+public:
+    struct Node {
+        Node *nextRetired = nullptr;
+        virtual ~Node() = default;
+    };
+
+    static void add(Node *n)
+    {
+        n->nextRetired = head().load(std::memory_order_relaxed);
+        while (!head().compare_exchange_weak(n->nextRetired, n, std::memory_order_release));
+    }
+
+    static Node *takeAll()
+    {
+        return head().exchange(nullptr, std::memory_order_acquire);
+    }
+
+    static void freeAll(Node *n)
+    {
+        while (n != nullptr) {
+            Node *next = n->nextRetired;
+            delete n;
+            n = next;
+        }
+    }
+
+private:
+    static std::atomic<Node *> &head()
+    {
+        static std::atomic<Node *> h { nullptr };
+        return h;
+    }
+};
+
+template <typename T, typename Traits>
+class ConcurrentTable {
+    using Key = typename Traits::Key;
+
+    struct Table: RetiredTables::Node {
+        size_t mask; // capacity - 1
+        std::atomic<T *> *slots;
+
+        explicit Table(size_t capacity): mask(capacity - 1), slots(new std::atomic<T *>[capacity])
+        {
+            for (size_t i = 0; i < capacity; i++)
+                slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~Table() override
+        {
+            delete[] slots;
+        }
+    };
+
+    static T *tombstone()
+    {
+        return reinterpret_cast<T *>(1);
+    }
+
+    std::atomic<Table *> table;
+
+    std::mutex insertMutex;
+    size_t count = 0;   // 有效元素的数量
+    size_t used = 0;    // count 加上墓碑的数量
+
+    // 调用者需持有 insertMutex
+    void insertLocked(Table *t, T *value)
+    {
+        size_t i = Traits::hash(Traits::key(value)) & t->mask;
+        while (true) {
+            T *v = t->slots[i].load(std::memory_order_relaxed);
+            if (v == nullptr or v == tombstone()) {
+                if (v == nullptr)
+                    used++;
+                count++;
+                t->slots[i].store(value, std::memory_order_release);
+                return;
+            }
+            i = (i + 1) & t->mask;
+        }
+    }
+
+    // 装载因子不超过 1/2；调用者需持有 insertMutex
+    void ensureCapacityLocked()
+    {
+        Table *t = table.load(std::memory_order_relaxed);
+        if ((used + 1) * 2 <= t->mask + 1)
+            return;
+
+        // 墓碑多时原大小重建即可
+        size_t capacity = t->mask + 1;
+        if ((count + 1) * 4 > capacity)
+            capacity *= 2;
+
+        auto n = new Table(capacity);
+        size_t oldCount = count;
+        count = used = 0;
+        for (size_t i = 0; i <= t->mask; i++) {
+            T *v = t->slots[i].load(std::memory_order_relaxed);
+            if (v != nullptr and v != tombstone())
+                insertLocked(n, v);
+        }
+        assert(count == oldCount);
+        table.store(n, std::memory_order_release);
+        RetiredTables::add(t);
+    }
+
+public:
+    explicit ConcurrentTable(size_t initialCapacity = 64)
+    {
+        size_t capacity = 8;
+        while (capacity < initialCapacity)
+            capacity *= 2;
+        table.store(new Table(capacity), std::memory_order_relaxed);
+    }
+
+    ConcurrentTable(const ConcurrentTable &) = delete;
+    ConcurrentTable &operator=(const ConcurrentTable &) = delete;
+
+    // 之前替换下来的表在 RetiredTables 中，由 gc 释放
+    ~ConcurrentTable()
+    {
+        delete table.load(std::memory_order_relaxed);
+    }
+
+    // 无锁
+    T *find(Key key) const
+    {
+        NoSuspendScope noSuspend;
+        Table *t = table.load(std::memory_order_acquire);
+        size_t i = Traits::hash(key) & t->mask;
+        while (true) {
+            T *v = t->slots[i].load(std::memory_order_acquire);
+            if (v == nullptr)
+                return nullptr;
+            if (v != tombstone() and Traits::equals(Traits::key(v), key))
+                return v;
+            i = (i + 1) & t->mask;
+        }
+    }
+
+    /*
+     * 如果已有相同键的元素，返回它；否则插入 @value 并返回 @value.
+     */
+    T *putIfAbsent(T *value)
+    {
+        assert(value != nullptr);
+        NoSuspendScope noSuspend;
+        std::lock_guard<std::mutex> lock(insertMutex);
+        T *v = find(Traits::key(value));
+        if (v != nullptr)
+            return v;
+        ensureCapacityLocked();
+        insertLocked(table.load(std::memory_order_relaxed), value);
+        return value;
+    }
+
+    /*
+     * 如果没有键为 @key 的元素，在锁内调用 @create 创建一个并插入。
+     * 返回表中键为 @key 的元素。
+     */
+    template <typename Create>
+    T *findOrCreate(Key key, Create create)
+    {
+        T *v = find(key);
+        if (v != nullptr)
+            return v;
+
+        NoSuspendScope noSuspend;
+        std::lock_guard<std::mutex> lock(insertMutex);
+        v = find(key);
+        if (v != nullptr)
+            return v;
+        v = create();
+        ensureCapacityLocked();
+        insertLocked(table.load(std::memory_order_relaxed), v);
+        return v;
+    }
+
+    // 删除满足 @pred 的元素，返回删除的个数
+    template <typename Pred>
+    size_t removeIf(Pred pred)
+    {
+        NoSuspendScope noSuspend;
+        std::lock_guard<std::mutex> lock(insertMutex);
+        Table *t = table.load(std::memory_order_relaxed);
+        size_t removed = 0;
+        for (size_t i = 0; i <= t->mask; i++) {
+            T *v = t->slots[i].load(std::memory_order_relaxed);
+            if (v != nullptr and v != tombstone() and pred(v)) {
+                t->slots[i].store(tombstone(), std::memory_order_release);
+                removed++;
+            }
+        }
+        count -= removed;
+        return removed;
+    }
+
+    // 无锁遍历，可能看不到遍历期间插入的元素
+    template <typename Visit>
+    void forEach(Visit visit) const
+    {
+        NoSuspendScope noSuspend;
+        Table *t = table.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= t->mask; i++) {
+            T *v = t->slots[i].load(std::memory_order_acquire);
+            if (v != nullptr and v != tombstone())
+                visit(v);
+        }
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+};
+
+#endif //KAYOVM_CONCURRENT_TABLE_H
@@ -0,0 +1,203 @@
+/*
+ * Author: kayo
+ */
+
+#include <mutex>
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "JarFile.h"
+#include "../../zlib/zlib.h"
+
+using namespace std;
+
+#define LOCAL_HEADER_SIG 0x04034b50
+#define CENTRAL_HEADER_SIG 0x02014b50
+#define END_HEADER_SIG 0x06054b50
+
+#define LOCAL_HEADER_LEN 30
+#define CENTRAL_HEADER_LEN 46
+#define END_HEADER_LEN 22
+#define MAX_COMMENT_LEN 0xffff
+
+#define METHOD_STORED 0
+
+// zip 文件中的整数都按小端存储
+static inline u2 le2(const u1 *p)
+{
+    return (u2) (p[0] | (p[1] << 8));
+}
+
+static inline u4 le4(const u1 *p)
+{
+    return (u4) p[0] | ((u4) p[1] << 8) | ((u4) p[2] << 16) | ((u4) p[3] << 24);
+}
+
+JarFile *JarFile::open(const char *path)
+{
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 or st.st_size < END_HEADER_LEN) {
+        close(fd);
+        return nullptr;
+    }
+
+    void *mem = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // 映射在 fd 关闭后仍然有效
+    if (mem == MAP_FAILED)
+        return nullptr;
+
+    auto jar = new JarFile(path);
+    jar->mem = (const u1 *) mem;
+    jar->len = (size_t) st.st_size;
+    if (!jar->parseCentralDirectory()) {
+        delete jar;
+        return nullptr;
+    }
+    return jar;
+}
+
+JarFile::~JarFile()
+{
+    if (mem != nullptr)
+        munmap((void *) mem, len);
+}
+
+bool JarFile::parseCentralDirectory()
+{
+    // 从文件末尾向前找 end of central directory record，其后最多跟着 64K 的注释
+    const u1 *end = nullptr;
+    const u1 *low = mem + len - min(len, (size_t) END_HEADER_LEN + MAX_COMMENT_LEN);
+    for (const u1 *p = mem + len - END_HEADER_LEN; p >= low; p--) {
+        if (le4(p) == END_HEADER_SIG) {
+            end = p;
+            break;
+        }
+    }
+    if (end == nullptr)
+        return false;
+
+    u2 total = le2(end + 10);
+    u4 cenLen = le4(end + 12);
+    u4 cenOffset = le4(end + 16);
+    if (total == 0xffff or cenOffset == 0xffffffff) // todo zip64
+        return false;
+    if ((size_t) cenOffset + cenLen > len)
+        return false;
+    commentLen = min(le2(end + 20), (u2) (mem + len - end - END_HEADER_LEN));
+    comment = end + END_HEADER_LEN;
+
+    // 先填满 entries 再建索引，保证 Entry 的地址不会变
+    entries.reserve(total);
+    const u1 *p = mem + cenOffset;
+    const u1 *cenEnd = p + cenLen;
+    while (p + CENTRAL_HEADER_LEN <= cenEnd) {
+        if (le4(p) != CENTRAL_HEADER_SIG)
+            return false;
+
+        Entry e;
+        e.cen = p;
+        e.name = p + CENTRAL_HEADER_LEN;
+        e.nameLen = le2(p + 28);
+        e.method = le2(p + 10);
+        e.compressedSize = le4(p + 20);
+        e.uncompressedSize = le4(p + 24);
+        e.localHeaderOffset = le4(p + 42);
+        if (e.name + e.nameLen > cenEnd)
+            return false;
+        entries.push_back(e);
+
+        p += CENTRAL_HEADER_LEN + e.nameLen + le2(p + 30) + le2(p + 32);
+    }
+
+    index.reserve(entries.size());
+    for (auto &e : entries) {
+        index.emplace(string((const char *) e.name, e.nameLen), &e);
+    }
+    return true;
+}
+
+bool JarFile::startsWithLOC() const
+{
+    return le4(mem) == LOCAL_HEADER_SIG;
+}
+
+const JarFile::Entry *JarFile::find(const char *name) const
+{
+    auto iter = index.find(name);
+    return iter != index.end() ? iter->second : nullptr;
+}
+
+const JarFile::Entry *JarFile::find(const char *name, size_t nameLen) const
+{
+    auto iter = index.find(string(name, nameLen));
+    return iter != index.end() ? iter->second : nullptr;
+}
+
+const u1 *JarFile::data(const Entry *entry) const
+{
+    assert(entry != nullptr);
+
+    // local header 中 name 和 extra 的长度可能与中央目录中的不同，需要重新读取
+    if ((size_t) entry->localHeaderOffset + LOCAL_HEADER_LEN > len)
+        return nullptr;
+    const u1 *loc = mem + entry->localHeaderOffset;
+    if (le4(loc) != LOCAL_HEADER_SIG)
+        return nullptr;
+
+    size_t offset = (size_t) entry->localHeaderOffset + LOCAL_HEADER_LEN + le2(loc + 26) + le2(loc + 28);
+    if (offset + entry->compressedSize > len)
+        return nullptr;
+    return mem + offset;
+}
+
+bool JarFile::read(const Entry *entry, u1 *buf) const
+{
+    assert(entry != nullptr && buf != nullptr);
+
+    const u1 *src = data(entry);
+    if (src == nullptr)
+        return false;
+
+    if (entry->method == METHOD_STORED) {
+        memcpy(buf, src, entry->uncompressedSize);
+        return true;
+    }
+    if (entry->method != Z_DEFLATED) {
+        return false;
+    }
+
+    // 直接从映射中解压到 @buf
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) // raw deflate, 没有 zlib 头
+        return false;
+    zs.next_in = const_cast<u1 *>(src); // zlib 不会修改输入
+    zs.avail_in = (uInt) entry->compressedSize;
+    zs.next_out = buf;
+    zs.avail_out = (uInt) entry->uncompressedSize;
+    int ret = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END and zs.total_out == entry->uncompressedSize;
+}
+
+JarFile *openJar(const char *path)
+{
+    static mutex jarsMutex;
+    static unordered_map<string, JarFile *> jars;
+
+    lock_guard<mutex> lock(jarsMutex);
+    auto iter = jars.find(path);
+    if (iter != jars.end())
+        return iter->second;
+
+    JarFile *jar = JarFile::open(path);
+    jars.emplace(path, jar);
+    return jar;
+}
@@ -0,0 +1,103 @@
+/*
+ * Author: kayo
+ */
+
+#ifndef KAYOVM_JAR_FILE_H
+#define KAYOVM_JAR_FILE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "../jtypes.h"
+
+/*
+ * 只读的 jar(zip) 文件。
+ *
+ * 整个文件被 mmap 到内存，打开时解析一次中央目录（central directory），
+ * 建立 entry name 到 entry 的哈希表，之后的查找都是 O(1) 的。
+ * 表建立之后不再修改，所以可以被多个线程同时使用。
+ *
+ * 映射是只读的，始终与文件内容一致。类的字节码会被解释器改写，
+ * 所以即使是 STORED 的 entry，也要用 read() 拷贝一份再解析。
+ */
+class JarFile {
+public:
+    struct Entry {
+        const u1 *cen;  // 此 entry 在中央目录中的 header
+        const u1 *name; // 不以'\0'结尾
+        u2 nameLen;
+        u2 method;      // 0: stored, 8: deflated
+        u4 compressedSize;
+        u4 uncompressedSize;
+        u4 localHeaderOffset;
+    };
+
+private:
+    std::string path;
+    const u1 *mem = nullptr;
+    size_t len = 0;
+    const u1 *comment = nullptr;
+    u2 commentLen = 0;
+
+    // 按中央目录中的顺序
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, Entry *> index;
+
+    explicit JarFile(const char *path): path(path) { }
+    bool parseCentralDirectory();
+
+public:
+    ~JarFile();
+
+    /*
+     * 打开 @path 并解析其中央目录，失败返回 nullptr.
+     */
+    static JarFile *open(const char *path);
+
+    const char *getPath() const
+    {
+        return path.c_str();
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    const Entry *get(size_t i) const
+    {
+        return i < entries.size() ? &entries[i] : nullptr;
+    }
+
+    const Entry *find(const char *name) const;
+    const Entry *find(const char *name, size_t nameLen) const;
+
+    // 文件是否以 local header 开头（而不是以其他数据开头，比如自解压程序）
+    bool startsWithLOC() const;
+
+    const u1 *getComment(u2 &commentLen) const
+    {
+        commentLen = this->commentLen;
+        return comment;
+    }
+
+    /*
+     * @entry 在文件中（压缩后）的数据，长度为 entry->compressedSize，
+     * 文件损坏时返回 nullptr.
+     */
+    const u1 *data(const Entry *entry) const;
+
+    /*
+     * 解压 @entry 的内容到 @buf，@buf 的长度不小于 entry->uncompressedSize.
+     * 成功返回 true.
+     */
+    bool read(const Entry *entry, u1 *buf) const;
+};
+
+/*
+ * 同一路径的 jar 只会被打开一次，之后返回缓存的 JarFile。
+ * 打开失败返回 nullptr（失败也被缓存）。线程安全。
+ */
+JarFile *openJar(const char *path);
+
+#endif //KAYOVM_JAR_FILE_H
@@ -4,36 +4,98 @@
 
 #include <cassert>
 #include <cstring>
-#include <unordered_set>
+#include <cstdlib>
+#include <unordered_map>
 #include <pthread.h>
 #include "encoding.h"
 
 using namespace std;
 
-static unordered_set<const utf8_t *, utf8::Hash, utf8::Comparator> utf8Set;
+// key: utf8 string, value: owner of the utf8 string
+static unordered_map<const utf8_t *, const void *, utf8::Hash, utf8::Comparator> utf8Pool;
 static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
 
-const utf8_t *utf8::save(const utf8_t *utf8)
+const utf8_t *utf8::save(const utf8_t *utf8, const void *owner)
 {
     assert(utf8 != nullptr);
 
     pthread_rwlock_wrlock(&lock);
-    const utf8_t *s = *utf8Set.insert(utf8).first;
+    auto result = utf8Pool.insert(make_pair(utf8, owner));
+    if (!result.second and result.first->second != owner) {
+        // 已被其他 owner 保存，变为共享的
+        result.first->second = nullptr;
+    }
+    const utf8_t *s = result.first->first;
+    pthread_rwlock_unlock(&lock);
+    return s;
+}
+
+const utf8_t *utf8::find(const utf8_t *utf8, const void *user)
+{
+    assert(utf8 != nullptr);
+
+    pthread_rwlock_rdlock(&lock);
+    auto iter = utf8Pool.find(utf8);
+    if (iter == utf8Pool.end()) {
+        pthread_rwlock_unlock(&lock);
+        return nullptr;
+    }
+
+    const utf8_t *s = iter->first;
+    bool shared = iter->second == nullptr or iter->second == user;
     pthread_rwlock_unlock(&lock);
+
+    if (!shared) {
+        // 被其他 owner 独占，变为共享的（很少发生）
+        pthread_rwlock_wrlock(&lock);
+        iter = utf8Pool.find(utf8);
+        if (iter != utf8Pool.end() and iter->second != user)
+            iter->second = nullptr;
+        pthread_rwlock_unlock(&lock);
+    }
+
+    return s;
+}
+
+const utf8_t *utf8::intern(const utf8_t *utf8)
+{
+    assert(utf8 != nullptr);
+
+    const utf8_t *s = find(utf8);
+    if (s == nullptr) {
+        s = save(dup(utf8));
+    }
     return s;
 }
 
-const utf8_t *utf8::find(const utf8_t *utf8)
+const utf8_t *utf8::canonical(const utf8_t *utf8)
 {
     assert(utf8 != nullptr);
 
     pthread_rwlock_rdlock(&lock);
-    auto iter = utf8Set.find(utf8);
-    const utf8_t *s = iter == utf8Set.end() ? nullptr : *iter;
+    auto iter = utf8Pool.find(utf8);
+    const utf8_t *s = iter == utf8Pool.end() ? nullptr : iter->first;
     pthread_rwlock_unlock(&lock);
     return s;
 }
 
+void utf8::release(const void *owner)
+{
+    assert(owner != nullptr);
+
+    pthread_rwlock_wrlock(&lock);
+    for (auto iter = utf8Pool.begin(); iter != utf8Pool.end();) {
+        if (iter->second == owner) {
+            auto s = iter->first;
+            iter = utf8Pool.erase(iter);
+            free((void *) s);
+        } else {
+            iter++;
+        }
+    }
+    pthread_rwlock_unlock(&lock);
+}
+
 static inline unicode_t getUtf8Char(const utf8_t *&utf8)
 {
     assert(utf8 != nullptr);
@@ -52,14 +114,19 @@ static inline unicode_t getUtf8Char(const utf8_t *&utf8)
     return x;
 }
 
+/*
+ * 改进过的utf8中每个字符只有一种编码方式，
+ * 所以按字节计算 hash 和比较，与按字符解码后的结果一致，不需要解码。
+ */
 size_t utf8::hash(const utf8_t *utf8)
 {
     if (utf8 == nullptr)
         return 0;
 
-    size_t hash = 0;
-    while (*utf8) {
-        hash = hash * 37 + getUtf8Char(utf8);
+    // FNV-1a
+    size_t hash = 2166136261u;
+    for (; *utf8; utf8++) {
+        hash = (hash ^ (u1) *utf8) * 16777619u;
     }
 
     return hash;
@@ -82,15 +149,7 @@ bool utf8::equals(const utf8_t *p1, const utf8_t *p2)
 {
     assert(p1 != nullptr && p2 != nullptr);
 
-    if (p1 == p2)
-        return true;
-
-    while(*p1 && *p2) {
-        if(getUtf8Char(p1) != getUtf8Char(p2))
-            return false;
-    }
-
-    return !(*p1 || *p2);
+    return p1 == p2 or strcmp(p1, p2) == 0;
 }
 
 utf8_t *utf8::dup(const utf8_t *utf8)
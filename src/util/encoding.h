@@ -20,11 +20,37 @@
  */
 
 namespace utf8 {
+    /*
+     * 池中的字符串可以有一个 owner（一般为某个 class loader 的 Metaspace），
+     * owner 为 null 的字符串永久保存在池中。
+     * 当一个有 owner 的字符串被其他 owner（或null）使用时，它就变为共享的（owner 置为 null），
+     * 只有仍被 owner 独占的字符串才会在 release(owner) 时释放。
+     */
+
     // save a utf8 string to pool.
-    const utf8_t *save(const utf8_t *utf8);
+    // 如果池中已有相等的字符串，返回池中的，否则 @utf8 被放入池中，其 owner 为 @owner.
+    // 放入池中的字符串需是 malloc 分配的（如 strdup），或者是永久存在的（此时 owner 为 null）。
+    const utf8_t *save(const utf8_t *utf8, const void *owner = nullptr);
 
     // get utf8 from pool, return null if not exist.
-    const utf8_t *find(const utf8_t *utf8);
+    // 如果找到的字符串被 @user 之外的 owner 独占，则将其变为共享的。
+    const utf8_t *find(const utf8_t *utf8, const void *user = nullptr);
+
+    // 从池中删除并释放被 @owner 独占的字符串
+    void release(const void *owner);
+
+    /*
+     * 池中的字符串是规范的（canonical）：内容相等的字符串在池中只有一份，
+     * 所以两个规范字符串相等当且仅当它们的指针相等。
+     * 常量池中的 CONSTANT_Utf8，以及 S() 符号都是规范字符串。
+     */
+
+    // 返回池中与 @utf8 相等的规范字符串，池中没有则复制一份永久保存到池中。
+    const utf8_t *intern(const utf8_t *utf8);
+
+    // 返回池中与 @utf8 相等的规范字符串，不存在返回 null.
+    // 与 find 不同，不改变字符串的 owner，返回值只可用于指针比较，不可长期持有。
+    const utf8_t *canonical(const utf8_t *utf8);
 
     size_t hash(const utf8_t *utf8);
 
@@ -29,4 +29,12 @@ if __name__ == '__main__':
     run_test('invoke/MethodHandleTest')
     
     run_test('lambda/LambdaTest')
+    
+    run_test('method/ChaDeoptTest')
+    
+    run_test('method/AccessorInlineTest')
+    
+    run_test('thread/ParkTest')
+    
+    run_test('management/GcMXBeanTest')
     #   unittest.main()
@@ -0,0 +1,64 @@
+package management;
+
+import java.lang.management.GarbageCollectorMXBean;
+import java.lang.management.ManagementFactory;
+import java.util.List;
+
+/**
+ * 测试 ManagementFactory.getGarbageCollectorMXBeans()：
+ * 能得到垃圾收集器，System.gc() 之后收集次数增加，收集时间不减少。
+ */
+public class GcMXBeanTest {
+
+    private static long totalCount(List<GarbageCollectorMXBean> gcs) {
+        long count = 0;
+        for (GarbageCollectorMXBean gc : gcs)
+            count += gc.getCollectionCount();
+        return count;
+    }
+
+    private static long totalTime(List<GarbageCollectorMXBean> gcs) {
+        long time = 0;
+        for (GarbageCollectorMXBean gc : gcs)
+            time += gc.getCollectionTime();
+        return time;
+    }
+
+    public static void main(String[] args) {
+        List<GarbageCollectorMXBean> gcs = ManagementFactory.getGarbageCollectorMXBeans();
+        if (gcs.isEmpty()) {
+            System.out.println("getGarbageCollectorMXBeans failed!");
+            return;
+        }
+        for (GarbageCollectorMXBean gc : gcs) {
+            if (gc.getName() == null || gc.getMemoryPoolNames().length == 0) {
+                System.out.println("GarbageCollectorMXBean is wrong!");
+                return;
+            }
+        }
+
+        long count = totalCount(gcs);
+        long time = totalTime(gcs);
+        if (count < 0 || time < 0) {
+            System.out.println("collection count or time is wrong!");
+            return;
+        }
+
+        for (int i = 0; i < 1000; i++) {
+            Object garbage = new byte[1024];
+        }
+        System.gc();
+
+        if (totalCount(gcs) <= count) {
+            System.out.println("collection count failed!");
+            return;
+        }
+        if (totalTime(gcs) < time) {
+            System.out.println("collection time failed!");
+            return;
+        }
+
+        System.out.println("OK!");
+    }
+
+}
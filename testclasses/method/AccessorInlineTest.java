@@ -0,0 +1,123 @@
+package method;
+
+/**
+ * 测试 getter、setter 和空构造函数的内联，
+ * 包括形状和 getter/setter 一样但多了参数的方法。
+ */
+public class AccessorInlineTest {
+
+    static class Point {
+        private int x;
+        private long y;
+        private double z;
+        private Object tag;
+
+        int getX() { return x; }
+        long getY() { return y; }
+        double getZ() { return z; }
+        Object getTag() { return tag; }
+
+        void setX(int x) { this.x = x; }
+        void setY(long y) { this.y = y; }
+        void setZ(double z) { this.z = z; }
+        void setTag(Object tag) { this.tag = tag; }
+
+        // 字节码和 getX/setX 一样，但多了参数，调用时要弹出全部参数
+        int getX(int unused) { return x; }
+        int getX(long unused1, Object unused2) { return x; }
+        void setX(int x, int unused) { this.x = x; }
+        void setY(long y, Object unused) { this.y = y; }
+
+        // private 方法由 invokespecial 调用
+        private int privateGetX() { return x; }
+        private void privateSetX(int x) { this.x = x; }
+
+        int callPrivate(int v) {
+            privateSetX(v);
+            return privateGetX();
+        }
+    }
+
+    // final 类的方法调用不需要类层次检查
+    static final class FinalBox {
+        private int v;
+        int get() { return v; }
+        void set(int v) { this.v = v; }
+    }
+
+    static class Empty {
+    }
+
+    static class EmptyChild extends Empty {
+        EmptyChild() { }
+    }
+
+    static int initCount = 0;
+
+    // 构造函数不是空的，不能被跳过
+    static class Counting extends Empty {
+        Counting() { initCount++; }
+    }
+
+    static class CountingChild extends Counting {
+        CountingChild() { }
+    }
+
+    private static boolean check(boolean ok, String what) {
+        if (!ok)
+            System.out.println(what + " is wrong!");
+        return ok;
+    }
+
+    public static void main(String[] args) {
+        Point p = new Point();
+        FinalBox box = new FinalBox();
+
+        for (int i = 0; i < 100; i++) {
+            p.setX(i);
+            p.setY(i * 10000000000L);
+            p.setZ(i + 0.5);
+            p.setTag("tag" + i);
+            if (!check(p.getX() == i, "getX/setX")) return;
+            if (!check(p.getY() == i * 10000000000L, "getY/setY")) return;
+            if (!check(p.getZ() == i + 0.5, "getZ/setZ")) return;
+            if (!check(("tag" + i).equals(p.getTag()), "getTag/setTag")) return;
+
+            // 多余的参数不能留在操作数栈上
+            int sum = p.getX(7) + p.getX(7L, p) + 1;
+            if (!check(sum == 2 * i + 1, "getX with extra params")) return;
+            p.setX(i + 1, 9);
+            if (!check(p.getX() == i + 1, "setX with extra params")) return;
+            p.setY(3L, null);
+            if (!check(p.getY() == 3L, "setY with extra params")) return;
+
+            if (!check(p.callPrivate(i * 2) == i * 2, "private accessor")) return;
+
+            box.set(i);
+            if (!check(box.get() == i, "final class accessor")) return;
+
+            new EmptyChild();
+            new CountingChild();
+        }
+
+        if (!check(initCount == 100, "non-empty constructor")) return;
+
+        // 内联的访问方法也要检查 null
+        Point np = null;
+        try {
+            np.getX();
+            System.out.println("getX on null does not throw!");
+            return;
+        } catch (NullPointerException e) {
+        }
+        try {
+            np.setX(1);
+            System.out.println("setX on null does not throw!");
+            return;
+        } catch (NullPointerException e) {
+        }
+
+        System.out.println("OK!");
+    }
+
+}
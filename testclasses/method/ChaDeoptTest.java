@@ -0,0 +1,76 @@
+package method;
+
+/**
+ * 测试 invokevirtual 的类层次分析（CHA）去虚化：
+ * 调用点在没有子类覆盖方法时被改写为直接调用，
+ * 覆盖方法的子类加载之后，调用点要退回到虚调用。
+ */
+public class ChaDeoptTest {
+
+    static class Base {
+        int f() { return 1; }
+        int g() { return 10; }
+    }
+
+    // 只在 loadSub 中用到，第一次 new 时才被加载
+    static class Sub extends Base {
+        @Override
+        int f() { return 2; }
+    }
+
+    // 覆盖 g 的子类由 Class.forName 加载
+    static class Sub2 extends Base {
+        @Override
+        int g() { return 20; }
+    }
+
+    static int callF(Base b) {
+        return b.f();
+    }
+
+    static int callG(Base b) {
+        return b.g();
+    }
+
+    static Base loadSub() {
+        return new Sub();
+    }
+
+    public static void main(String[] args) throws Exception {
+        Base base = new Base();
+
+        // 预热：Sub 还没有加载，调用点被改写为直接调用 Base.f
+        for (int i = 0; i < 1000; i++) {
+            if (callF(base) != 1 || callG(base) != 10) {
+                System.out.println("wrong result before loading subclass!");
+                return;
+            }
+        }
+
+        // 加载覆盖 f 的子类，同一个调用点必须分派到 Sub.f
+        Base sub = loadSub();
+        if (callF(sub) != 2) {
+            System.out.println("callF(sub) is not deoptimized!");
+            return;
+        }
+        if (callF(base) != 1) {
+            System.out.println("callF(base) is wrong after deoptimization!");
+            return;
+        }
+        // Sub 没有覆盖 g，g 的调用结果不变
+        if (callG(sub) != 10) {
+            System.out.println("callG(sub) is wrong!");
+            return;
+        }
+
+        // 通过反射加载覆盖 g 的子类
+        Base sub2 = (Base) Class.forName("method.ChaDeoptTest$Sub2").newInstance();
+        if (callG(sub2) != 20 || callG(base) != 10 || callF(sub2) != 1) {
+            System.out.println("callG(sub2) is not deoptimized!");
+            return;
+        }
+
+        System.out.println("OK!");
+    }
+
+}
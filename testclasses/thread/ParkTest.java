@@ -0,0 +1,112 @@
+package thread;
+
+import java.util.concurrent.locks.LockSupport;
+
+/**
+ * 测试 LockSupport.park/unpark：
+ * 先 unpark 后 park，相对和绝对时间的超时，以及被中断。
+ */
+public class ParkTest {
+
+    private static volatile boolean done;
+
+    private static boolean check(boolean ok, String what) {
+        if (!ok)
+            System.out.println(what + " failed!");
+        return ok;
+    }
+
+    // 先 unpark，之后的 park 立即返回，许可只有一个
+    private static boolean unparkBeforePark() {
+        Thread self = Thread.currentThread();
+        LockSupport.unpark(self);
+        LockSupport.unpark(self);
+
+        long start = System.nanoTime();
+        LockSupport.park();
+        if (System.nanoTime() - start > 500_000_000L)
+            return false;
+
+        // 许可已被消耗，这次 park 要等到超时（可能伪唤醒，所以多试几次）
+        for (int i = 0; i < 3; i++) {
+            start = System.nanoTime();
+            LockSupport.parkNanos(100_000_000L);
+            if (System.nanoTime() - start >= 50_000_000L)
+                return true;
+        }
+        return false;
+    }
+
+    // 另一个线程先 park，之后被 unpark 唤醒
+    private static boolean unparkAfterPark() throws InterruptedException {
+        done = false;
+        Thread t = new Thread(() -> {
+            while (!done)
+                LockSupport.park();
+        });
+        t.start();
+        Thread.sleep(200);
+        done = true;
+        LockSupport.unpark(t);
+        t.join(5000);
+        return !t.isAlive();
+    }
+
+    private static boolean relativeTimeout() {
+        long start = System.nanoTime();
+        LockSupport.parkNanos(200_000_000L);
+        long elapsed = System.nanoTime() - start;
+        // 可能伪唤醒，不检查下限，只保证没有阻塞太久
+        return elapsed < 5_000_000_000L;
+    }
+
+    private static boolean absoluteTimeout() {
+        long deadline = System.currentTimeMillis() + 200;
+        while (System.currentTimeMillis() < deadline)
+            LockSupport.parkUntil(deadline);
+        // 已过截止时间，立即返回
+        long start = System.nanoTime();
+        LockSupport.parkUntil(deadline - 1000);
+        return System.nanoTime() - start < 500_000_000L;
+    }
+
+    // park 中的线程被中断后返回，中断标志保持
+    private static boolean interruptWhileParked() throws InterruptedException {
+        final boolean[] interrupted = { false };
+        Thread t = new Thread(() -> {
+            while (!Thread.currentThread().isInterrupted())
+                LockSupport.park();
+            interrupted[0] = true;
+        });
+        t.start();
+        Thread.sleep(200);
+        t.interrupt();
+        t.join(5000);
+        return !t.isAlive() && interrupted[0];
+    }
+
+    // 已被中断的线程 park 立即返回
+    private static boolean interruptBeforePark() {
+        Thread.currentThread().interrupt();
+        long start = System.nanoTime();
+        LockSupport.park();
+        boolean ok = System.nanoTime() - start < 500_000_000L;
+        return Thread.interrupted() && ok;
+    }
+
+    public static void main(String[] args) throws InterruptedException {
+        if (!check(unparkBeforePark(), "unpark before park")) return;
+        if (!check(unparkAfterPark(), "unpark after park")) return;
+        if (!check(relativeTimeout(), "parkNanos")) return;
+        if (!check(absoluteTimeout(), "parkUntil")) return;
+        if (!check(interruptWhileParked(), "interrupt while parked")) return;
+        if (!check(interruptBeforePark(), "interrupt before park")) return;
+
+        // unpark 还没有启动的线程什么也不做
+        LockSupport.unpark(new Thread());
+        LockSupport.unpark(null);
+
+        System.out.println("OK!");
+    }
+
+}